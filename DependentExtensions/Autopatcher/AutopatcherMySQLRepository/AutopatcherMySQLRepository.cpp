@@ -402,6 +402,64 @@ int AutopatcherMySQLRepository::GetPatches(const char *applicationName, FileList
 	return true;
 }
 
+bool AutopatcherMySQLRepository::GetNewestFileHash(const char *applicationName, const char *filename, char *hash)
+{
+	char query[1024];
+	RakNet::RakString escapedApplicationName = GetEscapedString(applicationName);
+	RakNet::RakString escapedFilename = GetEscapedString(filename);
+	sprintf(query,
+		"SELECT contentHash, createFile FROM FileVersionHistory "
+		"WHERE applicationId=(SELECT applicationID FROM Applications WHERE applicationName='%s') AND filename='%s' "
+		"ORDER BY fileId DESC LIMIT 1;",
+		escapedApplicationName.C_String(), escapedFilename.C_String());
+
+	MYSQL_RES * result = 0;
+	if (!ExecuteBlockingCommand (query, &result))
+		return false;
+
+	// A file whose newest row deletes it has no version to patch to
+	bool found=false;
+	MYSQL_ROW row = mysql_fetch_row (result);
+	if (row != 0 && row [0] != 0 && row [1][0]=='1' && mysql_fetch_lengths (result) [0]==HASH_LENGTH)
+	{
+		memcpy(hash, row [0], HASH_LENGTH);
+		found=true;
+	}
+	mysql_free_result(result);
+	return found;
+}
+
+bool AutopatcherMySQLRepository::GetFileVersion(const char *applicationName, const char *filename, const char *hash, char **content, unsigned int *contentLength)
+{
+	char query[1024];
+	RakNet::RakString escapedApplicationName = GetEscapedString(applicationName);
+	RakNet::RakString escapedFilename = GetEscapedString(filename);
+	char escapedHash [2 * HASH_LENGTH + 1];
+	mysql_real_escape_string(mySqlConnection, escapedHash, hash, HASH_LENGTH);
+	sprintf(query,
+		"SELECT content FROM FileVersionHistory "
+		"WHERE applicationId=(SELECT applicationID FROM Applications WHERE applicationName='%s') AND filename='%s' AND contentHash='%s' AND createFile=1 "
+		"ORDER BY fileId DESC LIMIT 1;",
+		escapedApplicationName.C_String(), escapedFilename.C_String(), escapedHash);
+
+	MYSQL_RES * result = 0;
+	if (!ExecuteBlockingCommand (query, &result))
+		return false;
+
+	MYSQL_ROW row = mysql_fetch_row (result);
+	if (row == 0 || row [0] == 0)
+	{
+		mysql_free_result(result);
+		return false;
+	}
+
+	*contentLength = (unsigned int) mysql_fetch_lengths (result) [0];
+	*content = new char [*contentLength];
+	memcpy(*content, row [0], *contentLength);
+	mysql_free_result(result);
+	return true;
+}
+
 bool AutopatcherMySQLRepository::GetMostRecentChangelistWithPatches(RakNet::RakString &applicationName, FileList *patchedFiles, FileList *addedFiles, FileList *addedOrModifiedFileHashes, FileList *deletedFiles, double *priorRowPatchTime, double *mostRecentRowPatchTime)
 {
 	// Not yet implemented
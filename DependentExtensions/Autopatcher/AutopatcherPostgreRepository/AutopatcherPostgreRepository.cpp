@@ -552,6 +552,75 @@ int AutopatcherPostgreRepository::GetPatches(const char *applicationName, FileLi
 
 	return 1;
 }
+bool AutopatcherPostgreRepository::GetNewestFileHash(const char *applicationName, const char *filename, char *hash)
+{
+	const char *query = "SELECT contentHash, createFile FROM FileVersionHistory WHERE applicationId=(SELECT applicationID FROM applications WHERE applicationName=$1::text) "
+		"AND filename=$2::text ORDER BY fileId DESC LIMIT 1;";
+	const char *outTemp[2];
+	int outLengths[2];
+	int formats[2];
+	outTemp[0]=applicationName;
+	outLengths[0]=(int) strlen(applicationName);
+	formats[0]=PQEXECPARAM_FORMAT_TEXT;
+	outTemp[1]=filename;
+	outLengths[1]=(int) strlen(filename);
+	formats[1]=PQEXECPARAM_FORMAT_TEXT;
+	PGresult *result = PQexecParams(pgConn, query,2,0,outTemp,outLengths,formats,PQEXECPARAM_FORMAT_BINARY);
+	if (IsResultSuccessful(result, false)==false)
+	{
+		PQclear(result);
+		return false;
+	}
+
+	// A file whose newest row deletes it has no version to patch to
+	bool found=false;
+	if (PQntuples(result)>0)
+	{
+		int contentHashIndex = PQfnumber(result, "contentHash");
+		int createFileIndex = PQfnumber(result, "createFile");
+		if (PQgetvalue(result, 0, createFileIndex)[0]==1 && PQgetlength(result, 0, contentHashIndex)==HASH_LENGTH)
+		{
+			memcpy(hash, PQgetvalue(result, 0, contentHashIndex), HASH_LENGTH);
+			found=true;
+		}
+	}
+	PQclear(result);
+	return found;
+}
+bool AutopatcherPostgreRepository::GetFileVersion(const char *applicationName, const char *filename, const char *hash, char **content, unsigned int *contentLength)
+{
+	const char *query = "SELECT content FROM FileVersionHistory WHERE applicationId=(SELECT applicationID FROM applications WHERE applicationName=$1::text) "
+		"AND filename=$2::text AND contentHash=$3::bytea AND createFile=TRUE ORDER BY fileId DESC LIMIT 1;";
+	const char *outTemp[3];
+	int outLengths[3];
+	int formats[3];
+	outTemp[0]=applicationName;
+	outLengths[0]=(int) strlen(applicationName);
+	formats[0]=PQEXECPARAM_FORMAT_TEXT;
+	outTemp[1]=filename;
+	outLengths[1]=(int) strlen(filename);
+	formats[1]=PQEXECPARAM_FORMAT_TEXT;
+	outTemp[2]=hash;
+	outLengths[2]=HASH_LENGTH;
+	formats[2]=PQEXECPARAM_FORMAT_BINARY;
+	PGresult *result = PQexecParams(pgConn, query,3,0,outTemp,outLengths,formats,PQEXECPARAM_FORMAT_BINARY);
+	if (IsResultSuccessful(result, false)==false)
+	{
+		PQclear(result);
+		return false;
+	}
+	if (PQntuples(result)==0 || PQgetisnull(result, 0, 0))
+	{
+		PQclear(result);
+		return false;
+	}
+
+	*contentLength=(unsigned int) PQgetlength(result, 0, 0);
+	*content = new char[*contentLength];
+	memcpy(*content, PQgetvalue(result, 0, 0), *contentLength);
+	PQclear(result);
+	return true;
+}
 bool AutopatcherPostgreRepository::GetMostRecentChangelistWithPatches(RakNet::RakString &applicationName, FileList *patchedFiles, FileList *addedFiles, FileList *addedOrModifiedFileHashes, FileList *deletedFiles, double *priorRowPatchTime, double *mostRecentRowPatchTime)
 {
 	PGresult *result;
@@ -2161,6 +2230,58 @@ unsigned int AutopatcherPostgreRepository2::GetFilePart( const char *filename, u
 		return bytesRead;
 	}
 }
+bool AutopatcherPostgreRepository2::GetFileVersion(const char *applicationName, const char *filename, const char *hash, char **content, unsigned int *contentLength)
+{
+	const char *query = "SELECT pathToContent FROM FileVersionHistory WHERE applicationId=(SELECT applicationID FROM applications WHERE applicationName=$1::text) "
+		"AND filename=$2::text AND contentHash=$3::bytea AND createFile=TRUE ORDER BY fileId DESC LIMIT 1;";
+	const char *outTemp[3];
+	int outLengths[3];
+	int formats[3];
+	outTemp[0]=applicationName;
+	outLengths[0]=(int) strlen(applicationName);
+	formats[0]=PQEXECPARAM_FORMAT_TEXT;
+	outTemp[1]=filename;
+	outLengths[1]=(int) strlen(filename);
+	formats[1]=PQEXECPARAM_FORMAT_TEXT;
+	outTemp[2]=hash;
+	outLengths[2]=HASH_LENGTH;
+	formats[2]=PQEXECPARAM_FORMAT_BINARY;
+	PGresult *result = PQexecParams(pgConn, query,3,0,outTemp,outLengths,formats,PQEXECPARAM_FORMAT_TEXT);
+	if (IsResultSuccessful(result, false)==false)
+	{
+		PQclear(result);
+		return false;
+	}
+	if (PQntuples(result)==0 || PQgetisnull(result, 0, 0))
+	{
+		PQclear(result);
+		return false;
+	}
+
+	// Every version is kept on the harddrive, at the path stored when it was added
+	const char *path = PQgetvalue(result, 0, 0);
+	FILE *fp = fopen(path, "rb");
+	if (fp==0)
+	{
+		sprintf(lastError,"ERROR: Cannot open file %s in GetFileVersion\n",path);
+		PQclear(result);
+		return false;
+	}
+	PQclear(result);
+
+	fseek(fp, 0, SEEK_END);
+	*contentLength = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	*content = new char[*contentLength];
+	if (fread(*content, 1, *contentLength, fp)!=*contentLength)
+	{
+		delete [] *content;
+		fclose(fp);
+		return false;
+	}
+	fclose(fp);
+	return true;
+}
 const int AutopatcherPostgreRepository::GetIncrementalReadChunkSize(void) const
 {
 	return 262144*4*16;
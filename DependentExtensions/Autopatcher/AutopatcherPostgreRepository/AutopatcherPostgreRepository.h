@@ -99,6 +99,22 @@ public:
 	/// \return true on success, false on failure
 	virtual bool GetMostRecentChangelistWithPatches(RakNet::RakString &applicationName, FileList *patchedFiles, FileList *addedFiles, FileList *addedOrModifiedFileHashes, FileList *deletedFiles, double *priorRowPatchTime, double *mostRecentRowPatchTime);
 
+	/// Get the hash of the newest version of a file. This is used by PatchCache and not usually explicitly called.
+	/// \param[in] applicationName A null terminated string previously passed to AddApplication
+	/// \param[in] filename The file to look up
+	/// \param[out] hash HASH_LENGTH bytes
+	/// \return True on success, false if there is no such file or its newest version deletes it.
+	virtual bool GetNewestFileHash(const char *applicationName, const char *filename, char *hash);
+
+	/// Get the contents of the version of a file with \a hash. This is used by PatchCache and not usually explicitly called.
+	/// \param[in] applicationName A null terminated string previously passed to AddApplication
+	/// \param[in] filename The file to look up
+	/// \param[in] hash HASH_LENGTH bytes, as returned by GetNewestFileHash() or sent by AutopatcherClient
+	/// \param[out] content Allocated with new []. Free it with delete []
+	/// \param[out] contentLength The length of \a content
+	/// \return True on success, false if there is no such version.
+	virtual bool GetFileVersion(const char *applicationName, const char *filename, const char *hash, char **content, unsigned int *contentLength);
+
 	/// If any of the above functions fail, the error string is stored internally.  Call this to get it.
 	virtual const char *GetLastError(void) const;
 
@@ -132,6 +148,7 @@ public:
 	virtual bool GetMostRecentChangelistWithPatches(RakNet::RakString &applicationName, FileList *patchedFiles, FileList *addedFiles, FileList *addedOrModifiedFileHashes, FileList *deletedFiles, double *priorRowPatchTime, double *mostRecentRowPatchTime);
 	virtual bool UpdateApplicationFiles(const char *applicationName, const char *applicationDirectory, const char *userName, FileListProgress *cb);
 	virtual unsigned int GetFilePart( const char *filename, unsigned int startReadBytes, unsigned int numBytesToRead, void *preallocatedDestination, FileListNodeContext context);
+	virtual bool GetFileVersion(const char *applicationName, const char *filename, const char *hash, char **content, unsigned int *contentLength);
 	
 	/// Can override this to create patches using a different tool
 	/// \param[in] oldFile Path to the old version of the file, on disk
@@ -25,6 +25,8 @@
 #include "AutopatcherRepositoryInterface.h"
 #include "RakAssert.h"
 #include "AutopatcherPatchContext.h"
+#include "PatchCache.h"
+#include "GetTime.h"
 #include <stdio.h>
 #include <time.h>
 
@@ -111,6 +113,10 @@ AutopatcherServer::AutopatcherServer()
 	cache_maxTime=0;
 	cacheLoaded=false;
 	allowDownloadOfOriginalUnmodifiedFiles=true;
+	patchCache=0;
+	precomputeCount=0;
+	precomputeInterval=60000;
+	lastPrecomputeTime=0;
 }
 AutopatcherServer::~AutopatcherServer()
 {
@@ -193,6 +199,16 @@ void AutopatcherServer::Update(void)
 		}
 		DeallocPacketUnified(packet);
 	}
+
+	if (patchCache && precomputeCount>0 && threadPool.WasStarted() && RakNet::GetTimeMS()-lastPrecomputeTime>=precomputeInterval)
+	{
+		// In the background only, so precomputing does not hold up requests
+		threadPool.LockInput();
+		bool idle = threadPool.InputSize()==0 && threadPool.NumThreadsWorking()==0;
+		threadPool.UnlockInput();
+		if (idle)
+			PrecomputePatches();
+	}
 }
 PluginReceiveResult AutopatcherServer::OnReceive(Packet *packet)
 {
@@ -498,6 +514,9 @@ AutopatcherServer::ResultTypeAndBitstream* GetPatchCB(AutopatcherServer::ThreadD
 //	RakAssert(server->repository);
 //	if (server->repository->GetPatches(threadData.applicationName.C_String(), threadData.clientList, rtab.patchList, currentDate))
 	rtab.resultCode = repository->GetPatches(threadData.applicationName.C_String(), threadData.clientList, server->allowDownloadOfOriginalUnmodifiedFiles, rtab.patchList);
+	FileList cachedPatchList;
+	if (rtab.resultCode==1 && server->patchCache && server->PatchFromCache(repository, threadData.applicationName.C_String(), threadData.clientList, rtab.patchList, &cachedPatchList))
+		rtab.patchList=&cachedPatchList;
 	rtab.operation=AutopatcherServer::ResultTypeAndBitstream::GET_PATCH;
 	rtab.setId=threadData.setId;
 	rtab.currentDate=(double) time(NULL);
@@ -572,6 +591,14 @@ AutopatcherServer::ResultTypeAndBitstream* GetPatchCB(AutopatcherServer::ThreadD
 	// return rtab;
 	return 0;
 }
+AutopatcherServer::ResultTypeAndBitstream* PrecomputePatchesCB(AutopatcherServer::ThreadData threadData, bool *returnOutput, void* perThreadData)
+{
+	AutopatcherServer *server = threadData.server;
+	AutopatcherRepositoryInterface *repository = (AutopatcherRepositoryInterface*)perThreadData;
+	server->patchCache->Precompute(repository, server->precomputeCount);
+	*returnOutput=false;
+	return 0;
+}
 }
 PluginReceiveResult AutopatcherServer::OnGetPatch(Packet *packet)
 {
@@ -854,6 +881,82 @@ void AutopatcherServer::SetAllowDownloadOfOriginalUnmodifiedFiles(bool allow)
 {
 	allowDownloadOfOriginalUnmodifiedFiles = allow;
 }
+void AutopatcherServer::SetPatchCache(PatchCache *cache, unsigned int _precomputeCount, RakNet::TimeMS _precomputeInterval)
+{
+	patchCache=cache;
+	precomputeCount=_precomputeCount;
+	precomputeInterval=_precomputeInterval;
+}
+void AutopatcherServer::PrecomputePatches(void)
+{
+	if (patchCache==0 || precomputeCount==0)
+		return;
+
+	lastPrecomputeTime=RakNet::GetTimeMS();
+	ThreadData threadData;
+	threadData.server=this;
+	threadData.lastUpdateDate=0;
+	threadData.systemAddress=UNASSIGNED_SYSTEM_ADDRESS;
+	threadData.clientList=0;
+	threadData.setId=0;
+	threadPool.AddInput(PrecomputePatchesCB, threadData);
+}
+bool AutopatcherServer::PatchFromCache(AutopatcherRepositoryInterface *repository, const char *applicationName, FileList *clientList, FileList *patchList, FileList *cachedPatchList)
+{
+	bool anyPatched=false;
+	unsigned int i,j;
+	for (i=0; i < patchList->fileList.Size(); i++)
+	{
+		FileListNode &node = patchList->fileList[i];
+		bool patched=false;
+
+		// The repository sends the whole file when it has no patch from the version the client has
+		if (node.context.op==PC_WRITE_FILE)
+		{
+			for (j=0; j < clientList->fileList.Size(); j++)
+			{
+				if (clientList->fileList[j].filename==node.filename)
+					break;
+			}
+
+			char newHash[HASH_LENGTH];
+			char *patch;
+			unsigned int patchLength;
+			if (j < clientList->fileList.Size() && clientList->fileList[j].data && clientList->fileList[j].dataLengthBytes==HASH_LENGTH &&
+				repository->GetNewestFileHash(applicationName, node.filename.C_String(), newHash) &&
+				memcmp(newHash, clientList->fileList[j].data, HASH_LENGTH)!=0 &&
+				patchCache->GetPatch(repository, applicationName, node.filename.C_String(), clientList->fileList[j].data, newHash, &patch, &patchLength))
+			{
+				if (patchLength+HASH_LENGTH < node.fileLengthBytes)
+				{
+					// Nothing is copied until a patch is found, so the common case of no patches costs no copy of patchList
+					if (anyPatched==false)
+					{
+						for (j=0; j < i; j++)
+						{
+							FileListNode &prior = patchList->fileList[j];
+							cachedPatchList->AddFile(prior.filename, prior.fullPathToFile, prior.data, prior.dataLengthBytes, prior.fileLengthBytes, prior.context, prior.isAReference);
+						}
+					}
+
+					// As the repositories send patches: the hash of the new version then the patch, with patchAlgorithm 0 for CreatePatch()
+					char *data = new char[HASH_LENGTH+patchLength];
+					memcpy(data, newHash, HASH_LENGTH);
+					memcpy(data+HASH_LENGTH, patch, patchLength);
+					cachedPatchList->AddFile(node.filename, node.fullPathToFile, data, HASH_LENGTH+patchLength, node.fileLengthBytes, FileListNodeContext(PC_HASH_1_WITH_PATCH,0,0,0), false);
+					delete [] data;
+					patched=true;
+					anyPatched=true;
+				}
+				delete [] patch;
+			}
+		}
+
+		if (patched==false && anyPatched)
+			cachedPatchList->AddFile(node.filename, node.fullPathToFile, node.data, node.dataLengthBytes, node.fileLengthBytes, node.context, node.isAReference);
+	}
+	return anyPatched;
+}
 unsigned int AutopatcherServer::GetFilePart( const char *filename, unsigned int startReadBytes, unsigned int numBytesToRead, void *preallocatedDestination, FileListNodeContext context)
 {
 	/*
@@ -35,6 +35,7 @@
 #include "RakString.h"
 #include "FileList.h"
 #include "IncrementalReadInterface.h"
+#include "RakNetTime.h"
 
 namespace RakNet
 {
@@ -43,6 +44,7 @@ class RakPeerInterface;
 struct Packet;
 class AutopatcherRepositoryInterface;
 class FileListTransfer;
+class PatchCache;
 
 class RAK_DLL_EXPORT AutopatcherServerLoadNotifier
 {
@@ -195,6 +197,18 @@ public:
 	/// \param[in] allow True to allow downloading original game files, false to disallow
 	void SetAllowDownloadOfOriginalUnmodifiedFiles(bool allow);
 
+	/// Make patches for clients whose version of a file the repository has no patch from, rather than sending them the whole file
+	/// Patches are kept in \a cache, so that clients upgrading from the same version only cost one CreatePatch()
+	/// The repositories passed to StartThreads() must implement AutopatcherRepositoryInterface::GetNewestFileHash() and AutopatcherRepositoryInterface::GetFileVersion()
+	/// \param[in] cache An externally allocated instance of PatchCache. Pass 0 to send the whole file, which is the default
+	/// \param[in] precomputeCount While no requests are being processed, PatchCache::Precompute() is called with this count on a worker thread. Pass 0 to not precompute
+	/// \param[in] precomputeInterval The least time between calls to PatchCache::Precompute(), in milliseconds
+	void SetPatchCache(PatchCache *cache, unsigned int precomputeCount=0, RakNet::TimeMS precomputeInterval=60000);
+
+	/// Call PatchCache::Precompute() on a worker thread now, such as after adding a version to the repository
+	/// Does nothing unless SetPatchCache() was called with a \a precomputeCount
+	void PrecomputePatches(void);
+
 	/// Clear buffered input and output
 	void Clear(void);
 
@@ -247,6 +261,7 @@ public:
 protected:
 	friend AutopatcherServer::ResultTypeAndBitstream* GetChangelistSinceDateCB(AutopatcherServer::ThreadData pap, bool *returnOutput, void* perThreadData);
 	friend AutopatcherServer::ResultTypeAndBitstream* GetPatchCB(AutopatcherServer::ThreadData pap, bool *returnOutput, void* perThreadData);
+	friend AutopatcherServer::ResultTypeAndBitstream* PrecomputePatchesCB(AutopatcherServer::ThreadData pap, bool *returnOutput, void* perThreadData);
 	PluginReceiveResult OnGetChangelistSinceDate(Packet *packet);
 	PluginReceiveResult OnGetPatch(Packet *packet);
 	void OnGetChangelistSinceDateInt(Packet *packet);
@@ -255,6 +270,8 @@ protected:
 	void PerThreadDestructor(void* factoryResult, void *context);
 	void RemoveFromThreadPool(SystemAddress systemAddress);
 	virtual unsigned int GetFilePart( const char *filename, unsigned int startReadBytes, unsigned int numBytesToRead, void *preallocatedDestination, FileListNodeContext context);
+	// Copies patchList to cachedPatchList, with whole files the client has an older version of replaced by patches from patchCache. Returns true if any were replaced, otherwise cachedPatchList is left empty
+	bool PatchFromCache(AutopatcherRepositoryInterface *repository, const char *applicationName, FileList *clientList, FileList *patchList, FileList *cachedPatchList);
 
 	//AutopatcherRepositoryInterface *repository;
 	FileListTransfer *fileListTransfer;
@@ -298,6 +315,10 @@ protected:
 	double cache_minTime, cache_maxTime;
 	bool cacheLoaded;
 	bool allowDownloadOfOriginalUnmodifiedFiles;
+
+	PatchCache *patchCache;
+	unsigned int precomputeCount;
+	RakNet::TimeMS precomputeInterval, lastPrecomputeTime;
 };
 
 } // namespace RakNet
@@ -25,6 +25,12 @@
  */
  
 #include "MemoryCompressor.h"
+#include "CreatePatch.h"
+#include "ThreadPool.h"
+#include "SignaledEvent.h"
+#include "SimpleMutex.h"
+#include "GetTime.h"
+#include "DS_List.h"
 
 #if 0
 __FBSDID("$FreeBSD: src/usr.bin/bsdiff/bsdiff/bsdiff.c,v 1.1 2005/08/06 01:59:05 cperciva Exp $");
@@ -70,19 +76,19 @@ static void errx(int i, ...)
 #define O_BINARY _O_BINARY 
 #endif
 
-static void split(off_t *I,off_t *V,off_t start,off_t len,off_t h)
+static void split(off_t *I,off_t *V,const off_t *Vr,off_t start,off_t len,off_t h)
 {
 	off_t i,j,k,x,tmp,jj,kk;
 
 	if(len<16) {
 		for(k=start;k<start+len;k+=j) {
-			j=1;x=V[I[k]+h];
+			j=1;x=Vr[I[k]+h];
 			for(i=1;k+i<start+len;i++) {
-				if(V[I[k+i]+h]<x) {
-					x=V[I[k+i]+h];
+				if(Vr[I[k+i]+h]<x) {
+					x=Vr[I[k+i]+h];
 					j=0;
 				};
-				if(V[I[k+i]+h]==x) {
+				if(Vr[I[k+i]+h]==x) {
 					tmp=I[k+j];I[k+j]=I[k+i];I[k+i]=tmp;
 					j++;
 				};
@@ -93,19 +99,19 @@ static void split(off_t *I,off_t *V,off_t start,off_t len,off_t h)
 		return;
 	};
 
-	x=V[I[start+len/2]+h];
+	x=Vr[I[start+len/2]+h];
 	jj=0;kk=0;
 	for(i=start;i<start+len;i++) {
-		if(V[I[i]+h]<x) jj++;
-		if(V[I[i]+h]==x) kk++;
+		if(Vr[I[i]+h]<x) jj++;
+		if(Vr[I[i]+h]==x) kk++;
 	};
 	jj+=start;kk+=jj;
 
 	i=start;j=0;k=0;
 	while(i<jj) {
-		if(V[I[i]+h]<x) {
+		if(Vr[I[i]+h]<x) {
 			i++;
-		} else if(V[I[i]+h]==x) {
+		} else if(Vr[I[i]+h]==x) {
 			tmp=I[i];I[i]=I[jj+j];I[jj+j]=tmp;
 			j++;
 		} else {
@@ -115,7 +121,7 @@ static void split(off_t *I,off_t *V,off_t start,off_t len,off_t h)
 	};
 
 	while(jj+j<kk) {
-		if(V[I[jj+j]+h]==x) {
+		if(Vr[I[jj+j]+h]==x) {
 			j++;
 		} else {
 			tmp=I[jj+j];I[jj+j]=I[kk+k];I[kk+k]=tmp;
@@ -123,18 +129,19 @@ static void split(off_t *I,off_t *V,off_t start,off_t len,off_t h)
 		};
 	};
 
-	if(jj>start) split(I,V,start,jj-start,h);
+	if(jj>start) split(I,V,Vr,start,jj-start,h);
 
 	for(i=0;i<kk-jj;i++) V[I[jj+i]]=kk-1;
 	if(jj==kk-1) I[jj]=-1;
 
-	if(start+len>kk) split(I,V,kk,start+len-kk,h);
+	if(start+len>kk) split(I,V,Vr,kk,start+len-kk,h);
 }
 
-static void qsufsort(off_t *I,off_t *V,u_char *old,off_t oldsize)
+// Sorts the suffixes by their first byte, which is the first pass of qsufsort
+static void qsufsortInit(off_t *I,off_t *V,u_char *old,off_t oldsize)
 {
 	off_t buckets[256];
-	off_t i,h,len;
+	off_t i;
 
 	//for(i=0;i<256;i++) buckets[i]=0;
 	memset(buckets, 0, sizeof(buckets));
@@ -149,6 +156,13 @@ static void qsufsort(off_t *I,off_t *V,u_char *old,off_t oldsize)
 	V[oldsize]=0;
 	for(i=1;i<256;i++) if(buckets[i]==buckets[i-1]+1) I[buckets[i]]=-1;
 	I[0]=-1;
+}
+
+static void qsufsort(off_t *I,off_t *V,u_char *old,off_t oldsize)
+{
+	off_t i,h,len;
+
+	qsufsortInit(I,V,old,oldsize);
 
 	for(h=1;I[0]!=-(oldsize+1);h+=h) {
 		len=0;
@@ -159,7 +173,7 @@ static void qsufsort(off_t *I,off_t *V,u_char *old,off_t oldsize)
 			} else {
 				if(len) I[i-len]=-len;
 				len=V[I[i]]+1-i;
-				split(I,V,i,len,h);
+				split(I,V,V,i,len,h);
 				i+=len;
 				len=0;
 			};
@@ -170,6 +184,130 @@ static void qsufsort(off_t *I,off_t *V,u_char *old,off_t oldsize)
 	for(i=0;i<oldsize+1;i++) I[V[i]]=i;
 }
 
+// Jobs of a pass of qsufsortThreaded() not yet done. jobsDone is set when the last one is
+struct SplitPass
+{
+	RakNet::SimpleMutex mutex;
+	unsigned int jobsRemaining;
+	RakNet::SignaledEvent jobsDone;
+};
+
+// Groups of suffixes that one pass of qsufsortThreaded() splits, as a job for a thread
+struct SplitJob
+{
+	off_t *I,*V;
+	const off_t *Vr;
+	// Start and length of each group
+	const off_t *groups;
+	unsigned int firstGroup, groupCount;
+	off_t h;
+	SplitPass *pass;
+};
+
+static void runSplitJob(SplitJob *job)
+{
+	for(unsigned int g=job->firstGroup;g<job->firstGroup+job->groupCount;g++)
+		split(job->I,job->V,job->Vr,job->groups[g*2],job->groups[g*2+1],job->h);
+
+	job->pass->mutex.Lock();
+	bool lastJob=--job->pass->jobsRemaining==0;
+	job->pass->mutex.Unlock();
+	if(lastJob)
+		job->pass->jobsDone.SetEvent();
+}
+
+static SplitJob* SplitJobCB(SplitJob *job, bool *returnOutput, void *perThreadData)
+{
+	(void) perThreadData;
+	runSplitJob(job);
+	*returnOutput=false;
+	return job;
+}
+
+// Jobs per thread in each pass, so threads given groups that split quickly are not left idle
+static const unsigned int SPLIT_JOBS_PER_THREAD=4;
+
+// Same result as qsufsort, with the groups of each pass split on threadPool as well as this thread.
+// A group split on one thread reads the group numbers of suffixes another thread may be changing,
+// so each pass reads from Vr, a copy of V from before the pass, rather than from V as qsufsort does
+static void qsufsortThreaded(off_t *I,off_t *V,off_t *Vr,u_char *old,off_t oldsize,
+		ThreadPool<SplitJob*,SplitJob*> *threadPool,int threadCount)
+{
+	off_t i,h,len;
+	DataStructures::List<off_t> groups;
+	DataStructures::List<SplitJob> jobs;
+	SplitPass pass;
+	pass.jobsDone.InitEvent();
+
+	qsufsortInit(I,V,old,oldsize);
+
+	for(h=1;I[0]!=-(oldsize+1);h+=h) {
+		// Find the groups to split, joining runs of sorted suffixes as qsufsort does.
+		// Splitting a group only changes V for the suffixes in it, so this finds the same groups
+		off_t groupedLength=0;
+		groups.Clear(true);
+		len=0;
+		for(i=0;i<oldsize+1;) {
+			if(I[i]<0) {
+				len-=I[i];
+				i-=I[i];
+			} else {
+				if(len) I[i-len]=-len;
+				len=V[I[i]]+1-i;
+				groups.Insert(i);
+				groups.Insert(len);
+				groupedLength+=len;
+				i+=len;
+				len=0;
+			};
+		};
+		if(len) I[i-len]=-len;
+		if(groups.Size()==0) continue;
+
+		memcpy(Vr,V,(oldsize+1)*sizeof(off_t));
+
+		// Share the groups between jobs with about the same number of suffixes each
+		off_t jobLength=groupedLength/(threadCount*SPLIT_JOBS_PER_THREAD)+1;
+		unsigned int groupCount=groups.Size()/2;
+		jobs.Clear(true);
+		for(unsigned int g=0;g<groupCount;) {
+			SplitJob job;
+			job.I=I;job.V=V;job.Vr=Vr;
+			job.groups=&groups[0];
+			job.firstGroup=g;
+			job.h=h;
+			job.pass=&pass;
+			off_t length=0;
+			while(g<groupCount && length<jobLength) {
+				length+=groups[g*2+1];
+				g++;
+			};
+			job.groupCount=g-job.firstGroup;
+			jobs.Insert(job);
+		};
+		pass.mutex.Lock();
+		pass.jobsRemaining=jobs.Size();
+		pass.mutex.Unlock();
+		for(unsigned int j=1;j<jobs.Size();j++)
+			threadPool->AddInput(SplitJobCB,&jobs[j]);
+
+		runSplitJob(&jobs[0]);
+		threadPool->RunInput();
+		// Then block until the threads finish the jobs they took. The event may still be set from an earlier pass, so check the count each time it wakes
+		for(;;) {
+			pass.mutex.Lock();
+			unsigned int jobsRemaining=pass.jobsRemaining;
+			pass.mutex.Unlock();
+			if(jobsRemaining==0)
+				break;
+			pass.jobsDone.WaitOnEvent(1000);
+		};
+	};
+
+	pass.jobsDone.CloseEvent();
+	for(i=0;i<oldsize+1;i++) I[V[i]]=i;
+}
+
 static off_t matchlen(u_char *old,off_t oldsize,u_char *_new,off_t newsize)
 {
 	off_t i;
@@ -236,15 +374,50 @@ static void offtout(off_t x,u_char *buf)
 	if(x<0) buf[7]|=0x80;
 }
 
-// This function modifies the main() function included in bsdiff.c of bsdiff-4.3 found at http://www.daemonology.net/bsdiff/
-// It is changed to be a standalone function, to work entirely in memory, and to use my class MemoryCompressor as an interface to BZip
-// Up to the caller to delete out
-bool CreatePatch(const char *old, unsigned oldsize, char *_new, unsigned int newsize, char **out, unsigned *outSize)
+// Smallest CreatePatchOptions::windowSize used
+static const unsigned int MIN_WINDOW_SIZE=65536;
+
+// Compressed ctrl, diff and extra blocks of a patch, written a part of the new file at a time
+struct PatchWriter
+{
+	MemoryCompressor ctrl,diff,extra;
+	// The last ctrl triple is held back, as the seek at its end depends on where the next part starts in old
+	bool hasPending;
+	off_t pendingDiffLength,pendingExtraLength,pendingOldEnd,pendingNextOldStart;
+};
+
+static bool writeControl(PatchWriter *writer)
+{
+	u_char buf[8];
+	offtout(writer->pendingDiffLength,buf);
+	if (writer->ctrl.Compress((char*)buf, 8, false)==false)
+		return false;
+	offtout(writer->pendingExtraLength,buf);
+	if (writer->ctrl.Compress((char*)buf, 8, false)==false)
+		return false;
+	offtout(writer->pendingNextOldStart-writer->pendingOldEnd,buf);
+	return writer->ctrl.Compress((char*)buf, 8, false);
+}
+
+// oldStart and nextOldStart are positions in the whole old file
+static bool addControl(PatchWriter *writer,off_t oldStart,off_t diffLength,off_t extraLength,off_t nextOldStart)
+{
+	if (writer->hasPending && writeControl(writer)==false)
+		return false;
+	writer->hasPending=true;
+	writer->pendingDiffLength=diffLength;
+	writer->pendingExtraLength=extraLength;
+	writer->pendingOldEnd=oldStart+diffLength;
+	writer->pendingNextOldStart=nextOldStart;
+	return true;
+}
+
+// The bsdiff comparison of _new against old, whose sorted suffixes are in I. oldOffset is where old starts in the whole old file.
+// db and eb must hold newsize bytes. Returns in matchOffset how far into old the last match was from where it is in _new,
+// and in diffLength the bytes stored as differences from old rather than as extra bytes
+static bool diffWindow(off_t *I,u_char *old,off_t oldsize,off_t oldOffset,u_char *_new,off_t newsize,
+		u_char *db,u_char *eb,PatchWriter *writer,off_t *matchOffset,off_t *diffLength)
 {
-//	int fd;
-//	u_char *old,*new;
-//	off_t oldsize,newsize;
-	off_t *I,*V;
 	off_t scan,pos,len;
 	off_t lastscan,lastpos,lastoffset;
 	off_t oldscore,scsc;
@@ -252,92 +425,10 @@ bool CreatePatch(const char *old, unsigned oldsize, char *_new, unsigned int new
 	off_t overlap,Ss,lens;
 	off_t i;
 	off_t dblen,eblen;
-	u_char *db,*eb;
-	u_char buf[8];
-	u_char header[32];
-	MemoryCompressor patch;
-//	unsigned outWriteOffset;
-//	FILE * pf;
-//	BZFILE * pfbz2;
-//	int bz2err;
-
-
-//	if(argc!=4) errx(1,"usage: %s oldfile newfile patchfile\n",argv[0]);
-
-	/* Allocate oldsize+1 bytes instead of oldsize bytes to ensure
-		that we never try to malloc(0) and get a NULL pointer */
-	/*
-	if(((fd=open(argv[1],O_RDONLY | _O_BINARY ,0))<0) ||
-		((oldsize=lseek(fd,0,SEEK_END))==-1) ||
-		((old=malloc(oldsize+1))==NULL) ||
-		(lseek(fd,0,SEEK_SET)!=0) ||
-		(read(fd,old,oldsize)!=oldsize) ||
-		(close(fd)==-1)) err(1,"%s",argv[1]);
-		*/
-
-	if(((I=(off_t*)malloc((oldsize+1)*sizeof(off_t)))==NULL) ||
-		((V=(off_t*)malloc((oldsize+1)*sizeof(off_t)))==NULL))
-		// err(1,NULL);
-			return false;
-
-	qsufsort(I,V,(u_char*)old,oldsize);
-
-	free(V);
-
-	/* Allocate newsize+1 bytes instead of newsize bytes to ensure
-		that we never try to malloc(0) and get a NULL pointer */
-	/*
-	if(((fd=open(argv[2],O_RDONLY | _O_BINARY ,0))<0) ||
-		((newsize=lseek(fd,0,SEEK_END))==-1) ||
-		((new=malloc(newsize+1))==NULL) ||
-		(lseek(fd,0,SEEK_SET)!=0) ||
-		(read(fd,new,newsize)!=newsize) ||
-		(close(fd)==-1)) err(1,"%s",argv[2]);
-
-		*/
-
-	if(((db=(u_char*)malloc(newsize+1))==NULL) ||
-		((eb=(u_char*)malloc(newsize+1))==NULL))
-		// err(1,NULL);
-		{
-			free(I);
-			return false;
-		}
 
 	dblen=0;
 	eblen=0;
-
-	/* Create the patch file */
-//	if ((pf = fopen(argv[3], "wb")) == NULL)
-//		err(1, "%s", argv[3]);
-
-	/* Header is
-		0	8	 "BSDIFF40"
-		8	8	length of bzip2ed ctrl block
-		16	8	length of bzip2ed diff block
-		24	8	length of new file */
-	/* File is
-		0	32	Header
-		32	??	Bzip2ed ctrl block
-		??	??	Bzip2ed diff block
-		??	??	Bzip2ed extra block */
-
-	memcpy(header,"BSDIFF40",8);
-	offtout(0, header + 8);
-	offtout(0, header + 16);
-	offtout(newsize, header + 24);
-//	if (fwrite(header, 32, 1, pf) != 1)
-//		err(1, "fwrite(%s)", argv[3]);
-
-	// Allocate enough to hold any output
-//	*out = (char*) malloc(oldsize+newsize);
-	// Copy out the header
-//	memcpy(*out, header, 32);
-	//outWriteOffset=32;
-
-	/* Compute the differences, writing ctrl as we go */
-//	if ((pfbz2 = BZ2_bzWriteOpen(&bz2err, pf, 9, 0, 0)) == NULL)
-//		errx(1, "BZ2_bzWriteOpen, bz2err = %d", bz2err);
+	pos=0;
 
 	scan=0;len=0;
 	lastscan=0;lastpos=0;lastoffset=0;
@@ -345,7 +436,7 @@ bool CreatePatch(const char *old, unsigned oldsize, char *_new, unsigned int new
 		oldscore=0;
 
 		for(scsc=scan+=len;scan<newsize;scan++) {
-			len=search(I,(u_char*)old,oldsize,(u_char*)_new+scan,newsize-scan,
+			len=search(I,old,oldsize,_new+scan,newsize-scan,
 					0,oldsize,&pos);
 
 			for(;scsc<scan+len;scsc++)
@@ -401,41 +492,8 @@ bool CreatePatch(const char *old, unsigned oldsize, char *_new, unsigned int new
 			dblen+=lenf;
 			eblen+=(scan-lenb)-(lastscan+lenf);
 
-			offtout(lenf,buf);
-			if (patch.Compress((char*)buf, 8, false)==false)
-			{
-				free(db);
-				free(eb);
-				free(I);
-				return false;
-			}
-			//BZ2_bzWrite(&bz2err, pfbz2, buf, 8);
-			//if (bz2err != BZ_OK)
-			//	errx(1, "BZ2_bzWrite, bz2err = %d", bz2err);
-
-			offtout((scan-lenb)-(lastscan+lenf),buf);
-			if (patch.Compress((char*)buf, 8, false)==false)
-			{
-				free(db);
-				free(eb);
-				free(I);
-				return false;
-			}
-			//BZ2_bzWrite(&bz2err, pfbz2, buf, 8);
-			//if (bz2err != BZ_OK)
-			//	errx(1, "BZ2_bzWrite, bz2err = %d", bz2err);
-
-			offtout((pos-lenb)-(lastpos+lenf),buf);
-			if (patch.Compress((char*)buf, 8, false)==false)
-			{
-				free(db);
-				free(eb);
-				free(I);
+			if (addControl(writer,oldOffset+lastpos,lenf,(scan-lenb)-(lastscan+lenf),oldOffset+pos-lenb)==false)
 				return false;
-			}
-			//BZ2_bzWrite(&bz2err, pfbz2, buf, 8);
-			//if (bz2err != BZ_OK)
-			//	errx(1, "BZ2_bzWrite, bz2err = %d", bz2err);
 
 			lastscan=scan-lenb;
 			lastpos=pos-lenb;
@@ -443,101 +501,155 @@ bool CreatePatch(const char *old, unsigned oldsize, char *_new, unsigned int new
 		};
 	};
 
-//	BZ2_bzWriteClose(&bz2err, pfbz2, 0, NULL, NULL);
-//	if (bz2err != BZ_OK)
-//		errx(1, "BZ2_bzWriteClose, bz2err = %d", bz2err);
+	*matchOffset=lastoffset;
+	*diffLength=dblen;
+	return writer->diff.Compress((char*)db,(unsigned)dblen,false) &&
+		writer->extra.Compress((char*)eb,(unsigned)eblen,false);
+}
 
-	/* Compute size of compressed ctrl data */
-//	if ((len = ftello(pf)) == -1)
-//		err(1, "ftello");
-	if (patch.Compress(0,0,true)==false)
-	{
-		free(db);
-		free(eb);
-		free(I);
-		return false;
+// Arrays used while creating a patch, freed when it returns
+struct PatchArrays
+{
+	PatchArrays() {I=V=Vr=0;db=eb=0;}
+	~PatchArrays() {free(I);free(V);free(Vr);free(db);free(eb);}
+	off_t *I,*V,*Vr;
+	u_char *db,*eb;
+};
+
+// This function modifies the main() function included in bsdiff.c of bsdiff-4.3 found at http://www.daemonology.net/bsdiff/
+// It is changed to be a standalone function, to work entirely in memory, and to use my class MemoryCompressor as an interface to BZip
+// Up to the caller to delete out
+bool CreatePatch(const char *old, unsigned oldsize, char *_new, unsigned int newsize, char **out, unsigned *outSize)
+{
+	return CreatePatch(old, oldsize, _new, newsize, out, outSize, CreatePatchOptions());
+}
+
+bool CreatePatch(const char *old, unsigned oldsize, char *_new, unsigned int newsize, char **out, unsigned *outSize, const CreatePatchOptions &options, CreatePatchStatistics *statistics)
+{
+	PatchArrays arrays;
+	PatchWriter writer;
+	u_char header[32];
+	off_t oldWindowSize, newWindowSize;
+	off_t indexedStart;
+	off_t newStart, newLength, oldStart;
+	off_t matchOffset=0, diffLength=0;
+	unsigned long long workingMemory=0, peakWorkingMemory=0;
+	RakNet::TimeUS sortTime=0, diffTime=0;
+	ThreadPool<SplitJob*,SplitJob*> threadPool;
+
+	// Without a window the whole of old is indexed, and the whole of new compared against it
+	if (options.windowSize==0) {
+		oldWindowSize=oldsize;
+		newWindowSize=newsize;
+	} else {
+		unsigned int windowSize=options.windowSize < MIN_WINDOW_SIZE ? MIN_WINDOW_SIZE : options.windowSize;
+		oldWindowSize=MIN((off_t)windowSize,(off_t)oldsize);
+		newWindowSize=windowSize/2;
 	}
-	len=patch.GetTotalOutputSize()+32; // test: len should be 188
-	offtout(len-32, header + 8);
-	//memcpy(*out+outWriteOffset, patch.GetOutput(), patch.GetTotalOutputSize());
-	//outWriteOffset+=patch.GetTotalOutputSize();
-	//patch.Clear();
-	
 
-	/* Write compressed diff data */
-//	if ((pfbz2 = BZ2_bzWriteOpen(&bz2err, pf, 9, 0, 0)) == NULL)
-//		errx(1, "BZ2_bzWriteOpen, bz2err = %d", bz2err);
-//	BZ2_bzWrite(&bz2err, pfbz2, db, dblen);
-	if (patch.Compress((char*)db,dblen,true)==false)
-	{
-		free(db);
-		free(eb);
-		free(I);
+	/* Allocate oldsize+1 entries so I and V are never empty */
+	if ((arrays.I=(off_t*)malloc((oldWindowSize+1)*sizeof(off_t)))==NULL)
 		return false;
-	}
-//	memcpy(*out+outWriteOffset, patch.GetOutput(), patch.GetTotalOutputSize());
-//	outWriteOffset+=patch.GetTotalOutputSize();
-//	patch.Clear();
-//	if (bz2err != BZ_OK)
-//		errx(1, "BZ2_bzWrite, bz2err = %d", bz2err);
-//	BZ2_bzWriteClose(&bz2err, pfbz2, 0, NULL, NULL);
-//	if (bz2err != BZ_OK)
-//		errx(1, "BZ2_bzWriteClose, bz2err = %d", bz2err);
+	workingMemory+=(oldWindowSize+1)*sizeof(off_t);
 
-	/* Compute size of compressed diff data */
-//	if ((newsize = ftello(pf)) == -1)
-//		err(1, "ftello");
-	newsize=32+patch.GetTotalOutputSize();
-	offtout(newsize - len, header + 16);
-//	memcpy(*out+outWriteOffset, patch.GetOutput(), patch.GetTotalOutputSize());
-//	outWriteOffset+=patch.GetTotalOutputSize();
-//	patch.Clear();
+	bool useThreads=options.threadCount > 1 && threadPool.StartThreads(options.threadCount-1, 0);
 
-	/* Write compressed extra data */
-//	if ((pfbz2 = BZ2_bzWriteOpen(&bz2err, pf, 9, 0, 0)) == NULL)
-//		errx(1, "BZ2_bzWriteOpen, bz2err = %d", bz2err);
-//	BZ2_bzWrite(&bz2err, pfbz2, eb, eblen);
-	if (patch.Compress((char*)eb,eblen,true)==false)
-	{
-		free(db);
-		free(eb);
-		free(I);
-		return false;
+	/* Header is
+		0	8	 "BSDIFF40"
+		8	8	length of bzip2ed ctrl block
+		16	8	length of bzip2ed diff block
+		24	8	length of new file */
+	/* File is
+		0	32	Header
+		32	??	Bzip2ed ctrl block
+		??	??	Bzip2ed diff block
+		??	??	Bzip2ed extra block */
+
+	memcpy(header,"BSDIFF40",8);
+	offtout(newsize, header + 24);
+
+	writer.hasPending=false;
+	indexedStart=-1;
+	for (newStart=0; newStart < (off_t) newsize; newStart+=newLength) {
+		newLength=MIN(newWindowSize,(off_t)newsize-newStart);
+
+		// Index the part of old where the last part of new was found, or failing that in the same relative position as this part of new
+		oldStart=0;
+		if (oldWindowSize < (off_t) oldsize) {
+			if (diffLength >= newWindowSize/2)
+				oldStart=newStart+newLength/2+matchOffset-oldWindowSize/2;
+			else
+				oldStart=(off_t)((double)(newStart+newLength/2)*oldsize/newsize)-oldWindowSize/2;
+			if (oldStart < 0)
+				oldStart=0;
+			if (oldStart > (off_t) oldsize-oldWindowSize)
+				oldStart=(off_t) oldsize-oldWindowSize;
+		}
+
+		if (oldStart!=indexedStart) {
+			RakNet::TimeUS startTime=RakNet::GetTimeUS();
+			if ((arrays.V=(off_t*)malloc((oldWindowSize+1)*sizeof(off_t)))==NULL)
+				return false;
+			unsigned long long sortMemory=(oldWindowSize+1)*sizeof(off_t);
+			if (useThreads) {
+				if ((arrays.Vr=(off_t*)malloc((oldWindowSize+1)*sizeof(off_t)))==NULL)
+					return false;
+				sortMemory+=(oldWindowSize+1)*sizeof(off_t);
+				qsufsortThreaded(arrays.I,arrays.V,arrays.Vr,(u_char*)old+oldStart,oldWindowSize,&threadPool,options.threadCount);
+			} else
+				qsufsort(arrays.I,arrays.V,(u_char*)old+oldStart,oldWindowSize);
+			if (workingMemory+sortMemory > peakWorkingMemory)
+				peakWorkingMemory=workingMemory+sortMemory;
+			free(arrays.V);
+			free(arrays.Vr);
+			arrays.V=arrays.Vr=0;
+			indexedStart=oldStart;
+			sortTime+=RakNet::GetTimeUS()-startTime;
+		}
+
+		/* Allocate newWindowSize+1 bytes instead of newWindowSize bytes to ensure
+			that we never try to malloc(0) and get a NULL pointer */
+		if (arrays.db==0) {
+			if(((arrays.db=(u_char*)malloc(newWindowSize+1))==NULL) ||
+				((arrays.eb=(u_char*)malloc(newWindowSize+1))==NULL))
+				return false;
+			workingMemory+=(newWindowSize+1)*2;
+			if (workingMemory > peakWorkingMemory)
+				peakWorkingMemory=workingMemory;
+		}
+
+		// The last ctrl triple of the previous part seeks to where this part starts
+		if (writer.hasPending)
+			writer.pendingNextOldStart=oldStart;
+
+		RakNet::TimeUS startTime=RakNet::GetTimeUS();
+		if (diffWindow(arrays.I,(u_char*)old+oldStart,oldWindowSize,oldStart,(u_char*)_new+newStart,newLength,arrays.db,arrays.eb,&writer,&matchOffset,&diffLength)==false)
+			return false;
+		matchOffset+=oldStart-newStart;
+		diffTime+=RakNet::GetTimeUS()-startTime;
 	}
-//	memcpy(*out+outWriteOffset, patch.GetOutput(), patch.GetTotalOutputSize());
-//	outWriteOffset+=patch.GetTotalOutputSize();
-//	patch.Clear();
-//	if (bz2err != BZ_OK)
-//		errx(1, "BZ2_bzWrite, bz2err = %d", bz2err);
-//	BZ2_bzWriteClose(&bz2err, pfbz2, 0, NULL, NULL);
-//	if (bz2err != BZ_OK)
-//		errx(1, "BZ2_bzWriteClose, bz2err = %d", bz2err);
+	threadPool.StopThreads();
 
-	/* Seek to the beginning, write the header, and close the file */
-//	if (fseeko(pf, 0, SEEK_SET))
-//		err(1, "fseeko");
-//	if (fwrite(header, 32, 1, pf) != 1)
-//		err(1, "fwrite(%s)", argv[3]);
-//	if (fclose(pf))
-//		err(1, "fclose");
-
-//	memcpy(*out,header,32);
-//	*out=(char*) realloc(*out, outWriteOffset);
-//	*outSize=outWriteOffset;
-
-	*outSize=patch.GetTotalOutputSize()+32;
+	if ((writer.hasPending && writeControl(&writer)==false) ||
+		writer.ctrl.Compress(0,0,true)==false ||
+		writer.diff.Compress(0,0,true)==false ||
+		writer.extra.Compress(0,0,true)==false)
+		return false;
+	offtout(writer.ctrl.GetTotalOutputSize(), header + 8);
+	offtout(writer.diff.GetTotalOutputSize(), header + 16);
+
+	*outSize=32+writer.ctrl.GetTotalOutputSize()+writer.diff.GetTotalOutputSize()+writer.extra.GetTotalOutputSize();
 	*out = new char [*outSize];
 	memcpy(*out, header, 32);
-	memcpy(*out+32, patch.GetOutput(), patch.GetTotalOutputSize());
-	
-
-	/* Free the memory we used */
-	free(db);
-	free(eb);
-	free(I);
-	//free(old);
-	//free(new);
-
+	memcpy(*out+32, writer.ctrl.GetOutput(), writer.ctrl.GetTotalOutputSize());
+	memcpy(*out+32+writer.ctrl.GetTotalOutputSize(), writer.diff.GetOutput(), writer.diff.GetTotalOutputSize());
+	memcpy(*out+32+writer.ctrl.GetTotalOutputSize()+writer.diff.GetTotalOutputSize(), writer.extra.GetOutput(), writer.extra.GetTotalOutputSize());
+
+	if (statistics) {
+		statistics->sortTime=sortTime;
+		statistics->diffTime=diffTime;
+		statistics->peakWorkingMemory=peakWorkingMemory;
+	}
 	return true;
 }
 
@@ -1,3 +1,30 @@
 /// Given \a old and \a new , return \a out which will contain a patch to get from \a old to \a new .  \a out is allocated for you.
 bool CreatePatch(const char *old, unsigned oldsize, char *_new, unsigned int newsize, char **out, unsigned *outSize);
 
+/// Options for the second version of CreatePatch(). The defaults make the same patch as the first version
+struct CreatePatchOptions
+{
+	CreatePatchOptions() : threadCount(1), windowSize(0) {}
+
+	/// Threads that sort the suffixes of \a old, counting the calling thread. Sorting takes most of the time for large files.
+	/// Threads use another 8 bytes of memory per byte sorted
+	int threadCount;
+
+	/// If not 0, \a old is sorted \a windowSize bytes at a time, and \a _new compared against it half that at a time, so memory use stays at about 17 times \a windowSize however large the files are.
+	/// Each part of \a _new is only compared to the part of \a old in the same relative position, so patches are larger where data moved by more than about \a windowSize / 4.
+	/// At least 65536 is used
+	unsigned int windowSize;
+};
+
+/// Filled in by the second version of CreatePatch()
+struct CreatePatchStatistics
+{
+	/// Microseconds sorting the suffixes of \a old, and comparing \a _new against them
+	unsigned long long sortTime, diffTime;
+
+	/// The most memory allocated at once to sort and compare, in bytes. The patch and the compressors are not counted
+	unsigned long long peakWorkingMemory;
+};
+
+/// Same as the first version, with \a options to sort on threads or to bound the memory used. \a statistics may be 0
+bool CreatePatch(const char *old, unsigned oldsize, char *_new, unsigned int newsize, char **out, unsigned *outSize, const CreatePatchOptions &options, CreatePatchStatistics *statistics=0);
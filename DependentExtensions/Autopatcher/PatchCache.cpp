@@ -0,0 +1,559 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file
+/// \brief Keeps patches made by AutopatcherServer, by the hash of the version patched from and the hash of the version patched to
+
+#include "PatchCache.h"
+#include "AutopatcherRepositoryInterface.h"
+#include "BitStream.h"
+#include "FileOperations.h"
+#include "GetTime.h"
+#include "DS_List.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace RakNet;
+
+static const unsigned HASH_LENGTH=4;
+// Changed whenever the format of the files written by WritePatch() changes
+static const uint32_t PATCH_FILE_VERSION=0x50430001;
+// Version, patch time and patch length
+static const unsigned int PATCH_FILE_HEADER_LENGTH=sizeof(uint32_t)+sizeof(uint64_t)+sizeof(uint32_t);
+// Past this many patches that could not be made, those failed longer ago than PatchCache::SetFailedPatchTime() are removed
+static const unsigned int MAX_FAILED_PATCHES=4096;
+
+PatchCacheStatistics::PatchCacheStatistics()
+{
+	hits=0;
+	misses=0;
+	diskReads=0;
+	precomputed=0;
+	patchTime=0;
+	patchTimeSaved=0;
+}
+double PatchCacheStatistics::GetHitRate(void) const
+{
+	if (hits+misses==0)
+		return 0.0;
+	return (double) hits / (double) (hits+misses);
+}
+PatchCache::PatchCache()
+{
+	memoryUsed=0;
+	maxMemory=64*1048576;
+	newestKey=0;
+	failedPatchTime=10000;
+	maxPriorVersions=65536;
+}
+PatchCache::~PatchCache()
+{
+	Clear();
+}
+void PatchCache::SetDirectory(const char *_directory)
+{
+	patchesMutex.Lock();
+	if (_directory && _directory[0])
+	{
+		directory=_directory;
+		if (IsSlash(directory.C_String()[directory.GetLength()-1])==false)
+			directory+="/";
+	}
+	else
+		directory.Clear();
+	patchesMutex.Unlock();
+}
+void PatchCache::SetMaxMemory(unsigned int bytes)
+{
+	patchesMutex.Lock();
+	maxMemory=bytes;
+	patchesMutex.Unlock();
+}
+void PatchCache::SetMaxPriorVersions(unsigned int count)
+{
+	priorVersionsMutex.Lock();
+	maxPriorVersions=count;
+	if (priorVersions.Size() > maxPriorVersions)
+		ForgetLeastRequested();
+	priorVersionsMutex.Unlock();
+}
+void PatchCache::SetFailedPatchTime(RakNet::TimeMS milliseconds)
+{
+	patchesMutex.Lock();
+	failedPatchTime=milliseconds;
+	failedPatches.Clear();
+	patchesMutex.Unlock();
+}
+void PatchCache::SetCreatePatchOptions(const CreatePatchOptions &options)
+{
+	patchesMutex.Lock();
+	createPatchOptions=options;
+	patchesMutex.Unlock();
+}
+bool PatchCache::GetPatch(AutopatcherRepositoryInterface *repository, const char *applicationName, const char *filename, const char *oldHash, const char *newHash, char **patch, unsigned int *patchLength)
+{
+	uint64_t key=GetKey(oldHash, newHash);
+	patchesMutex.Lock();
+	Patch *cached=patches.Peek(key);
+	if (cached)
+	{
+		*patchLength=cached->length;
+		*patch=new char[cached->length];
+		memcpy(*patch, cached->data, cached->length);
+		statistics.hits++;
+		statistics.patchTimeSaved+=cached->patchTime;
+		if (key!=newestKey)
+		{
+			Unlink(key);
+			LinkNewest(key);
+		}
+		patchesMutex.Unlock();
+		CountRequest(applicationName, filename, oldHash);
+		return true;
+	}
+	if (HasFailedRecently(key))
+	{
+		statistics.misses++;
+		patchesMutex.Unlock();
+		return false;
+	}
+	patchesMutex.Unlock();
+
+	char *data;
+	unsigned int length;
+	RakNet::TimeUS patchTime;
+	bool fromDisk=ReadPatch(key, &data, &length, &patchTime);
+	if (fromDisk==false)
+	{
+		if (MakePatch(repository, applicationName, filename, oldHash, newHash, &data, &length, &patchTime)==false)
+		{
+			patchesMutex.Lock();
+			statistics.misses++;
+			AddFailed(key);
+			patchesMutex.Unlock();
+			return false;
+		}
+		WritePatch(key, data, length, patchTime);
+	}
+
+	*patchLength=length;
+	*patch=new char[length];
+	memcpy(*patch, data, length);
+
+	patchesMutex.Lock();
+	if (fromDisk)
+	{
+		statistics.hits++;
+		statistics.diskReads++;
+		statistics.patchTimeSaved+=patchTime;
+	}
+	else
+	{
+		statistics.misses++;
+		statistics.patchTime+=patchTime;
+	}
+	if (patches.HasData(key)==false)
+		AddToMemory(key, data, length, patchTime);
+	else
+		delete [] data;
+	patchesMutex.Unlock();
+	CountRequest(applicationName, filename, oldHash);
+	return true;
+}
+void PatchCache::CountRequest(const char *applicationName, const char *filename, const char *oldHash)
+{
+	// Only versions a patch was returned from are counted, so the repository has them
+	RakNet::RakString priorVersionKey("%02x%02x%02x%02x\t%s\t%s", (unsigned char) oldHash[0], (unsigned char) oldHash[1], (unsigned char) oldHash[2], (unsigned char) oldHash[3], applicationName, filename);
+	priorVersionsMutex.Lock();
+	PriorVersion *priorVersion=priorVersions.Peek(priorVersionKey);
+	if (priorVersion)
+		priorVersion->requests++;
+	else
+	{
+		PriorVersion newPriorVersion;
+		newPriorVersion.applicationName=applicationName;
+		newPriorVersion.filename=filename;
+		memcpy(newPriorVersion.hash, oldHash, HASH_LENGTH);
+		newPriorVersion.requests=1;
+		priorVersions.Push(priorVersionKey, newPriorVersion);
+		if (priorVersions.Size() > maxPriorVersions)
+			ForgetLeastRequested();
+	}
+	priorVersionsMutex.Unlock();
+}
+void PatchCache::ForgetLeastRequested(void)
+{
+	// A quarter at a time, so this is not done on every request
+	DataStructures::List<PriorVersion> versions;
+	DataStructures::List<RakNet::RakString> keys;
+	priorVersions.GetAsList(versions, keys);
+	unsigned int keep=maxPriorVersions/4*3;
+	if (versions.Size() <= keep)
+		return;
+	if (keep==0)
+	{
+		priorVersions.Clear();
+		return;
+	}
+
+	// Requests of the least requested version kept
+	DataStructures::List<unsigned int> requests;
+	unsigned int i;
+	for (i=0; i < versions.Size(); i++)
+		requests.Insert(versions[i].requests);
+	unsigned int *first=&requests[0];
+	std::nth_element(first, first+(versions.Size()-keep), first+versions.Size());
+	unsigned int leastKept=requests[versions.Size()-keep];
+
+	// Fewer requests than that first, then as many with that many requests as needed
+	unsigned int toForget=versions.Size()-keep;
+	for (i=0; i < versions.Size() && toForget > 0; i++)
+	{
+		if (versions[i].requests < leastKept)
+		{
+			priorVersions.Remove(keys[i]);
+			toForget--;
+		}
+	}
+	for (i=0; i < versions.Size() && toForget > 0; i++)
+	{
+		if (versions[i].requests==leastKept)
+		{
+			priorVersions.Remove(keys[i]);
+			toForget--;
+		}
+	}
+}
+unsigned int PatchCache::Precompute(AutopatcherRepositoryInterface *repository, unsigned int count)
+{
+	DataStructures::List<PriorVersion> versions;
+	DataStructures::List<RakNet::RakString> keys;
+	priorVersionsMutex.Lock();
+	priorVersions.GetAsList(versions, keys);
+	priorVersionsMutex.Unlock();
+
+	unsigned int made=0;
+	unsigned int i, j;
+	for (i=0; i < count && i < versions.Size(); i++)
+	{
+		// Move the most requested of the rest to i
+		unsigned int mostRequested=i;
+		for (j=i+1; j < versions.Size(); j++)
+		{
+			if (versions[j].requests > versions[mostRequested].requests)
+				mostRequested=j;
+		}
+		if (mostRequested!=i)
+		{
+			PriorVersion temp=versions[i];
+			versions[i]=versions[mostRequested];
+			versions[mostRequested]=temp;
+		}
+
+		const PriorVersion &priorVersion=versions[i];
+		char newestHash[HASH_LENGTH];
+		if (repository->GetNewestFileHash(priorVersion.applicationName.C_String(), priorVersion.filename.C_String(), newestHash)==false)
+			continue;
+		if (memcmp(newestHash, priorVersion.hash, HASH_LENGTH)==0)
+			continue;
+		uint64_t key=GetKey(priorVersion.hash, newestHash);
+		if (HasPatch(key))
+			continue;
+
+		char *data;
+		unsigned int length;
+		RakNet::TimeUS patchTime;
+		if (MakePatch(repository, priorVersion.applicationName.C_String(), priorVersion.filename.C_String(), priorVersion.hash, newestHash, &data, &length, &patchTime)==false)
+			continue;
+		WritePatch(key, data, length, patchTime);
+		patchesMutex.Lock();
+		statistics.precomputed++;
+		statistics.patchTime+=patchTime;
+		if (patches.HasData(key)==false)
+			AddToMemory(key, data, length, patchTime);
+		else
+			delete [] data;
+		patchesMutex.Unlock();
+		made++;
+	}
+	return made;
+}
+void PatchCache::GetStatistics(PatchCacheStatistics *_statistics) const
+{
+	patchesMutex.Lock();
+	*_statistics=statistics;
+	patchesMutex.Unlock();
+}
+void PatchCache::ResetStatistics(void)
+{
+	patchesMutex.Lock();
+	statistics=PatchCacheStatistics();
+	patchesMutex.Unlock();
+}
+unsigned int PatchCache::GetMemoryUsed(void) const
+{
+	patchesMutex.Lock();
+	unsigned int bytes=memoryUsed;
+	patchesMutex.Unlock();
+	return bytes;
+}
+void PatchCache::Clear(void)
+{
+	DataStructures::List<Patch> patchList;
+	DataStructures::List<uint64_t> keys;
+	patchesMutex.Lock();
+	patches.GetAsList(patchList, keys);
+	for (unsigned int i=0; i < patchList.Size(); i++)
+		delete [] patchList[i].data;
+	patches.Clear();
+	memoryUsed=0;
+	failedPatches.Clear();
+	patchesMutex.Unlock();
+
+	priorVersionsMutex.Lock();
+	priorVersions.Clear();
+	priorVersionsMutex.Unlock();
+}
+uint64_t PatchCache::GetKey(const char *oldHash, const char *newHash)
+{
+	// Byte by byte, so the files written are named the same on every system
+	uint64_t key=0;
+	unsigned int i;
+	for (i=0; i < HASH_LENGTH; i++)
+		key=(key << 8) | (unsigned char) oldHash[i];
+	for (i=0; i < HASH_LENGTH; i++)
+		key=(key << 8) | (unsigned char) newHash[i];
+	return key;
+}
+unsigned long PatchCache::KeyToInteger(const uint64_t &key)
+{
+	return (unsigned long) (key ^ (key >> 32));
+}
+void PatchCache::GetPath(uint64_t key, char *path) const
+{
+	sprintf(path, "%s%08x%08x.patch", directory.C_String(), (unsigned int) (key >> 32), (unsigned int) key);
+}
+bool PatchCache::ReadPatch(uint64_t key, char **data, unsigned int *length, RakNet::TimeUS *patchTime) const
+{
+	char path[1024];
+	patchesMutex.Lock();
+	if (directory.IsEmpty() || directory.GetLength()+32 > sizeof(path))
+	{
+		patchesMutex.Unlock();
+		return false;
+	}
+	GetPath(key, path);
+	patchesMutex.Unlock();
+
+	FILE *fp=fopen(path, "rb");
+	if (fp==0)
+		return false;
+	unsigned char header[PATCH_FILE_HEADER_LENGTH];
+	if (fread(header, 1, PATCH_FILE_HEADER_LENGTH, fp)!=PATCH_FILE_HEADER_LENGTH)
+	{
+		fclose(fp);
+		return false;
+	}
+	RakNet::BitStream bitStream(header, PATCH_FILE_HEADER_LENGTH, false);
+	uint32_t version=0, fileLength=0;
+	uint64_t fileTime=0;
+	bitStream.Read(version);
+	bitStream.Read(fileTime);
+	bitStream.Read(fileLength);
+	// The length in the header must be the rest of the file, so a damaged header does not allocate more than the file holds
+	fseek(fp, 0, SEEK_END);
+	long fileSize=ftell(fp);
+	fseek(fp, PATCH_FILE_HEADER_LENGTH, SEEK_SET);
+	if (version!=PATCH_FILE_VERSION || fileSize < 0 || (unsigned long) fileSize-PATCH_FILE_HEADER_LENGTH!=fileLength)
+	{
+		fclose(fp);
+		return false;
+	}
+	*data=new char[fileLength];
+	bool read=fread(*data, 1, fileLength, fp)==fileLength;
+	fclose(fp);
+	if (read==false)
+	{
+		// Cut short, as when the server stopped while writing it
+		delete [] *data;
+		return false;
+	}
+	*length=fileLength;
+	*patchTime=fileTime;
+	return true;
+}
+void PatchCache::WritePatch(uint64_t key, const char *data, unsigned int length, RakNet::TimeUS patchTime) const
+{
+	char path[1024], temporaryPath[1040];
+	patchesMutex.Lock();
+	if (directory.IsEmpty() || directory.GetLength()+32 > sizeof(path))
+	{
+		patchesMutex.Unlock();
+		return;
+	}
+	GetPath(key, path);
+	patchesMutex.Unlock();
+
+	RakNet::BitStream bitStream(PATCH_FILE_HEADER_LENGTH+length);
+	bitStream.Write(PATCH_FILE_VERSION);
+	bitStream.Write((uint64_t) patchTime);
+	bitStream.Write((uint32_t) length);
+	bitStream.WriteAlignedBytes((const unsigned char*) data, length);
+
+	// Written under another name first, so a patch cut short is never read back
+	sprintf(temporaryPath, "%s.tmp", path);
+	if (WriteFileWithDirectories(temporaryPath, (char*) bitStream.GetData(), bitStream.GetNumberOfBytesUsed())==false)
+		return;
+	if (rename(temporaryPath, path)!=0)
+		remove(temporaryPath);
+}
+bool PatchCache::HasPatch(uint64_t key)
+{
+	patchesMutex.Lock();
+	bool inMemory=patches.HasData(key);
+	bool useDirectory=directory.IsEmpty()==false;
+	patchesMutex.Unlock();
+	if (inMemory)
+		return true;
+	if (useDirectory==false)
+		return false;
+
+	char *data;
+	unsigned int length;
+	RakNet::TimeUS patchTime;
+	if (ReadPatch(key, &data, &length, &patchTime)==false)
+		return false;
+	patchesMutex.Lock();
+	if (patches.HasData(key)==false)
+		AddToMemory(key, data, length, patchTime);
+	else
+		delete [] data;
+	patchesMutex.Unlock();
+	return true;
+}
+void PatchCache::AddToMemory(uint64_t key, char *data, unsigned int length, RakNet::TimeUS patchTime)
+{
+	if (length > maxMemory)
+	{
+		delete [] data;
+		return;
+	}
+
+	Patch patch;
+	patch.data=data;
+	patch.length=length;
+	patch.patchTime=patchTime;
+	patches.Push(key, patch);
+	LinkNewest(key);
+	memoryUsed+=length;
+
+	while (memoryUsed > maxMemory)
+	{
+		uint64_t oldestKey=patches.Peek(newestKey)->newer;
+		Patch *oldest=patches.Peek(oldestKey);
+		memoryUsed-=oldest->length;
+		delete [] oldest->data;
+		Unlink(oldestKey);
+		patches.Remove(oldestKey);
+	}
+}
+void PatchCache::LinkNewest(uint64_t key)
+{
+	Patch *patch=patches.Peek(key);
+	// patches.Size() counts this patch, which is not linked yet
+	if (patches.Size()==1)
+	{
+		patch->newer=key;
+		patch->older=key;
+	}
+	else
+	{
+		Patch *newest=patches.Peek(newestKey);
+		uint64_t oldestKey=newest->newer;
+		patch->older=newestKey;
+		patch->newer=oldestKey;
+		newest->newer=key;
+		patches.Peek(oldestKey)->older=key;
+	}
+	newestKey=key;
+}
+void PatchCache::Unlink(uint64_t key)
+{
+	Patch *patch=patches.Peek(key);
+	if (patch->newer==key)
+		return;
+	uint64_t olderKey=patch->older, newerKey=patch->newer;
+	patches.Peek(olderKey)->newer=newerKey;
+	patches.Peek(newerKey)->older=olderKey;
+	if (newestKey==key)
+		newestKey=olderKey;
+}
+bool PatchCache::HasFailedRecently(uint64_t key)
+{
+	RakNet::TimeMS *failedTime=failedPatches.Peek(key);
+	if (failedTime==0)
+		return false;
+	if (RakNet::GetTimeMS()-*failedTime < failedPatchTime)
+		return true;
+	failedPatches.Remove(key);
+	return false;
+}
+void PatchCache::AddFailed(uint64_t key)
+{
+	if (failedPatchTime==0)
+		return;
+	RakNet::TimeMS time=RakNet::GetTimeMS();
+	RakNet::TimeMS *failedTime=failedPatches.Peek(key);
+	if (failedTime)
+	{
+		*failedTime=time;
+		return;
+	}
+	if (failedPatches.Size() >= MAX_FAILED_PATCHES)
+	{
+		DataStructures::List<RakNet::TimeMS> failedTimes;
+		DataStructures::List<uint64_t> keys;
+		failedPatches.GetAsList(failedTimes, keys);
+		for (unsigned int i=0; i < keys.Size(); i++)
+		{
+			if (time-failedTimes[i] >= failedPatchTime)
+				failedPatches.Remove(keys[i]);
+		}
+		// Failed too recently to remove. Asking the repository again is only slower
+		if (failedPatches.Size() >= MAX_FAILED_PATCHES)
+			failedPatches.Clear();
+	}
+	failedPatches.Push(key, time);
+}
+bool PatchCache::MakePatch(AutopatcherRepositoryInterface *repository, const char *applicationName, const char *filename, const char *oldHash, const char *newHash, char **patch, unsigned int *patchLength, RakNet::TimeUS *patchTime)
+{
+	char *oldContent, *newContent;
+	unsigned int oldLength, newLength;
+	if (repository->GetFileVersion(applicationName, filename, oldHash, &oldContent, &oldLength)==false)
+		return false;
+	if (repository->GetFileVersion(applicationName, filename, newHash, &newContent, &newLength)==false)
+	{
+		delete [] oldContent;
+		return false;
+	}
+
+	patchesMutex.Lock();
+	CreatePatchOptions options=createPatchOptions;
+	patchesMutex.Unlock();
+
+	RakNet::TimeUS startTime=RakNet::GetTimeUS();
+	bool created=CreatePatch(oldContent, oldLength, newContent, newLength, patch, patchLength, options);
+	*patchTime=RakNet::GetTimeUS()-startTime;
+	delete [] oldContent;
+	delete [] newContent;
+	return created;
+}
@@ -0,0 +1,171 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file
+/// \brief Keeps patches made by AutopatcherServer, by the hash of the version patched from and the hash of the version patched to
+
+#ifndef __PATCH_CACHE_H
+#define __PATCH_CACHE_H
+
+#include <stdint.h>
+#include "Export.h"
+#include "DS_OpenHash.h"
+#include "RakString.h"
+#include "SimpleMutex.h"
+#include "RakNetTime.h"
+#include "CreatePatch.h"
+
+namespace RakNet
+{
+class AutopatcherRepositoryInterface;
+
+/// Counters kept by PatchCache
+struct RAK_DLL_EXPORT PatchCacheStatistics
+{
+	PatchCacheStatistics();
+
+	/// Patches asked for that were in memory or on disk
+	unsigned int hits;
+
+	/// Patches asked for that had to be made
+	unsigned int misses;
+
+	/// Of \a hits, how many were read from disk
+	unsigned int diskReads;
+
+	/// Patches made ahead of time by PatchCache::Precompute()
+	unsigned int precomputed;
+
+	/// Microseconds in CreatePatch(), for misses and PatchCache::Precompute()
+	RakNet::TimeUS patchTime;
+
+	/// For each hit, the microseconds CreatePatch() took when that patch was made
+	RakNet::TimeUS patchTimeSaved;
+
+	/// \return \a hits divided by \a hits plus \a misses, or 0 before any patch was asked for
+	double GetHitRate(void) const;
+};
+
+/// \brief Patches between versions of files, so that many clients upgrading from the same version only cost one CreatePatch()
+/// \details A patch is found by the 4 byte hashes the autopatcher uses for the contents of the version patched from and the version patched to, whatever the name of the file.
+/// Patches are kept in memory up to SetMaxMemory(), least recently used first out. With SetDirectory() each patch is also written to a file there,
+/// which is read back when the patch is not in memory, including after a restart.<BR>
+/// Versions of files are read through AutopatcherRepositoryInterface::GetFileVersion(), so only repositories that implement it can be used.<BR>
+/// Thread safe. Two threads asking for the same patch that is not yet made will both make it.
+/// \sa AutopatcherServer::SetPatchCache()
+class RAK_DLL_EXPORT PatchCache
+{
+public:
+	PatchCache();
+	~PatchCache();
+
+	/// \brief Where to write patches, and read them from when they are not in memory
+	/// \param[in] directory Created when the first patch is written. Pass 0 to only keep patches in memory, which is the default
+	void SetDirectory(const char *directory);
+
+	/// \brief How many bytes of patches to keep in memory. Defaults to 64 megabytes
+	/// \details Patches over this are removed from memory, least recently used first. They can still be read from the directory passed to SetDirectory()
+	void SetMaxMemory(unsigned int bytes);
+
+	/// \brief How many versions patched from to count requests for, for Precompute(). Defaults to 65536
+	/// \details Past this, the least requested quarter is forgotten
+	void SetMaxPriorVersions(unsigned int count);
+
+	/// \brief How long GetPatch() returns false without asking the repository again, after a patch could not be made
+	/// \details So clients asking for versions the repository does not have do not each cost a lookup. Defaults to 10000 milliseconds. Pass 0 to always ask
+	void SetFailedPatchTime(RakNet::TimeMS milliseconds);
+
+	/// \brief Options passed to CreatePatch(), such as a window size to bound the memory used on large files
+	/// \details Patches already made are kept whatever options made them
+	void SetCreatePatchOptions(const CreatePatchOptions &options);
+
+	/// \brief Gets a patch from the version of \a filename with \a oldHash to the version with \a newHash
+	/// \details Made with CreatePatch() if not in memory or on disk, reading both versions from \a repository. If a patch is returned, counted by Precompute() as a request for \a oldHash
+	/// \param[in] repository Used from the calling thread only
+	/// \param[in] oldHash, newHash 4 bytes each, as sent by AutopatcherClient and returned by AutopatcherRepositoryInterface::GetNewestFileHash()
+	/// \param[out] patch For ApplyPatch(). Allocated with new []. Free with delete []
+	/// \return False if there is no patch, as \a repository does not have one of the versions or CreatePatch() failed
+	bool GetPatch(AutopatcherRepositoryInterface *repository, const char *applicationName, const char *filename, const char *oldHash, const char *newHash, char **patch, unsigned int *patchLength);
+
+	/// \brief Makes patches to the newest version of each file from the \a count versions most often passed to GetPatch() as \a oldHash
+	/// \details Call after adding a version to the repository, so that clients asking for patches to it find them made.
+	/// Versions that already have a patch to the newest version are skipped
+	/// \param[in] repository Used from the calling thread only
+	/// \return How many patches were made
+	unsigned int Precompute(AutopatcherRepositoryInterface *repository, unsigned int count);
+
+	void GetStatistics(PatchCacheStatistics *statistics) const;
+	void ResetStatistics(void);
+
+	/// \return Bytes of patches in memory
+	unsigned int GetMemoryUsed(void) const;
+
+	/// \brief Removes every patch from memory, and forgets how often each version was asked for
+	/// \details Files written to the directory passed to SetDirectory() are not deleted
+	void Clear(void);
+
+protected:
+	struct Patch
+	{
+		char *data;
+		unsigned int length;
+		// Microseconds CreatePatch() took
+		RakNet::TimeUS patchTime;
+		// Keys of the next newer and older patches in memory. The oldest is newer than the newest, so the list is a ring
+		uint64_t newer, older;
+	};
+	struct PriorVersion
+	{
+		RakNet::RakString applicationName;
+		RakNet::RakString filename;
+		char hash[4];
+		unsigned int requests;
+	};
+
+	static uint64_t GetKey(const char *oldHash, const char *newHash);
+	static unsigned long KeyToInteger(const uint64_t &key);
+	void GetPath(uint64_t key, char *path) const;
+	void CountRequest(const char *applicationName, const char *filename, const char *oldHash);
+	// Call with priorVersionsMutex locked
+	void ForgetLeastRequested(void);
+	bool ReadPatch(uint64_t key, char **data, unsigned int *length, RakNet::TimeUS *patchTime) const;
+	void WritePatch(uint64_t key, const char *data, unsigned int length, RakNet::TimeUS patchTime) const;
+	bool HasPatch(uint64_t key);
+	// Call with patchesMutex locked. Takes \a data
+	void AddToMemory(uint64_t key, char *data, unsigned int length, RakNet::TimeUS patchTime);
+	// Call with patchesMutex locked. Links a patch in patches as the newest, or unlinks it
+	void LinkNewest(uint64_t key);
+	void Unlink(uint64_t key);
+	// Call with patchesMutex locked
+	bool HasFailedRecently(uint64_t key);
+	void AddFailed(uint64_t key);
+	bool MakePatch(AutopatcherRepositoryInterface *repository, const char *applicationName, const char *filename, const char *oldHash, const char *newHash, char **patch, unsigned int *patchLength, RakNet::TimeUS *patchTime);
+
+	mutable SimpleMutex patchesMutex;
+	DataStructures::OpenHash<uint64_t, Patch, PatchCache::KeyToInteger> patches;
+	unsigned int memoryUsed, maxMemory;
+	// Of the ring of patches in memory, if there are any
+	uint64_t newestKey;
+	// When each patch that could not be made failed
+	DataStructures::OpenHash<uint64_t, RakNet::TimeMS, PatchCache::KeyToInteger> failedPatches;
+	RakNet::TimeMS failedPatchTime;
+	PatchCacheStatistics statistics;
+	RakNet::RakString directory;
+	CreatePatchOptions createPatchOptions;
+
+	SimpleMutex priorVersionsMutex;
+	DataStructures::OpenHash<RakNet::RakString, PriorVersion, RakNet::RakString::ToInteger> priorVersions;
+	unsigned int maxPriorVersions;
+};
+
+} // namespace RakNet
+
+#endif
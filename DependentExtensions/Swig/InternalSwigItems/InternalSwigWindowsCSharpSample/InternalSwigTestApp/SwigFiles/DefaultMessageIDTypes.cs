@@ -132,8 +132,8 @@ public enum DefaultMessageIDTypes {
   ID_CLOUD_SUBSCRIPTION_NOTIFICATION,
   ID_RESERVED_1,
   ID_RESERVED_2,
-  ID_RESERVED_3,
-  ID_RESERVED_4,
+  ID_FILE_LIST_CHUNK_MANIFEST,
+  ID_FILE_LIST_CHUNK_REQUEST,
   ID_RESERVED_5,
   ID_RESERVED_6,
   ID_RESERVED_7,
@@ -0,0 +1,199 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Feeds the datagram numbers a receiver would see, with random reordering and loss, to DataStructures::RangeList and RangeBitmap as ReliabilityLayer does for ACKs
+// Times the inserts, and writing the ACK datagrams every few hundred datagrams received
+// Every ACK datagram is read back with RangeList::Deserialize(), and each received number must be acknowledged exactly once, including across the 24 bit wraparound
+
+#include <cstdio>
+#include <cstring>
+#include "DS_RangeList.h"
+#include "DS_RangeBitmap.h"
+#include "BitStream.h"
+#include "RakNetTypes.h"
+#include "GetTime.h"
+
+using namespace DataStructures;
+using namespace RakNet;
+
+static const unsigned int DATAGRAM_COUNT=1000000;
+// Starts close enough to the top of the 24 bit range that the numbers wrap halfway through
+static const uint32_t FIRST_DATAGRAM=0x1000000-DATAGRAM_COUNT/2;
+static const unsigned int SEQUENCE_SPACE=0x1000000;
+// About the payload of one datagram at the default MTU
+static const BitSize_t MAX_ACK_BITS=1400*8;
+
+struct Scenario
+{
+	const char *description;
+	// Datagrams are swapped with another up to this far ahead
+	unsigned int reorderDistance;
+	// Out of 1000
+	unsigned int lossPerThousand;
+	// Datagrams received between each time the ACKs are sent
+	unsigned int datagramsPerFlush;
+};
+
+struct Times
+{
+	double insert, serialize;
+	unsigned int ackDatagrams;
+};
+
+static unsigned int randomState=12345;
+static unsigned int NextRandom(void)
+{
+	randomState=randomState*1103515245+12345;
+	return randomState>>8;
+}
+
+// Returns the datagram numbers in the order they arrive
+static unsigned int MakeArrivals(const Scenario &scenario, uint24_t *arrivals)
+{
+	unsigned int count=0;
+	for (unsigned int i=0; i < DATAGRAM_COUNT; i++)
+	{
+		if (NextRandom()%1000 < scenario.lossPerThousand)
+			continue;
+		arrivals[count++]=uint24_t(FIRST_DATAGRAM+i);
+	}
+	if (scenario.reorderDistance > 0)
+	{
+		for (unsigned int i=0; i+scenario.reorderDistance < count; i++)
+		{
+			unsigned int other=i+NextRandom()%scenario.reorderDistance;
+			uint24_t temp=arrivals[i];
+			arrivals[i]=arrivals[other];
+			arrivals[other]=temp;
+		}
+	}
+	return count;
+}
+
+// Reads back every ACK datagram, counting the acknowledgements of each number. Returns false if a datagram could not be read
+static bool CountAcks(BitStream &acks, unsigned int ackDatagrams, unsigned char *ackCounts)
+{
+	for (unsigned int i=0; i < ackDatagrams; i++)
+	{
+		RangeList<uint24_t> received;
+		if (received.Deserialize(&acks)==false)
+			return false;
+		for (unsigned int j=0; j < received.ranges.Size(); j++)
+		{
+			uint32_t minIndex=received.ranges[j].minIndex;
+			uint32_t maxIndex=received.ranges[j].maxIndex;
+			for (uint32_t index=minIndex; index <= maxIndex; index++)
+				ackCounts[index]++;
+		}
+	}
+	return true;
+}
+
+template <class AckList>
+static void TimeAcks(uint24_t *arrivals, unsigned int arrivalCount, unsigned int datagramsPerFlush, BitStream &acks, Times &times)
+{
+	AckList ackList;
+	RakNet::TimeUS insertTime=0, serializeTime=0;
+	times.ackDatagrams=0;
+	for (unsigned int i=0; i < arrivalCount; i+=datagramsPerFlush)
+	{
+		unsigned int end=i+datagramsPerFlush < arrivalCount ? i+datagramsPerFlush : arrivalCount;
+		RakNet::TimeUS start=RakNet::GetTimeUS();
+		for (unsigned int j=i; j < end; j++)
+			ackList.Insert(arrivals[j]);
+		RakNet::TimeUS inserted=RakNet::GetTimeUS();
+		// As ReliabilityLayer::SendACKs()
+		while (ackList.Size() > 0)
+		{
+			ackList.Serialize(&acks, MAX_ACK_BITS, true);
+			times.ackDatagrams++;
+		}
+		serializeTime+=RakNet::GetTimeUS()-inserted;
+		insertTime+=inserted-start;
+	}
+	times.insert=(double) insertTime*1000.0/arrivalCount;
+	times.serialize=(double) serializeTime*1000.0/arrivalCount;
+}
+
+// Returns the number of datagrams not acknowledged exactly once
+static unsigned int CheckAcks(BitStream &acks, unsigned int ackDatagrams, uint24_t *arrivals, unsigned int arrivalCount, unsigned char *ackCounts)
+{
+	memset(ackCounts, 0, SEQUENCE_SPACE);
+	if (CountAcks(acks, ackDatagrams, ackCounts)==false)
+		return arrivalCount;
+	unsigned int wrong=0;
+	for (unsigned int i=0; i < arrivalCount; i++)
+	{
+		if (ackCounts[(uint32_t) arrivals[i]]!=1)
+			wrong++;
+		ackCounts[(uint32_t) arrivals[i]]=0;
+	}
+	// Anything still counted was acknowledged without being received
+	for (unsigned int i=0; i < SEQUENCE_SPACE; i++)
+	{
+		if (ackCounts[i]!=0)
+			wrong++;
+	}
+	return wrong;
+}
+
+int main(void)
+{
+	printf("Times ACK tracking with DataStructures::RangeList and RangeBitmap under reordering and loss.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	Scenario scenarios[]=
+	{
+		{"In order, no loss", 0, 0, 256},
+		{"Reorder 16, 1% loss", 16, 10, 256},
+		{"Reorder 256, 5% loss", 256, 50, 256},
+		{"Reorder 256, 5% loss, slow ACKs", 256, 50, 4096},
+	};
+	const unsigned int scenarioCount=sizeof(scenarios)/sizeof(scenarios[0]);
+
+	uint24_t *arrivals=new uint24_t[DATAGRAM_COUNT];
+	unsigned char *ackCounts=new unsigned char[SEQUENCE_SPACE];
+	unsigned int failures=0;
+
+	printf("%-34s %-12s %10s %12s %14s\n", "Scenario", "Container", "Insert ns", "Serialize ns", "ACK datagrams");
+	for (unsigned int i=0; i < scenarioCount; i++)
+	{
+		unsigned int arrivalCount=MakeArrivals(scenarios[i], arrivals);
+
+		BitStream rangeListAcks, rangeBitmapAcks;
+		Times rangeListTimes, rangeBitmapTimes;
+		TimeAcks<RangeList<uint24_t> >(arrivals, arrivalCount, scenarios[i].datagramsPerFlush, rangeListAcks, rangeListTimes);
+		TimeAcks<RangeBitmap<uint24_t> >(arrivals, arrivalCount, scenarios[i].datagramsPerFlush, rangeBitmapAcks, rangeBitmapTimes);
+		printf("%-34s %-12s %10.1f %12.1f %14u\n", scenarios[i].description, "RangeList", rangeListTimes.insert, rangeListTimes.serialize, rangeListTimes.ackDatagrams);
+		printf("%-34s %-12s %10.1f %12.1f %14u\n", "", "RangeBitmap", rangeBitmapTimes.insert, rangeBitmapTimes.serialize, rangeBitmapTimes.ackDatagrams);
+
+		unsigned int wrong=CheckAcks(rangeListAcks, rangeListTimes.ackDatagrams, arrivals, arrivalCount, ackCounts);
+		if (wrong > 0)
+			printf("%u datagrams were not acknowledged exactly once by RangeList\n", wrong);
+		wrong=CheckAcks(rangeBitmapAcks, rangeBitmapTimes.ackDatagrams, arrivals, arrivalCount, ackCounts);
+		if (wrong > 0)
+		{
+			printf("%u datagrams were not acknowledged exactly once by RangeBitmap\n", wrong);
+			failures+=wrong;
+		}
+	}
+
+	delete [] arrivals;
+	delete [] ackCounts;
+
+	if (failures > 0)
+	{
+		printf("\nFAILED: %u datagrams were not acknowledged exactly once\n", failures);
+		return 1;
+	}
+	printf("\nRangeBitmap acknowledged every datagram received exactly once\n");
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Sends messages from a client to a server over loopback, and reports the payload allocations made per message and the time taken
+// Run with "arena" to use the per thread arena allocator and list allocations by call site, or without arguments to use malloc
+
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <atomic>
+#include "RakPeerInterface.h"
+#include "MessageIdentifiers.h"
+#include "RakAllocator.h"
+#include "DS_List.h"
+#include "GetTime.h"
+#include "RakSleep.h"
+
+using namespace RakNet;
+
+static const unsigned short SERVER_PORT=60001;
+static const unsigned int MESSAGE_COUNT=200000;
+// Mix of small, medium, near MTU and split messages
+static const unsigned int MESSAGE_SIZES[]={16, 120, 600, 1200, 4000};
+static const unsigned int MESSAGE_SIZE_COUNT=sizeof(MESSAGE_SIZES)/sizeof(MESSAGE_SIZES[0]);
+
+static std::atomic<uint64_t> mallocCount(0);
+
+static void *CountingMalloc_Ex(size_t size, const char *file, unsigned int line)
+{
+	(void) file;
+	(void) line;
+	mallocCount++;
+	return malloc(size);
+}
+
+static void *CountingRealloc_Ex(void *p, size_t size, const char *file, unsigned int line)
+{
+	(void) file;
+	(void) line;
+	mallocCount++;
+	return realloc(p, size);
+}
+
+static void CountingFree_Ex(void *p, const char *file, unsigned int line)
+{
+	(void) file;
+	(void) line;
+	free(p);
+}
+
+static uint64_t GetAllocationCount(bool useArena)
+{
+	if (useArena==false)
+		return mallocCount;
+
+	DataStructures::List<AllocationSiteStatistics> sites;
+	GetAllocationSiteStatistics(sites);
+	uint64_t total=0;
+	for (unsigned int i=0; i < sites.Size(); i++)
+		total+=sites[i].allocations;
+	return total;
+}
+
+static void PrintAllocationSites(void)
+{
+	DataStructures::List<AllocationSiteStatistics> sites;
+	GetAllocationSiteStatistics(sites);
+
+	// Most allocations first
+	for (unsigned int i=1; i < sites.Size(); i++)
+	{
+		for (unsigned int j=i; j > 0 && sites[j-1].allocations < sites[j].allocations; j--)
+		{
+			AllocationSiteStatistics temp=sites[j-1];
+			sites[j-1]=sites[j];
+			sites[j]=temp;
+		}
+	}
+
+	printf("\n%12s %14s  %s\n", "Allocations", "Bytes", "Call site");
+	for (unsigned int i=0; i < sites.Size(); i++)
+	{
+		const char *file=sites[i].file ? sites[i].file : "(other)";
+		const char *slash=strrchr(file, '/');
+		if (slash==0)
+			slash=strrchr(file, '\\');
+		printf("%12llu %14llu  %s:%u\n", (unsigned long long) sites[i].allocations, (unsigned long long) sites[i].bytes, slash ? slash+1 : file, sites[i].line);
+	}
+}
+
+// Allocates and frees payload sized blocks on one thread, to compare the cost of the allocator itself
+static double TimeAllocations(void)
+{
+	static const unsigned int BLOCKS=256;
+	static const unsigned int ROUNDS=4000;
+	void *blocks[BLOCKS];
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	for (unsigned int round=0; round < ROUNDS; round++)
+	{
+		for (unsigned int i=0; i < BLOCKS; i++)
+			blocks[i]=rakMalloc_Ex(MESSAGE_SIZES[(i+round)%MESSAGE_SIZE_COUNT], _FILE_AND_LINE_);
+		for (unsigned int i=0; i < BLOCKS; i++)
+			rakFree_Ex(blocks[i], _FILE_AND_LINE_);
+	}
+	RakNet::TimeUS elapsed=RakNet::GetTimeUS()-start;
+	return (double) elapsed*1000.0/(BLOCKS*ROUNDS);
+}
+
+int main(int argc, char **argv)
+{
+	printf("Measures payload allocations per message between a loopback client and server.\n");
+	printf("Run with \"arena\" to use the arena allocator, or with no arguments to use malloc.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	// Must happen before any RakPeerInterface is created
+	bool useArena=argc > 1 && strcmp(argv[1], "arena")==0;
+	if (useArena)
+		UseArenaAllocator();
+	else
+	{
+		SetMalloc_Ex(CountingMalloc_Ex);
+		SetRealloc_Ex(CountingRealloc_Ex);
+		SetFree_Ex(CountingFree_Ex);
+	}
+	printf("Allocator: %s\n", useArena ? "arena" : "malloc");
+	printf("Allocate and free, one thread: %.1f ns per block\n", TimeAllocations());
+
+	RakPeerInterface *server=RakPeerInterface::GetInstance();
+	RakPeerInterface *client=RakPeerInterface::GetInstance();
+	SocketDescriptor serverSd(SERVER_PORT,0);
+	SocketDescriptor clientSd;
+	if (server->Startup(1,&serverSd,1)!=CRABNET_STARTED || client->Startup(1,&clientSd,1)!=CRABNET_STARTED)
+	{
+		printf("Startup failed\n");
+		return 1;
+	}
+	server->SetMaximumIncomingConnections(1);
+	client->Connect("127.0.0.1", SERVER_PORT, 0, 0);
+
+	bool connected=false;
+	RakNet::TimeMS timeout=RakNet::GetTimeMS()+5000;
+	while (connected==false && RakNet::GetTimeMS() < timeout)
+	{
+		Packet *packet;
+		for (packet=server->Receive(); packet; server->DeallocatePacket(packet), packet=server->Receive())
+		{
+			if (packet->data[0]==ID_NEW_INCOMING_CONNECTION)
+				connected=true;
+		}
+		for (packet=client->Receive(); packet; client->DeallocatePacket(packet), packet=client->Receive())
+			;
+		RakSleep(1);
+	}
+	if (connected==false)
+	{
+		printf("Could not connect\n");
+		return 1;
+	}
+
+	char payload[4000];
+	memset(payload, 0, sizeof(payload));
+	payload[0]=ID_USER_PACKET_ENUM;
+
+	uint64_t allocationsBefore=GetAllocationCount(useArena);
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	unsigned int sent=0, received=0;
+	timeout=RakNet::GetTimeMS()+60000;
+	while (received < MESSAGE_COUNT && RakNet::GetTimeMS() < timeout)
+	{
+		// Keep a bounded number of messages in flight, so the send buffer does not grow without limit
+		while (sent < MESSAGE_COUNT && sent-received < 2000)
+		{
+			client->Send(payload, MESSAGE_SIZES[sent%MESSAGE_SIZE_COUNT], HIGH_PRIORITY, RELIABLE_ORDERED, 0, UNASSIGNED_SYSTEM_ADDRESS, true);
+			sent++;
+		}
+
+		Packet *packet;
+		for (packet=server->Receive(); packet; server->DeallocatePacket(packet), packet=server->Receive())
+		{
+			if (packet->data[0]==ID_USER_PACKET_ENUM)
+				received++;
+		}
+		for (packet=client->Receive(); packet; client->DeallocatePacket(packet), packet=client->Receive())
+			;
+		RakSleep(0);
+	}
+	RakNet::TimeUS elapsed=RakNet::GetTimeUS()-start;
+	uint64_t allocations=GetAllocationCount(useArena)-allocationsBefore;
+
+	printf("Messages received: %u of %u\n", received, MESSAGE_COUNT);
+	if (received > 0)
+	{
+		printf("Payload allocations: %llu, %.2f per message\n", (unsigned long long) allocations, (double) allocations/received);
+		printf("Time: %.2f seconds, %.0f messages per second\n", elapsed/1000000.0, received/(elapsed/1000000.0));
+	}
+	if (useArena)
+		PrintAllocationSites();
+
+	server->Shutdown(100);
+	client->Shutdown(100);
+	RakPeerInterface::DestroyInstance(server);
+	RakPeerInterface::DestroyInstance(client);
+	return 0;
+}
@@ -0,0 +1,373 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Sends edited versions of a file over loopback with FileListTransfer::SendChunked(), to a receiver that has the original version,
+// and counts the bytes sent. Every file received must match the edited version
+// Finally downloads a changed file with DirectoryDeltaTransfer with chunking turned on
+// Usage: ChunkedTransferBenchmark [megabytes in the file] [threads]. Defaults to 16 megabytes, and to reading files in Receive()
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include "RakPeerInterface.h"
+#include "FileListTransfer.h"
+#include "FileListTransferCBInterface.h"
+#include "FileList.h"
+#include "DirectoryDeltaTransfer.h"
+#include "IncrementalReadInterface.h"
+#include "FileOperations.h"
+#include "MessageIdentifiers.h"
+#include "RakNetStatistics.h"
+#include "GetTime.h"
+#include "RakSleep.h"
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace RakNet;
+
+static const unsigned short SERVER_PORT=60001;
+static const unsigned int CHUNK_SIZE=1048576;
+static const char *BASIS_FILE="ChunkedTransferBenchmark_old.bin";
+static const char *SENT_FILE="ChunkedTransferBenchmark_new.bin";
+static const char *SERVER_DIRECTORY="ChunkedTransferBenchmarkServer/";
+static const char *CLIENT_DIRECTORY="ChunkedTransferBenchmarkClient/";
+
+static unsigned int randomState=12345;
+static unsigned int NextRandom(void)
+{
+	randomState=randomState*1103515245+12345;
+	return randomState>>8;
+}
+
+struct Version
+{
+	char *data;
+	unsigned int length;
+};
+
+// Random data, from the high bits as the low bits of NextRandom() repeat every 65536 bytes, with a run of zeros in the middle that is cut into many identical chunks
+static Version MakeOriginal(unsigned int length)
+{
+	Version version;
+	version.length=length;
+	version.data=new char[length];
+	for (unsigned int i=0; i < length; i++)
+		version.data[i]=(char) (NextRandom()>>16);
+	memset(version.data+length/2, 0, length/16);
+	return version;
+}
+
+// Replaces length bytes at offset with insertLength new random bytes
+static Version Edit(const Version &original, unsigned int offset, unsigned int length, unsigned int insertLength)
+{
+	Version version;
+	version.length=original.length-length+insertLength;
+	version.data=new char[version.length];
+	memcpy(version.data, original.data, offset);
+	for (unsigned int i=0; i < insertLength; i++)
+		version.data[offset+i]=(char) (NextRandom()>>16);
+	memcpy(version.data+offset+insertLength, original.data+offset+length, original.length-offset-length);
+	return version;
+}
+
+class ReceiveFile : public FileListTransferCBInterface
+{
+public:
+	ReceiveFile() {expected=0; correct=false; complete=false;}
+	bool OnFile(OnFileStruct *onFileStruct)
+	{
+		correct=onFileStruct->fileData!=0 && onFileStruct->byteLengthOfThisFile==expected->length &&
+			memcmp(onFileStruct->fileData, expected->data, expected->length)==0;
+		return true;
+	}
+	void OnFileProgress(FileProgressStruct *) {}
+	bool OnDownloadComplete(DownloadCompleteStruct *) {complete=true; return false;}
+
+	const Version *expected;
+	bool correct, complete;
+};
+
+struct Loopback
+{
+	RakPeerInterface *server, *client;
+	SystemAddress serverAddress, clientAddress;
+	FileListTransfer serverTransfer, clientTransfer;
+	DirectoryDeltaTransfer serverDirectoryTransfer, clientDirectoryTransfer;
+};
+
+static bool Connect(Loopback &loopback)
+{
+	loopback.server=RakPeerInterface::GetInstance();
+	loopback.client=RakPeerInterface::GetInstance();
+	SocketDescriptor serverSd(SERVER_PORT,0);
+	SocketDescriptor clientSd;
+	if (loopback.server->Startup(1,&serverSd,1)!=CRABNET_STARTED || loopback.client->Startup(1,&clientSd,1)!=CRABNET_STARTED)
+		return false;
+	loopback.server->SetMaximumIncomingConnections(1);
+	loopback.server->AttachPlugin(&loopback.serverTransfer);
+	loopback.client->AttachPlugin(&loopback.clientTransfer);
+	loopback.server->AttachPlugin(&loopback.serverDirectoryTransfer);
+	loopback.client->AttachPlugin(&loopback.clientDirectoryTransfer);
+	loopback.serverDirectoryTransfer.SetFileListTransferPlugin(&loopback.serverTransfer);
+	loopback.clientDirectoryTransfer.SetFileListTransferPlugin(&loopback.clientTransfer);
+
+	loopback.serverAddress=UNASSIGNED_SYSTEM_ADDRESS;
+	loopback.clientAddress=UNASSIGNED_SYSTEM_ADDRESS;
+	loopback.client->Connect("127.0.0.1", SERVER_PORT, 0, 0);
+	RakNet::TimeMS timeout=RakNet::GetTimeMS()+10000;
+	while ((loopback.serverAddress==UNASSIGNED_SYSTEM_ADDRESS || loopback.clientAddress==UNASSIGNED_SYSTEM_ADDRESS) && RakNet::GetTimeMS() < timeout)
+	{
+		Packet *packet;
+		for (packet=loopback.client->Receive(); packet; loopback.client->DeallocatePacket(packet), packet=loopback.client->Receive())
+		{
+			if (packet->data[0]==ID_CONNECTION_REQUEST_ACCEPTED)
+				loopback.serverAddress=packet->systemAddress;
+		}
+		for (packet=loopback.server->Receive(); packet; loopback.server->DeallocatePacket(packet), packet=loopback.server->Receive())
+		{
+			if (packet->data[0]==ID_NEW_INCOMING_CONNECTION)
+				loopback.clientAddress=packet->systemAddress;
+		}
+		RakSleep(1);
+	}
+	return loopback.serverAddress!=UNASSIGNED_SYSTEM_ADDRESS && loopback.clientAddress!=UNASSIGNED_SYSTEM_ADDRESS;
+}
+
+static void Disconnect(Loopback &loopback)
+{
+	loopback.server->Shutdown(100);
+	loopback.client->Shutdown(100);
+	RakPeerInterface::DestroyInstance(loopback.server);
+	RakPeerInterface::DestroyInstance(loopback.client);
+}
+
+// Message bytes, counting headers, sent both ways
+static uint64_t MessageBytes(Loopback &loopback)
+{
+	RakNetStatistics serverStatistics, clientStatistics;
+	loopback.server->GetStatistics(loopback.clientAddress, &serverStatistics);
+	loopback.client->GetStatistics(loopback.serverAddress, &clientStatistics);
+	return serverStatistics.runningTotal[USER_MESSAGE_BYTES_SENT]+clientStatistics.runningTotal[USER_MESSAGE_BYTES_SENT];
+}
+
+static bool WaitForDownload(Loopback &loopback, ReceiveFile &receiveFile)
+{
+	RakNet::TimeMS timeout=RakNet::GetTimeMS()+120000;
+	while (receiveFile.complete==false && RakNet::GetTimeMS() < timeout)
+	{
+		Packet *packet;
+		for (packet=loopback.client->Receive(); packet; loopback.client->DeallocatePacket(packet), packet=loopback.client->Receive())
+			;
+		for (packet=loopback.server->Receive(); packet; loopback.server->DeallocatePacket(packet), packet=loopback.server->Receive())
+			;
+		RakSleep(0);
+	}
+	return receiveFile.complete && receiveFile.correct;
+}
+
+static void PrintResult(const char *description, const Version &version, uint64_t fileBytes, uint64_t reusedBytes, uint64_t messageBytes, RakNet::TimeUS elapsed)
+{
+	printf("  %-26s %12u %12u %7.2f%% %12u %12u %8.1f ms\n", description, version.length, (unsigned int) fileBytes, 100.0*fileBytes/version.length,
+		(unsigned int) reusedBytes, (unsigned int) messageBytes, elapsed/1000.0);
+}
+
+// Sends version to the client, which has the original version in BASIS_FILE if useBasis
+static bool SendVersion(Loopback &loopback, IncrementalReadInterface *reader, const char *description, const Version &version, bool useBasis)
+{
+	if (WriteFileWithDirectories(SENT_FILE, version.data, version.length)==false)
+	{
+		printf("Could not write %s\n", SENT_FILE);
+		return false;
+	}
+	FileList fileList;
+	fileList.AddFile("archive.bin", SENT_FILE, 0, version.length, version.length, FileListNodeContext(0,0,0,0), true);
+	FileList basis;
+	if (useBasis)
+		basis.AddFile("archive.bin", BASIS_FILE, 0, 0, 0, FileListNodeContext(0,0,0,0), true);
+
+	ReceiveFile receiveFile;
+	receiveFile.expected=&version;
+	uint64_t fileBytes=loopback.serverTransfer.GetFileBytesSent();
+	uint64_t reusedBytes=loopback.clientTransfer.GetFileBytesReused();
+	uint64_t messageBytes=MessageBytes(loopback);
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+
+	unsigned short setId=loopback.clientTransfer.SetupReceive(&receiveFile, false, loopback.serverAddress);
+	loopback.clientTransfer.SetReceiveBasis(setId, basis);
+	loopback.serverTransfer.SendChunked(&fileList, loopback.server, loopback.clientAddress, setId, HIGH_PRIORITY, 0, reader, CHUNK_SIZE);
+	bool received=WaitForDownload(loopback, receiveFile);
+
+	RakNet::TimeUS elapsed=RakNet::GetTimeUS()-start;
+	PrintResult(description, version, loopback.serverTransfer.GetFileBytesSent()-fileBytes, loopback.clientTransfer.GetFileBytesReused()-reusedBytes,
+		MessageBytes(loopback)-messageBytes, elapsed);
+	if (received==false)
+		printf("%s: the file received was not the one sent\n", description);
+	return received;
+}
+
+// The client has the original version of data/archive.bin, and the server one with a byte changed, along with a file both have
+static bool DownloadDirectory(Loopback &loopback, IncrementalReadInterface *reader, const Version &original, const Version &version)
+{
+	char path[256];
+	const char unchanged[]="The same on both systems";
+	sprintf(path, "%sdata/archive.bin", SERVER_DIRECTORY);
+	bool written=WriteFileWithDirectories(path, version.data, version.length);
+	sprintf(path, "%sdata/unchanged.txt", SERVER_DIRECTORY);
+	written=written && WriteFileWithDirectories(path, (char*) unchanged, sizeof(unchanged));
+	sprintf(path, "%sdata/archive.bin", CLIENT_DIRECTORY);
+	written=written && WriteFileWithDirectories(path, original.data, original.length);
+	sprintf(path, "%sdata/unchanged.txt", CLIENT_DIRECTORY);
+	written=written && WriteFileWithDirectories(path, (char*) unchanged, sizeof(unchanged));
+	if (written==false)
+	{
+		printf("Could not write %s\n", path);
+		return false;
+	}
+
+	loopback.serverDirectoryTransfer.SetApplicationDirectory(SERVER_DIRECTORY);
+	loopback.serverDirectoryTransfer.AddUploadsFromSubdirectory("data");
+	loopback.serverDirectoryTransfer.SetDownloadRequestIncrementalReadInterface(reader, CHUNK_SIZE);
+	loopback.serverDirectoryTransfer.SetDownloadRequestChunking(true);
+	loopback.clientDirectoryTransfer.SetApplicationDirectory(CLIENT_DIRECTORY);
+
+	ReceiveFile receiveFile;
+	receiveFile.expected=&version;
+	uint64_t fileBytes=loopback.serverTransfer.GetFileBytesSent();
+	uint64_t reusedBytes=loopback.clientTransfer.GetFileBytesReused();
+	uint64_t messageBytes=MessageBytes(loopback);
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+
+	loopback.clientDirectoryTransfer.DownloadFromSubdirectory("data", "data", true, loopback.serverAddress, &receiveFile, HIGH_PRIORITY, 0, 0);
+	bool received=WaitForDownload(loopback, receiveFile);
+
+	RakNet::TimeUS elapsed=RakNet::GetTimeUS()-start;
+	PrintResult("DirectoryDeltaTransfer", version, loopback.serverTransfer.GetFileBytesSent()-fileBytes, loopback.clientTransfer.GetFileBytesReused()-reusedBytes,
+		MessageBytes(loopback)-messageBytes, elapsed);
+
+	// DirectoryDeltaTransfer writes the file over the original
+	sprintf(path, "%sdata/archive.bin", CLIENT_DIRECTORY);
+	FILE *fp=fopen(path, "rb");
+	char *written_data=new char[version.length];
+	bool onDisk=fp!=0 && fread(written_data, version.length, 1, fp)==1 && memcmp(written_data, version.data, version.length)==0;
+	delete [] written_data;
+	if (fp)
+		fclose(fp);
+	if (received==false || onDisk==false)
+		printf("DirectoryDeltaTransfer: the file received was not the one sent\n");
+
+	const char *directories[2]={SERVER_DIRECTORY, CLIENT_DIRECTORY};
+	for (int i=0; i < 2; i++)
+	{
+		sprintf(path, "%sdata/archive.bin", directories[i]);
+		remove(path);
+		sprintf(path, "%sdata/unchanged.txt", directories[i]);
+		remove(path);
+		sprintf(path, "%sdata", directories[i]);
+#ifdef _WIN32
+		_rmdir(path);
+		_rmdir(directories[i]);
+#else
+		rmdir(path);
+		rmdir(directories[i]);
+#endif
+	}
+	return received && onDisk;
+}
+
+int main(int argc, char **argv)
+{
+	printf("Counts the bytes FileListTransfer::SendChunked() sends for edited versions of a file the receiver has.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	unsigned int megabytes=16;
+	if (argc > 1)
+		megabytes=(unsigned int) atoi(argv[1]);
+	if (megabytes < 1)
+		megabytes=1;
+	// Files are read and chunked on these threads, rather than in Receive()
+	int threads=0;
+	if (argc > 2)
+		threads=atoi(argv[2]);
+
+	Version original=MakeOriginal(megabytes*1048576);
+	if (WriteFileWithDirectories(BASIS_FILE, original.data, original.length)==false)
+	{
+		printf("\nFAILED: could not write %s\n", BASIS_FILE);
+		return 1;
+	}
+
+	Loopback loopback;
+	if (Connect(loopback)==false)
+	{
+		printf("\nFAILED: could not connect over loopback\n");
+		return 1;
+	}
+	if (threads > 0)
+	{
+		loopback.serverTransfer.StartIncrementalReadThreads(threads);
+		loopback.clientTransfer.StartIncrementalReadThreads(threads);
+	}
+	IncrementalReadInterface reader;
+
+	printf("  %-26s %12s %12s %8s %12s %12s %11s\n", "", "File bytes", "Bytes sent", "", "Reused", "Messages", "Time");
+	struct EditCase
+	{
+		const char *description;
+		unsigned int offset, length, insertLength;
+	};
+	const unsigned int length=original.length;
+	const EditCase editCases[]=
+	{
+		{"Unchanged", 0, 0, 0},
+		{"One byte changed", length/3, 1, 1},
+		{"100 bytes inserted", length/5, 0, 100},
+		{"4096 bytes removed", length/4, 4096, 0},
+		{"65536 bytes appended", length, 0, 65536},
+		{"1 MB replaced", length/8, 1048576, 1048576},
+	};
+	unsigned int failures=0;
+	for (unsigned int i=0; i < sizeof(editCases)/sizeof(editCases[0]); i++)
+	{
+		Version version=Edit(original, editCases[i].offset, editCases[i].length, editCases[i].insertLength);
+		if (SendVersion(loopback, &reader, editCases[i].description, version, true)==false)
+			failures++;
+		delete [] version.data;
+	}
+
+	// Ten edits spread through the file, each changing a few chunks
+	Version version=Edit(original, 0, 0, 0);
+	for (unsigned int i=0; i < 10; i++)
+		version.data[NextRandom()%version.length]^=1;
+	if (SendVersion(loopback, &reader, "10 bytes changed", version, true)==false)
+		failures++;
+	if (SendVersion(loopback, &reader, "No basis file", version, false)==false)
+		failures++;
+	if (DownloadDirectory(loopback, &reader, original, version)==false)
+		failures++;
+	delete [] version.data;
+
+	Disconnect(loopback);
+	remove(BASIS_FILE);
+	remove(SENT_FILE);
+	delete [] original.data;
+
+	if (failures > 0)
+	{
+		printf("\nFAILED: %u files were not received intact\n", failures);
+		return 1;
+	}
+	printf("\nEvery edited file was received intact\n");
+	return 0;
+}
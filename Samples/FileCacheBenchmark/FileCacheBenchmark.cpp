@@ -0,0 +1,327 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Times the sending side of many concurrent FileListTransfer downloads of the same file set, reading each part as SendIRIToAddressCB() does,
+// with the default IncrementalReadInterface and with MappedFileCache. Each client is at a different place in the set, and they take turns sending one part
+// Every part read is checked against the generated contents, and a small set is also sent through FileListTransfer over loopback with MappedFileCache
+// Usage: FileCacheBenchmark [megabytes in the set] [clients]. Defaults to 500 megabytes and 200 clients
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include "RakPeerInterface.h"
+#include "FileListTransfer.h"
+#include "FileListTransferCBInterface.h"
+#include "FileList.h"
+#include "IncrementalReadInterface.h"
+#include "MappedFileCache.h"
+#include "MessageIdentifiers.h"
+#include "GetTime.h"
+#include "RakSleep.h"
+
+using namespace RakNet;
+
+static const unsigned int FILE_COUNT=50;
+static const unsigned int CHUNK_SIZE=262144;
+static const unsigned short SERVER_PORT=60000;
+static const unsigned int LOOPBACK_FILE_COUNT=8;
+static const unsigned int LOOPBACK_CHUNK_SIZE=65536;
+
+// Word i of file f, so any part can be checked without keeping the files in memory
+static uint32_t FileWord(unsigned int fileIndex, unsigned int wordIndex)
+{
+	uint32_t word=(fileIndex+1)*2654435761u ^ wordIndex*2246822519u;
+	return word ^ (word >> 15);
+}
+
+static void FileName(unsigned int fileIndex, char *filename)
+{
+	sprintf(filename, "FileCacheBenchmark_%02u.bin", fileIndex);
+}
+
+static bool WriteTestFile(unsigned int fileIndex, unsigned int length)
+{
+	char filename[64];
+	FileName(fileIndex, filename);
+	FILE *fp=fopen(filename, "wb");
+	if (fp==0)
+		return false;
+	uint32_t *words=new uint32_t[CHUNK_SIZE/4];
+	bool written=true;
+	for (unsigned int offset=0; offset < length && written; offset+=CHUNK_SIZE)
+	{
+		unsigned int partLength=length-offset < CHUNK_SIZE ? length-offset : CHUNK_SIZE;
+		for (unsigned int i=0; i < (partLength+3)/4; i++)
+			words[i]=FileWord(fileIndex, offset/4+i);
+		written=fwrite(words, 1, partLength, fp)==partLength;
+	}
+	delete [] words;
+	fclose(fp);
+	return written;
+}
+
+static bool CheckPart(unsigned int fileIndex, unsigned int offset, const char *data, unsigned int length)
+{
+	// The first and last whole word of the part
+	uint32_t word;
+	memcpy(&word, data, 4);
+	if (word!=FileWord(fileIndex, offset/4))
+		return false;
+	memcpy(&word, data+(length & ~3u)-4, 4);
+	return word==FileWord(fileIndex, (offset+(length & ~3u))/4-1);
+}
+
+struct Client
+{
+	unsigned int fileIndex;
+	unsigned int offset;
+	unsigned int filesDone;
+};
+
+// Returns milliseconds, or 0 if any part had the wrong contents
+static double SendToClients(IncrementalReadInterface *incrementalReadInterface, unsigned int clientCount, unsigned int fileLength, uint64_t *bytesSent)
+{
+	Client *clients=new Client[clientCount];
+	for (unsigned int i=0; i < clientCount; i++)
+	{
+		clients[i].fileIndex=i%FILE_COUNT;
+		clients[i].offset=0;
+		clients[i].filesDone=0;
+	}
+	// Stands in for the datagrams the part is copied into by SendListUnified()
+	char *outgoing=new char[CHUNK_SIZE];
+	char filename[64];
+	FileListNodeContext context;
+	unsigned int clientsDone=0;
+	bool correct=true;
+	*bytesSent=0;
+
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	while (clientsDone < clientCount && correct)
+	{
+		for (unsigned int i=0; i < clientCount; i++)
+		{
+			Client &client=clients[i];
+			if (client.filesDone==FILE_COUNT)
+				continue;
+			FileName(client.fileIndex, filename);
+
+			// As SendIRIToAddressCB()
+			const char *part;
+			unsigned int bytesRead;
+			char *buff=(char*) malloc(CHUNK_SIZE);
+			bool acquired=incrementalReadInterface->AcquireFilePart(filename, client.offset, CHUNK_SIZE, &part, &bytesRead, context);
+			if (!acquired)
+			{
+				bytesRead=incrementalReadInterface->GetFilePart(filename, client.offset, CHUNK_SIZE, buff, context);
+				part=buff;
+			}
+			if (bytesRead==0 || CheckPart(client.fileIndex, client.offset, part, bytesRead)==false)
+				correct=false;
+			else
+				memcpy(outgoing, part, bytesRead);
+			if (acquired)
+				incrementalReadInterface->ReleaseFilePart(filename, part);
+			free(buff);
+
+			*bytesSent+=bytesRead;
+			client.offset+=bytesRead;
+			if (client.offset==fileLength || bytesRead==0)
+			{
+				client.offset=0;
+				client.fileIndex=(client.fileIndex+1)%FILE_COUNT;
+				if (++client.filesDone==FILE_COUNT)
+					clientsDone++;
+			}
+		}
+	}
+	RakNet::TimeUS elapsed=RakNet::GetTimeUS()-start;
+
+	delete [] clients;
+	delete [] outgoing;
+	return correct ? (double) elapsed/1000.0 : 0.0;
+}
+
+class CheckFiles : public FileListTransferCBInterface
+{
+public:
+	CheckFiles() {filesReceived=0; wrongFiles=0; complete=false;}
+	bool OnFile(OnFileStruct *onFileStruct)
+	{
+		unsigned int fileIndex=(unsigned int) atoi(onFileStruct->fileName+strlen("FileCacheBenchmark_"));
+		unsigned int length=LoopbackFileLength(fileIndex);
+		bool correct=onFileStruct->byteLengthOfThisFile==length;
+		for (unsigned int i=0; i < length/4 && correct; i++)
+		{
+			uint32_t word;
+			memcpy(&word, onFileStruct->fileData+i*4, 4);
+			correct=word==FileWord(fileIndex, i);
+		}
+		if (!correct)
+			wrongFiles++;
+		filesReceived++;
+		return true;
+	}
+	void OnFileProgress(FileProgressStruct *) {}
+	bool OnDownloadComplete(DownloadCompleteStruct *) {complete=true; return false;}
+
+	// An empty file, some small enough to be sent together, and some sent in several parts
+	static unsigned int LoopbackFileLength(unsigned int fileIndex) {return fileIndex*fileIndex*fileIndex*1024;}
+
+	unsigned int filesReceived, wrongFiles;
+	bool complete;
+};
+
+// Sends LOOPBACK_FILE_COUNT files through FileListTransfer with MappedFileCache. Returns true if every file arrived intact
+static bool SendOverLoopback(MappedFileCache *mappedFileCache)
+{
+	RakPeerInterface *server=RakPeerInterface::GetInstance();
+	RakPeerInterface *client=RakPeerInterface::GetInstance();
+	SocketDescriptor serverSd(SERVER_PORT,0);
+	SocketDescriptor clientSd;
+	if (server->Startup(1,&serverSd,1)!=CRABNET_STARTED || client->Startup(1,&clientSd,1)!=CRABNET_STARTED)
+	{
+		printf("Startup failed\n");
+		return false;
+	}
+	server->SetMaximumIncomingConnections(1);
+	FileListTransfer serverTransfer, clientTransfer;
+	server->AttachPlugin(&serverTransfer);
+	client->AttachPlugin(&clientTransfer);
+	serverTransfer.StartIncrementalReadThreads(1);
+
+	FileList fileList;
+	char filename[64];
+	for (unsigned int i=0; i < LOOPBACK_FILE_COUNT; i++)
+	{
+		FileName(i, filename);
+		unsigned int length=CheckFiles::LoopbackFileLength(i);
+		fileList.AddFile(filename, filename, 0, length, length, FileListNodeContext(0,0,0,0), true);
+	}
+
+	CheckFiles checkFiles;
+	client->Connect("127.0.0.1", SERVER_PORT, 0, 0);
+	// Sent once the client has set up the receive and the server has the connection
+	bool receiveSetUp=false, sent=false;
+	unsigned short setId=0;
+	SystemAddress clientAddress=UNASSIGNED_SYSTEM_ADDRESS;
+	RakNet::TimeMS timeout=RakNet::GetTimeMS()+30000;
+	while (checkFiles.complete==false && RakNet::GetTimeMS() < timeout)
+	{
+		Packet *packet;
+		for (packet=client->Receive(); packet; client->DeallocatePacket(packet), packet=client->Receive())
+		{
+			if (packet->data[0]==ID_CONNECTION_REQUEST_ACCEPTED)
+			{
+				setId=clientTransfer.SetupReceive(&checkFiles, false, packet->systemAddress);
+				receiveSetUp=true;
+			}
+		}
+		for (packet=server->Receive(); packet; server->DeallocatePacket(packet), packet=server->Receive())
+		{
+			if (packet->data[0]==ID_NEW_INCOMING_CONNECTION)
+				clientAddress=packet->systemAddress;
+		}
+		if (receiveSetUp && clientAddress!=UNASSIGNED_SYSTEM_ADDRESS && sent==false)
+		{
+			serverTransfer.Send(&fileList, server, clientAddress, setId, HIGH_PRIORITY, 0, mappedFileCache, LOOPBACK_CHUNK_SIZE);
+			sent=true;
+		}
+		RakSleep(1);
+	}
+
+	server->Shutdown(100);
+	client->Shutdown(100);
+	RakPeerInterface::DestroyInstance(server);
+	RakPeerInterface::DestroyInstance(client);
+
+	if (checkFiles.filesReceived!=LOOPBACK_FILE_COUNT || checkFiles.wrongFiles > 0)
+	{
+		printf("Loopback transfer received %u of %u files, %u of them wrong\n", checkFiles.filesReceived, LOOPBACK_FILE_COUNT, checkFiles.wrongFiles);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	printf("Times reading the same file set for many concurrent FileListTransfer downloads,\n");
+	printf("with the default IncrementalReadInterface and with MappedFileCache.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	unsigned int setMegabytes=argc > 1 ? (unsigned int) atoi(argv[1]) : 500;
+	unsigned int clientCount=argc > 2 ? (unsigned int) atoi(argv[2]) : 200;
+	if (setMegabytes==0 || clientCount==0)
+	{
+		printf("Usage: FileCacheBenchmark [megabytes in the set] [clients]\n");
+		return 1;
+	}
+	// Whole words, so every part can be checked
+	unsigned int fileLength=(unsigned int) ((uint64_t) setMegabytes*1048576/FILE_COUNT) & ~3u;
+
+	bool success=true;
+	for (unsigned int i=0; i < FILE_COUNT && success; i++)
+		success=WriteTestFile(i, fileLength);
+	if (!success)
+	{
+		printf("\nFAILED: could not write the file set\n");
+		return 1;
+	}
+
+	printf("%u clients each downloading %u files of %u bytes, %u bytes per part\n", clientCount, FILE_COUNT, fileLength, CHUNK_SIZE);
+	IncrementalReadInterface readInterface;
+	MappedFileCache mappedFileCache;
+	uint64_t readBytes, mappedBytes;
+	double readMs=SendToClients(&readInterface, clientCount, fileLength, &readBytes);
+	double mappedMs=SendToClients(&mappedFileCache, clientCount, fileLength, &mappedBytes);
+	MappedFileCache::Statistics statistics=mappedFileCache.GetStatistics();
+	if (readMs > 0)
+		printf("  %-24s %10.0f ms %10.0f MB/s\n", "IncrementalReadInterface", readMs, (double) readBytes/1048576.0/(readMs/1000.0));
+	if (mappedMs > 0)
+		printf("  %-24s %10.0f ms %10.0f MB/s\n", "MappedFileCache", mappedMs, (double) mappedBytes/1048576.0/(mappedMs/1000.0));
+	printf("MappedFileCache mapped %u files, %.0f MB, with %llu mappings for %llu parts\n\n", statistics.filesMapped, (double) statistics.bytesMapped/1048576.0,
+		(unsigned long long) statistics.mappingsCreated, (unsigned long long) statistics.partsMapped);
+	uint64_t expectedBytes=(uint64_t) clientCount*FILE_COUNT*fileLength;
+	if (readMs==0 || mappedMs==0 || readBytes!=expectedBytes || mappedBytes!=expectedBytes)
+	{
+		printf("A part read had the wrong contents\n");
+		success=false;
+	}
+	mappedFileCache.Clear();
+
+	for (unsigned int i=0; i < FILE_COUNT; i++)
+	{
+		char filename[64];
+		FileName(i, filename);
+		remove(filename);
+	}
+
+	for (unsigned int i=0; i < LOOPBACK_FILE_COUNT && success; i++)
+		success=WriteTestFile(i, CheckFiles::LoopbackFileLength(i));
+	if (success && SendOverLoopback(&mappedFileCache)==false)
+		success=false;
+	mappedFileCache.Clear();
+	for (unsigned int i=0; i < LOOPBACK_FILE_COUNT; i++)
+	{
+		char filename[64];
+		FileName(i, filename);
+		remove(filename);
+	}
+
+	if (!success)
+	{
+		printf("\nFAILED: a file was not sent intact\n");
+		return 1;
+	}
+	printf("Every part was read intact, and FileListTransfer sent every file over loopback from MappedFileCache\n");
+	return 0;
+}
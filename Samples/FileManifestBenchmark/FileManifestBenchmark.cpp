@@ -0,0 +1,210 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Times DirectoryDeltaTransfer::GenerateHashes() on a directory tree: hashing every file on one thread, on several threads,
+// and with a FileManifestCache saved by an earlier run, before and after changing and deleting some files
+// Every file list built must have the same hashes as one built by hashing every file on one thread
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include "DirectoryDeltaTransfer.h"
+#include "FileList.h"
+#include "FileManifestCache.h"
+#include "FileOperations.h"
+#include "SuperFastHash.h"
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace RakNet;
+
+static const char *ROOT_DIRECTORY="FileManifestBenchmarkFiles/";
+static const char *MANIFEST_FILE="FileManifestBenchmark.manifest";
+static const unsigned int DIRECTORY_COUNT=16;
+static const unsigned int FILES_PER_DIRECTORY=32;
+static const unsigned int FILE_LENGTH=524288;
+static const int HASH_THREADS=4;
+// Every this many files is rewritten with different contents before the last run, and one file is deleted
+static const unsigned int CHANGE_INTERVAL=50;
+
+static unsigned int randomState=12345;
+static unsigned int NextRandom(void)
+{
+	randomState=randomState*1103515245+12345;
+	return randomState>>8;
+}
+
+static void FilePath(unsigned int fileIndex, char *path)
+{
+	sprintf(path, "%sdir%02u/file%03u.bin", ROOT_DIRECTORY, fileIndex/FILES_PER_DIRECTORY, fileIndex%FILES_PER_DIRECTORY);
+}
+
+static bool WriteFile(unsigned int fileIndex, unsigned int length)
+{
+	char path[256];
+	FilePath(fileIndex, path);
+	char *data=new char[length];
+	for (unsigned int i=0; i < length; i++)
+		data[i]=(char) NextRandom();
+	bool written=WriteFileWithDirectories(path, data, length);
+	delete [] data;
+	return written;
+}
+
+// Returns the number of files whose hash differs from, or that are missing in, expected
+static unsigned int CompareHashes(const FileList &fileList, const FileList &expected)
+{
+	unsigned int differences=expected.fileList.Size() > fileList.fileList.Size() ? expected.fileList.Size()-fileList.fileList.Size() : 0;
+	for (unsigned int i=0; i < fileList.fileList.Size(); i++)
+	{
+		const FileListNode &node=fileList.fileList[i];
+		unsigned int j;
+		for (j=0; j < expected.fileList.Size(); j++)
+		{
+			if (node.filename==expected.fileList[j].filename)
+				break;
+		}
+		if (j==expected.fileList.Size() || node.fileLengthBytes!=expected.fileList[j].fileLengthBytes ||
+			memcmp(node.data, expected.fileList[j].data, 4)!=0)
+			differences++;
+	}
+	return differences;
+}
+
+static void PrintStatistics(const char *description, const FileList::AddFilesStatistics &statistics)
+{
+	printf("  %-34s %8.1f ms %8.1f ms %8.1f ms %8u %8u\n", description, statistics.scanTime/1000.0, statistics.hashTime/1000.0,
+		statistics.totalTime/1000.0, statistics.filesHashed, statistics.filesFromManifest);
+}
+
+int main(void)
+{
+	printf("Times building the file list of a directory tree with and without FileManifestCache and hash threads.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	const unsigned int fileCount=DIRECTORY_COUNT*FILES_PER_DIRECTORY;
+	for (unsigned int i=0; i < fileCount; i++)
+	{
+		if (WriteFile(i, FILE_LENGTH)==false)
+		{
+			printf("\nFAILED: could not write %s\n", ROOT_DIRECTORY);
+			return 1;
+		}
+	}
+	remove(MANIFEST_FILE);
+
+	DirectoryDeltaTransfer directoryDeltaTransfer;
+	directoryDeltaTransfer.SetApplicationDirectory(ROOT_DIRECTORY);
+	unsigned int failures=0;
+
+	printf("%u files of %u bytes in %u directories\n", fileCount, FILE_LENGTH, DIRECTORY_COUNT);
+	printf("  %-34s %11s %11s %11s %8s %8s\n", "", "Scan", "Hash", "Total", "Hashed", "Cached");
+
+	FileList expected;
+	directoryDeltaTransfer.GenerateHashes(expected, "", true);
+	PrintStatistics("One thread", expected.GetAddFilesStatistics());
+
+	FileList threaded;
+	directoryDeltaTransfer.SetHashOptions(0, HASH_THREADS);
+	directoryDeltaTransfer.GenerateHashes(threaded, "", true);
+	PrintStatistics("Hash threads", threaded.GetAddFilesStatistics());
+	failures+=CompareHashes(threaded, expected);
+
+	// First run with a manifest, which has to hash everything
+	FileManifestCache manifestCache;
+	manifestCache.Load(MANIFEST_FILE);
+	directoryDeltaTransfer.SetHashOptions(&manifestCache, HASH_THREADS);
+	FileList firstRun;
+	directoryDeltaTransfer.GenerateHashes(firstRun, "", true);
+	PrintStatistics("Hash threads, empty manifest", firstRun.GetAddFilesStatistics());
+	failures+=CompareHashes(firstRun, expected);
+	manifestCache.RemoveUnused();
+	manifestCache.Save(MANIFEST_FILE);
+
+	// Restarted with nothing changed
+	FileManifestCache loadedManifestCache;
+	if (loadedManifestCache.Load(MANIFEST_FILE)==false || loadedManifestCache.Size()!=fileCount)
+	{
+		printf("The manifest saved did not load with %u files\n", fileCount);
+		failures++;
+	}
+	directoryDeltaTransfer.SetHashOptions(&loadedManifestCache, HASH_THREADS);
+	FileList unchanged;
+	directoryDeltaTransfer.GenerateHashes(unchanged, "", true);
+	PrintStatistics("Saved manifest, no changes", unchanged.GetAddFilesStatistics());
+	failures+=CompareHashes(unchanged, expected);
+	if (unchanged.GetAddFilesStatistics().filesHashed!=0)
+	{
+		printf("%u unchanged files were hashed again\n", unchanged.GetAddFilesStatistics().filesHashed);
+		failures++;
+	}
+	// As after each time the file list is built, so entries for deleted files do not build up
+	loadedManifestCache.RemoveUnused();
+
+	// Rewrite some files with different contents and lengths, and delete one
+	unsigned int changedCount=0;
+	for (unsigned int i=0; i < fileCount; i+=CHANGE_INTERVAL)
+	{
+		WriteFile(i, FILE_LENGTH+4);
+		changedCount++;
+	}
+	char deletedPath[256];
+	FilePath(fileCount-1, deletedPath);
+	remove(deletedPath);
+	FileList changedExpected;
+	directoryDeltaTransfer.SetHashOptions(0, 0);
+	directoryDeltaTransfer.GenerateHashes(changedExpected, "", true);
+
+	directoryDeltaTransfer.SetHashOptions(&loadedManifestCache, HASH_THREADS);
+	FileList changed;
+	directoryDeltaTransfer.GenerateHashes(changed, "", true);
+	PrintStatistics("Saved manifest, some changed", changed.GetAddFilesStatistics());
+	failures+=CompareHashes(changed, changedExpected);
+	if (changed.GetAddFilesStatistics().filesHashed!=changedCount)
+	{
+		printf("%u files were hashed, rather than the %u changed\n", changed.GetAddFilesStatistics().filesHashed, changedCount);
+		failures++;
+	}
+	if (loadedManifestCache.RemoveUnused()!=1)
+	{
+		printf("The deleted file was not removed from the manifest\n");
+		failures++;
+	}
+
+	changedExpected.DeleteFiles(ROOT_DIRECTORY);
+	for (unsigned int i=0; i < DIRECTORY_COUNT; i++)
+	{
+		char path[256];
+		sprintf(path, "%sdir%02u", ROOT_DIRECTORY, i);
+#ifdef _WIN32
+		_rmdir(path);
+#else
+		rmdir(path);
+#endif
+	}
+#ifdef _WIN32
+	_rmdir(ROOT_DIRECTORY);
+#else
+	rmdir(ROOT_DIRECTORY);
+#endif
+	remove(MANIFEST_FILE);
+
+	if (failures > 0)
+	{
+		printf("\nFAILED: %u file lists or counts were wrong\n", failures);
+		return 1;
+	}
+	printf("\nEvery file list had the same hashes, and only changed files were hashed again\n");
+	return 0;
+}
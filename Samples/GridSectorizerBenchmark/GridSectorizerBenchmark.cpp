@@ -0,0 +1,163 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Moves 50,000 entities around a GridSectorizer at 30 Hz, and runs range and k-nearest queries each tick
+// Reports the time per tick for moves and queries, and checks query results against a brute force search
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "GridSectorizer.h"
+#include "GetTime.h"
+
+static const int NUM_ENTITIES=50000;
+static const int NUM_TICKS=90;
+static const int TICKS_PER_SECOND=30;
+static const int RANGE_QUERIES_PER_TICK=500;
+static const int NEAREST_QUERIES_PER_TICK=500;
+static const int NEAREST_K=16;
+static const float WORLD_SIZE=10000.0f;
+static const float CELL_SIZE=100.0f;
+static const float QUERY_RADIUS=150.0f;
+static const float ENTITY_HALF_SIZE=1.0f;
+
+struct Entity
+{
+	float x, y;
+	float velocityX, velocityY;
+};
+
+static float RandomFloat(float range)
+{
+	return (float) rand() / (float) RAND_MAX * range;
+}
+
+static float DistanceSquared(const Entity &entity, float x, float y)
+{
+	float dx = x < entity.x-ENTITY_HALF_SIZE ? entity.x-ENTITY_HALF_SIZE-x : (x > entity.x+ENTITY_HALF_SIZE ? x-entity.x-ENTITY_HALF_SIZE : 0.0f);
+	float dy = y < entity.y-ENTITY_HALF_SIZE ? entity.y-ENTITY_HALF_SIZE-y : (y > entity.y+ENTITY_HALF_SIZE ? y-entity.y-ENTITY_HALF_SIZE : 0.0f);
+	return dx*dx+dy*dy;
+}
+
+static bool VerifyRangeQuery(Entity *entities, DataStructures::List<void*> &result, float minX, float minY, float maxX, float maxY)
+{
+	int expected=0;
+	for (int i=0; i < NUM_ENTITIES; i++)
+	{
+		if (entities[i].x-ENTITY_HALF_SIZE <= maxX && entities[i].x+ENTITY_HALF_SIZE >= minX &&
+			entities[i].y-ENTITY_HALF_SIZE <= maxY && entities[i].y+ENTITY_HALF_SIZE >= minY)
+			expected++;
+	}
+	if ((int) result.Size()!=expected)
+		return false;
+	// Each entity exactly once
+	for (unsigned i=0; i < result.Size(); i++)
+	{
+		for (unsigned j=i+1; j < result.Size(); j++)
+		{
+			if (result[i]==result[j])
+				return false;
+		}
+	}
+	return true;
+}
+
+static bool VerifyNearestQuery(Entity *entities, DataStructures::List<void*> &result, float x, float y)
+{
+	if (result.Size()!=NEAREST_K)
+		return false;
+	float furthest = DistanceSquared(*(Entity*) result[result.Size()-1], x, y);
+	int closer=0;
+	for (int i=0; i < NUM_ENTITIES; i++)
+	{
+		if (DistanceSquared(entities[i], x, y) < furthest)
+			closer++;
+	}
+	return closer < NEAREST_K;
+}
+
+int main(void)
+{
+	printf("Moves %i entities in a GridSectorizer at %i Hz and runs %i range and %i k-nearest (k=%i) queries per tick.\n",
+		NUM_ENTITIES, TICKS_PER_SECOND, RANGE_QUERIES_PER_TICK, NEAREST_QUERIES_PER_TICK, NEAREST_K);
+
+	GridSectorizer gridSectorizer;
+	gridSectorizer.Init(CELL_SIZE, CELL_SIZE, 0.0f, 0.0f, WORLD_SIZE, WORLD_SIZE);
+
+	Entity *entities = new Entity[NUM_ENTITIES];
+	for (int i=0; i < NUM_ENTITIES; i++)
+	{
+		entities[i].x=RandomFloat(WORLD_SIZE);
+		entities[i].y=RandomFloat(WORLD_SIZE);
+		// Up to running speed, 10 units per second
+		entities[i].velocityX=RandomFloat(20.0f)-10.0f;
+		entities[i].velocityY=RandomFloat(20.0f)-10.0f;
+		gridSectorizer.AddEntry(&entities[i], entities[i].x-ENTITY_HALF_SIZE, entities[i].y-ENTITY_HALF_SIZE, entities[i].x+ENTITY_HALF_SIZE, entities[i].y+ENTITY_HALF_SIZE);
+	}
+
+	DataStructures::List<void*> result;
+	RakNet::TimeUS moveTime=0, rangeTime=0, nearestTime=0, startTime;
+	unsigned long long rangeResults=0;
+	int failures=0;
+	const float dt = 1.0f / TICKS_PER_SECOND;
+	for (int tick=0; tick < NUM_TICKS; tick++)
+	{
+		startTime=RakNet::GetTimeUS();
+		for (int i=0; i < NUM_ENTITIES; i++)
+		{
+			Entity &entity = entities[i];
+			float newX = entity.x + entity.velocityX*dt;
+			float newY = entity.y + entity.velocityY*dt;
+			if (newX < 0.0f || newX > WORLD_SIZE) {entity.velocityX=-entity.velocityX; newX=entity.x;}
+			if (newY < 0.0f || newY > WORLD_SIZE) {entity.velocityY=-entity.velocityY; newY=entity.y;}
+			gridSectorizer.MoveEntry(&entity,
+				entity.x-ENTITY_HALF_SIZE, entity.y-ENTITY_HALF_SIZE, entity.x+ENTITY_HALF_SIZE, entity.y+ENTITY_HALF_SIZE,
+				newX-ENTITY_HALF_SIZE, newY-ENTITY_HALF_SIZE, newX+ENTITY_HALF_SIZE, newY+ENTITY_HALF_SIZE);
+			entity.x=newX;
+			entity.y=newY;
+		}
+		moveTime+=RakNet::GetTimeUS()-startTime;
+
+		for (int i=0; i < RANGE_QUERIES_PER_TICK; i++)
+		{
+			float x=RandomFloat(WORLD_SIZE), y=RandomFloat(WORLD_SIZE);
+			startTime=RakNet::GetTimeUS();
+			gridSectorizer.GetEntries(result, x-QUERY_RADIUS, y-QUERY_RADIUS, x+QUERY_RADIUS, y+QUERY_RADIUS);
+			rangeTime+=RakNet::GetTimeUS()-startTime;
+			rangeResults+=result.Size();
+			// Brute force checking is slow, so only check a few
+			if (i==0 && VerifyRangeQuery(entities, result, x-QUERY_RADIUS, y-QUERY_RADIUS, x+QUERY_RADIUS, y+QUERY_RADIUS)==false)
+				failures++;
+		}
+
+		for (int i=0; i < NEAREST_QUERIES_PER_TICK; i++)
+		{
+			float x=RandomFloat(WORLD_SIZE), y=RandomFloat(WORLD_SIZE);
+			startTime=RakNet::GetTimeUS();
+			gridSectorizer.GetNearestEntries(result, x, y, NEAREST_K);
+			nearestTime+=RakNet::GetTimeUS()-startTime;
+			if (i==0 && VerifyNearestQuery(entities, result, x, y)==false)
+				failures++;
+		}
+	}
+
+	printf("Move all entities: %.3f ms/tick\n", (double) moveTime / NUM_TICKS / 1000.0);
+	printf("Range queries:     %.3f ms/tick (%.1f results per query)\n", (double) rangeTime / NUM_TICKS / 1000.0, (double) rangeResults / (NUM_TICKS*RANGE_QUERIES_PER_TICK));
+	printf("Nearest queries:   %.3f ms/tick\n", (double) nearestTime / NUM_TICKS / 1000.0);
+	printf("Tick budget at %i Hz: %.3f ms\n", TICKS_PER_SECOND, 1000.0 / TICKS_PER_SECOND);
+	if (failures)
+		printf("FAILED: %i queries did not match a brute force search\n", failures);
+	else
+		printf("All checked queries matched a brute force search\n");
+
+	delete [] entities;
+	return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,287 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Times inserts, lookups of present and missing keys, and removals on DataStructures::Hash, OrderedList and OpenHash, from 64 to 16384 entries
+// Keys are RakStrings, as for the functions and slots of RPC4, and 64 bit integers, as for the NetworkIDs of TeamManager
+// Before timing, runs the same random operations on a Hash and an OpenHash and checks they always agree
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include "DS_Hash.h"
+#include "DS_OpenHash.h"
+#include "DS_OrderedList.h"
+#include "RakString.h"
+#include "GetTime.h"
+
+using namespace DataStructures;
+using namespace RakNet;
+
+static const unsigned int SIZES[]={64, 1024, 4096, 16384};
+static const unsigned int SIZE_COUNT=sizeof(SIZES)/sizeof(SIZES[0]);
+// Operations timed for each container and size, repeating the smaller sizes
+static const unsigned int OPERATIONS_PER_SIZE=65536;
+static const unsigned int RANDOM_OPERATIONS=500000;
+
+static unsigned long Uint64ToInteger(const uint64_t &key)
+{
+	// Same as TM_Team::ToUint32()
+	return (unsigned long) (key & 0xFFFFFFFF);
+}
+
+template <class key_type>
+struct Entry
+{
+	key_type key;
+	unsigned int value;
+};
+
+template <class key_type>
+int EntryComp(const key_type &key, const Entry<key_type> &entry)
+{
+	if (key < entry.key)
+		return -1;
+	if (key==entry.key)
+		return 0;
+	return 1;
+}
+
+struct Times
+{
+	double push, hit, miss, remove;
+};
+
+static unsigned int randomState=12345;
+static unsigned int NextRandom(void)
+{
+	randomState=randomState*1103515245+12345;
+	return randomState>>8;
+}
+
+static double NsPerOperation(RakNet::TimeUS start, unsigned int operations)
+{
+	return (double) (RakNet::GetTimeUS()-start)*1000.0/operations;
+}
+
+// Hash and OpenHash have the same interface. Returns false if a lookup returned the wrong value
+template <class Map, class key_type>
+static bool TimeHash(key_type *keys, key_type *missingKeys, unsigned int count, Times &times)
+{
+	const unsigned int rounds=OPERATIONS_PER_SIZE/count;
+	unsigned int wrong=0;
+	Map *maps=new Map[rounds];
+
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	for (unsigned int round=0; round < rounds; round++)
+		for (unsigned int i=0; i < count; i++)
+			maps[round].Push(keys[i], i);
+	times.push=NsPerOperation(start, rounds*count);
+
+	start=RakNet::GetTimeUS();
+	for (unsigned int round=0; round < rounds; round++)
+		for (unsigned int i=0; i < count; i++)
+		{
+			unsigned int *value=maps[round].Peek(keys[i]);
+			if (value==0 || *value!=i)
+				wrong++;
+		}
+	times.hit=NsPerOperation(start, rounds*count);
+
+	start=RakNet::GetTimeUS();
+	for (unsigned int round=0; round < rounds; round++)
+		for (unsigned int i=0; i < count; i++)
+		{
+			if (maps[round].Peek(missingKeys[i])!=0)
+				wrong++;
+		}
+	times.miss=NsPerOperation(start, rounds*count);
+
+	start=RakNet::GetTimeUS();
+	for (unsigned int round=0; round < rounds; round++)
+		for (unsigned int i=0; i < count; i++)
+		{
+			if (maps[round].Remove(keys[i])==false)
+				wrong++;
+		}
+	times.remove=NsPerOperation(start, rounds*count);
+
+	delete [] maps;
+	return wrong==0;
+}
+
+template <class key_type>
+static bool TimeOrderedList(key_type *keys, key_type *missingKeys, unsigned int count, Times &times)
+{
+	typedef OrderedList<key_type, Entry<key_type>, EntryComp<key_type> > EntryList;
+	const unsigned int rounds=OPERATIONS_PER_SIZE/count;
+	unsigned int wrong=0;
+	EntryList *lists=new EntryList[rounds];
+
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	for (unsigned int round=0; round < rounds; round++)
+		for (unsigned int i=0; i < count; i++)
+		{
+			Entry<key_type> entry;
+			entry.key=keys[i];
+			entry.value=i;
+			lists[round].Insert(keys[i], entry, true);
+		}
+	times.push=NsPerOperation(start, rounds*count);
+
+	start=RakNet::GetTimeUS();
+	for (unsigned int round=0; round < rounds; round++)
+		for (unsigned int i=0; i < count; i++)
+		{
+			bool exists;
+			unsigned int index=lists[round].GetIndexFromKey(keys[i], &exists);
+			if (exists==false || lists[round][index].value!=i)
+				wrong++;
+		}
+	times.hit=NsPerOperation(start, rounds*count);
+
+	start=RakNet::GetTimeUS();
+	for (unsigned int round=0; round < rounds; round++)
+		for (unsigned int i=0; i < count; i++)
+		{
+			bool exists;
+			lists[round].GetIndexFromKey(missingKeys[i], &exists);
+			if (exists)
+				wrong++;
+		}
+	times.miss=NsPerOperation(start, rounds*count);
+
+	start=RakNet::GetTimeUS();
+	for (unsigned int round=0; round < rounds; round++)
+		for (unsigned int i=0; i < count; i++)
+			lists[round].Remove(keys[i]);
+	times.remove=NsPerOperation(start, rounds*count);
+	for (unsigned int round=0; round < rounds; round++)
+	{
+		if (lists[round].Size()!=0)
+			wrong++;
+	}
+
+	delete [] lists;
+	return wrong==0;
+}
+
+static void PrintTimes(const char *keyType, unsigned int count, const char *container, const Times &times)
+{
+	printf("%-10s %8u  %-12s %10.1f %10.1f %10.1f %10.1f\n", keyType, count, container, times.push, times.hit, times.miss, times.remove);
+}
+
+// Runs random pushes, pops and lookups on a Hash and an OpenHash with the same keys, and returns the number of times they disagreed
+static unsigned int CompareRandomOperations(void)
+{
+	Hash<uint64_t, unsigned int, 256, Uint64ToInteger> hash;
+	OpenHash<uint64_t, unsigned int, Uint64ToInteger> openHash;
+	unsigned int disagreements=0;
+	for (unsigned int i=0; i < RANDOM_OPERATIONS; i++)
+	{
+		// Few enough keys that most operations find one, with the high bits set so only the mixing of OpenHash spreads them
+		uint64_t key=((uint64_t) (NextRandom()%4096) << 40) | (NextRandom()%4);
+		unsigned int operation=NextRandom()%4;
+		if (operation==0)
+		{
+			if (hash.HasData(key)!=openHash.HasData(key))
+				disagreements++;
+			else if (hash.HasData(key)==false)
+			{
+				hash.Push(key, i);
+				openHash.Push(key, i);
+			}
+		}
+		else if (operation==1)
+		{
+			unsigned int hashValue=0, openHashValue=0;
+			bool hashFound=hash.Pop(hashValue, key);
+			bool openHashFound=openHash.Pop(openHashValue, key);
+			if (hashFound!=openHashFound || hashValue!=openHashValue)
+				disagreements++;
+		}
+		else
+		{
+			unsigned int *hashValue=hash.Peek(key);
+			unsigned int *openHashValue=openHash.Peek(key);
+			if ((hashValue==0)!=(openHashValue==0) || (hashValue && *hashValue!=*openHashValue))
+				disagreements++;
+		}
+		if (hash.Size()!=openHash.Size())
+			disagreements++;
+	}
+	return disagreements;
+}
+
+int main(void)
+{
+	printf("Times DataStructures::Hash, OrderedList and OpenHash from 64 to 16384 entries.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	unsigned int failures=CompareRandomOperations();
+	if (failures > 0)
+		printf("Hash and OpenHash disagreed %u times\n", failures);
+
+	const unsigned int maxCount=SIZES[SIZE_COUNT-1];
+	RakString *stringKeys=new RakString[maxCount];
+	RakString *missingStringKeys=new RakString[maxCount];
+	uint64_t *integerKeys=new uint64_t[maxCount];
+	uint64_t *missingIntegerKeys=new uint64_t[maxCount];
+	uint64_t base=((uint64_t) NextRandom() << 32) | NextRandom();
+	for (unsigned int i=0; i < maxCount; i++)
+	{
+		stringKeys[i].Set("Function%u", i);
+		missingStringKeys[i].Set("Missing%u", i);
+		// Sequential, as NetworkIDs are
+		integerKeys[i]=base+i;
+		missingIntegerKeys[i]=base+maxCount+i;
+	}
+
+	printf("%-10s %8s  %-12s %10s %10s %10s %10s\n", "Keys", "Entries", "Container", "Push ns", "Hit ns", "Miss ns", "Remove ns");
+	for (unsigned int i=0; i < SIZE_COUNT; i++)
+	{
+		Times times;
+		if (TimeHash<Hash<RakString, unsigned int, 256, RakString::ToInteger> >(stringKeys, missingStringKeys, SIZES[i], times)==false)
+			failures++;
+		PrintTimes("RakString", SIZES[i], "Hash<256>", times);
+		if (TimeOrderedList(stringKeys, missingStringKeys, SIZES[i], times)==false)
+			failures++;
+		PrintTimes("RakString", SIZES[i], "OrderedList", times);
+		if (TimeHash<OpenHash<RakString, unsigned int, RakString::ToInteger> >(stringKeys, missingStringKeys, SIZES[i], times)==false)
+			failures++;
+		PrintTimes("RakString", SIZES[i], "OpenHash", times);
+	}
+	for (unsigned int i=0; i < SIZE_COUNT; i++)
+	{
+		Times times;
+		if (TimeHash<Hash<uint64_t, unsigned int, 256, Uint64ToInteger> >(integerKeys, missingIntegerKeys, SIZES[i], times)==false)
+			failures++;
+		PrintTimes("uint64_t", SIZES[i], "Hash<256>", times);
+		if (TimeOrderedList(integerKeys, missingIntegerKeys, SIZES[i], times)==false)
+			failures++;
+		PrintTimes("uint64_t", SIZES[i], "OrderedList", times);
+		if (TimeHash<OpenHash<uint64_t, unsigned int, Uint64ToInteger> >(integerKeys, missingIntegerKeys, SIZES[i], times)==false)
+			failures++;
+		PrintTimes("uint64_t", SIZES[i], "OpenHash", times);
+	}
+
+	delete [] stringKeys;
+	delete [] missingStringKeys;
+	delete [] integerKeys;
+	delete [] missingIntegerKeys;
+
+	if (failures > 0)
+	{
+		printf("\nFAILED: %u checks did not return the expected entries\n", failures);
+		return 1;
+	}
+	printf("\nAll containers returned the expected entries\n");
+	return 0;
+}
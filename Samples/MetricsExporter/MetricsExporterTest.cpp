@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Runs a server and a client over loopback and exports the server's metrics
+// While it runs, the metrics can be read from http://127.0.0.1:9464/metrics, for example with curl or as a Prometheus scrape target
+
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include "RakPeerInterface.h"
+#include "MessageIdentifiers.h"
+#include "MetricsExporter.h"
+#include "TCPInterface.h"
+#include "BitStream.h"
+#include "GetTime.h"
+#include "RakSleep.h"
+
+using namespace RakNet;
+
+static const unsigned short SERVER_PORT=60000;
+static const unsigned short METRICS_PORT=9464;
+static const RakNet::TimeMS RUN_TIME=20000;
+
+int main(void)
+{
+	printf("Exports the metrics of a server with one loopback client.\n");
+	printf("While this runs, the metrics are served on http://127.0.0.1:%i/metrics\n", METRICS_PORT);
+	printf("Difficulty: Beginner\n\n");
+
+	RakPeerInterface *server=RakPeerInterface::GetInstance();
+	RakPeerInterface *client=RakPeerInterface::GetInstance();
+	MetricsExporter metricsExporter;
+	TCPInterface httpServer;
+
+	server->AttachPlugin(&metricsExporter);
+	metricsExporter.SetIncludeConnectionStatistics(true);
+	metricsExporter.SetSnapshotInterval(1000);
+
+	SocketDescriptor serverSd(SERVER_PORT,0);
+	SocketDescriptor clientSd;
+	if (server->Startup(1,&serverSd,1)!=CRABNET_STARTED || client->Startup(1,&clientSd,1)!=CRABNET_STARTED)
+	{
+		printf("Startup failed\n");
+		return 1;
+	}
+	server->SetMaximumIncomingConnections(1);
+	if (httpServer.Start(METRICS_PORT, 8))
+		metricsExporter.SetHTTPServer(&httpServer);
+	else
+		printf("Could not listen on port %i, metrics will only be written to metrics.txt\n", METRICS_PORT);
+
+	client->Connect("127.0.0.1", SERVER_PORT, 0, 0);
+
+	RakNet::TimeMS startTime=RakNet::GetTimeMS();
+	RakNet::TimeMS nextWrite=startTime;
+	unsigned int messageCount=0;
+	char payload[400];
+	memset(payload, 0, sizeof(payload));
+	payload[0]=ID_USER_PACKET_ENUM;
+	while (RakNet::GetTimeMS()-startTime < RUN_TIME)
+	{
+		Packet *packet;
+		for (packet=server->Receive(); packet; server->DeallocatePacket(packet), packet=server->Receive())
+			;
+		for (packet=client->Receive(); packet; client->DeallocatePacket(packet), packet=client->Receive())
+		{
+			if (packet->data[0]==ID_CONNECTION_REQUEST_ACCEPTED)
+				printf("Client connected, sending messages\n");
+		}
+
+		// Some traffic at every priority
+		if (client->NumberOfConnections()>0)
+		{
+			for (int priority=IMMEDIATE_PRIORITY; priority < NUMBER_OF_PRIORITIES; priority++)
+				client->Send(payload, 1+messageCount%sizeof(payload), (PacketPriority) priority, RELIABLE_ORDERED, 0, UNASSIGNED_SYSTEM_ADDRESS, true);
+			messageCount++;
+		}
+
+		metricsExporter.SetGauge("example_messages_queued", "Messages the client queued in this sample.", (double) messageCount*NUMBER_OF_PRIORITIES);
+
+		if (RakNet::GetTimeMS() >= nextWrite)
+		{
+			metricsExporter.WriteSnapshot("metrics.txt");
+			nextWrite+=1000;
+		}
+
+		RakSleep(10);
+	}
+
+	metricsExporter.UpdateSnapshot();
+	printf("%s", metricsExporter.GetSnapshot().C_String());
+	metricsExporter.WriteSnapshot("metrics.txt");
+
+	httpServer.Stop();
+	client->Shutdown(100);
+	server->Shutdown(100);
+	server->DetachPlugin(&metricsExporter);
+	RakPeerInterface::DestroyInstance(client);
+	RakPeerInterface::DestroyInstance(server);
+	return 0;
+}
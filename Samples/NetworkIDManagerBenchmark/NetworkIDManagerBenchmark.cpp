@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Measures NetworkIDManager insert, lookup and remove times at different object counts
+// Objects are inserted both as an authority (consecutive IDs from GetNewNetworkID()) and as a client (arbitrary IDs from SetNetworkID())
+
+#include <cstdio>
+#include <stdlib.h>
+#include "NetworkIDManager.h"
+#include "NetworkIDObject.h"
+#include "GetTime.h"
+
+using namespace RakNet;
+
+static const int objectCounts[] = {1000, 100000, 1000000};
+static const int NUM_LOOKUP_PASSES=4;
+
+static NetworkID RandomNetworkID(void)
+{
+	NetworkID id;
+	do
+	{
+		id = ((NetworkID) rand() << 48) ^ ((NetworkID) rand() << 32) ^ ((NetworkID) rand() << 16) ^ (NetworkID) rand();
+	} while (id==UNASSIGNED_NETWORK_ID);
+	return id;
+}
+
+// Returns the number of failed checks
+static int RunBenchmark(int numObjects, bool isAuthority)
+{
+	int failures=0;
+	NetworkIDManager manager;
+	NetworkIDObject *objects = new NetworkIDObject[numObjects];
+	NetworkID *ids = new NetworkID[numObjects];
+	int *lookupOrder = new int[numObjects];
+
+	RakNet::TimeUS startTime = RakNet::GetTimeUS();
+	for (int i=0; i < numObjects; i++)
+	{
+		if (isAuthority==false)
+		{
+			// The odds of a repeated random 64 bit ID are negligible at these counts
+			objects[i].SetNetworkID(RandomNetworkID());
+		}
+		objects[i].SetNetworkIDManager(&manager);
+	}
+	RakNet::TimeUS insertTime = RakNet::GetTimeUS()-startTime;
+
+	for (int i=0; i < numObjects; i++)
+	{
+		ids[i]=objects[i].GetNetworkID();
+		lookupOrder[i]=i;
+	}
+	for (int i=numObjects-1; i > 0; i--)
+	{
+		int j=rand()%(i+1);
+		int temp=lookupOrder[i];
+		lookupOrder[i]=lookupOrder[j];
+		lookupOrder[j]=temp;
+	}
+	if (manager.GetNetworkIDObjectCount()!=(unsigned int) numObjects)
+		failures++;
+
+	startTime = RakNet::GetTimeUS();
+	for (int pass=0; pass < NUM_LOOKUP_PASSES; pass++)
+	{
+		for (int i=0; i < numObjects; i++)
+		{
+			int index=lookupOrder[i];
+			if (manager.GET_OBJECT_FROM_ID<NetworkIDObject*>(ids[index])!=&objects[index])
+				failures++;
+		}
+	}
+	RakNet::TimeUS lookupTime = RakNet::GetTimeUS()-startTime;
+
+	// Missing IDs probe until an empty slot, which is the worst case for lookups
+	startTime = RakNet::GetTimeUS();
+	for (int i=0; i < numObjects; i++)
+	{
+		if (manager.GET_OBJECT_FROM_ID<NetworkIDObject*>(ids[i]^0x5555555555555555ULL)!=0 && (ids[i]^0x5555555555555555ULL)!=ids[i])
+		{
+			// Could legitimately be another object's ID, but not at these counts with random IDs
+			if (isAuthority==false)
+				failures++;
+		}
+	}
+	RakNet::TimeUS missTime = RakNet::GetTimeUS()-startTime;
+
+	// Remove every other object in lookup order, check the rest are still found, then remove the rest
+	startTime = RakNet::GetTimeUS();
+	for (int i=0; i < numObjects; i+=2)
+		objects[lookupOrder[i]].SetNetworkIDManager(0);
+	RakNet::TimeUS removeTime = RakNet::GetTimeUS()-startTime;
+	for (int i=0; i < numObjects; i++)
+	{
+		int index=lookupOrder[i];
+		NetworkIDObject *expected = (i%2==0) ? 0 : &objects[index];
+		if (manager.GET_OBJECT_FROM_ID<NetworkIDObject*>(ids[index])!=expected)
+			failures++;
+	}
+	startTime = RakNet::GetTimeUS();
+	for (int i=1; i < numObjects; i+=2)
+		objects[lookupOrder[i]].SetNetworkIDManager(0);
+	removeTime += RakNet::GetTimeUS()-startTime;
+	if (manager.GetNetworkIDObjectCount()!=0)
+		failures++;
+
+	printf("%8i objects, %s: insert %.1f ns, lookup %.1f ns, missing lookup %.1f ns, remove %.1f ns\n",
+		numObjects, isAuthority ? "authority" : "client   ",
+		1000.0 * insertTime / numObjects,
+		1000.0 * lookupTime / ((double) numObjects * NUM_LOOKUP_PASSES),
+		1000.0 * missTime / numObjects,
+		1000.0 * removeTime / numObjects);
+
+	delete [] objects;
+	delete [] ids;
+	delete [] lookupOrder;
+	return failures;
+}
+
+int main(void)
+{
+	printf("Measures NetworkIDManager times per object.\n");
+
+	int failures=0;
+	for (unsigned i=0; i < sizeof(objectCounts)/sizeof(objectCounts[0]); i++)
+	{
+		failures+=RunBenchmark(objectCounts[i], true);
+		failures+=RunBenchmark(objectCounts[i], false);
+	}
+
+	if (failures)
+		printf("FAILED: %i lookups returned the wrong object\n", failures);
+	else
+		printf("All lookups returned the right object\n");
+	return failures==0 ? 0 : 1;
+}
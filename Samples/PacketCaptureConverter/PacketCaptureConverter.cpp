@@ -0,0 +1,256 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Converts a capture written by PacketCaptureLogger to text, CSV, or a pcap file
+// The pcap file uses link type USER0 (147), with each PacketCaptureRecord as one frame, so a dissector for PacketCaptureRecord is needed to see the fields in Wireshark
+
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include "PacketCaptureLogger.h"
+#include "PacketLogger.h"
+#include "PacketPriority.h"
+
+using namespace RakNet;
+
+enum OutputFormat
+{
+	OF_TEXT,
+	OF_CSV,
+	OF_PCAP
+};
+
+static const char *EventTypeToString(unsigned char eventType)
+{
+	static const char *eventTypes[] = {"SndRaw", "RcvRaw", "Snd", "Rcv", "Ack", "PBP", "Err", "Wrn"};
+	if (eventType < sizeof(eventTypes)/sizeof(eventTypes[0]))
+		return eventTypes[eventType];
+	return "?";
+}
+
+static const char *ReliabilityToString(unsigned char reliability)
+{
+	static const char *reliabilities[] = {"UNRELIABLE", "UNRELIABLE_SEQUENCED", "RELIABLE", "RELIABLE_ORDERED", "RELIABLE_SEQUENCED",
+		"UNRELIABLE_WITH_ACK_RECEIPT", "RELIABLE_WITH_ACK_RECEIPT", "RELIABLE_ORDERED_WITH_ACK_RECEIPT"};
+	if (reliability < sizeof(reliabilities)/sizeof(reliabilities[0]))
+		return reliabilities[reliability];
+	return "?";
+}
+
+static void AddressToString(const PacketCaptureRecord &record, char *out)
+{
+	if (record.ipVersion==6)
+	{
+		char *p=out;
+		p+=sprintf(p, "[");
+		for (int i=0; i < 16; i+=2)
+			p+=sprintf(p, i==0 ? "%x" : ":%x", (record.remoteAddress[i]<<8) | record.remoteAddress[i+1]);
+		sprintf(p, "]:%u", record.remotePort);
+	}
+	else
+		sprintf(out, "%u.%u.%u.%u:%u", record.remoteAddress[0], record.remoteAddress[1], record.remoteAddress[2], record.remoteAddress[3], record.remotePort);
+}
+
+static void MessageIdToString(const PacketCaptureRecord &record, char *out)
+{
+	if (record.eventType==PCE_ACK || record.eventType==PCE_ERROR || record.eventType==PCE_WARNING)
+	{
+		out[0]=0;
+		return;
+	}
+	const char *name=PacketLogger::BaseIDTOString(record.messageId);
+	if (name)
+		strcpy(out, name);
+	else
+		sprintf(out, "%u", record.messageId);
+}
+
+static void SnippetToString(const PacketCaptureRecord &record, char *out)
+{
+	if (record.eventType==PCE_ERROR || record.eventType==PCE_WARNING)
+	{
+		memcpy(out, record.snippet, record.snippetLength);
+		out[record.snippetLength]=0;
+		return;
+	}
+	for (unsigned int i=0; i < record.snippetLength; i++)
+		sprintf(out+i*2, "%02x", record.snippet[i]);
+	out[record.snippetLength*2]=0;
+}
+
+static void WriteText(FILE *out, const PacketCaptureFileHeader &header, const PacketCaptureRecord &record)
+{
+	char address[64], messageId[64], snippet[PACKET_CAPTURE_MAX_SNIPPET_LENGTH*2+1];
+	AddressToString(record, address);
+	MessageIdToString(record, messageId);
+	SnippetToString(record, snippet);
+
+	fprintf(out, "%12.6f %-6s %-21s guid=%llu", (double) (record.time-header.startTimeUS)/1000000.0, EventTypeToString(record.eventType), address, (unsigned long long) record.remoteGuid);
+	if (record.eventType==PCE_ACK)
+	{
+		fprintf(out, " reliable#=%u\n", record.reliableMessageNumber);
+		return;
+	}
+	if (messageId[0])
+		fprintf(out, " %s%s", (record.flags & PCF_TIMESTAMPED) ? "TS+" : "", messageId);
+	fprintf(out, " bits=%u", record.bitLength);
+	if (record.eventType==PCE_SEND || record.eventType==PCE_RECEIVE)
+	{
+		fprintf(out, " %s", ReliabilityToString(record.reliability));
+		if ((record.flags & PCF_UNRELIABLE)==0)
+			fprintf(out, " reliable#=%u", record.reliableMessageNumber);
+		fprintf(out, " frame=%u channel=%u ordering=%u sequencing=%u", record.frameNumber, record.orderingChannel, record.orderingIndex, record.sequencingIndex);
+		if (record.flags & PCF_SPLIT)
+			fprintf(out, " split=%u:%u/%u", record.splitPacketId, record.splitPacketIndex, record.splitPacketCount);
+	}
+	if (snippet[0])
+		fprintf(out, " %s", snippet);
+	fprintf(out, "\n");
+}
+
+static void WriteCSV(FILE *out, const PacketCaptureFileHeader &header, const PacketCaptureRecord &record)
+{
+	char address[64], messageId[64], snippet[PACKET_CAPTURE_MAX_SNIPPET_LENGTH*2+1];
+	AddressToString(record, address);
+	MessageIdToString(record, messageId);
+	SnippetToString(record, snippet);
+	// Error messages could contain the separator
+	for (char *c=snippet; *c; c++)
+		if (*c==',' || *c=='\n')
+			*c=' ';
+
+	fprintf(out, "%llu,%s,%s,%llu,%s,%i,%u,%s,%u,%u,%u,%u,%u,%u,%u,%u,%u,%s\n",
+		(unsigned long long) (record.time-header.startTimeUS),
+		EventTypeToString(record.eventType),
+		address,
+		(unsigned long long) record.remoteGuid,
+		messageId,
+		(record.flags & PCF_TIMESTAMPED) ? 1 : 0,
+		record.bitLength,
+		(record.eventType==PCE_SEND || record.eventType==PCE_RECEIVE) ? ReliabilityToString(record.reliability) : "",
+		record.priority,
+		record.reliableMessageNumber,
+		record.frameNumber,
+		record.orderingChannel,
+		record.orderingIndex,
+		record.sequencingIndex,
+		record.splitPacketId,
+		record.splitPacketIndex,
+		record.splitPacketCount,
+		snippet);
+}
+
+static void WritePcapHeader(FILE *out)
+{
+	uint32_t magic=0xa1b2c3d4;
+	uint16_t versionMajor=2, versionMinor=4;
+	int32_t thisZone=0;
+	uint32_t sigFigs=0, snapLen=65535, linkType=147;
+	fwrite(&magic, sizeof(magic), 1, out);
+	fwrite(&versionMajor, sizeof(versionMajor), 1, out);
+	fwrite(&versionMinor, sizeof(versionMinor), 1, out);
+	fwrite(&thisZone, sizeof(thisZone), 1, out);
+	fwrite(&sigFigs, sizeof(sigFigs), 1, out);
+	fwrite(&snapLen, sizeof(snapLen), 1, out);
+	fwrite(&linkType, sizeof(linkType), 1, out);
+}
+
+static void WritePcap(FILE *out, const PacketCaptureFileHeader &header, const PacketCaptureRecord &record)
+{
+	uint64_t elapsedUS=record.time-header.startTimeUS;
+	uint32_t seconds=(uint32_t) (header.startTimeSeconds + elapsedUS/1000000);
+	uint32_t microseconds=(uint32_t) (elapsedUS%1000000);
+	uint32_t length=sizeof(PacketCaptureRecord);
+	fwrite(&seconds, sizeof(seconds), 1, out);
+	fwrite(&microseconds, sizeof(microseconds), 1, out);
+	fwrite(&length, sizeof(length), 1, out);
+	fwrite(&length, sizeof(length), 1, out);
+	fwrite(&record, sizeof(record), 1, out);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 3)
+	{
+		printf("Converts a PacketCaptureLogger capture.\n");
+		printf("Usage: PacketCaptureConverter capture output [text|csv|pcap]\n");
+		return 1;
+	}
+
+	OutputFormat format=OF_TEXT;
+	if (argc > 3)
+	{
+		if (strcmp(argv[3], "csv")==0)
+			format=OF_CSV;
+		else if (strcmp(argv[3], "pcap")==0)
+			format=OF_PCAP;
+		else if (strcmp(argv[3], "text")!=0)
+		{
+			printf("Unknown format %s\n", argv[3]);
+			return 1;
+		}
+	}
+
+	FILE *in=fopen(argv[1], "rb");
+	if (in==0)
+	{
+		printf("Cannot open %s\n", argv[1]);
+		return 1;
+	}
+	PacketCaptureFileHeader header;
+	if (fread(&header, sizeof(header), 1, in)!=1 || memcmp(header.magic, PACKET_CAPTURE_MAGIC, sizeof(header.magic))!=0)
+	{
+		printf("%s is not a packet capture\n", argv[1]);
+		fclose(in);
+		return 1;
+	}
+	if (header.version!=PACKET_CAPTURE_VERSION || header.recordSize!=sizeof(PacketCaptureRecord))
+	{
+		printf("%s has version %u and record size %u, expected version %u and record size %u. It may have been captured on a system with the other byte order.\n",
+			argv[1], header.version, header.recordSize, PACKET_CAPTURE_VERSION, (unsigned int) sizeof(PacketCaptureRecord));
+		fclose(in);
+		return 1;
+	}
+
+	FILE *out=fopen(argv[2], format==OF_PCAP ? "wb" : "wt");
+	if (out==0)
+	{
+		printf("Cannot create %s\n", argv[2]);
+		fclose(in);
+		return 1;
+	}
+	if (format==OF_TEXT)
+		fprintf(out, "Capture from guid %llu, %llu seconds since 1970\n", (unsigned long long) header.localGuid, (unsigned long long) header.startTimeSeconds);
+	else if (format==OF_CSV)
+		fprintf(out, "TimeUS,Event,Remote,RemoteGUID,MessageID,Timestamped,BitLength,Reliability,Priority,Reliable#,Frame,OrderingChannel,OrderingIndex,SequencingIndex,SplitPacketId,SplitPacketIndex,SplitPacketCount,Snippet\n");
+	else
+		WritePcapHeader(out);
+
+	PacketCaptureRecord record;
+	unsigned int recordCount=0;
+	while (fread(&record, sizeof(record), 1, in)==1)
+	{
+		if (record.snippetLength > PACKET_CAPTURE_MAX_SNIPPET_LENGTH)
+			record.snippetLength=PACKET_CAPTURE_MAX_SNIPPET_LENGTH;
+		if (format==OF_TEXT)
+			WriteText(out, header, record);
+		else if (format==OF_CSV)
+			WriteCSV(out, header, record);
+		else
+			WritePcap(out, header, record);
+		recordCount++;
+	}
+
+	printf("Converted %u records\n", recordCount);
+	fclose(in);
+	fclose(out);
+	return 0;
+}
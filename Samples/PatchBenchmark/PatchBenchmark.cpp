@@ -0,0 +1,166 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Times CreatePatch() on two versions of a file, as it was and with suffixes sorted on threads and with windows of a few sizes,
+// and shows the memory used and the size of each patch. Every patch must apply to give the new version
+// Usage: PatchBenchmark [megabytes in the file]. Defaults to 16 megabytes
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "CreatePatch.h"
+#include "ApplyPatch.h"
+#include "GetTime.h"
+
+static const int THREAD_COUNT=4;
+
+static unsigned int randomState=12345;
+static unsigned int NextRandom(void)
+{
+	randomState=randomState*1103515245+12345;
+	return randomState>>8;
+}
+
+// Something like a program or a packed archive: records made from a small vocabulary, with numbers in them
+static char *MakeOriginal(unsigned int length)
+{
+	static const char *words[]={"vertex", "texture", "normal", "mesh", "player", "script", "dialogue", "cell", "npc", "weapon",
+		"armor", "sound", "region", "faction", "spell", "effect"};
+	char *data=new char[length];
+	unsigned int offset=0;
+	while (offset < length)
+	{
+		char record[64];
+		int recordLength=sprintf(record, "%s%s%08x", words[(NextRandom()>>4)%16], words[(NextRandom()>>4)%16], NextRandom());
+		for (int i=0; i < recordLength && offset < length; i++)
+			data[offset++]=record[i];
+	}
+	return data;
+}
+
+// The next version: numbers changed throughout, as when code moves, with some blocks inserted, removed and moved
+static char *MakeNewVersion(const char *original, unsigned int originalLength, unsigned int *length)
+{
+	unsigned int insertLength=originalLength/64;
+	char *data=new char[originalLength+insertLength];
+	memcpy(data, original, originalLength);
+	for (unsigned int offset=0; offset < originalLength; offset+=4096+NextRandom()%4096)
+		data[offset]=(char) ('0'+NextRandom()%10);
+
+	// Move a block from near the end to near the start
+	unsigned int movedLength=originalLength/32;
+	char *moved=new char[movedLength];
+	memcpy(moved, data+originalLength-movedLength*2, movedLength);
+	memmove(data+originalLength/8+movedLength, data+originalLength/8, originalLength-movedLength*2-originalLength/8);
+	memcpy(data+originalLength/8, moved, movedLength);
+	delete [] moved;
+
+	// Insert new data in the middle, which pushes the end along
+	unsigned int insertAt=originalLength/2;
+	memmove(data+insertAt+insertLength, data+insertAt, originalLength-insertAt);
+	for (unsigned int i=0; i < insertLength; i++)
+		data[insertAt+i]=(char) (NextRandom()>>16);
+	*length=originalLength+insertLength;
+	return data;
+}
+
+int main(int argc, char **argv)
+{
+	printf("Times CreatePatch() with and without threads and windows, and shows the memory used and the patch sizes.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	unsigned int megabytes=16;
+	if (argc > 1)
+		megabytes=(unsigned int) atoi(argv[1]);
+	if (megabytes < 1)
+		megabytes=1;
+
+	unsigned int oldLength=megabytes*1048576;
+	char *oldData=MakeOriginal(oldLength);
+	unsigned int newLength;
+	char *newData=MakeNewVersion(oldData, oldLength, &newLength);
+
+	struct PatchCase
+	{
+		const char *description;
+		int threadCount;
+		unsigned int windowSize;
+	};
+	const PatchCase patchCases[]=
+	{
+		{"As before", 1, 0},
+		{"Threads", THREAD_COUNT, 0},
+		{"Window of 1/4 the file", THREAD_COUNT, oldLength/4},
+		{"Window of 1/16 the file", 1, oldLength/16},
+		{"Window of 1/64 the file", 1, oldLength/64},
+	};
+
+	printf("%u bytes old, %u bytes new, %i threads\n", oldLength, newLength, THREAD_COUNT);
+	printf("  %-24s %11s %11s %11s %10s %10s\n", "", "Sort", "Diff", "Total", "Memory", "Patch");
+	unsigned int failures=0;
+	char *firstPatch=0;
+	unsigned int firstPatchLength=0;
+	for (unsigned int i=0; i < sizeof(patchCases)/sizeof(patchCases[0]); i++)
+	{
+		CreatePatchOptions options;
+		options.threadCount=patchCases[i].threadCount;
+		options.windowSize=patchCases[i].windowSize;
+		CreatePatchStatistics statistics;
+		char *patch;
+		unsigned int patchLength;
+		RakNet::TimeUS startTime=RakNet::GetTimeUS();
+		if (CreatePatch(oldData, oldLength, newData, newLength, &patch, &patchLength, options, &statistics)==false)
+		{
+			printf("%s: CreatePatch failed\n", patchCases[i].description);
+			failures++;
+			continue;
+		}
+		RakNet::TimeUS totalTime=RakNet::GetTimeUS()-startTime;
+		printf("  %-24s %8.1f ms %8.1f ms %8.1f ms %7.1f MB %10u\n", patchCases[i].description, statistics.sortTime/1000.0,
+			statistics.diffTime/1000.0, totalTime/1000.0, statistics.peakWorkingMemory/1048576.0, patchLength);
+
+		char *patched;
+		unsigned int patchedLength;
+		bool applied=ApplyPatch(oldData, oldLength, &patched, &patchedLength, patch, patchLength);
+		if (applied==false || patchedLength!=newLength || memcmp(patched, newData, newLength)!=0)
+		{
+			printf("%s: the patch did not give the new version\n", patchCases[i].description);
+			failures++;
+		}
+		if (applied)
+			delete [] patched;
+
+		// Sorting on threads gives the same order, so the same patch
+		if (firstPatch==0)
+		{
+			firstPatch=patch;
+			firstPatchLength=patchLength;
+			continue;
+		}
+		if (patchCases[i].windowSize==0 && (patchLength!=firstPatchLength || memcmp(patch, firstPatch, patchLength)!=0))
+		{
+			printf("%s: the patch differs from the one made without threads\n", patchCases[i].description);
+			failures++;
+		}
+		delete [] patch;
+	}
+	delete [] firstPatch;
+	delete [] oldData;
+	delete [] newData;
+
+	if (failures > 0)
+	{
+		printf("\nFAILED: %u patches were wrong\n", failures);
+		return 1;
+	}
+	printf("\nEvery patch gave the new version\n");
+	return 0;
+}
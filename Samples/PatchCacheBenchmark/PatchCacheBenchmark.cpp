@@ -0,0 +1,314 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Asks a PatchCache for patches the way AutopatcherServer does, for clients spread over the prior versions of some files, and shows the hit rate
+// and the CreatePatch() time spent and saved: as clients first arrive, after a restart that reads the patches back from disk,
+// and after a new version is released, with patches to it precomputed from the most requested versions
+// Every patch must apply to give the newest version
+
+#include <cstdio>
+#include <cstring>
+#include "PatchCache.h"
+#include "ApplyPatch.h"
+#include "AutopatcherRepositoryInterface.h"
+#include "BitStream.h"
+#include "FileList.h"
+#include "SuperFastHash.h"
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace RakNet;
+
+static const char *PATCH_DIRECTORY="PatchCacheBenchmarkFiles/";
+static const unsigned int FILE_COUNT=4;
+static const unsigned int FILE_LENGTH=262144;
+static const unsigned int VERSION_COUNT=6;
+static const unsigned int CLIENT_COUNT=100;
+static const unsigned int PRECOMPUTE_COUNT=8;
+
+static unsigned int randomState=12345;
+static unsigned int NextRandom(void)
+{
+	randomState=randomState*1103515245+12345;
+	return randomState>>8;
+}
+
+// Every version of every file in memory. Only what PatchCache uses is implemented
+class VersionRepository : public AutopatcherRepositoryInterface
+{
+public:
+	VersionRepository()
+	{
+		newestVersion=0;
+		for (unsigned int fileIndex=0; fileIndex < FILE_COUNT; fileIndex++)
+		{
+			sprintf(filenames[fileIndex], "data/file%u.bin", fileIndex);
+			MakeOriginal(fileIndex);
+			for (unsigned int version=1; version < VERSION_COUNT; version++)
+				MakeNextVersion(fileIndex, version);
+			for (unsigned int version=0; version < VERSION_COUNT; version++)
+			{
+				// As AutopatcherClient hashes files
+				unsigned int hash=SuperFastHash(contents[fileIndex][version], lengths[fileIndex][version]);
+				if (RakNet::BitStream::DoEndianSwap())
+					RakNet::BitStream::ReverseBytesInPlace((unsigned char*) &hash, sizeof(hash));
+				memcpy(hashes[fileIndex][version], &hash, 4);
+			}
+		}
+	}
+	~VersionRepository()
+	{
+		for (unsigned int fileIndex=0; fileIndex < FILE_COUNT; fileIndex++)
+			for (unsigned int version=0; version < VERSION_COUNT; version++)
+				delete [] contents[fileIndex][version];
+	}
+
+	virtual bool GetNewestFileHash(const char *applicationName, const char *filename, char *hash)
+	{
+		(void) applicationName;
+		int fileIndex=FindFile(filename);
+		if (fileIndex < 0)
+			return false;
+		memcpy(hash, hashes[fileIndex][newestVersion], 4);
+		return true;
+	}
+	virtual bool GetFileVersion(const char *applicationName, const char *filename, const char *hash, char **content, unsigned int *contentLength)
+	{
+		(void) applicationName;
+		int fileIndex=FindFile(filename);
+		if (fileIndex < 0)
+			return false;
+		for (unsigned int version=0; version <= newestVersion; version++)
+		{
+			if (memcmp(hashes[fileIndex][version], hash, 4)==0)
+			{
+				*contentLength=lengths[fileIndex][version];
+				*content=new char[*contentLength];
+				memcpy(*content, contents[fileIndex][version], *contentLength);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	virtual bool GetChangelistSinceDate(const char *, FileList *, FileList *, double) {return false;}
+	virtual int GetPatches(const char *, FileList *, bool, FileList *) {return 0;}
+	virtual bool GetMostRecentChangelistWithPatches(RakNet::RakString &, FileList *, FileList *, FileList *, FileList *, double *, double *) {return false;}
+	virtual const char *GetLastError(void) const {return "";}
+	virtual const int GetIncrementalReadChunkSize(void) const {return 262144;}
+	virtual unsigned int GetFilePart(const char *, unsigned int, unsigned int, void *, FileListNodeContext) {return 0;}
+
+	int FindFile(const char *filename) const
+	{
+		for (unsigned int fileIndex=0; fileIndex < FILE_COUNT; fileIndex++)
+		{
+			if (strcmp(filenames[fileIndex], filename)==0)
+				return (int) fileIndex;
+		}
+		return -1;
+	}
+
+	char filenames[FILE_COUNT][32];
+	char *contents[FILE_COUNT][VERSION_COUNT];
+	unsigned int lengths[FILE_COUNT][VERSION_COUNT];
+	char hashes[FILE_COUNT][VERSION_COUNT][4];
+	// Versions after this are not released yet
+	unsigned int newestVersion;
+
+protected:
+	// Records made from a small vocabulary, with numbers in them
+	void MakeOriginal(unsigned int fileIndex)
+	{
+		static const char *words[]={"vertex", "texture", "normal", "mesh", "player", "script", "dialogue", "cell"};
+		char *data=new char[FILE_LENGTH];
+		unsigned int offset=0;
+		while (offset < FILE_LENGTH)
+		{
+			char record[64];
+			int recordLength=sprintf(record, "%s%s%08x", words[(NextRandom()>>4)%8], words[(NextRandom()>>4)%8], NextRandom());
+			for (int i=0; i < recordLength && offset < FILE_LENGTH; i++)
+				data[offset++]=record[i];
+		}
+		contents[fileIndex][0]=data;
+		lengths[fileIndex][0]=FILE_LENGTH;
+	}
+	// The version before with bytes changed throughout and a block of new data inserted
+	void MakeNextVersion(unsigned int fileIndex, unsigned int version)
+	{
+		const char *prior=contents[fileIndex][version-1];
+		unsigned int priorLength=lengths[fileIndex][version-1];
+		unsigned int insertLength=1024;
+		unsigned int insertAt=NextRandom()%priorLength;
+		char *data=new char[priorLength+insertLength];
+		memcpy(data, prior, insertAt);
+		for (unsigned int i=0; i < insertLength; i++)
+			data[insertAt+i]=(char) (NextRandom()>>16);
+		memcpy(data+insertAt+insertLength, prior+insertAt, priorLength-insertAt);
+		for (unsigned int offset=0; offset < priorLength+insertLength; offset+=2048+NextRandom()%2048)
+			data[offset]=(char) ('0'+NextRandom()%10);
+		contents[fileIndex][version]=data;
+		lengths[fileIndex][version]=priorLength+insertLength;
+	}
+};
+
+// Half the clients have the version before the newest, a quarter the one before that, and so on
+static unsigned int PickPriorVersion(unsigned int newestVersion)
+{
+	unsigned int version=newestVersion-1;
+	while (version > 0 && NextRandom()%2==0)
+		version--;
+	return version;
+}
+
+// Asks for patches for CLIENT_COUNT clients, each with every file at one prior version. Returns the number of patches that were wrong
+static unsigned int RunClients(PatchCache *patchCache, VersionRepository *repository, const char *description)
+{
+	unsigned int failures=0;
+	patchCache->ResetStatistics();
+	for (unsigned int client=0; client < CLIENT_COUNT; client++)
+	{
+		unsigned int priorVersion=PickPriorVersion(repository->newestVersion);
+		for (unsigned int fileIndex=0; fileIndex < FILE_COUNT; fileIndex++)
+		{
+			const char *filename=repository->filenames[fileIndex];
+			char newestHash[4];
+			repository->GetNewestFileHash("PatchCacheBenchmark", filename, newestHash);
+			char *patch;
+			unsigned int patchLength;
+			if (patchCache->GetPatch(repository, "PatchCacheBenchmark", filename, repository->hashes[fileIndex][priorVersion], newestHash, &patch, &patchLength)==false)
+			{
+				printf("%s: no patch for %s from version %u\n", description, filename, priorVersion);
+				failures++;
+				continue;
+			}
+
+			char *patched;
+			unsigned int patchedLength;
+			bool applied=ApplyPatch(repository->contents[fileIndex][priorVersion], repository->lengths[fileIndex][priorVersion], &patched, &patchedLength, patch, patchLength);
+			unsigned int newestVersion=repository->newestVersion;
+			if (applied==false || patchedLength!=repository->lengths[fileIndex][newestVersion] ||
+				memcmp(patched, repository->contents[fileIndex][newestVersion], patchedLength)!=0)
+			{
+				printf("%s: the patch for %s from version %u did not give the newest version\n", description, filename, priorVersion);
+				failures++;
+			}
+			if (applied)
+				delete [] patched;
+			delete [] patch;
+		}
+	}
+
+	PatchCacheStatistics statistics;
+	patchCache->GetStatistics(&statistics);
+	printf("  %-30s %6u %6u %6u %7.1f%% %10.1f ms %10.1f ms %7.1f MB\n", description, statistics.hits+statistics.misses, statistics.hits,
+		statistics.diskReads, statistics.GetHitRate()*100.0, statistics.patchTime/1000.0, statistics.patchTimeSaved/1000.0,
+		patchCache->GetMemoryUsed()/1048576.0);
+	return failures;
+}
+
+static void RemovePatchFiles(VersionRepository *repository)
+{
+	// Named by PatchCache from the hashes of the versions patched from and to
+	for (unsigned int fileIndex=0; fileIndex < FILE_COUNT; fileIndex++)
+	{
+		for (unsigned int oldVersion=0; oldVersion < VERSION_COUNT; oldVersion++)
+		{
+			for (unsigned int newVersion=oldVersion+1; newVersion < VERSION_COUNT; newVersion++)
+			{
+				const unsigned char *oldHash=(const unsigned char*) repository->hashes[fileIndex][oldVersion];
+				const unsigned char *newHash=(const unsigned char*) repository->hashes[fileIndex][newVersion];
+				char path[256];
+				sprintf(path, "%s%02x%02x%02x%02x%02x%02x%02x%02x.patch", PATCH_DIRECTORY, oldHash[0], oldHash[1], oldHash[2], oldHash[3],
+					newHash[0], newHash[1], newHash[2], newHash[3]);
+				remove(path);
+			}
+		}
+	}
+#ifdef _WIN32
+	_rmdir(PATCH_DIRECTORY);
+#else
+	rmdir(PATCH_DIRECTORY);
+#endif
+}
+
+int main(void)
+{
+	printf("Shows the hit rate of PatchCache and the CreatePatch() time it saves, with patches kept on disk and precomputed.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	VersionRepository repository;
+	RemovePatchFiles(&repository);
+	unsigned int failures=0;
+
+	printf("%u files of about %u bytes, %u clients each asking for every file from one of %u prior versions\n", FILE_COUNT, FILE_LENGTH, CLIENT_COUNT, VERSION_COUNT-2);
+	printf("  %-30s %6s %6s %6s %8s %13s %13s %10s\n", "", "Asked", "Hits", "Disk", "Rate", "CreatePatch", "Saved", "Memory");
+
+	repository.newestVersion=VERSION_COUNT-2;
+	PatchCache patchCache;
+	patchCache.SetDirectory(PATCH_DIRECTORY);
+	failures+=RunClients(&patchCache, &repository, "First clients");
+	PatchCacheStatistics statistics;
+	patchCache.GetStatistics(&statistics);
+	// Each version of each file is patched from once at most
+	if (statistics.misses > FILE_COUNT*(VERSION_COUNT-2))
+	{
+		printf("%u patches were made, more than one for each prior version of each file\n", statistics.misses);
+		failures++;
+	}
+
+	// Restarted: nothing in memory, every patch on disk
+	PatchCache restartedPatchCache;
+	restartedPatchCache.SetDirectory(PATCH_DIRECTORY);
+	failures+=RunClients(&restartedPatchCache, &repository, "After a restart");
+	restartedPatchCache.GetStatistics(&statistics);
+	if (statistics.misses!=0)
+	{
+		printf("%u patches were made again after a restart\n", statistics.misses);
+		failures++;
+	}
+
+	// A new version, with patches to it made before clients ask, from the versions most asked for so far
+	repository.newestVersion=VERSION_COUNT-1;
+	unsigned int precomputed=restartedPatchCache.Precompute(&repository, PRECOMPUTE_COUNT);
+	restartedPatchCache.GetStatistics(&statistics);
+	printf("  %-30s %u patches made in %.1f ms\n", "Precomputed", precomputed, statistics.patchTime/1000.0);
+	if (precomputed==0 || precomputed > PRECOMPUTE_COUNT)
+	{
+		printf("%u patches were precomputed, rather than 1 to %u\n", precomputed, PRECOMPUTE_COUNT);
+		failures++;
+	}
+	failures+=RunClients(&restartedPatchCache, &repository, "New version, precomputed");
+
+	// Memory bounded to about two patches. The rest are read from disk
+	PatchCache boundedPatchCache;
+	boundedPatchCache.SetDirectory(PATCH_DIRECTORY);
+	const unsigned int maxMemory=32768;
+	boundedPatchCache.SetMaxMemory(maxMemory);
+	failures+=RunClients(&boundedPatchCache, &repository, "Memory bounded to 32 KB");
+	if (boundedPatchCache.GetMemoryUsed() > maxMemory)
+	{
+		printf("%u bytes of patches were kept in memory, over the %u allowed\n", boundedPatchCache.GetMemoryUsed(), maxMemory);
+		failures++;
+	}
+
+	RemovePatchFiles(&repository);
+
+	if (failures > 0)
+	{
+		printf("\nFAILED: %u patches or counts were wrong\n", failures);
+		return 1;
+	}
+	printf("\nEvery patch gave the newest version, and no patch was made twice\n");
+	return 0;
+}
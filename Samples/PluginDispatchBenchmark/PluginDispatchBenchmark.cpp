@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Measures RakPeer::Receive() throughput with different numbers of plugins attached
+// Each plugin handles one message ID of its own. It is run once reporting its message ID through PluginInterface2::GetReceiveMessageIDs(),
+// so RakPeer only calls it for that message, and once without, so it is called for every packet as before
+// Most packets are game messages that no plugin handles, as is typical
+
+#include <cstdio>
+#include <cstring>
+#include "RakPeerInterface.h"
+#include "PluginInterface2.h"
+#include "MessageIdentifiers.h"
+#include "GetTime.h"
+
+using namespace RakNet;
+
+static const int pluginCounts[] = {1, 5, 15};
+static const int NUM_PACKETS=200000;
+static const int PACKETS_PER_BATCH=1000;
+static const MessageID GAME_MESSAGE=ID_USER_PACKET_ENUM+100;
+
+class BenchmarkPlugin : public PluginInterface2
+{
+public:
+	BenchmarkPlugin() : handledMessageId(0), reportMessageIds(false), handledCount(0) {}
+	virtual PluginReceiveResult OnReceive(Packet *packet)
+	{
+		switch (packet->data[0])
+		{
+		case ID_TIMESTAMP:
+			break;
+		default:
+			if (packet->data[0]==handledMessageId)
+			{
+				handledCount++;
+				return RR_STOP_PROCESSING_AND_DEALLOCATE;
+			}
+		}
+		return RR_CONTINUE_PROCESSING;
+	}
+	virtual bool GetReceiveMessageIDs(bool messageIds[256]) const
+	{
+		if (reportMessageIds==false)
+			return false;
+		messageIds[handledMessageId]=true;
+		return true;
+	}
+
+	MessageID handledMessageId;
+	bool reportMessageIds;
+	int handledCount;
+};
+
+// Returns packets per second returned or consumed by Receive()
+static double MeasureReceive(RakPeerInterface *peer, int numPlugins)
+{
+	int packetsSent=0, packetsReceived=0;
+	RakNet::TimeUS total=0;
+	while (packetsSent < NUM_PACKETS)
+	{
+		// One in ten packets is for a plugin
+		for (int i=0; i < PACKETS_PER_BATCH; i++, packetsSent++)
+		{
+			Packet *packet=peer->AllocatePacket(16);
+			memset(packet->data, 0, 16);
+			if (i%10==0)
+				packet->data[0]=(MessageID) (ID_USER_PACKET_ENUM+(i/10)%numPlugins);
+			else
+				packet->data[0]=GAME_MESSAGE;
+			peer->PushBackPacket(packet, false);
+		}
+
+		RakNet::TimeUS startTime=RakNet::GetTimeUS();
+		for (Packet *packet=peer->Receive(); packet; packet=peer->Receive())
+		{
+			packetsReceived++;
+			peer->DeallocatePacket(packet);
+		}
+		total+=RakNet::GetTimeUS()-startTime;
+	}
+	(void) packetsReceived;
+	return (double) NUM_PACKETS * 1000000.0 / (double) total;
+}
+
+int main(void)
+{
+	printf("Measures RakPeer::Receive() packets per second with plugins attached.\n");
+
+	RakPeerInterface *peer=RakPeerInterface::GetInstance();
+	SocketDescriptor sd;
+	if (peer->Startup(1,&sd,1)!=CRABNET_STARTED)
+	{
+		printf("Startup failed\n");
+		return 1;
+	}
+
+	BenchmarkPlugin plugins[15];
+	int failures=0;
+	for (unsigned i=0; i < sizeof(pluginCounts)/sizeof(pluginCounts[0]); i++)
+	{
+		int numPlugins=pluginCounts[i];
+		double packetsPerSecond[2];
+		for (int dispatch=0; dispatch < 2; dispatch++)
+		{
+			for (int j=0; j < numPlugins; j++)
+			{
+				plugins[j].handledMessageId=(MessageID) (ID_USER_PACKET_ENUM+j);
+				plugins[j].reportMessageIds=dispatch==1;
+				plugins[j].handledCount=0;
+				peer->AttachPlugin(&plugins[j]);
+			}
+
+			packetsPerSecond[dispatch]=MeasureReceive(peer, numPlugins);
+
+			int handled=0;
+			for (int j=0; j < numPlugins; j++)
+			{
+				handled+=plugins[j].handledCount;
+				peer->DetachPlugin(&plugins[j]);
+			}
+			if (handled!=NUM_PACKETS/10)
+				failures++;
+		}
+		printf("%2i plugins: every plugin %.0f packets/s, dispatch table %.0f packets/s (%.2fx)\n",
+			numPlugins, packetsPerSecond[0], packetsPerSecond[1], packetsPerSecond[1]/packetsPerSecond[0]);
+	}
+
+	if (failures)
+		printf("FAILED: plugins did not see the packets meant for them\n");
+
+	peer->Shutdown(0);
+	RakPeerInterface::DestroyInstance(peer);
+	return failures==0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Copies, assigns and hashes RakStrings from several threads at once, and reports the time per operation for each thread count
+// Times are the wall time divided by the operations each thread ran, so they stay flat as long as the threads do not contend
+// Copies share a small set of strings between all threads, assignments allocate a new string each time, and hashes read a local copy
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include "RakString.h"
+#include "GetTime.h"
+
+using namespace RakNet;
+
+static const unsigned int OPERATIONS_PER_THREAD=1000000;
+static const unsigned int MAX_THREADS=8;
+static const char *SOURCE_STRINGS[]=
+{
+	"ID_USER_PACKET_ENUM",
+	"127.0.0.1|60000",
+	"A string long enough that it does not fit in the inline storage of a RakString, so it is allocated with malloc on assignment instead",
+	"Player",
+};
+static const unsigned int SOURCE_STRING_COUNT=sizeof(SOURCE_STRINGS)/sizeof(SOURCE_STRINGS[0]);
+
+enum Operation
+{
+	OPERATION_COPY,
+	OPERATION_ASSIGN,
+	OPERATION_HASH,
+};
+
+static RakString sharedStrings[SOURCE_STRING_COUNT];
+static unsigned long sourceHashes[SOURCE_STRING_COUNT];
+static std::atomic<unsigned int> threadsReady(0);
+static std::atomic<bool> startFlag(false);
+static std::atomic<unsigned int> errors(0);
+
+static void RunOperations(Operation operation)
+{
+	threadsReady++;
+	while (startFlag==false)
+		std::this_thread::yield();
+
+	unsigned int errorCount=0;
+	if (operation==OPERATION_COPY)
+	{
+		for (unsigned int i=0; i < OPERATIONS_PER_THREAD; i++)
+		{
+			RakString copy(sharedStrings[i%SOURCE_STRING_COUNT]);
+			if (copy.C_String()[0]!=SOURCE_STRINGS[i%SOURCE_STRING_COUNT][0])
+				errorCount++;
+		}
+	}
+	else if (operation==OPERATION_ASSIGN)
+	{
+		RakString str;
+		for (unsigned int i=0; i < OPERATIONS_PER_THREAD; i++)
+		{
+			str=SOURCE_STRINGS[i%SOURCE_STRING_COUNT];
+			if (str.C_String()[0]!=SOURCE_STRINGS[i%SOURCE_STRING_COUNT][0])
+				errorCount++;
+		}
+	}
+	else
+	{
+		RakString localStrings[SOURCE_STRING_COUNT];
+		for (unsigned int i=0; i < SOURCE_STRING_COUNT; i++)
+			localStrings[i]=sharedStrings[i];
+		for (unsigned int i=0; i < OPERATIONS_PER_THREAD; i++)
+		{
+			if (RakString::ToInteger(localStrings[i%SOURCE_STRING_COUNT])!=sourceHashes[i%SOURCE_STRING_COUNT])
+				errorCount++;
+		}
+	}
+	errors+=errorCount;
+}
+
+static double TimeOperation(Operation operation, unsigned int threadCount)
+{
+	std::thread threads[MAX_THREADS];
+	threadsReady=0;
+	startFlag=false;
+	for (unsigned int i=0; i < threadCount; i++)
+		threads[i]=std::thread(RunOperations, operation);
+	while (threadsReady < threadCount)
+		std::this_thread::yield();
+
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	startFlag=true;
+	for (unsigned int i=0; i < threadCount; i++)
+		threads[i].join();
+	RakNet::TimeUS elapsed=RakNet::GetTimeUS()-start;
+	return (double) elapsed*1000.0/OPERATIONS_PER_THREAD;
+}
+
+int main(void)
+{
+	printf("Measures RakString copy, assignment and hashing from several threads at once.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	for (unsigned int i=0; i < SOURCE_STRING_COUNT; i++)
+	{
+		sharedStrings[i]=SOURCE_STRINGS[i];
+		sourceHashes[i]=RakString::ToInteger(SOURCE_STRINGS[i]);
+	}
+
+	printf("%8s %14s %14s %14s\n", "Threads", "Copy ns/op", "Assign ns/op", "Hash ns/op");
+	for (unsigned int threadCount=1; threadCount <= MAX_THREADS; threadCount*=2)
+	{
+		double nsPerOperation[3];
+		for (int operation=OPERATION_COPY; operation <= OPERATION_HASH; operation++)
+			nsPerOperation[operation]=TimeOperation((Operation) operation, threadCount);
+		printf("%8u %14.1f %14.1f %14.1f\n", threadCount, nsPerOperation[0], nsPerOperation[1], nsPerOperation[2]);
+	}
+
+	for (unsigned int i=0; i < SOURCE_STRING_COUNT; i++)
+	{
+		if (strcmp(sharedStrings[i].C_String(), SOURCE_STRINGS[i])!=0)
+			errors++;
+	}
+
+	if (errors > 0)
+	{
+		printf("\nFAILED: %u strings did not match their source\n", errors.load());
+		return 1;
+	}
+	printf("\nAll strings matched their source\n");
+	return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Compares the time per packet of draining the incoming queue with a RakPeer::Receive() loop and with RakPeer::ReceiveBatch()
+// Receive() calls every plugin's Update() and takes the queue lock once per packet, ReceiveBatch() once per batch
+// Also checks that ReceiveBatch() returns the packets in order, and passes plugin messages to the plugins
+
+#include <cstdio>
+#include <cstring>
+#include "RakPeerInterface.h"
+#include "PluginInterface2.h"
+#include "MessageIdentifiers.h"
+#include "GetTime.h"
+
+using namespace RakNet;
+
+static const int pluginCounts[] = {0, 5, 15};
+static const int NUM_PACKETS=500000;
+static const int PACKETS_PER_FRAME=2000;
+static const unsigned int BATCH_SIZE=256;
+static const MessageID GAME_MESSAGE=ID_USER_PACKET_ENUM+100;
+static const MessageID PLUGIN_MESSAGE=ID_USER_PACKET_ENUM;
+
+class BenchmarkPlugin : public PluginInterface2
+{
+public:
+	BenchmarkPlugin() : updateCount(0), handledCount(0) {}
+	virtual void Update(void)
+	{
+		updateCount++;
+	}
+	virtual PluginReceiveResult OnReceive(Packet *packet)
+	{
+		if (packet->data[0]==PLUGIN_MESSAGE)
+		{
+			handledCount++;
+			return RR_STOP_PROCESSING_AND_DEALLOCATE;
+		}
+		return RR_CONTINUE_PROCESSING;
+	}
+	virtual bool GetReceiveMessageIDs(bool messageIds[256]) const
+	{
+		messageIds[PLUGIN_MESSAGE]=true;
+		return true;
+	}
+
+	int updateCount;
+	int handledCount;
+};
+
+// Returns nanoseconds per packet to drain the queue, or a negative number if packets were lost or out of order
+static double MeasureReceive(RakPeerInterface *peer, bool useBatch, int numPlugins)
+{
+	Packet *packets[BATCH_SIZE];
+	unsigned int nextSequence=0, expectedSequence=0;
+	int packetsSent=0;
+	RakNet::TimeUS total=0;
+	bool inOrder=true;
+	while (packetsSent < NUM_PACKETS)
+	{
+		// One in twenty packets is for the plugins, when there are any
+		for (int i=0; i < PACKETS_PER_FRAME; i++, packetsSent++)
+		{
+			Packet *packet=peer->AllocatePacket(16);
+			memset(packet->data, 0, 16);
+			if (numPlugins > 0 && i%20==0)
+				packet->data[0]=PLUGIN_MESSAGE;
+			else
+			{
+				packet->data[0]=GAME_MESSAGE;
+				memcpy(packet->data+1, &nextSequence, sizeof(nextSequence));
+				nextSequence++;
+			}
+			peer->PushBackPacket(packet, false);
+		}
+
+		RakNet::TimeUS startTime=RakNet::GetTimeUS();
+		if (useBatch)
+		{
+			unsigned int count;
+			while ((count=peer->ReceiveBatch(packets, BATCH_SIZE)) > 0)
+			{
+				for (unsigned int i=0; i < count; i++)
+				{
+					unsigned int sequence;
+					memcpy(&sequence, packets[i]->data+1, sizeof(sequence));
+					if (packets[i]->data[0]!=GAME_MESSAGE || sequence!=expectedSequence++)
+						inOrder=false;
+				}
+				peer->DeallocatePackets(packets, count);
+			}
+		}
+		else
+		{
+			for (Packet *packet=peer->Receive(); packet; packet=peer->Receive())
+			{
+				unsigned int sequence;
+				memcpy(&sequence, packet->data+1, sizeof(sequence));
+				if (packet->data[0]!=GAME_MESSAGE || sequence!=expectedSequence++)
+					inOrder=false;
+				peer->DeallocatePacket(packet);
+			}
+		}
+		total+=RakNet::GetTimeUS()-startTime;
+	}
+
+	if (inOrder==false || expectedSequence!=nextSequence)
+		return -1.0;
+	return (double) total * 1000.0 / (double) NUM_PACKETS;
+}
+
+int main(void)
+{
+	printf("Compares RakPeer::Receive() and RakPeer::ReceiveBatch() time per packet with plugins attached.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	RakPeerInterface *peer=RakPeerInterface::GetInstance();
+	SocketDescriptor sd;
+	if (peer->Startup(1,&sd,1)!=CRABNET_STARTED)
+	{
+		printf("Startup failed\n");
+		return 1;
+	}
+
+	BenchmarkPlugin plugins[15];
+	int failures=0;
+	for (unsigned i=0; i < sizeof(pluginCounts)/sizeof(pluginCounts[0]); i++)
+	{
+		int numPlugins=pluginCounts[i];
+		double nsPerPacket[2];
+		int updateCount[2];
+		for (int batch=0; batch < 2; batch++)
+		{
+			for (int j=0; j < numPlugins; j++)
+			{
+				plugins[j].updateCount=0;
+				plugins[j].handledCount=0;
+				peer->AttachPlugin(&plugins[j]);
+			}
+
+			nsPerPacket[batch]=MeasureReceive(peer, batch==1, numPlugins);
+			if (nsPerPacket[batch] < 0.0)
+				failures++;
+
+			updateCount[batch]=numPlugins > 0 ? plugins[0].updateCount : 0;
+			// Only the first plugin attached sees plugin messages, since it deallocates them
+			if (numPlugins > 0 && plugins[0].handledCount!=NUM_PACKETS/20)
+				failures++;
+			for (int j=0; j < numPlugins; j++)
+				peer->DetachPlugin(&plugins[j]);
+		}
+		printf("%2i plugins: Receive() %.1f ns/packet, %i Update() calls. ReceiveBatch() %.1f ns/packet, %i Update() calls (%.2fx)\n",
+			numPlugins, nsPerPacket[0], updateCount[0], nsPerPacket[1], updateCount[1], nsPerPacket[0]/nsPerPacket[1]);
+	}
+
+	if (failures)
+		printf("FAILED: packets were lost or out of order, or plugins did not see the packets meant for them\n");
+
+	peer->Shutdown(0);
+	RakPeerInterface::DestroyInstance(peer);
+	return failures==0 ? 0 : 1;
+}
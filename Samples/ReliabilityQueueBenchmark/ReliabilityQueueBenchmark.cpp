@@ -0,0 +1,274 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Times the two priority queues of ReliabilityLayer against the binary Heap they replaced, with the weights ReliabilityLayer gives them
+// Send buffer: each update pushes and pops 16 messages of random priority, with 10000 messages left queued, as ReliabilityLayer::Update() does with a full send buffer
+// Ordering heap: ordered messages arrive up to 64 apart, and every so often one is lost and arrives again 10000 messages later, so the rest wait on the heap
+// The send buffers must pop the same weights as a Heap given the same pushes, and the ordering heaps must deliver every message in order
+
+#include <cstdio>
+#include <stdint.h>
+#include "DS_Heap.h"
+#include "DS_MergedQueues.h"
+#include "DS_RadixHeap.h"
+#include "PacketPriority.h"
+#include "GetTime.h"
+
+using namespace DataStructures;
+
+static const unsigned int QUEUED_MESSAGES=10000;
+static const unsigned int MESSAGES_PER_UPDATE=16;
+static const unsigned int UPDATE_COUNT=100000;
+static const unsigned int ORDERED_MESSAGE_COUNT=1000000;
+static const unsigned int REORDER_DISTANCE=64;
+// One message in this many is lost, and arrives again after QUEUED_MESSAGES more
+static const unsigned int LOSS_INTERVAL=50000;
+
+struct Message
+{
+	int priority;
+	uint32_t orderingIndex;
+};
+
+static unsigned int randomState=12345;
+static unsigned int NextRandom(void)
+{
+	randomState=randomState*1103515245+12345;
+	return randomState>>8;
+}
+
+// Gives the same weights as ReliabilityLayer::GetNextWeight()
+template <class SendBuffer>
+class SendWeights
+{
+public:
+	SendWeights() {Init();}
+	void Init(void)
+	{
+		for (int priorityLevel=0; priorityLevel < NUMBER_OF_PRIORITIES; priorityLevel++)
+			nextWeights[priorityLevel]=(1 << priorityLevel)*priorityLevel+priorityLevel;
+	}
+	uint64_t GetNextWeight(SendBuffer &sendBuffer, int priorityLevel)
+	{
+		uint64_t next=nextWeights[priorityLevel];
+		if (sendBuffer.Size() > 0)
+		{
+			int peekPL=sendBuffer.Peek()->priority;
+			uint64_t weight=sendBuffer.PeekWeight();
+			uint64_t min=weight-(1 << peekPL)*peekPL+peekPL;
+			if (next < min)
+				next=min+((uint64_t) 1 << priorityLevel)*priorityLevel+priorityLevel;
+			nextWeights[priorityLevel]=next+((uint64_t) 1 << priorityLevel)*(priorityLevel+1)+priorityLevel;
+		}
+		else
+			Init();
+		return next;
+	}
+
+protected:
+	uint64_t nextWeights[NUMBER_OF_PRIORITIES];
+};
+
+typedef Heap<uint64_t, Message*, false> MessageHeap;
+typedef MergedQueues<uint64_t, Message*, NUMBER_OF_PRIORITIES> MessageQueues;
+typedef RadixHeap<uint64_t, Message*> MessageRadixHeap;
+
+static void PushToSendBuffer(MessageHeap &heap, Message *message, uint64_t weight)
+{
+	heap.Push(weight, message);
+}
+
+static void PushToSendBuffer(MessageQueues &queues, Message *message, uint64_t weight)
+{
+	queues.Push(message->priority, weight, message);
+}
+
+static Message* PopFrom(MessageHeap &heap)
+{
+	return heap.Pop(0);
+}
+
+static Message* PopFrom(MessageQueues &queues)
+{
+	return queues.Pop();
+}
+
+static Message* PopFrom(MessageRadixHeap &heap)
+{
+	return heap.Pop();
+}
+
+// Returns nanoseconds per update
+template <class SendBuffer>
+static double TimeSendBuffer(Message *messages)
+{
+	SendBuffer sendBuffer;
+	SendWeights<SendBuffer> weights;
+	unsigned int next=0;
+	for (unsigned int i=0; i < QUEUED_MESSAGES; i++, next++)
+		PushToSendBuffer(sendBuffer, &messages[next%QUEUED_MESSAGES], weights.GetNextWeight(sendBuffer, messages[next%QUEUED_MESSAGES].priority));
+
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	for (unsigned int update=0; update < UPDATE_COUNT; update++)
+	{
+		for (unsigned int i=0; i < MESSAGES_PER_UPDATE; i++, next++)
+		{
+			Message *message=&messages[next%QUEUED_MESSAGES];
+			PushToSendBuffer(sendBuffer, message, weights.GetNextWeight(sendBuffer, message->priority));
+		}
+		for (unsigned int i=0; i < MESSAGES_PER_UPDATE; i++)
+			PopFrom(sendBuffer);
+	}
+	return (double) (RakNet::GetTimeUS()-start)*1000.0/UPDATE_COUNT;
+}
+
+// Pushes the same weights to a Heap and to MergedQueues, and returns the number of pops where their weights differ. Equal weights may come out in a different order, so only weights are compared
+static unsigned int CompareSendBuffers(Message *messages)
+{
+	MessageHeap heap;
+	MessageQueues queues;
+	SendWeights<MessageQueues> weights;
+	unsigned int differences=0;
+	for (unsigned int i=0; i < QUEUED_MESSAGES*10; i++)
+	{
+		Message *message=&messages[i%QUEUED_MESSAGES];
+		uint64_t weight=weights.GetNextWeight(queues, message->priority);
+		heap.Push(weight, message);
+		queues.Push(message->priority, weight, message);
+		// Pop less than is pushed until the buffer is large, then empty it so the weights start again
+		unsigned int pops=heap.Size() > QUEUED_MESSAGES ? heap.Size() : NextRandom()%2;
+		for (unsigned int j=0; j < pops; j++)
+		{
+			if (heap.PeekWeight()!=queues.PeekWeight())
+				differences++;
+			heap.Pop(0);
+			queues.Pop();
+		}
+		if (heap.Size()!=queues.Size())
+			differences++;
+	}
+	return differences;
+}
+
+// Delivers ordered messages as ReliabilityLayer::HandleSocketReceiveFromConnectedPlayer() does, and returns the number delivered out of order
+template <class OrderingHeap>
+static unsigned int DeliverOrdered(uint32_t *arrivals, unsigned int arrivalCount, Message *messages, double &nsPerMessage)
+{
+	OrderingHeap orderingHeap;
+	uint32_t orderedReadIndex=0, heapIndexOffset=0, expected=0;
+	unsigned int outOfOrder=0;
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	for (unsigned int i=0; i < arrivalCount; i++)
+	{
+		Message *message=&messages[arrivals[i]];
+		if (message->orderingIndex==orderedReadIndex)
+		{
+			if (message->orderingIndex!=expected++)
+				outOfOrder++;
+			orderedReadIndex++;
+			while (orderingHeap.Size() > 0 && orderingHeap.Peek()->orderingIndex==orderedReadIndex)
+			{
+				Message *waiting=PopFrom(orderingHeap);
+				if (waiting->orderingIndex!=expected++)
+					outOfOrder++;
+				orderedReadIndex++;
+			}
+		}
+		else
+		{
+			if (orderingHeap.Size()==0)
+				heapIndexOffset=orderedReadIndex;
+			uint64_t weight=(uint64_t) (message->orderingIndex-heapIndexOffset)*1048576+(1048576-1);
+			orderingHeap.Push(weight, message);
+		}
+	}
+	nsPerMessage=(double) (RakNet::GetTimeUS()-start)*1000.0/arrivalCount;
+	if (expected!=arrivalCount)
+		outOfOrder+=arrivalCount-expected;
+	return outOfOrder;
+}
+
+// Arrival order of the ordered messages, reordered and with some arriving again much later
+static void MakeArrivals(uint32_t *arrivals)
+{
+	for (uint32_t i=0; i < ORDERED_MESSAGE_COUNT; i++)
+		arrivals[i]=i;
+	for (unsigned int i=0; i+REORDER_DISTANCE < ORDERED_MESSAGE_COUNT; i++)
+	{
+		unsigned int other=i+NextRandom()%REORDER_DISTANCE;
+		uint32_t temp=arrivals[i];
+		arrivals[i]=arrivals[other];
+		arrivals[other]=temp;
+	}
+	// Resent much later, by rotating it past the next QUEUED_MESSAGES arrivals
+	for (unsigned int i=LOSS_INTERVAL; i+QUEUED_MESSAGES < ORDERED_MESSAGE_COUNT; i+=LOSS_INTERVAL)
+	{
+		uint32_t lost=arrivals[i];
+		for (unsigned int j=i; j < i+QUEUED_MESSAGES; j++)
+			arrivals[j]=arrivals[j+1];
+		arrivals[i+QUEUED_MESSAGES]=lost;
+	}
+}
+
+int main(void)
+{
+	printf("Times the ReliabilityLayer send buffer and ordering heaps with 10000 queued messages.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	Message *sendMessages=new Message[QUEUED_MESSAGES];
+	for (unsigned int i=0; i < QUEUED_MESSAGES; i++)
+	{
+		sendMessages[i].priority=NextRandom()%NUMBER_OF_PRIORITIES;
+		sendMessages[i].orderingIndex=0;
+	}
+	unsigned int failures=CompareSendBuffers(sendMessages);
+	if (failures > 0)
+		printf("MergedQueues popped %u weights different from Heap\n", failures);
+
+	double heapTime=TimeSendBuffer<MessageHeap>(sendMessages);
+	double queuesTime=TimeSendBuffer<MessageQueues>(sendMessages);
+	printf("Send buffer, %u pushes and pops per update\n", MESSAGES_PER_UPDATE);
+	printf("  %-14s %10.1f ns per update\n", "Heap", heapTime);
+	printf("  %-14s %10.1f ns per update\n\n", "MergedQueues", queuesTime);
+
+	Message *orderedMessages=new Message[ORDERED_MESSAGE_COUNT];
+	for (unsigned int i=0; i < ORDERED_MESSAGE_COUNT; i++)
+	{
+		orderedMessages[i].priority=HIGH_PRIORITY;
+		orderedMessages[i].orderingIndex=i;
+	}
+	uint32_t *arrivals=new uint32_t[ORDERED_MESSAGE_COUNT];
+	MakeArrivals(arrivals);
+
+	double heapNs, radixHeapNs;
+	unsigned int heapOutOfOrder=DeliverOrdered<MessageHeap>(arrivals, ORDERED_MESSAGE_COUNT, orderedMessages, heapNs);
+	unsigned int radixHeapOutOfOrder=DeliverOrdered<MessageRadixHeap>(arrivals, ORDERED_MESSAGE_COUNT, orderedMessages, radixHeapNs);
+	printf("Ordering heap, reordered by up to %u and one message in %u arriving %u late\n", REORDER_DISTANCE, LOSS_INTERVAL, QUEUED_MESSAGES);
+	printf("  %-14s %10.1f ns per message\n", "Heap", heapNs);
+	printf("  %-14s %10.1f ns per message\n", "RadixHeap", radixHeapNs);
+	if (heapOutOfOrder > 0)
+		printf("Heap delivered %u messages out of order\n", heapOutOfOrder);
+	if (radixHeapOutOfOrder > 0)
+		printf("RadixHeap delivered %u messages out of order\n", radixHeapOutOfOrder);
+	failures+=radixHeapOutOfOrder;
+
+	delete [] sendMessages;
+	delete [] orderedMessages;
+	delete [] arrivals;
+
+	if (failures > 0)
+	{
+		printf("\nFAILED: %u messages came out of the wrong queue position\n", failures);
+		return 1;
+	}
+	printf("\nThe send buffer and ordering heaps returned every message in order\n");
+	return 0;
+}
@@ -0,0 +1,347 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Measures the bytes a server sends per tick for a typical replica set, with and without ReplicaManager3::SetDeltaSerialization()
+// A server and a client ReplicaManager3 run over loopback. Each replica serializes a mostly static block (name, inventory, stats) and a few fields that change every tick (position, rotation)
+// The reliable runs use RELIABLE_ORDERED. The unreliable runs use UNRELIABLE_WITH_ACK_RECEIPT and drop datagrams in both directions, so both serializations and the acks for them are lost
+// After the last tick, every replica on the client must match the server
+
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <atomic>
+#include "RakPeerInterface.h"
+#include "RakNetStatistics.h"
+#include "RakNetSocket2.h"
+#include "MessageIdentifiers.h"
+#include "BitStream.h"
+#include "ReplicaManager3.h"
+#include "NetworkIDManager.h"
+#include "GetTime.h"
+#include "RakSleep.h"
+
+using namespace RakNet;
+
+static const int NUM_REPLICAS=200;
+static const int NUM_TICKS=100;
+static const int TICK_MS=10;
+static const int INVENTORY_SIZE=32;
+static const int LOSS_PERCENT=10;
+static const RakNet::TimeMS CONVERGE_TIMEOUT_MS=10000;
+static const unsigned short SERVER_PORT=60501;
+
+// Read by the recv threads of both peers
+static std::atomic<int> lossPercent(0);
+static std::atomic<unsigned int> datagramCount(0);
+
+static bool DropDatagrams(RNS2RecvStruct * /*recvStruct*/)
+{
+	// Hash the count rather than use rand(), so the replicas change the same way in every run
+	unsigned int n = (datagramCount++) * 2654435761u;
+	return (int) ((n >> 16) % 100) >= lossPercent;
+}
+
+struct BenchmarkObject
+{
+	char name[32];
+	float position[3];
+	float rotation[4];
+	int health;
+	int inventory[INVENTORY_SIZE];
+
+	void Serialize(BitStream *bs) const
+	{
+		bs->Write(name, sizeof(name));
+		bs->Write(position[0]);
+		bs->Write(position[1]);
+		bs->Write(position[2]);
+		bs->Write(rotation[0]);
+		bs->Write(rotation[1]);
+		bs->Write(rotation[2]);
+		bs->Write(rotation[3]);
+		bs->Write(health);
+		for (int i=0; i < INVENTORY_SIZE; i++)
+			bs->Write(inventory[i]);
+	}
+	void Deserialize(BitStream *bs)
+	{
+		bs->Read(name, sizeof(name));
+		bs->Read(position[0]);
+		bs->Read(position[1]);
+		bs->Read(position[2]);
+		bs->Read(rotation[0]);
+		bs->Read(rotation[1]);
+		bs->Read(rotation[2]);
+		bs->Read(rotation[3]);
+		bs->Read(health);
+		for (int i=0; i < INVENTORY_SIZE; i++)
+			bs->Read(inventory[i]);
+	}
+	void Tick(int tick)
+	{
+		// Everything moves, some take damage, rarely does anyone pick something up
+		position[0]+=.5f;
+		position[2]+=.25f;
+		rotation[1]=(float) (tick%360);
+		if (rand()%10==0)
+			health--;
+		if (rand()%100==0)
+			inventory[rand()%INVENTORY_SIZE]++;
+	}
+};
+
+static bool ticking=false;
+static int currentTick=0;
+static PacketReliability serializeReliability=RELIABLE_ORDERED;
+
+class BenchmarkReplica : public Replica3
+{
+public:
+	BenchmarkReplica(bool _isServer) : isServer(_isServer) {memset(&object, 0, sizeof(object));}
+	virtual void WriteAllocationID(RakNet::Connection_RM3 * /*destinationConnection*/, RakNet::BitStream * /*allocationIdBitstream*/) const {}
+	virtual RM3ConstructionState QueryConstruction(RakNet::Connection_RM3 *destinationConnection, ReplicaManager3 * /*replicaManager3*/) {return QueryConstruction_ServerConstruction(destinationConnection, isServer);}
+	virtual bool QueryRemoteConstruction(RakNet::Connection_RM3 *sourceConnection) {return QueryRemoteConstruction_ServerConstruction(sourceConnection, isServer);}
+	virtual void SerializeConstruction(RakNet::BitStream *constructionBitstream, RakNet::Connection_RM3 * /*destinationConnection*/) {object.Serialize(constructionBitstream);}
+	virtual bool DeserializeConstruction(RakNet::BitStream *constructionBitstream, RakNet::Connection_RM3 * /*sourceConnection*/) {object.Deserialize(constructionBitstream); return true;}
+	virtual void SerializeDestruction(RakNet::BitStream * /*destructionBitstream*/, RakNet::Connection_RM3 * /*destinationConnection*/) {}
+	virtual bool DeserializeDestruction(RakNet::BitStream * /*destructionBitstream*/, RakNet::Connection_RM3 * /*sourceConnection*/) {return true;}
+	virtual RakNet::RM3ActionOnPopConnection QueryActionOnPopConnection(RakNet::Connection_RM3 *droppedConnection) const
+	{
+		if (isServer)
+			return QueryActionOnPopConnection_Server(droppedConnection);
+		return QueryActionOnPopConnection_Client(droppedConnection);
+	}
+	virtual void DeallocReplica(RakNet::Connection_RM3 * /*sourceConnection*/) {delete this;}
+	virtual RakNet::RM3QuerySerializationResult QuerySerialization(RakNet::Connection_RM3 *destinationConnection) {return QuerySerialization_ServerSerializable(destinationConnection, isServer);}
+	virtual void OnUserReplicaPreSerializeTick(void)
+	{
+		if (isServer && ticking)
+			object.Tick(currentTick);
+	}
+	virtual RM3SerializationResult Serialize(RakNet::SerializeParameters *serializeParameters)
+	{
+		serializeParameters->pro[0].reliability=serializeReliability;
+		object.Serialize(&serializeParameters->outputBitstream[0]);
+		// A lost unreliable serialization is only made up for by a later one, so send every tick rather than only on change
+		if (serializeReliability==UNRELIABLE_WITH_ACK_RECEIPT)
+			return RM3SR_SERIALIZED_ALWAYS;
+		return RM3SR_BROADCAST_IDENTICALLY;
+	}
+	virtual void Deserialize(RakNet::DeserializeParameters *deserializeParameters)
+	{
+		if (deserializeParameters->bitstreamWrittenTo[0])
+			object.Deserialize(&deserializeParameters->serializationBitstream[0]);
+	}
+
+	bool isServer;
+	BenchmarkObject object;
+};
+
+class BenchmarkConnection : public Connection_RM3
+{
+public:
+	BenchmarkConnection(const SystemAddress &_systemAddress, RakNetGUID _guid) : Connection_RM3(_systemAddress, _guid) {}
+	virtual Replica3 *AllocReplica(RakNet::BitStream * /*allocationId*/, ReplicaManager3 * /*replicaManager3*/) {return new BenchmarkReplica(false);}
+};
+
+class BenchmarkReplicaManager : public ReplicaManager3
+{
+public:
+	virtual Connection_RM3* AllocConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID) const {return new BenchmarkConnection(systemAddress,rakNetGUID);}
+	virtual void DeallocConnection(Connection_RM3 *connection) const {delete connection;}
+};
+
+struct RunResult
+{
+	double bytesPerTick;
+	unsigned int receiptsAcked, receiptsLost;
+	bool converged;
+};
+
+// Runs one server tick and processes what arrived on both peers. Receipts are passed on by ReplicaManager3 after it has used them
+static void Pump(RakPeerInterface *server, RakPeerInterface *client, RunResult *result)
+{
+	// Each ReceiveBatch() calls ReplicaManager3::Update() once, so the server only calls it once per tick. Anything left over is processed next tick
+	static Packet *packets[4096];
+	unsigned int count=server->ReceiveBatch(packets, 4096);
+	for (unsigned int i=0; i < count; i++)
+	{
+		if (packets[i]->data[0]==ID_SND_RECEIPT_ACKED)
+			result->receiptsAcked++;
+		else if (packets[i]->data[0]==ID_SND_RECEIPT_LOSS)
+			result->receiptsLost++;
+	}
+	server->DeallocatePackets(packets, count);
+
+	while ((count=client->ReceiveBatch(packets, 4096))>0)
+		client->DeallocatePackets(packets, count);
+}
+
+// Returns how many of the server's replicas exist on the client, and how many of those match
+static int CountMatching(BenchmarkReplica **serverReplicas, NetworkIDManager *clientNetworkIdManager, int *constructedCount)
+{
+	int matching=0;
+	*constructedCount=0;
+	for (int i=0; i < NUM_REPLICAS; i++)
+	{
+		BenchmarkReplica *clientReplica = clientNetworkIdManager->GET_OBJECT_FROM_ID<BenchmarkReplica*>(serverReplicas[i]->GetNetworkID());
+		if (clientReplica==0)
+			continue;
+		(*constructedCount)++;
+		if (memcmp(&clientReplica->object, &serverReplicas[i]->object, sizeof(BenchmarkObject))==0)
+			matching++;
+	}
+	return matching;
+}
+
+static bool RunBenchmark(PacketReliability reliability, bool deltaSerialization, int loss, RunResult *result)
+{
+	memset(result, 0, sizeof(RunResult));
+	srand(0);
+	serializeReliability=reliability;
+	ticking=false;
+	lossPercent=0;
+
+	NetworkIDManager serverNetworkIdManager, clientNetworkIdManager;
+	BenchmarkReplicaManager serverReplicaManager, clientReplicaManager;
+	RakPeerInterface *server=RakPeerInterface::GetInstance();
+	RakPeerInterface *client=RakPeerInterface::GetInstance();
+	SocketDescriptor serverSd(SERVER_PORT,0), clientSd;
+	if (server->Startup(1,&serverSd,1)!=CRABNET_STARTED || client->Startup(1,&clientSd,1)!=CRABNET_STARTED)
+	{
+		printf("Failed to start on port %i\n", SERVER_PORT);
+		RakPeerInterface::DestroyInstance(server);
+		RakPeerInterface::DestroyInstance(client);
+		return false;
+	}
+	server->SetMaximumIncomingConnections(1);
+	server->SetIncomingDatagramEventHandler(DropDatagrams);
+	client->SetIncomingDatagramEventHandler(DropDatagrams);
+	server->AttachPlugin(&serverReplicaManager);
+	client->AttachPlugin(&clientReplicaManager);
+	serverReplicaManager.SetNetworkIDManager(&serverNetworkIdManager);
+	clientReplicaManager.SetNetworkIDManager(&clientNetworkIdManager);
+	serverReplicaManager.SetAutoSerializeInterval(0);
+	serverReplicaManager.SetDeltaSerialization(deltaSerialization);
+	clientReplicaManager.SetDeltaSerialization(deltaSerialization);
+
+	BenchmarkReplica *serverReplicas[NUM_REPLICAS];
+	for (int i=0; i < NUM_REPLICAS; i++)
+	{
+		serverReplicas[i] = new BenchmarkReplica(true);
+		BenchmarkObject &object = serverReplicas[i]->object;
+		sprintf(object.name, "Object %i", i);
+		object.position[0]=(float) (rand()%1000);
+		object.health=100;
+		for (int j=0; j < INVENTORY_SIZE; j++)
+			object.inventory[j]=rand()%50;
+		serverReplicaManager.Reference(serverReplicas[i]);
+	}
+
+	client->Connect("127.0.0.1",SERVER_PORT,0,0);
+
+	// Wait for every replica to be constructed on the client before anything is measured
+	int constructedCount=0;
+	RakNet::TimeMS timeout=RakNet::GetTimeMS()+30000;
+	while (constructedCount < NUM_REPLICAS && RakNet::GetTimeMS() < timeout)
+	{
+		Pump(server, client, result);
+		CountMatching(serverReplicas, &clientNetworkIdManager, &constructedCount);
+		RakSleep(TICK_MS);
+	}
+	bool started = constructedCount==NUM_REPLICAS;
+	if (started==false)
+		printf("Only %i of %i replicas were constructed on the client\n", constructedCount, NUM_REPLICAS);
+
+	if (started)
+	{
+		SystemAddress clientAddress = server->GetSystemAddressFromIndex(0);
+		uint64_t bytesBefore = server->GetStatistics(clientAddress)->runningTotal[ACTUAL_BYTES_SENT];
+		memset(result, 0, sizeof(RunResult));
+
+		lossPercent=loss;
+		ticking=true;
+		for (currentTick=0; currentTick < NUM_TICKS; currentTick++)
+		{
+			// ReplicaManager3::Update() ticks and serializes every replica
+			Pump(server, client, result);
+			RakSleep(TICK_MS);
+		}
+		ticking=false;
+		result->bytesPerTick = (double) (server->GetStatistics(clientAddress)->runningTotal[ACTUAL_BYTES_SENT] - bytesBefore) / NUM_TICKS;
+
+		// Reliable serializations still in flight arrive, unreliable ones keep being sent until one gets through
+		timeout=RakNet::GetTimeMS()+CONVERGE_TIMEOUT_MS;
+		int matching=0;
+		while (RakNet::GetTimeMS() < timeout)
+		{
+			Pump(server, client, result);
+			matching=CountMatching(serverReplicas, &clientNetworkIdManager, &constructedCount);
+			if (matching==NUM_REPLICAS)
+				break;
+			RakSleep(TICK_MS);
+		}
+		result->converged = matching==NUM_REPLICAS;
+		if (result->converged==false)
+			printf("Only %i of %i replicas match the server\n", matching, NUM_REPLICAS);
+	}
+
+	lossPercent=0;
+	client->Shutdown(0);
+	server->Shutdown(0);
+	for (int i=0; i < NUM_REPLICAS; i++)
+		delete serverReplicas[i];
+	client->DetachPlugin(&clientReplicaManager);
+	server->DetachPlugin(&serverReplicaManager);
+	RakPeerInterface::DestroyInstance(client);
+	RakPeerInterface::DestroyInstance(server);
+	return started;
+}
+
+int main(void)
+{
+	printf("Measures bytes/tick sent by a ReplicaManager3 server to one client over loopback, with and without delta serialization.\n");
+	printf("%i replicas, %i ticks of %i ms.\n", NUM_REPLICAS, NUM_TICKS, TICK_MS);
+
+	struct Run
+	{
+		const char *name;
+		PacketReliability reliability;
+		int loss;
+	};
+	const Run runs[] = {
+		{"RELIABLE_ORDERED", RELIABLE_ORDERED, 0},
+		{"UNRELIABLE_WITH_ACK_RECEIPT", UNRELIABLE_WITH_ACK_RECEIPT, LOSS_PERCENT},
+	};
+
+	int failures=0;
+	for (unsigned i=0; i < sizeof(runs)/sizeof(runs[0]); i++)
+	{
+		RunResult full, delta;
+		if (RunBenchmark(runs[i].reliability, false, runs[i].loss, &full)==false ||
+			RunBenchmark(runs[i].reliability, true, runs[i].loss, &delta)==false)
+			return 1;
+
+		printf("\n%s, %i%% of datagrams dropped:\n", runs[i].name, runs[i].loss);
+		printf("Full serialization:  %.1f bytes/tick\n", full.bytesPerTick);
+		printf("Delta serialization: %.1f bytes/tick (%.1f%%)\n", delta.bytesPerTick, 100.0 * delta.bytesPerTick / full.bytesPerTick);
+		if (runs[i].reliability==UNRELIABLE_WITH_ACK_RECEIPT)
+			printf("Delta receipts: %u acked, %u lost\n", delta.receiptsAcked, delta.receiptsLost);
+		if (full.converged==false || delta.converged==false)
+			failures++;
+	}
+
+	if (failures)
+		printf("\nFAILED: the client's replicas did not converge to the server's\n");
+	else
+		printf("\nThe client's replicas converged to the server's in every run\n");
+	return failures==0 ? 0 : 1;
+}
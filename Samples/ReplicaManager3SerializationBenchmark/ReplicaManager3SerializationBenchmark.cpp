@@ -0,0 +1,191 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Measures the time ReplicaManager3::Update() takes to serialize a server's replicas to many connections
+// first on the calling thread, then with ReplicaManager3::StartSerializationThreads()
+// The clients are plain RakPeer instances on loopback. They only answer the ReplicaManager3 handshake and discard everything else
+
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include "RakPeerInterface.h"
+#include "MessageIdentifiers.h"
+#include "BitStream.h"
+#include "ReplicaManager3.h"
+#include "NetworkIDManager.h"
+#include "GetTime.h"
+#include "RakSleep.h"
+
+using namespace RakNet;
+
+static const int NUM_CLIENTS=50;
+static const int NUM_REPLICAS=1000;
+static const int NUM_TICKS=50;
+static const unsigned short SERVER_PORT=60500;
+
+class BenchmarkReplica : public Replica3
+{
+public:
+	BenchmarkReplica() {x=(float) (rand()%1000); y=(float) (rand()%1000); health=100;}
+	virtual void WriteAllocationID(RakNet::Connection_RM3 * /*destinationConnection*/, RakNet::BitStream * /*allocationIdBitstream*/) const {}
+	virtual RM3ConstructionState QueryConstruction(RakNet::Connection_RM3 *destinationConnection, ReplicaManager3 * /*replicaManager3*/) {return QueryConstruction_ServerConstruction(destinationConnection, true);}
+	virtual bool QueryRemoteConstruction(RakNet::Connection_RM3 *sourceConnection) {return QueryRemoteConstruction_ServerConstruction(sourceConnection, true);}
+	virtual void SerializeConstruction(RakNet::BitStream * /*constructionBitstream*/, RakNet::Connection_RM3 * /*destinationConnection*/) {}
+	virtual bool DeserializeConstruction(RakNet::BitStream * /*constructionBitstream*/, RakNet::Connection_RM3 * /*sourceConnection*/) {return true;}
+	virtual void SerializeDestruction(RakNet::BitStream * /*destructionBitstream*/, RakNet::Connection_RM3 * /*destinationConnection*/) {}
+	virtual bool DeserializeDestruction(RakNet::BitStream * /*destructionBitstream*/, RakNet::Connection_RM3 * /*sourceConnection*/) {return true;}
+	virtual RakNet::RM3ActionOnPopConnection QueryActionOnPopConnection(RakNet::Connection_RM3 *droppedConnection) const {return QueryActionOnPopConnection_Server(droppedConnection);}
+	virtual void DeallocReplica(RakNet::Connection_RM3 * /*sourceConnection*/) {delete this;}
+	virtual RakNet::RM3QuerySerializationResult QuerySerialization(RakNet::Connection_RM3 *destinationConnection) {return QuerySerialization_ServerSerializable(destinationConnection, true);}
+	virtual void OnUserReplicaPreSerializeTick(void)
+	{
+		x+=.5f;
+		y+=.25f;
+		if (rand()%10==0)
+			health--;
+	}
+	virtual RM3SerializationResult Serialize(RakNet::SerializeParameters *serializeParameters)
+	{
+		serializeParameters->pro[0].reliability=UNRELIABLE_SEQUENCED;
+		serializeParameters->outputBitstream[0].Write(x);
+		serializeParameters->outputBitstream[0].Write(y);
+		serializeParameters->outputBitstream[0].Write(health);
+		return RM3SR_BROADCAST_IDENTICALLY;
+	}
+	virtual void Deserialize(RakNet::DeserializeParameters * /*deserializeParameters*/) {}
+
+	float x, y;
+	int health;
+};
+
+class BenchmarkConnection : public Connection_RM3
+{
+public:
+	BenchmarkConnection(const SystemAddress &_systemAddress, RakNetGUID _guid) : Connection_RM3(_systemAddress, _guid) {}
+	virtual Replica3 *AllocReplica(RakNet::BitStream * /*allocationId*/, ReplicaManager3 * /*replicaManager3*/) {return 0;}
+};
+
+class BenchmarkReplicaManager : public ReplicaManager3
+{
+public:
+	virtual Connection_RM3* AllocConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID) const {return new BenchmarkConnection(systemAddress,rakNetGUID);}
+	virtual void DeallocConnection(Connection_RM3 *connection) const {delete connection;}
+};
+
+// Discards all incoming packets, echoing back the ReplicaManager3 handshake so the server validates the connection
+// Returns how many clients have had a replica constructed so far
+static int DrainClients(RakPeerInterface **clients, bool *constructed)
+{
+	int constructedCount=0;
+	for (int i=0; i < NUM_CLIENTS; i++)
+	{
+		for (Packet *packet=clients[i]->Receive(); packet; clients[i]->DeallocatePacket(packet), packet=clients[i]->Receive())
+		{
+			if (packet->data[0]==ID_REPLICA_MANAGER_SCOPE_CHANGE)
+			{
+				BitStream bsOut(packet->data, packet->length, false);
+				clients[i]->Send(&bsOut,HIGH_PRIORITY,RELIABLE_ORDERED,0,packet->guid,false);
+			}
+			else if (packet->data[0]==ID_REPLICA_MANAGER_CONSTRUCTION)
+				constructed[i]=true;
+		}
+		if (constructed[i])
+			constructedCount++;
+	}
+	return constructedCount;
+}
+
+static double MeasureUpdate(BenchmarkReplicaManager *replicaManager, RakPeerInterface **clients, bool *constructed)
+{
+	RakNet::TimeUS total=0;
+	for (int tick=0; tick < NUM_TICKS; tick++)
+	{
+		// The auto serialize interval is 0, so every call serializes
+		RakNet::TimeUS startTime=RakNet::GetTimeUS();
+		replicaManager->Update();
+		total+=RakNet::GetTimeUS()-startTime;
+
+		DrainClients(clients, constructed);
+	}
+	return (double) total / NUM_TICKS / 1000.0;
+}
+
+int main(void)
+{
+	printf("Measures ReplicaManager3::Update() serializing %i replicas to %i connections.\n", NUM_REPLICAS, NUM_CLIENTS);
+
+	NetworkIDManager networkIdManager;
+	BenchmarkReplicaManager replicaManager;
+	RakPeerInterface *server=RakPeerInterface::GetInstance();
+	SocketDescriptor serverSd(SERVER_PORT,0);
+	if (server->Startup(NUM_CLIENTS,&serverSd,1)!=CRABNET_STARTED)
+	{
+		printf("Server failed to start on port %i\n", SERVER_PORT);
+		return 1;
+	}
+	server->SetMaximumIncomingConnections(NUM_CLIENTS);
+	server->AttachPlugin(&replicaManager);
+	replicaManager.SetNetworkIDManager(&networkIdManager);
+	replicaManager.SetAutoSerializeInterval(0);
+
+	for (int i=0; i < NUM_REPLICAS; i++)
+		replicaManager.Reference(new BenchmarkReplica);
+
+	RakPeerInterface *clients[NUM_CLIENTS];
+	bool constructed[NUM_CLIENTS];
+	for (int i=0; i < NUM_CLIENTS; i++)
+	{
+		SocketDescriptor sd;
+		clients[i]=RakPeerInterface::GetInstance();
+		clients[i]->Startup(1,&sd,1);
+		clients[i]->Connect("127.0.0.1",SERVER_PORT,0,0);
+		constructed[i]=false;
+	}
+
+	// Wait for every connection to be validated and sent the initial construction
+	RakNet::Time timeout=RakNet::GetTime()+30000;
+	int constructedCount=0;
+	while (constructedCount < NUM_CLIENTS && RakNet::GetTime() < timeout)
+	{
+		for (Packet *packet=server->Receive(); packet; server->DeallocatePacket(packet), packet=server->Receive())
+			;
+		constructedCount=DrainClients(clients, constructed);
+		RakSleep(1);
+	}
+	if (constructedCount < NUM_CLIENTS)
+	{
+		printf("Only %i of %i clients were constructed to\n", constructedCount, NUM_CLIENTS);
+		return 1;
+	}
+
+	// From here on Update() is only called directly, so server->Receive() is not used
+	double serialMs=MeasureUpdate(&replicaManager, clients, constructed);
+	printf("Calling thread only: %.2f ms/tick\n", serialMs);
+
+	const int threadCounts[] = {2, 4, 8};
+	for (unsigned i=0; i < sizeof(threadCounts)/sizeof(threadCounts[0]); i++)
+	{
+		replicaManager.StartSerializationThreads(threadCounts[i]);
+		double parallelMs=MeasureUpdate(&replicaManager, clients, constructed);
+		replicaManager.StopSerializationThreads();
+		printf("%i worker threads: %.2f ms/tick (%.2fx)\n", threadCounts[i], parallelMs, serialMs / parallelMs);
+	}
+
+	for (int i=0; i < NUM_CLIENTS; i++)
+	{
+		clients[i]->Shutdown(0);
+		RakPeerInterface::DestroyInstance(clients[i]);
+	}
+	server->Shutdown(0);
+	server->DetachPlugin(&replicaManager);
+	RakPeerInterface::DestroyInstance(server);
+	return 0;
+}
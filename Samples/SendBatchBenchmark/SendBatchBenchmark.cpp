@@ -0,0 +1,170 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Compares the time the game thread spends per message queueing a tick of messages with RakPeer::Send() and with RakPeer::SendBatch()
+// Send() locks the buffered command queue twice per message, SendBatch() twice per tick
+// Also checks that the server receives every message in order, including one sent with SendList()
+
+#include <cstdio>
+#include <cstring>
+#include "RakPeerInterface.h"
+#include "MessageIdentifiers.h"
+#include "GetTime.h"
+#include "RakSleep.h"
+
+using namespace RakNet;
+
+static const unsigned short SERVER_PORT=60002;
+static const int TICKS=10;
+static const int MESSAGES_PER_TICK=20000;
+static const int MESSAGE_SIZE=24;
+
+// Receives until count messages arrived. Returns false if they did not all arrive in order
+static bool ReceiveMessages(RakPeerInterface *server, RakPeerInterface *client, unsigned int &expectedSequence, unsigned int count)
+{
+	Packet *packets[256];
+	unsigned int last=expectedSequence+count;
+	bool inOrder=true;
+	RakNet::TimeMS timeout=RakNet::GetTimeMS()+30000;
+	while (expectedSequence < last && RakNet::GetTimeMS() < timeout)
+	{
+		unsigned int received=server->ReceiveBatch(packets, 256);
+		for (unsigned int i=0; i < received; i++)
+		{
+			if (packets[i]->data[0]!=ID_USER_PACKET_ENUM)
+				continue;
+			unsigned int sequence;
+			memcpy(&sequence, packets[i]->data+1, sizeof(sequence));
+			if (sequence!=expectedSequence)
+				inOrder=false;
+			expectedSequence++;
+		}
+		server->DeallocatePackets(packets, received);
+
+		Packet *packet;
+		for (packet=client->Receive(); packet; client->DeallocatePacket(packet), packet=client->Receive())
+			;
+		if (received==0)
+			RakSleep(1);
+	}
+	return inOrder && expectedSequence==last;
+}
+
+int main(void)
+{
+	printf("Compares the time to queue messages with RakPeer::Send() and RakPeer::SendBatch().\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	RakPeerInterface *server=RakPeerInterface::GetInstance();
+	RakPeerInterface *client=RakPeerInterface::GetInstance();
+	SocketDescriptor serverSd(SERVER_PORT,0);
+	SocketDescriptor clientSd;
+	if (server->Startup(1,&serverSd,1)!=CRABNET_STARTED || client->Startup(1,&clientSd,1)!=CRABNET_STARTED)
+	{
+		printf("Startup failed\n");
+		return 1;
+	}
+	server->SetMaximumIncomingConnections(1);
+	client->Connect("127.0.0.1", SERVER_PORT, 0, 0);
+
+	RakNetGUID serverGuid=UNASSIGNED_CRABNET_GUID;
+	RakNet::TimeMS timeout=RakNet::GetTimeMS()+5000;
+	while (serverGuid==UNASSIGNED_CRABNET_GUID && RakNet::GetTimeMS() < timeout)
+	{
+		Packet *packet;
+		for (packet=client->Receive(); packet; client->DeallocatePacket(packet), packet=client->Receive())
+		{
+			if (packet->data[0]==ID_CONNECTION_REQUEST_ACCEPTED)
+				serverGuid=packet->guid;
+		}
+		for (packet=server->Receive(); packet; server->DeallocatePacket(packet), packet=server->Receive())
+			;
+		RakSleep(1);
+	}
+	if (serverGuid==UNASSIGNED_CRABNET_GUID)
+	{
+		printf("Could not connect\n");
+		return 1;
+	}
+
+	// Message ID, then sequence number
+	char *gameMessages=new char[MESSAGES_PER_TICK*MESSAGE_SIZE];
+	BatchedMessage *batch=new BatchedMessage[MESSAGES_PER_TICK];
+	memset(gameMessages, 0, MESSAGES_PER_TICK*MESSAGE_SIZE);
+	unsigned int nextSequence=0, expectedSequence=0;
+	double nsPerMessage[2];
+	bool success=true;
+	for (int useBatch=0; useBatch < 2; useBatch++)
+	{
+		RakNet::TimeUS total=0;
+		for (int tick=0; tick < TICKS; tick++)
+		{
+			for (int i=0; i < MESSAGES_PER_TICK; i++)
+			{
+				gameMessages[i*MESSAGE_SIZE]=ID_USER_PACKET_ENUM;
+				memcpy(gameMessages+i*MESSAGE_SIZE+1, &nextSequence, sizeof(nextSequence));
+				nextSequence++;
+			}
+
+			RakNet::TimeUS startTime=RakNet::GetTimeUS();
+			if (useBatch)
+			{
+				for (int i=0; i < MESSAGES_PER_TICK; i++)
+				{
+					batch[i].data=gameMessages+i*MESSAGE_SIZE;
+					batch[i].length=MESSAGE_SIZE;
+					batch[i].priority=HIGH_PRIORITY;
+					batch[i].reliability=RELIABLE_ORDERED;
+					batch[i].orderingChannel=0;
+					batch[i].systemIdentifier=serverGuid;
+					batch[i].broadcast=false;
+					batch[i].forceReceiptNumber=0;
+				}
+				if (client->SendBatch(batch, MESSAGES_PER_TICK)!=(unsigned int) MESSAGES_PER_TICK)
+					success=false;
+			}
+			else
+			{
+				for (int i=0; i < MESSAGES_PER_TICK; i++)
+					client->Send(gameMessages+i*MESSAGE_SIZE, MESSAGE_SIZE, HIGH_PRIORITY, RELIABLE_ORDERED, 0, serverGuid, false);
+			}
+			total+=RakNet::GetTimeUS()-startTime;
+
+			if (ReceiveMessages(server, client, expectedSequence, MESSAGES_PER_TICK)==false)
+				success=false;
+		}
+		nsPerMessage[useBatch]=(double) total*1000.0/(TICKS*MESSAGES_PER_TICK);
+	}
+
+	// SendList() goes through the same batched command, as one message built from its parts
+	unsigned char id=ID_USER_PACKET_ENUM;
+	unsigned int sequence=nextSequence++;
+	char payload[MESSAGE_SIZE-1-sizeof(unsigned int)];
+	memset(payload, 0, sizeof(payload));
+	const char *parts[3]={(const char *) &id, (const char *) &sequence, payload};
+	const int lengths[3]={1, (int) sizeof(sequence), (int) sizeof(payload)};
+	client->SendList(parts, lengths, 3, HIGH_PRIORITY, RELIABLE_ORDERED, 0, serverGuid, false);
+	if (ReceiveMessages(server, client, expectedSequence, 1)==false)
+		success=false;
+
+	printf("Send():      %.1f ns per message\n", nsPerMessage[0]);
+	printf("SendBatch(): %.1f ns per message (%.2fx)\n", nsPerMessage[1], nsPerMessage[0]/nsPerMessage[1]);
+	if (success==false)
+		printf("FAILED: messages were lost or out of order\n");
+
+	delete [] gameMessages;
+	delete [] batch;
+	server->Shutdown(100);
+	client->Shutdown(100);
+	RakPeerInterface::DestroyInstance(server);
+	RakPeerInterface::DestroyInstance(client);
+	return success ? 0 : 1;
+}
@@ -0,0 +1,264 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Fills a DataStructures::Table with 100000 rooms, and times QueryTable() with and without column blocks on the filtered columns
+// Every query on column blocks is checked against the same query on a copy of the table without them, before and after a round of updates and removals
+// Also writes one column block with TableSerializer::SerializeColumnBlock(), and checks it reads back into a copy of the table
+
+#include <cstdio>
+#include <cstring>
+#include "DS_Table.h"
+#include "TableSerializer.h"
+#include "BitStream.h"
+#include "GetTime.h"
+
+using namespace DataStructures;
+using namespace RakNet;
+
+static const unsigned int ROW_COUNT=100000;
+static const unsigned int MAP_COUNT=1000;
+static const unsigned int MAX_PLAYERS=64;
+static const unsigned int MAX_PING=400;
+static const char *GAME_MODES[]={"deathmatch", "ctf", "coop", "race", "survival", "arena", "sandbox", "roleplay"};
+static const unsigned int GAME_MODE_COUNT=sizeof(GAME_MODES)/sizeof(GAME_MODES[0]);
+static const unsigned int QUERY_REPEATS=20;
+
+enum
+{
+	COLUMN_NAME,
+	COLUMN_MAP,
+	COLUMN_PLAYERS,
+	COLUMN_PING,
+	COLUMN_MODE,
+};
+
+struct BenchmarkQuery
+{
+	const char *description;
+	Table::FilterQuery filters[2];
+	unsigned int filterCount;
+};
+
+static unsigned int randomState=12345;
+static unsigned int NextRandom(void)
+{
+	randomState=randomState*1103515245+12345;
+	return randomState>>8;
+}
+
+static void SetRoom(Table &table, unsigned int rowId)
+{
+	char name[32];
+	sprintf(name, "Room %u", rowId);
+	table.UpdateCell(rowId, COLUMN_NAME, name);
+	table.UpdateCell(rowId, COLUMN_MAP, (int) (NextRandom()%MAP_COUNT));
+	table.UpdateCell(rowId, COLUMN_PLAYERS, (int) (NextRandom()%MAX_PLAYERS));
+	// Rooms that have not reported a ping yet leave the cell empty
+	if (NextRandom()%10!=0)
+		table.UpdateCell(rowId, COLUMN_PING, (int) (NextRandom()%MAX_PING));
+	table.UpdateCell(rowId, COLUMN_MODE, (char *) GAME_MODES[NextRandom()%GAME_MODE_COUNT]);
+}
+
+static bool SameRows(Table &a, Table &b)
+{
+	if (a.GetRowCount()!=b.GetRowCount())
+		return false;
+	Page<unsigned, Table::Row*, _TABLE_BPLUS_TREE_ORDER> *pageA=a.GetListHead(), *pageB=b.GetListHead();
+	int indexA=0, indexB=0;
+	while (pageA && pageB)
+	{
+		if (pageA->keys[indexA]!=pageB->keys[indexB])
+			return false;
+		if (++indexA==pageA->size)
+		{
+			pageA=pageA->next;
+			indexA=0;
+		}
+		if (++indexB==pageB->size)
+		{
+			pageB=pageB->next;
+			indexB=0;
+		}
+	}
+	return pageA==0 && pageB==0;
+}
+
+// Returns the average time of one query in microseconds
+static double TimeQuery(Table &table, BenchmarkQuery &query, Table &result)
+{
+	// Freeing the rows of the last result is part of the next query, so do that first
+	result.Clear();
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	for (unsigned int i=0; i < QUERY_REPEATS; i++)
+		table.QueryTable(0, 0, query.filters, query.filterCount, 0, 0, &result);
+	return (double) (RakNet::GetTimeUS()-start)/QUERY_REPEATS;
+}
+
+// Runs every query on both tables and returns the number whose results differ
+static unsigned int CompareQueries(Table &blocked, Table &plain, BenchmarkQuery *queries, unsigned int queryCount)
+{
+	unsigned int mismatches=0;
+	for (unsigned int i=0; i < queryCount; i++)
+	{
+		Table blockedResult, plainResult;
+		blocked.QueryTable(0, 0, queries[i].filters, queries[i].filterCount, 0, 0, &blockedResult);
+		plain.QueryTable(0, 0, queries[i].filters, queries[i].filterCount, 0, 0, &plainResult);
+		if (SameRows(blockedResult, plainResult)==false)
+		{
+			printf("Results differ for %s: %u rows with column blocks, %u without\n", queries[i].description, blockedResult.GetRowCount(), plainResult.GetRowCount());
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+// Sends the players column of a table with SerializeColumnBlock(), into a copy whose players column was cleared, and returns the number of cells that differ afterwards
+static unsigned int CheckSerializedColumn(Table &table)
+{
+	Table copy;
+	copy=table;
+	for (Page<unsigned, Table::Row*, _TABLE_BPLUS_TREE_ORDER> *page=copy.GetListHead(); page; page=page->next)
+	{
+		for (int i=0; i < page->size; i++)
+			page->data[i]->cells[COLUMN_PLAYERS]->Clear();
+	}
+
+	RakNet::BitStream bitStream;
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	TableSerializer::SerializeColumnBlock(&table, COLUMN_PLAYERS, &bitStream);
+	double serializeTime=(RakNet::GetTimeUS()-start)/1000.0;
+	if (TableSerializer::DeserializeColumnBlock(&bitStream, &copy)==false)
+	{
+		printf("DeserializeColumnBlock failed\n");
+		return 1;
+	}
+
+	RakNet::BitStream tableBitStream;
+	start=RakNet::GetTimeUS();
+	TableSerializer::SerializeTable(&table, &tableBitStream);
+	double tableTime=(RakNet::GetTimeUS()-start)/1000.0;
+	printf("\nSerializing the players column: %.2f ms and %u bytes, the whole table: %.2f ms and %u bytes\n",
+		serializeTime, (unsigned int) bitStream.GetNumberOfBytesUsed(), tableTime, (unsigned int) tableBitStream.GetNumberOfBytesUsed());
+
+	unsigned int differences=0;
+	Page<unsigned, Table::Row*, _TABLE_BPLUS_TREE_ORDER> *page=table.GetListHead();
+	while (page)
+	{
+		for (int i=0; i < page->size; i++)
+		{
+			Table::Cell *original=page->data[i]->cells[COLUMN_PLAYERS];
+			Table::Cell *received=copy.GetRowByID(page->keys[i])->cells[COLUMN_PLAYERS];
+			if (original->isEmpty!=received->isEmpty || (original->isEmpty==false && original->i!=received->i))
+				differences++;
+		}
+		page=page->next;
+	}
+	return differences;
+}
+
+int main(void)
+{
+	printf("Times DataStructures::Table queries on 100000 rows with and without column blocks.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	Table table;
+	table.AddColumn("Name", Table::STRING);
+	table.AddColumn("Map", Table::NUMERIC);
+	table.AddColumn("Players", Table::NUMERIC);
+	table.AddColumn("Ping", Table::NUMERIC);
+	table.AddColumn("Mode", Table::STRING);
+	for (unsigned int rowId=0; rowId < ROW_COUNT; rowId++)
+	{
+		table.AddRow(rowId);
+		SetRoom(table, rowId);
+	}
+
+	Table::Cell mapCell, playersHighCell, playersLowCell, pingCell, pingHighCell, modeCell;
+	mapCell.Set(417);
+	playersHighCell.Set(60);
+	playersLowCell.Set(8);
+	pingCell.Set(50);
+	pingHighCell.Set((int) MAX_PING);
+	modeCell.Set("ctf");
+
+	BenchmarkQuery queries[6];
+	queries[0].description="Players >= 60";
+	queries[0].filters[0]=Table::FilterQuery(COLUMN_PLAYERS, &playersHighCell, Table::QF_GREATER_THAN_EQ);
+	queries[0].filterCount=1;
+	queries[1].description="Ping < 50 && Players > 8";
+	queries[1].filters[0]=Table::FilterQuery(COLUMN_PING, &pingCell, Table::QF_LESS_THAN);
+	queries[1].filters[1]=Table::FilterQuery(COLUMN_PLAYERS, &playersLowCell, Table::QF_GREATER_THAN);
+	queries[1].filterCount=2;
+	queries[2].description="Mode == \"ctf\" && Map == 417";
+	queries[2].filters[0]=Table::FilterQuery(COLUMN_MODE, &modeCell, Table::QF_EQUAL);
+	queries[2].filters[1]=Table::FilterQuery(COLUMN_MAP, &mapCell, Table::QF_EQUAL);
+	queries[2].filterCount=2;
+	queries[3].description="Ping is empty";
+	queries[3].filters[0]=Table::FilterQuery(COLUMN_PING, 0, Table::QF_IS_EMPTY);
+	queries[3].filterCount=1;
+	queries[4].description="Mode != \"ctf\" && Map != 417";
+	queries[4].filters[0]=Table::FilterQuery(COLUMN_MODE, &modeCell, Table::QF_NOT_EQUAL);
+	queries[4].filters[1]=Table::FilterQuery(COLUMN_MAP, &mapCell, Table::QF_NOT_EQUAL);
+	queries[4].filterCount=2;
+	// No rows pass, so this times the filter without copying rows to the result
+	queries[5].description="Ping >= 400";
+	queries[5].filters[0]=Table::FilterQuery(COLUMN_PING, &pingHighCell, Table::QF_GREATER_THAN_EQ);
+	queries[5].filterCount=1;
+	const unsigned int queryCount=sizeof(queries)/sizeof(queries[0]);
+
+	double scanTimes[queryCount];
+	Table result;
+	for (unsigned int i=0; i < queryCount; i++)
+		scanTimes[i]=TimeQuery(table, queries[i], result);
+
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	table.AddColumnBlock(COLUMN_MAP);
+	table.AddColumnBlock(COLUMN_PLAYERS);
+	table.AddColumnBlock(COLUMN_PING);
+	table.AddColumnBlock(COLUMN_MODE);
+	printf("Building 4 column blocks: %.1f ms\n\n", (RakNet::GetTimeUS()-start)/1000.0);
+
+	printf("%-34s %8s %14s %14s\n", "Query", "Rows", "Scan us", "Blocks us");
+	for (unsigned int i=0; i < queryCount; i++)
+	{
+		double blockTime=TimeQuery(table, queries[i], result);
+		printf("%-34s %8u %14.1f %14.1f\n", queries[i].description, result.GetRowCount(), scanTimes[i], blockTime);
+	}
+
+	// Column blocks are not copied, so this is the same data queried by testing every row
+	Table plain;
+	plain=table;
+	unsigned int mismatches=CompareQueries(table, plain, queries, queryCount);
+
+	// Change and remove rooms through the table, so the column blocks must follow
+	start=RakNet::GetTimeUS();
+	for (unsigned int i=0; i < ROW_COUNT/10; i++)
+		SetRoom(table, NextRandom()%ROW_COUNT);
+	double updateTime=(double) (RakNet::GetTimeUS()-start)/(ROW_COUNT/10);
+	for (unsigned int i=0; i < ROW_COUNT/10; i++)
+		table.RemoveRow(NextRandom()%ROW_COUNT);
+	printf("\nUpdating a row with 4 cells in column blocks: %.2f us\n", updateTime);
+
+	plain=table;
+	mismatches+=CompareQueries(table, plain, queries, queryCount);
+
+	unsigned int differences=CheckSerializedColumn(table);
+	if (differences > 0)
+		printf("%u cells differ after SerializeColumnBlock()\n", differences);
+
+	if (mismatches > 0 || differences > 0)
+	{
+		printf("\nFAILED: %u queries returned different rows with column blocks\n", mismatches);
+		return 1;
+	}
+	printf("\nQueries on column blocks returned the same rows as full scans\n");
+	return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+// Fills a DataStructures::Table with 100000 rooms, and times QueryTable() with and without secondary indexes on the filtered columns
+// Every indexed query is checked against the same query on a copy of the table without indexes, before and after a round of updates and removals
+
+#include <cstdio>
+#include <cstring>
+#include "DS_Table.h"
+#include "GetTime.h"
+
+using namespace DataStructures;
+
+static const unsigned int ROW_COUNT=100000;
+static const unsigned int MAP_COUNT=1000;
+static const unsigned int MAX_PLAYERS=64;
+static const char *GAME_MODES[]={"deathmatch", "ctf", "coop", "race", "survival", "arena", "sandbox", "roleplay"};
+static const unsigned int GAME_MODE_COUNT=sizeof(GAME_MODES)/sizeof(GAME_MODES[0]);
+static const unsigned int QUERY_REPEATS=20;
+
+enum
+{
+	COLUMN_NAME,
+	COLUMN_MAP,
+	COLUMN_PLAYERS,
+	COLUMN_MODE,
+};
+
+struct BenchmarkQuery
+{
+	const char *description;
+	Table::FilterQuery filters[2];
+	unsigned int filterCount;
+};
+
+static unsigned int randomState=12345;
+static unsigned int NextRandom(void)
+{
+	randomState=randomState*1103515245+12345;
+	return randomState>>8;
+}
+
+static void SetRoom(Table &table, unsigned int rowId)
+{
+	char name[32];
+	sprintf(name, "Room %u", rowId);
+	table.UpdateCell(rowId, COLUMN_NAME, name);
+	table.UpdateCell(rowId, COLUMN_MAP, (int) (NextRandom()%MAP_COUNT));
+	table.UpdateCell(rowId, COLUMN_PLAYERS, (int) (NextRandom()%MAX_PLAYERS));
+	table.UpdateCell(rowId, COLUMN_MODE, (char *) GAME_MODES[NextRandom()%GAME_MODE_COUNT]);
+}
+
+static bool SameRows(Table &a, Table &b)
+{
+	if (a.GetRowCount()!=b.GetRowCount())
+		return false;
+	Page<unsigned, Table::Row*, _TABLE_BPLUS_TREE_ORDER> *pageA=a.GetListHead(), *pageB=b.GetListHead();
+	int indexA=0, indexB=0;
+	while (pageA && pageB)
+	{
+		if (pageA->keys[indexA]!=pageB->keys[indexB])
+			return false;
+		if (++indexA==pageA->size)
+		{
+			pageA=pageA->next;
+			indexA=0;
+		}
+		if (++indexB==pageB->size)
+		{
+			pageB=pageB->next;
+			indexB=0;
+		}
+	}
+	return pageA==0 && pageB==0;
+}
+
+// Returns the average time of one query in microseconds
+static double TimeQuery(Table &table, BenchmarkQuery &query, Table &result)
+{
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	for (unsigned int i=0; i < QUERY_REPEATS; i++)
+		table.QueryTable(0, 0, query.filters, query.filterCount, 0, 0, &result);
+	return (double) (RakNet::GetTimeUS()-start)/QUERY_REPEATS;
+}
+
+// Runs every query on both tables and returns the number whose results differ
+static unsigned int CompareQueries(Table &indexed, Table &plain, BenchmarkQuery *queries, unsigned int queryCount)
+{
+	unsigned int mismatches=0;
+	for (unsigned int i=0; i < queryCount; i++)
+	{
+		Table indexedResult, plainResult;
+		indexed.QueryTable(0, 0, queries[i].filters, queries[i].filterCount, 0, 0, &indexedResult);
+		plain.QueryTable(0, 0, queries[i].filters, queries[i].filterCount, 0, 0, &plainResult);
+		if (SameRows(indexedResult, plainResult)==false)
+		{
+			printf("Results differ for %s: %u rows with indexes, %u without\n", queries[i].description, indexedResult.GetRowCount(), plainResult.GetRowCount());
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+int main(void)
+{
+	printf("Times DataStructures::Table queries on 100000 rows with and without secondary indexes.\n");
+	printf("Difficulty: Intermediate\n\n");
+
+	Table table;
+	table.AddColumn("Name", Table::STRING);
+	table.AddColumn("Map", Table::NUMERIC);
+	table.AddColumn("Players", Table::NUMERIC);
+	table.AddColumn("Mode", Table::STRING);
+	for (unsigned int rowId=0; rowId < ROW_COUNT; rowId++)
+	{
+		table.AddRow(rowId);
+		SetRoom(table, rowId);
+	}
+
+	Table::Cell mapCell, nameCell, playersHighCell, playersLowCell, modeCell;
+	mapCell.Set(417);
+	nameCell.Set("Room 4242");
+	playersHighCell.Set(60);
+	playersLowCell.Set(3);
+	modeCell.Set("ctf");
+
+	BenchmarkQuery queries[4];
+	queries[0].description="Map == 417";
+	queries[0].filters[0]=Table::FilterQuery(COLUMN_MAP, &mapCell, Table::QF_EQUAL);
+	queries[0].filterCount=1;
+	queries[1].description="Name == \"Room 4242\"";
+	queries[1].filters[0]=Table::FilterQuery(COLUMN_NAME, &nameCell, Table::QF_EQUAL);
+	queries[1].filterCount=1;
+	queries[2].description="Players >= 60 && Mode == \"ctf\"";
+	queries[2].filters[0]=Table::FilterQuery(COLUMN_PLAYERS, &playersHighCell, Table::QF_GREATER_THAN_EQ);
+	queries[2].filters[1]=Table::FilterQuery(COLUMN_MODE, &modeCell, Table::QF_EQUAL);
+	queries[2].filterCount=2;
+	queries[3].description="Players < 3";
+	queries[3].filters[0]=Table::FilterQuery(COLUMN_PLAYERS, &playersLowCell, Table::QF_LESS_THAN);
+	queries[3].filterCount=1;
+	const unsigned int queryCount=sizeof(queries)/sizeof(queries[0]);
+
+	double scanTimes[queryCount];
+	Table result;
+	for (unsigned int i=0; i < queryCount; i++)
+		scanTimes[i]=TimeQuery(table, queries[i], result);
+
+	RakNet::TimeUS start=RakNet::GetTimeUS();
+	table.AddIndex(COLUMN_NAME, Table::IT_HASH);
+	table.AddIndex(COLUMN_MAP, Table::IT_HASH);
+	table.AddIndex(COLUMN_PLAYERS, Table::IT_ORDERED);
+	table.AddIndex(COLUMN_MODE, Table::IT_HASH);
+	printf("Building 4 indexes: %.1f ms\n\n", (RakNet::GetTimeUS()-start)/1000.0);
+
+	printf("%-34s %8s %14s %14s\n", "Query", "Rows", "Scan us", "Indexed us");
+	for (unsigned int i=0; i < queryCount; i++)
+	{
+		double indexedTime=TimeQuery(table, queries[i], result);
+		printf("%-34s %8u %14.1f %14.1f\n", queries[i].description, result.GetRowCount(), scanTimes[i], indexedTime);
+	}
+
+	// Indexes are not copied, so this is the same data queried by testing every row
+	Table plain;
+	plain=table;
+	unsigned int mismatches=CompareQueries(table, plain, queries, queryCount);
+
+	// Change and remove rooms through the table, so the indexes must follow
+	start=RakNet::GetTimeUS();
+	for (unsigned int i=0; i < ROW_COUNT/10; i++)
+		SetRoom(table, NextRandom()%ROW_COUNT);
+	double updateTime=(double) (RakNet::GetTimeUS()-start)/(ROW_COUNT/10);
+	for (unsigned int i=0; i < ROW_COUNT/10; i++)
+		table.RemoveRow(NextRandom()%ROW_COUNT);
+	printf("\nUpdating 4 indexed cells of a row: %.2f us\n", updateTime);
+
+	plain=table;
+	mismatches+=CompareQueries(table, plain, queries, queryCount);
+
+	if (mismatches > 0)
+	{
+		printf("\nFAILED: %u queries returned different rows with indexes\n", mismatches);
+		return 1;
+	}
+	printf("\nIndexed queries returned the same rows as full scans\n");
+	return 0;
+}
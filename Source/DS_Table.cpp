@@ -15,6 +15,12 @@
 #include "RakAssert.h"
 #include "RakAssert.h"
 #include "Itoa.h"
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TABLE_COLUMN_BLOCK_SSE2
+#endif
 
 using namespace DataStructures;
 
@@ -37,6 +43,889 @@ void FreeRow(Table::Row *input, int index)
     delete input;
 }
 
+namespace
+{
+    // Copy of an indexed cell value, owned by the index so the entry can still be found after the cell changes
+    struct IndexKey
+    {
+        // NUMERIC value, or the length of c for STRING and BINARY
+        double i;
+        char *c;
+        void *ptr;
+        Table::ColumnType type;
+        // Makes keys unique, since many rows can have the same value
+        unsigned rowId;
+    };
+
+    int CompareIndexValues(const IndexKey &a, const IndexKey &b)
+    {
+        switch (a.type)
+        {
+            case Table::NUMERIC:
+                if (a.i < b.i)
+                    return -1;
+                return a.i > b.i ? 1 : 0;
+            case Table::STRING:
+                return strcmp(a.c, b.c);
+            case Table::POINTER:
+                if (a.ptr < b.ptr)
+                    return -1;
+                return a.ptr > b.ptr ? 1 : 0;
+            default:
+                // BINARY values are only compared for equality
+                if (a.i != b.i)
+                    return a.i < b.i ? -1 : 1;
+                return a.i == 0.0 ? 0 : memcmp(a.c, b.c, (int) a.i);
+        }
+    }
+
+    int CompareIndexKeys(const IndexKey &a, const IndexKey &b)
+    {
+        int result = CompareIndexValues(a, b);
+        if (result != 0)
+            return result;
+        if (a.rowId < b.rowId)
+            return -1;
+        return a.rowId > b.rowId ? 1 : 0;
+    }
+
+    // Used by BPlusTree
+    bool operator==(const IndexKey &a, const IndexKey &b) {return CompareIndexKeys(a, b) == 0;}
+    bool operator<(const IndexKey &a, const IndexKey &b) {return CompareIndexKeys(a, b) < 0;}
+    bool operator>(const IndexKey &a, const IndexKey &b) {return CompareIndexKeys(a, b) > 0;}
+
+    unsigned long HashIndexValue(const IndexKey &key)
+    {
+        uint64_t hash;
+        switch (key.type)
+        {
+            case Table::NUMERIC:
+            {
+                // 0.0 and -0.0 are equal, so they must hash the same
+                double value = key.i == 0.0 ? 0.0 : key.i;
+                memcpy(&hash, &value, sizeof(hash));
+                break;
+            }
+            case Table::POINTER:
+                hash = (uint64_t) (size_t) key.ptr;
+                break;
+            default:
+                hash = (uint64_t) key.i;
+                for (int index = 0; index < (int) key.i; index++)
+                    hash = (unsigned char) key.c[index] + (hash << 6) + (hash << 16) - hash;
+                break;
+        }
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        return (unsigned long) hash;
+    }
+
+    // Fills key from a row or filter cell, without copying its data. Returns false for values that QueryRow() never finds equal, less or greater
+    bool GetIndexValue(const Table::Cell *cell, Table::ColumnType type, IndexKey *key)
+    {
+        key->type = type;
+        key->i = 0.0;
+        key->c = nullptr;
+        key->ptr = nullptr;
+        switch (type)
+        {
+            case Table::NUMERIC:
+                // NaN is not equal, less or greater than anything
+                if (cell->i != cell->i)
+                    return false;
+                key->i = cell->i;
+                return true;
+            case Table::STRING:
+                if (cell->c == nullptr)
+                    return false;
+                key->i = (double) (strlen(cell->c) + 1);
+                key->c = cell->c;
+                return true;
+            case Table::BINARY:
+                if (cell->c == nullptr && cell->i != 0.0)
+                    return false;
+                key->i = cell->i;
+                key->c = cell->c;
+                return true;
+            case Table::POINTER:
+                key->ptr = cell->ptr;
+                return true;
+        }
+        return false;
+    }
+
+    struct HashIndexEntry
+    {
+        IndexKey key;
+        Table::Row *row;
+        unsigned long hash;
+        HashIndexEntry *next;
+        HashIndexEntry *previous;
+    };
+
+    // What an index holds for one row
+    struct IndexedRow
+    {
+        IndexKey key;
+        // IT_HASH only
+        HashIndexEntry *entry;
+    };
+}
+
+struct Table::SecondaryIndex
+{
+    SecondaryIndex(unsigned _columnIndex, IndexType _indexType, ColumnType _columnType);
+    ~SecondaryIndex();
+
+    void Add(unsigned rowId, Row *row);
+    void Remove(unsigned rowId);
+    bool CanQuery(const FilterQuery &filter) const;
+    // Returns false, with nothing added, if more than maxRows rows pass the filter
+    bool Query(const FilterQuery &filter, unsigned maxRows, DataStructures::List<unsigned> &rowIds, DataStructures::List<Row*> &rowList) const;
+
+    unsigned columnIndex;
+    IndexType indexType;
+    ColumnType columnType;
+
+    // Entry of each indexed row, so it can be found after the cell has changed
+    DataStructures::BPlusTree<unsigned, IndexedRow, _TABLE_BPLUS_TREE_ORDER> rowEntries;
+
+    // Non empty STRING cells holding a null pointer. QueryRow() skips filters on these cells, so while there are any the index cannot stand in for a filter
+    unsigned nullStringCount;
+
+    // IT_ORDERED
+    DataStructures::BPlusTree<IndexKey, Row*, _TABLE_BPLUS_TREE_ORDER> orderedKeys;
+
+    // IT_HASH. Chained, with a power of two number of buckets that doubles when there are more entries than buckets
+    HashIndexEntry **buckets;
+    unsigned bucketCount;
+    unsigned entryCount;
+};
+
+Table::SecondaryIndex::SecondaryIndex(unsigned _columnIndex, IndexType _indexType, ColumnType _columnType)
+{
+    columnIndex = _columnIndex;
+    indexType = _indexType;
+    columnType = _columnType;
+    nullStringCount = 0;
+    buckets = nullptr;
+    bucketCount = 0;
+    entryCount = 0;
+}
+
+Table::SecondaryIndex::~SecondaryIndex()
+{
+    DataStructures::Page<unsigned, IndexedRow, _TABLE_BPLUS_TREE_ORDER> *cur = rowEntries.GetListHead();
+    while (cur != nullptr)
+    {
+        for (int i = 0; i < cur->size; i++)
+        {
+            free(cur->data[i].key.c);
+            delete cur->data[i].entry;
+        }
+        cur = cur->next;
+    }
+    delete [] buckets;
+}
+
+void Table::SecondaryIndex::Add(unsigned rowId, Row *row)
+{
+    Cell *cell = row->cells[columnIndex];
+    if (cell->isEmpty)
+        return;
+
+    IndexedRow indexedRow;
+    indexedRow.entry = nullptr;
+    IndexKey &key = indexedRow.key;
+    if (GetIndexValue(cell, columnType, &key) == false)
+    {
+        if (columnType != STRING)
+            return;
+
+        // Remember the row, so Remove() knows to decrement nullStringCount
+        key.rowId = rowId;
+        rowEntries.Insert(rowId, indexedRow);
+        nullStringCount++;
+        return;
+    }
+
+    key.rowId = rowId;
+    if (key.c)
+    {
+        char *copy = (char *) malloc((int) key.i);
+        RakAssert(copy);
+        memcpy(copy, key.c, (int) key.i);
+        key.c = copy;
+    }
+
+    if (indexType == IT_ORDERED)
+    {
+        orderedKeys.Insert(key, row);
+        rowEntries.Insert(rowId, indexedRow);
+        return;
+    }
+
+    if (entryCount >= bucketCount)
+    {
+        unsigned newBucketCount = bucketCount == 0 ? 64 : bucketCount * 2;
+        HashIndexEntry **newBuckets = new HashIndexEntry *[newBucketCount];
+        for (unsigned bucket = 0; bucket < newBucketCount; bucket++)
+            newBuckets[bucket] = nullptr;
+        for (unsigned bucket = 0; bucket < bucketCount; bucket++)
+        {
+            while (buckets[bucket])
+            {
+                HashIndexEntry *entry = buckets[bucket];
+                buckets[bucket] = entry->next;
+                HashIndexEntry *&head = newBuckets[entry->hash & (newBucketCount - 1)];
+                entry->previous = nullptr;
+                entry->next = head;
+                if (head)
+                    head->previous = entry;
+                head = entry;
+            }
+        }
+        delete [] buckets;
+        buckets = newBuckets;
+        bucketCount = newBucketCount;
+    }
+
+    HashIndexEntry *entry = new HashIndexEntry;
+    entry->key = key;
+    entry->row = row;
+    entry->hash = HashIndexValue(key);
+    HashIndexEntry *&head = buckets[entry->hash & (bucketCount - 1)];
+    entry->previous = nullptr;
+    entry->next = head;
+    if (head)
+        head->previous = entry;
+    head = entry;
+    entryCount++;
+
+    indexedRow.entry = entry;
+    rowEntries.Insert(rowId, indexedRow);
+}
+
+void Table::SecondaryIndex::Remove(unsigned rowId)
+{
+    IndexedRow indexedRow;
+    if (rowEntries.Delete(rowId, indexedRow) == false)
+        return;
+
+    IndexKey &key = indexedRow.key;
+    if (key.type == STRING && key.c == nullptr)
+        nullStringCount--;
+    else if (indexType == IT_ORDERED)
+        orderedKeys.Delete(key);
+    else
+    {
+        HashIndexEntry *entry = indexedRow.entry;
+        if (entry->previous)
+            entry->previous->next = entry->next;
+        else
+            buckets[entry->hash & (bucketCount - 1)] = entry->next;
+        if (entry->next)
+            entry->next->previous = entry->previous;
+        delete entry;
+        entryCount--;
+    }
+    free(key.c);
+}
+
+bool Table::SecondaryIndex::CanQuery(const FilterQuery &filter) const
+{
+    if (nullStringCount > 0)
+        return false;
+
+    // Like QueryRow(), this uses the fields of the filter cell even if it is empty
+    IndexKey key;
+    if (filter.cellValue == nullptr || GetIndexValue(filter.cellValue, columnType, &key) == false)
+        return false;
+
+    switch (filter.operation)
+    {
+        case QF_EQUAL:
+            return true;
+        case QF_GREATER_THAN:
+        case QF_GREATER_THAN_EQ:
+        case QF_LESS_THAN:
+        case QF_LESS_THAN_EQ:
+            return indexType == IT_ORDERED;
+        default:
+            return false;
+    }
+}
+
+bool Table::SecondaryIndex::Query(const FilterQuery &filter, unsigned maxRows, DataStructures::List<unsigned> &rowIds,
+                                  DataStructures::List<Row*> &rowList) const
+{
+    IndexKey key;
+    GetIndexValue(filter.cellValue, columnType, &key);
+
+    if (indexType == IT_HASH)
+    {
+        if (bucketCount == 0)
+            return true;
+        unsigned long hash = HashIndexValue(key);
+        for (HashIndexEntry *entry = buckets[hash & (bucketCount - 1)]; entry; entry = entry->next)
+        {
+            if (entry->hash != hash || CompareIndexValues(entry->key, key) != 0)
+                continue;
+            if (rowIds.Size() == maxRows)
+            {
+                rowIds.Clear(true);
+                rowList.Clear(true);
+                return false;
+            }
+            rowIds.Insert(entry->key.rowId);
+            rowList.Insert(entry->row);
+        }
+        return true;
+    }
+
+    // Start at the first row with the filter value for QF_EQUAL, QF_GREATER_THAN and QF_GREATER_THAN_EQ, and at the lowest value otherwise
+    DataStructures::Page<IndexKey, Row*, _TABLE_BPLUS_TREE_ORDER> *cur;
+    int index = 0;
+    if (filter.operation == QF_LESS_THAN || filter.operation == QF_LESS_THAN_EQ)
+        cur = orderedKeys.GetListHead();
+    else
+    {
+        key.rowId = 0;
+        cur = orderedKeys.GetLeafAtLowerBound(key, &index);
+    }
+
+    for (; cur != nullptr; cur = cur->next, index = 0)
+    {
+        for (; index < cur->size; index++)
+        {
+            int comparison = CompareIndexValues(cur->keys[index], key);
+            if ((filter.operation == QF_EQUAL && comparison != 0) ||
+                (filter.operation == QF_LESS_THAN && comparison >= 0) ||
+                (filter.operation == QF_LESS_THAN_EQ && comparison > 0))
+                return true;
+            if (filter.operation == QF_GREATER_THAN && comparison == 0)
+                continue;
+
+            if (rowIds.Size() == maxRows)
+            {
+                rowIds.Clear(true);
+                rowList.Clear(true);
+                return false;
+            }
+            rowIds.Insert(cur->keys[index].rowId);
+            rowList.Insert(cur->data[index]);
+        }
+    }
+    return true;
+}
+
+bool Table::AddIndex(unsigned columnIndex, IndexType indexType)
+{
+    if (columnIndex >= columns.Size() || (indexType == IT_ORDERED && columns[columnIndex].columnType == BINARY))
+        return false;
+
+    RemoveIndex(columnIndex);
+    SecondaryIndex *index = new SecondaryIndex(columnIndex, indexType, columns[columnIndex].columnType);
+    DataStructures::Page<unsigned, Row *, _TABLE_BPLUS_TREE_ORDER> *cur = rows.GetListHead();
+    while (cur != nullptr)
+    {
+        for (int i = 0; i < cur->size; i++)
+            index->Add(cur->keys[i], cur->data[i]);
+        cur = cur->next;
+    }
+    indexes.Insert(index);
+    return true;
+}
+
+void Table::RemoveIndex(unsigned columnIndex)
+{
+    for (unsigned i = 0; i < indexes.Size(); i++)
+    {
+        if (indexes[i]->columnIndex == columnIndex)
+        {
+            delete indexes[i];
+            indexes.RemoveAtIndexFast(i);
+            return;
+        }
+    }
+}
+
+bool Table::HasIndex(unsigned columnIndex) const
+{
+    return GetIndex(columnIndex) != nullptr;
+}
+
+void Table::UpdateIndexes(unsigned rowId)
+{
+    Row *row = GetRowByID(rowId);
+    RemoveFromIndexes(rowId);
+    if (row != nullptr)
+        AddToIndexes(rowId, row);
+}
+
+void Table::UpdateIndexes(unsigned rowId, unsigned columnIndex)
+{
+    Row *row = GetRowByID(rowId);
+    if (row != nullptr && columnIndex < columns.Size())
+        UpdateIndex(rowId, columnIndex, row);
+}
+
+Table::SecondaryIndex *Table::GetIndex(unsigned columnIndex) const
+{
+    for (unsigned i = 0; i < indexes.Size(); i++)
+    {
+        if (indexes[i]->columnIndex == columnIndex)
+            return indexes[i];
+    }
+    return nullptr;
+}
+
+Table::ColumnBlock *Table::FindColumnBlock(unsigned columnIndex) const
+{
+    for (unsigned i = 0; i < columnBlocks.Size(); i++)
+    {
+        if (columnBlocks[i]->columnIndex == columnIndex)
+            return columnBlocks[i];
+    }
+    return nullptr;
+}
+
+void Table::AddToIndexes(unsigned rowId, Row *row)
+{
+    for (unsigned i = 0; i < indexes.Size(); i++)
+        indexes[i]->Add(rowId, row);
+
+    if (columnBlocks.Size() == 0)
+        return;
+    columnBlockSlots.Insert(rowId, columnBlockRowIds.Size());
+    columnBlockRowIds.Insert(rowId);
+    columnBlockRows.Insert(row);
+    for (unsigned i = 0; i < columnBlocks.Size(); i++)
+        columnBlocks[i]->AddSlot(row->cells[columnBlocks[i]->columnIndex]);
+}
+
+void Table::RemoveFromIndexes(unsigned rowId)
+{
+    for (unsigned i = 0; i < indexes.Size(); i++)
+        indexes[i]->Remove(rowId);
+
+    unsigned slot;
+    if (columnBlocks.Size() == 0 || columnBlockSlots.Delete(rowId, slot) == false)
+        return;
+    // The last slot moves into the removed one
+    unsigned lastSlot = columnBlockRowIds.Size() - 1;
+    if (slot != lastSlot)
+    {
+        columnBlockSlots.Delete(columnBlockRowIds[lastSlot]);
+        columnBlockSlots.Insert(columnBlockRowIds[lastSlot], slot);
+    }
+    columnBlockRowIds.RemoveAtIndexFast(slot);
+    columnBlockRows.RemoveAtIndexFast(slot);
+    for (unsigned i = 0; i < columnBlocks.Size(); i++)
+        columnBlocks[i]->RemoveSlot(slot);
+}
+
+void Table::UpdateIndex(unsigned rowId, unsigned columnIndex, Row *row)
+{
+    SecondaryIndex *index = GetIndex(columnIndex);
+    if (index != nullptr)
+    {
+        index->Remove(rowId);
+        index->Add(rowId, row);
+    }
+
+    ColumnBlock *block = FindColumnBlock(columnIndex);
+    unsigned slot;
+    if (block != nullptr && columnBlockSlots.Get(rowId, slot))
+        block->SetSlot(slot, row->cells[columnIndex]);
+}
+
+void Table::RemoveAllIndexes()
+{
+    for (unsigned i = 0; i < indexes.Size(); i++)
+        delete indexes[i];
+    indexes.Clear(false);
+}
+
+void Table::RemoveAllColumnBlocks()
+{
+    for (unsigned i = 0; i < columnBlocks.Size(); i++)
+        delete columnBlocks[i];
+    columnBlocks.Clear(false);
+    columnBlockRowIds.Clear(false);
+    columnBlockRows.Clear(false);
+    columnBlockSlots.Clear();
+    columnBlockMask.Clear(false);
+}
+
+bool Table::QueryIndexes(DataStructures::List<unsigned> &inclusionFilterColumnIndices, FilterQuery *inclusionFilters,
+                         DataStructures::List<unsigned> &rowIds, DataStructures::List<Row*> &rowList) const
+{
+    // Look up every filter that has a usable index, keeping the smallest set of rows. Each lookup gives up as soon as it finds more rows than that
+    // Hash lookups go first, as they are the most likely to be small
+    bool found = false;
+    DataStructures::List<unsigned> candidateRowIds;
+    DataStructures::List<Row*> candidateRowList;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (unsigned j = 0; j < inclusionFilterColumnIndices.Size(); j++)
+        {
+            if (inclusionFilterColumnIndices[j] == (unsigned) -1)
+                continue;
+            SecondaryIndex *index = GetIndex(inclusionFilterColumnIndices[j]);
+            if (index == nullptr || (index->indexType == IT_HASH) != (pass == 0) || index->CanQuery(inclusionFilters[j]) == false)
+                continue;
+
+            unsigned maxRows = found ? rowIds.Size() : (unsigned) -1;
+            if (index->Query(inclusionFilters[j], maxRows, candidateRowIds, candidateRowList))
+            {
+                rowIds = candidateRowIds;
+                rowList = candidateRowList;
+                candidateRowIds.Clear(true);
+                candidateRowList.Clear(true);
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+namespace
+{
+    // Comparisons of Table::QueryRow() for NUMERIC cells, on one value and on two at a time
+    struct NumbersEqual
+    {
+        static bool Scalar(double a, double b) { return a == b; }
+#ifdef TABLE_COLUMN_BLOCK_SSE2
+        static __m128d Vector(__m128d a, __m128d b) { return _mm_cmpeq_pd(a, b); }
+#endif
+    };
+
+    struct NumbersNotEqual
+    {
+        static bool Scalar(double a, double b) { return a != b; }
+#ifdef TABLE_COLUMN_BLOCK_SSE2
+        static __m128d Vector(__m128d a, __m128d b) { return _mm_cmpneq_pd(a, b); }
+#endif
+    };
+
+    struct NumbersGreaterThan
+    {
+        static bool Scalar(double a, double b) { return a > b; }
+#ifdef TABLE_COLUMN_BLOCK_SSE2
+        static __m128d Vector(__m128d a, __m128d b) { return _mm_cmpgt_pd(a, b); }
+#endif
+    };
+
+    struct NumbersGreaterThanEq
+    {
+        static bool Scalar(double a, double b) { return a >= b; }
+#ifdef TABLE_COLUMN_BLOCK_SSE2
+        static __m128d Vector(__m128d a, __m128d b) { return _mm_cmpge_pd(a, b); }
+#endif
+    };
+
+    struct NumbersLessThan
+    {
+        static bool Scalar(double a, double b) { return a < b; }
+#ifdef TABLE_COLUMN_BLOCK_SSE2
+        static __m128d Vector(__m128d a, __m128d b) { return _mm_cmplt_pd(a, b); }
+#endif
+    };
+
+    struct NumbersLessThanEq
+    {
+        static bool Scalar(double a, double b) { return a <= b; }
+#ifdef TABLE_COLUMN_BLOCK_SSE2
+        static __m128d Vector(__m128d a, __m128d b) { return _mm_cmple_pd(a, b); }
+#endif
+    };
+
+    // Clears mask[i] unless the cell in slot i is not empty and passes Compare against value
+    template <class Compare>
+    void FilterNumbers(const double *numbers, const unsigned char *nonEmpty, unsigned count, double value, unsigned char *mask)
+    {
+        unsigned i = 0;
+#ifdef TABLE_COLUMN_BLOCK_SSE2
+        const __m128d filterValue = _mm_set1_pd(value);
+        for (; i + 4 <= count; i += 4)
+        {
+            int bits = _mm_movemask_pd(Compare::Vector(_mm_loadu_pd(numbers + i), filterValue)) |
+                       (_mm_movemask_pd(Compare::Vector(_mm_loadu_pd(numbers + i + 2), filterValue)) << 2);
+            mask[i] &= nonEmpty[i] & bits;
+            mask[i + 1] &= nonEmpty[i + 1] & (bits >> 1);
+            mask[i + 2] &= nonEmpty[i + 2] & (bits >> 2);
+            mask[i + 3] &= nonEmpty[i + 3] & (bits >> 3);
+        }
+#endif
+        for (; i < count; i++)
+            mask[i] &= nonEmpty[i] & (Compare::Scalar(numbers[i], value) ? 1 : 0);
+    }
+
+    bool CanFilterColumnBlock(const Table::ColumnBlock *block, const Table::FilterQuery &filter)
+    {
+        if (block->columnType == Table::NUMERIC)
+        {
+            if (filter.operation == Table::QF_IS_EMPTY || filter.operation == Table::QF_NOT_EMPTY)
+                return true;
+            return filter.cellValue != nullptr && filter.operation <= Table::QF_LESS_THAN_EQ;
+        }
+
+        // QueryRow() skips STRING filters without a string, so they cannot remove any rows
+        return (filter.operation == Table::QF_EQUAL || filter.operation == Table::QF_NOT_EQUAL) &&
+               filter.cellValue != nullptr && filter.cellValue->c != nullptr;
+    }
+
+    // Clears mask[i] for the slots whose cell cannot pass filter. Matches Table::QueryRow()
+    void FilterColumnBlock(const Table::ColumnBlock *block, const Table::FilterQuery &filter, unsigned char *mask)
+    {
+        const unsigned count = block->nonEmpty.Size();
+        const unsigned char *nonEmpty = &block->nonEmpty[0];
+        if (block->columnType == Table::NUMERIC)
+        {
+            const double *numbers = &block->numbers[0];
+            switch (filter.operation)
+            {
+                case Table::QF_EQUAL:
+                    FilterNumbers<NumbersEqual>(numbers, nonEmpty, count, filter.cellValue->i, mask);
+                    break;
+                case Table::QF_NOT_EQUAL:
+                    FilterNumbers<NumbersNotEqual>(numbers, nonEmpty, count, filter.cellValue->i, mask);
+                    break;
+                case Table::QF_GREATER_THAN:
+                    FilterNumbers<NumbersGreaterThan>(numbers, nonEmpty, count, filter.cellValue->i, mask);
+                    break;
+                case Table::QF_GREATER_THAN_EQ:
+                    FilterNumbers<NumbersGreaterThanEq>(numbers, nonEmpty, count, filter.cellValue->i, mask);
+                    break;
+                case Table::QF_LESS_THAN:
+                    FilterNumbers<NumbersLessThan>(numbers, nonEmpty, count, filter.cellValue->i, mask);
+                    break;
+                case Table::QF_LESS_THAN_EQ:
+                    FilterNumbers<NumbersLessThanEq>(numbers, nonEmpty, count, filter.cellValue->i, mask);
+                    break;
+                case Table::QF_IS_EMPTY:
+                    for (unsigned i = 0; i < count; i++)
+                        mask[i] &= nonEmpty[i] ^ 1;
+                    break;
+                case Table::QF_NOT_EMPTY:
+                    for (unsigned i = 0; i < count; i++)
+                        mask[i] &= nonEmpty[i];
+                    break;
+            }
+            return;
+        }
+
+        const char *value = filter.cellValue->c;
+        const unsigned length = (unsigned) strlen(value);
+        const unsigned char wantEqual = filter.operation == Table::QF_EQUAL ? 1 : 0;
+        for (unsigned i = 0; i < count; i++)
+        {
+            if (mask[i] == 0)
+                continue;
+            if (nonEmpty[i] == 0)
+                mask[i] = 0;
+            // A null pointer is kept, since QueryRow() skips the filter for it
+            else if (block->stringOffsets[i] != (unsigned) -1)
+            {
+                bool equal = block->stringLengths[i] == length && memcmp(block->arena + block->stringOffsets[i], value, length) == 0;
+                mask[i] = (equal ? 1 : 0) == wantEqual;
+            }
+        }
+    }
+}
+
+Table::ColumnBlock::ColumnBlock(unsigned _columnIndex, ColumnType _columnType)
+{
+    columnIndex = _columnIndex;
+    columnType = _columnType;
+    arena = nullptr;
+    arenaUsed = 0;
+    arenaAllocated = 0;
+    arenaUnused = 0;
+}
+
+Table::ColumnBlock::~ColumnBlock()
+{
+    free(arena);
+}
+
+const char *Table::ColumnBlock::GetString(unsigned slot) const
+{
+    if (columnType != STRING || stringOffsets[slot] == (unsigned) -1)
+        return nullptr;
+    return arena + stringOffsets[slot];
+}
+
+void Table::ColumnBlock::AddSlot(const Cell *cell)
+{
+    nonEmpty.Insert(0);
+    if (columnType == NUMERIC)
+        numbers.Insert(0.0);
+    else
+    {
+        stringOffsets.Insert((unsigned) -1);
+        stringLengths.Insert(0);
+    }
+    SetSlot(nonEmpty.Size() - 1, cell);
+}
+
+void Table::ColumnBlock::SetSlot(unsigned slot, const Cell *cell)
+{
+    nonEmpty[slot] = cell->isEmpty ? 0 : 1;
+    if (columnType == NUMERIC)
+    {
+        numbers[slot] = cell->isEmpty ? 0.0 : cell->i;
+        return;
+    }
+
+    if (stringOffsets[slot] != (unsigned) -1)
+        arenaUnused += stringLengths[slot] + 1;
+    stringOffsets[slot] = (unsigned) -1;
+    stringLengths[slot] = 0;
+    if (cell->isEmpty || cell->c == nullptr)
+        return;
+
+    unsigned length = (unsigned) strlen(cell->c);
+    if (arenaUsed + length + 1 > arenaAllocated && arenaUnused > 0 && arenaUnused >= arenaUsed / 2)
+        CompactArena();
+    if (arenaUsed + length + 1 > arenaAllocated)
+    {
+        unsigned newSize = arenaAllocated == 0 ? 4096 : arenaAllocated * 2;
+        while (newSize < arenaUsed + length + 1)
+            newSize *= 2;
+        arena = (char *) realloc(arena, newSize);
+        RakAssert(arena);
+        arenaAllocated = newSize;
+    }
+    memcpy(arena + arenaUsed, cell->c, length + 1);
+    stringOffsets[slot] = arenaUsed;
+    stringLengths[slot] = length;
+    arenaUsed += length + 1;
+}
+
+void Table::ColumnBlock::RemoveSlot(unsigned slot)
+{
+    nonEmpty.RemoveAtIndexFast(slot);
+    if (columnType == NUMERIC)
+    {
+        numbers.RemoveAtIndexFast(slot);
+        return;
+    }
+
+    if (stringOffsets[slot] != (unsigned) -1)
+        arenaUnused += stringLengths[slot] + 1;
+    stringOffsets.RemoveAtIndexFast(slot);
+    stringLengths.RemoveAtIndexFast(slot);
+    if (stringOffsets.Size() == 0)
+    {
+        arenaUsed = 0;
+        arenaUnused = 0;
+    }
+}
+
+void Table::ColumnBlock::CompactArena()
+{
+    char *compacted = (char *) malloc(arenaAllocated);
+    RakAssert(compacted);
+    unsigned used = 0;
+    for (unsigned i = 0; i < stringOffsets.Size(); i++)
+    {
+        if (stringOffsets[i] == (unsigned) -1)
+            continue;
+        memcpy(compacted + used, arena + stringOffsets[i], stringLengths[i] + 1);
+        stringOffsets[i] = used;
+        used += stringLengths[i] + 1;
+    }
+    free(arena);
+    arena = compacted;
+    arenaUsed = used;
+    arenaUnused = 0;
+}
+
+bool Table::AddColumnBlock(unsigned columnIndex)
+{
+    if (columnIndex >= columns.Size() || (columns[columnIndex].columnType != NUMERIC && columns[columnIndex].columnType != STRING))
+        return false;
+
+    RemoveColumnBlock(columnIndex);
+    if (columnBlocks.Size() == 0)
+    {
+        // First column block, so give every row a slot
+        DataStructures::Page<unsigned, Row *, _TABLE_BPLUS_TREE_ORDER> *cur = rows.GetListHead();
+        while (cur != nullptr)
+        {
+            for (int i = 0; i < cur->size; i++)
+            {
+                columnBlockSlots.Insert(cur->keys[i], columnBlockRowIds.Size());
+                columnBlockRowIds.Insert(cur->keys[i]);
+                columnBlockRows.Insert(cur->data[i]);
+            }
+            cur = cur->next;
+        }
+    }
+
+    ColumnBlock *block = new ColumnBlock(columnIndex, columns[columnIndex].columnType);
+    block->nonEmpty.Preallocate(columnBlockRows.Size());
+    for (unsigned slot = 0; slot < columnBlockRows.Size(); slot++)
+        block->AddSlot(columnBlockRows[slot]->cells[columnIndex]);
+    columnBlocks.Insert(block);
+    return true;
+}
+
+void Table::RemoveColumnBlock(unsigned columnIndex)
+{
+    for (unsigned i = 0; i < columnBlocks.Size(); i++)
+    {
+        if (columnBlocks[i]->columnIndex == columnIndex)
+        {
+            delete columnBlocks[i];
+            columnBlocks.RemoveAtIndexFast(i);
+            if (columnBlocks.Size() == 0)
+                RemoveAllColumnBlocks();
+            return;
+        }
+    }
+}
+
+const Table::ColumnBlock *Table::GetColumnBlock(unsigned columnIndex) const
+{
+    return FindColumnBlock(columnIndex);
+}
+
+const DataStructures::List<unsigned> &Table::GetColumnBlockRowIds() const
+{
+    return columnBlockRowIds;
+}
+
+bool Table::QueryColumnBlocks(DataStructures::List<unsigned> &inclusionFilterColumnIndices, FilterQuery *inclusionFilters)
+{
+    const unsigned slotCount = columnBlockRowIds.Size();
+    bool found = false;
+    for (unsigned j = 0; j < inclusionFilterColumnIndices.Size(); j++)
+    {
+        if (inclusionFilterColumnIndices[j] == (unsigned) -1)
+            continue;
+        ColumnBlock *block = FindColumnBlock(inclusionFilterColumnIndices[j]);
+        if (block == nullptr || CanFilterColumnBlock(block, inclusionFilters[j]) == false)
+            continue;
+        if (slotCount == 0)
+            return true;
+
+        if (found == false)
+        {
+            // The mask is kept between queries, since allocating one the size of the table each time costs more than filtering it
+            while (columnBlockMask.Size() < slotCount)
+                columnBlockMask.Insert(0);
+            memset(&columnBlockMask[0], 1, slotCount);
+            found = true;
+        }
+        FilterColumnBlock(block, inclusionFilters[j], &columnBlockMask[0]);
+    }
+    return found;
+}
+
 Table::Cell::Cell()
 {
     isEmpty = true;
@@ -308,6 +1197,20 @@ void Table::RemoveColumn(unsigned columnIndex)
 
     columns.RemoveAtIndex(columnIndex);
 
+    // Drop the index and column block on this column, and renumber the ones after it
+    RemoveIndex(columnIndex);
+    for (unsigned i = 0; i < indexes.Size(); i++)
+    {
+        if (indexes[i]->columnIndex > columnIndex)
+            indexes[i]->columnIndex--;
+    }
+    RemoveColumnBlock(columnIndex);
+    for (unsigned i = 0; i < columnBlocks.Size(); i++)
+    {
+        if (columnBlocks[i]->columnIndex > columnIndex)
+            columnBlocks[i]->columnIndex--;
+    }
+
     // Remove this index from each row.
     DataStructures::Page<unsigned, Row *, _TABLE_BPLUS_TREE_ORDER> *cur = rows.GetListHead();
     while (cur != nullptr)
@@ -372,6 +1275,7 @@ Table::Row *Table::AddRow(unsigned rowId)
 
     for (unsigned rowIndex = 0; rowIndex < columns.Size(); rowIndex++)
         newRow->cells.Insert(new Table::Cell);
+    AddToIndexes(rowId, newRow);
     return newRow;
 }
 
@@ -390,7 +1294,8 @@ Table::Row *Table::AddRow(unsigned rowId, DataStructures::List<Cell> &initialCel
         else
             newRow->cells.Insert(new Table::Cell);
     }
-    rows.Insert(rowId, newRow);
+    if (rows.Insert(rowId, newRow))
+        AddToIndexes(rowId, newRow);
     return newRow;
 }
 
@@ -415,11 +1320,12 @@ Table::Row *Table::AddRow(unsigned rowId, DataStructures::List<Cell *> &initialC
         else
             newRow->cells.Insert(new Table::Cell);
     }
-    rows.Insert(rowId, newRow);
+    if (rows.Insert(rowId, newRow))
+        AddToIndexes(rowId, newRow);
     return newRow;
 }
 
-Table::Row *Table::AddRowColumns(unsigned rowId, Row *row, DataStructures::List<unsigned> columnIndices)
+Table::Row *Table::AddRowColumns(unsigned rowId, Row *row, const DataStructures::List<unsigned> &columnIndices)
 {
     Row *newRow = new Row;
     for (unsigned columnIndex = 0; columnIndex < columnIndices.Size(); columnIndex++)
@@ -433,7 +1339,8 @@ Table::Row *Table::AddRowColumns(unsigned rowId, Row *row, DataStructures::List<
         else
             newRow->cells.Insert(new Table::Cell);
     }
-    rows.Insert(rowId, newRow);
+    if (rows.Insert(rowId, newRow))
+        AddToIndexes(rowId, newRow);
     return newRow;
 }
 
@@ -442,6 +1349,7 @@ bool Table::RemoveRow(unsigned rowId)
     Row *out;
     if (rows.Delete(rowId, out))
     {
+        RemoveFromIndexes(rowId);
         DeleteRow(out);
         return true;
     }
@@ -454,7 +1362,10 @@ void Table::RemoveRows(Table *tableContainingRowIDs)
     while (cur != nullptr)
     {
         for (unsigned i = 0; i < (unsigned) cur->size; i++)
-            rows.Delete(cur->keys[i]);
+        {
+            if (rows.Delete(cur->keys[i]))
+                RemoveFromIndexes(cur->keys[i]);
+        }
         cur = cur->next;
     }
     return;
@@ -468,6 +1379,7 @@ bool Table::UpdateCell(unsigned rowId, unsigned columnIndex, int value)
     if (row != nullptr)
     {
         row->UpdateCell(columnIndex, value);
+        UpdateIndex(rowId, columnIndex, row);
         return true;
     }
     return false;
@@ -481,6 +1393,7 @@ bool Table::UpdateCell(unsigned rowId, unsigned columnIndex, char *str)
     if (row != nullptr)
     {
         row->UpdateCell(columnIndex, str);
+        UpdateIndex(rowId, columnIndex, row);
         return true;
     }
     return false;
@@ -494,6 +1407,7 @@ bool Table::UpdateCell(unsigned rowId, unsigned columnIndex, int byteLength, cha
     if (row != nullptr)
     {
         row->UpdateCell(columnIndex, byteLength, data);
+        UpdateIndex(rowId, columnIndex, row);
         return true;
     }
     return false;
@@ -503,10 +1417,12 @@ bool Table::UpdateCellByIndex(unsigned rowIndex, unsigned columnIndex, int value
 {
     RakAssert(columns[columnIndex].columnType == NUMERIC);
 
-    Row *row = GetRowByIndex(rowIndex, 0);
+    unsigned rowId;
+    Row *row = GetRowByIndex(rowIndex, &rowId);
     if (row != nullptr)
     {
         row->UpdateCell(columnIndex, value);
+        UpdateIndex(rowId, columnIndex, row);
         return true;
     }
     return false;
@@ -516,10 +1432,12 @@ bool Table::UpdateCellByIndex(unsigned rowIndex, unsigned columnIndex, char *str
 {
     RakAssert(columns[columnIndex].columnType == STRING);
 
-    Row *row = GetRowByIndex(rowIndex, 0);
+    unsigned rowId;
+    Row *row = GetRowByIndex(rowIndex, &rowId);
     if (row != nullptr)
     {
         row->UpdateCell(columnIndex, str);
+        UpdateIndex(rowId, columnIndex, row);
         return true;
     }
     return false;
@@ -529,10 +1447,12 @@ bool Table::UpdateCellByIndex(unsigned rowIndex, unsigned columnIndex, int byteL
 {
     RakAssert(columns[columnIndex].columnType == BINARY);
 
-    Row *row = GetRowByIndex(rowIndex, 0);
+    unsigned rowId;
+    Row *row = GetRowByIndex(rowIndex, &rowId);
     if (row)
     {
         row->UpdateCell(columnIndex, byteLength, data);
+        UpdateIndex(rowId, columnIndex, row);
         return true;
     }
     return false;
@@ -660,7 +1580,35 @@ void Table::QueryTable(unsigned *columnIndicesSubset, unsigned numColumnSubset,
         }
     }
 
-    if (rowIds == nullptr || numRowIDs == 0)
+    DataStructures::List<unsigned> indexedRowIds;
+    DataStructures::List<Row *> indexedRows;
+    if ((rowIds == nullptr || numRowIDs == 0) &&
+        QueryIndexes(inclusionFilterColumnIndices, inclusionFilters, indexedRowIds, indexedRows))
+    {
+        // Only the rows an index returned for one of the filters
+        for (unsigned i = 0; i < indexedRowIds.Size(); i++)
+            QueryRow(inclusionFilterColumnIndices, columnIndicesToReturn, indexedRowIds[i], indexedRows[i], inclusionFilters, result);
+    }
+    else if ((rowIds == nullptr || numRowIDs == 0) && QueryColumnBlocks(inclusionFilterColumnIndices, inclusionFilters))
+    {
+        // Only the rows that passed the filters on column blocks
+        const unsigned slotCount = columnBlockRowIds.Size();
+        unsigned slot = 0;
+        while (slot < slotCount)
+        {
+            // Skip eight slots at a time while none of them passed
+            uint64_t eightSlots;
+            if (slot + 8 <= slotCount && (memcpy(&eightSlots, &columnBlockMask[slot], 8), eightSlots == 0))
+            {
+                slot += 8;
+                continue;
+            }
+            if (columnBlockMask[slot])
+                QueryRow(inclusionFilterColumnIndices, columnIndicesToReturn, columnBlockRowIds[slot], columnBlockRows[slot], inclusionFilters, result);
+            slot++;
+        }
+    }
+    else if (rowIds == nullptr || numRowIDs == 0)
     {
         // All rows
         DataStructures::Page<unsigned, Row *, _TABLE_BPLUS_TREE_ORDER> *cur = rows.GetListHead();
@@ -1074,6 +2022,8 @@ void Table::PrintRow(char *out, int outLength, char columnDelineator, bool print
 
 void Table::Clear()
 {
+    RemoveAllIndexes();
+    RemoveAllColumnBlocks();
     rows.ForEachData(FreeRow);
     rows.Clear();
     columns.Clear(true);
@@ -13,6 +13,7 @@
 ///
 
 
+#include <cstring>
 #include "NetworkIDManager.h"
 #include "NetworkIDObject.h"
 #include "RakAssert.h"
@@ -28,28 +29,42 @@ STATIC_FACTORY_DEFINITIONS(NetworkIDManager, NetworkIDManager)
 NetworkIDManager::NetworkIDManager()
 {
     startingOffset = RakPeerInterface::Get64BitUniqueRandomNumber();
+    networkIdHash = nullptr;
+    networkIdHashLength = 0;
     Clear();
 }
 
 NetworkIDManager::~NetworkIDManager()
 {
-
+    delete[] networkIdHash;
 }
 
 void NetworkIDManager::Clear()
 {
-    memset(networkIdHash, 0, sizeof(networkIdHash));
+    if (networkIdHashLength != NETWORK_ID_MANAGER_HASH_LENGTH)
+    {
+        delete[] networkIdHash;
+        networkIdHash = new NetworkIDSlot[NETWORK_ID_MANAGER_HASH_LENGTH];
+        networkIdHashLength = NETWORK_ID_MANAGER_HASH_LENGTH;
+        networkIdHashMask = NETWORK_ID_MANAGER_HASH_LENGTH - 1;
+    }
+    memset(networkIdHash, 0, sizeof(NetworkIDSlot) * networkIdHashLength);
+    networkIdCount = 0;
+}
+
+unsigned int NetworkIDManager::GetNetworkIDObjectCount() const
+{
+    return networkIdCount;
 }
 
 NetworkIDObject *NetworkIDManager::GET_BASE_OBJECT_FROM_ID(NetworkID x)
 {
     unsigned int hashIndex = NetworkIDToHashIndex(x);
-    NetworkIDObject *nio = networkIdHash[hashIndex];
-    while (nio != nullptr)
+    while (networkIdHash[hashIndex].object != nullptr)
     {
-        if (nio->GetNetworkID() == x)
-            return nio;
-        nio = nio->nextInstanceForNetworkIDManager;
+        if (networkIdHash[hashIndex].networkId == x)
+            return networkIdHash[hashIndex].object;
+        hashIndex = (hashIndex + 1) & networkIdHashMask;
     }
     return nullptr;
 }
@@ -62,10 +77,34 @@ NetworkID NetworkIDManager::GetNewNetworkID()
     return startingOffset;
 }
 
-unsigned int NetworkIDManager::NetworkIDToHashIndex(NetworkID networkId)
+unsigned int NetworkIDManager::NetworkIDToHashIndex(NetworkID networkId) const
 {
-//    return SuperFastHash((const char*) &networkId.guid.g,sizeof(networkId.guid.g)) % NETWORK_ID_MANAGER_HASH_LENGTH;
-    return (unsigned int) (networkId % NETWORK_ID_MANAGER_HASH_LENGTH);
+    // Authorities hand out consecutive IDs, so mix the bits before masking to keep probe sequences short
+    uint64_t hash = networkId * 0x9E3779B97F4A7C15ULL;
+    return (unsigned int) (hash >> 32) & networkIdHashMask;
+}
+
+void NetworkIDManager::ResizeNetworkIDHash(unsigned int newLength)
+{
+    NetworkIDSlot *oldHash = networkIdHash;
+    unsigned int oldLength = networkIdHashLength;
+
+    networkIdHash = new NetworkIDSlot[newLength];
+    memset(networkIdHash, 0, sizeof(NetworkIDSlot) * newLength);
+    networkIdHashLength = newLength;
+    networkIdHashMask = newLength - 1;
+
+    for (unsigned int i = 0; i < oldLength; i++)
+    {
+        if (oldHash[i].object == nullptr)
+            continue;
+        unsigned int hashIndex = NetworkIDToHashIndex(oldHash[i].networkId);
+        while (networkIdHash[hashIndex].object != nullptr)
+            hashIndex = (hashIndex + 1) & networkIdHashMask;
+        networkIdHash[hashIndex] = oldHash[i];
+    }
+
+    delete[] oldHash;
 }
 
 void NetworkIDManager::TrackNetworkIDObject(NetworkIDObject *networkIdObject)
@@ -74,32 +113,24 @@ void NetworkIDManager::TrackNetworkIDObject(NetworkIDObject *networkIdObject)
     NetworkID rawId = networkIdObject->GetNetworkID();
     RakAssert(rawId != UNASSIGNED_NETWORK_ID);
 
-    networkIdObject->nextInstanceForNetworkIDManager = nullptr;
+    // Keep the load factor at or below 3/4
+    if ((networkIdCount + 1) * 4 > networkIdHashLength * 3)
+        ResizeNetworkIDHash(networkIdHashLength * 2);
 
     unsigned int hashIndex = NetworkIDToHashIndex(rawId);
-//    printf("TrackNetworkIDObject hashIndex=%i guid=%s\n",hashIndex, networkIdObject->GetNetworkID().guid.ToString()); // removeme
-    if (networkIdHash[hashIndex] == nullptr)
-    {
-        networkIdHash[hashIndex] = networkIdObject;
-        return;
-    }
-    NetworkIDObject *nio = networkIdHash[hashIndex];
-    // Duplicate insertion?
-    RakAssert(nio != networkIdObject);
-    // Random GUID conflict?
-    RakAssert(nio->GetNetworkID() != rawId);
-
-    while (nio->nextInstanceForNetworkIDManager != nullptr)
+    while (networkIdHash[hashIndex].object != nullptr)
     {
-        nio = nio->nextInstanceForNetworkIDManager;
-
         // Duplicate insertion?
-        RakAssert(nio != networkIdObject);
+        RakAssert(networkIdHash[hashIndex].object != networkIdObject);
         // Random GUID conflict?
-        RakAssert(nio->GetNetworkID() != rawId);
+        RakAssert(networkIdHash[hashIndex].networkId != rawId);
+
+        hashIndex = (hashIndex + 1) & networkIdHashMask;
     }
 
-    nio->nextInstanceForNetworkIDManager = networkIdObject;
+    networkIdHash[hashIndex].networkId = rawId;
+    networkIdHash[hashIndex].object = networkIdObject;
+    networkIdCount++;
 }
 
 void NetworkIDManager::StopTrackingNetworkIDObject(NetworkIDObject *networkIdObject)
@@ -108,30 +139,31 @@ void NetworkIDManager::StopTrackingNetworkIDObject(NetworkIDObject *networkIdObj
     NetworkID rawId = networkIdObject->GetNetworkID();
     RakAssert(rawId != UNASSIGNED_NETWORK_ID);
 
-    // RakAssert(networkIdObject->GetNetworkID()!=UNASSIGNED_NETWORK_ID);
     unsigned int hashIndex = NetworkIDToHashIndex(rawId);
-//    printf("hashIndex=%i\n",hashIndex); // removeme
-    NetworkIDObject *nio = networkIdHash[hashIndex];
-    if (nio == nullptr)
+    while (networkIdHash[hashIndex].object != networkIdObject)
     {
-        RakAssert("NetworkIDManager::StopTrackingNetworkIDObject didn't find object" && 0);
-        return;
-    }
-    if (nio == networkIdObject)
-    {
-        networkIdHash[hashIndex] = nio->nextInstanceForNetworkIDManager;
-        return;
+        if (networkIdHash[hashIndex].object == nullptr)
+        {
+            RakAssert("NetworkIDManager::StopTrackingNetworkIDObject didn't find object" && 0);
+            return;
+        }
+        hashIndex = (hashIndex + 1) & networkIdHashMask;
     }
 
-    while (nio != nullptr)
+    // Shift later entries of the same probe sequence back into the hole, so lookups never need tombstones
+    unsigned int holeIndex = hashIndex;
+    unsigned int nextIndex = (holeIndex + 1) & networkIdHashMask;
+    while (networkIdHash[nextIndex].object != nullptr)
     {
-        if (nio->nextInstanceForNetworkIDManager == networkIdObject)
+        unsigned int homeIndex = NetworkIDToHashIndex(networkIdHash[nextIndex].networkId);
+        // Move the entry unless its home slot lies cyclically in (holeIndex, nextIndex]
+        if (((nextIndex - homeIndex) & networkIdHashMask) >= ((nextIndex - holeIndex) & networkIdHashMask))
         {
-            nio->nextInstanceForNetworkIDManager = networkIdObject->nextInstanceForNetworkIDManager;
-            return;
+            networkIdHash[holeIndex] = networkIdHash[nextIndex];
+            holeIndex = nextIndex;
         }
-        nio = nio->nextInstanceForNetworkIDManager;
+        nextIndex = (nextIndex + 1) & networkIdHashMask;
     }
-
-    RakAssert("NetworkIDManager::StopTrackingNetworkIDObject didn't find object" && 0);
+    networkIdHash[holeIndex].object = nullptr;
+    networkIdCount--;
 }
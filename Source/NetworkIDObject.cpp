@@ -25,7 +25,6 @@ NetworkIDObject::NetworkIDObject()
     networkID = UNASSIGNED_NETWORK_ID;
     parent = nullptr;
     networkIDManager = nullptr;
-    nextInstanceForNetworkIDManager = nullptr;
 }
 
 NetworkIDObject::~NetworkIDObject()
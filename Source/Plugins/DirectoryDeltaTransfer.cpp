@@ -22,6 +22,7 @@
 #include "MessageIdentifiers.h"
 #include "FileOperations.h"
 #include "IncrementalReadInterface.h"
+#include "../Utils/LinuxStrings.h"
 
 using namespace RakNet;
 
@@ -86,6 +87,9 @@ DirectoryDeltaTransfer::DirectoryDeltaTransfer()
     orderingChannel = 0;
     incrementalReadInterface = 0;
     chunkSize = 0;
+    chunkDownloadRequests = false;
+    manifestCache = 0;
+    hashThreadCount = 0;
 }
 DirectoryDeltaTransfer::~DirectoryDeltaTransfer()
 {
@@ -134,8 +138,18 @@ void DirectoryDeltaTransfer::SetUploadSendParameters(PacketPriority _priority, c
     priority=_priority;
     orderingChannel=_orderingChannel;
 }
+void DirectoryDeltaTransfer::SetHashOptions(FileManifestCache *_manifestCache, int _hashThreadCount)
+{
+    manifestCache=_manifestCache;
+    hashThreadCount=_hashThreadCount;
+}
+const FileList::AddFilesStatistics& DirectoryDeltaTransfer::GetUploadsStatistics(void) const
+{
+    return availableUploads->GetAddFilesStatistics();
+}
 void DirectoryDeltaTransfer::AddUploadsFromSubdirectory(const char *subdir)
 {
+    availableUploads->SetHashOptions(manifestCache, hashThreadCount);
     availableUploads->AddFilesFromDirectory(applicationDirectory, subdir, true, false, true, FileListNodeContext(0,0,0,0));
 }
 unsigned short DirectoryDeltaTransfer::DownloadFromSubdirectory(FileList &localFiles, const char *subdir, const char *outputSubdir, bool prependAppDirToOutputSubdir, SystemAddress host, FileListTransferCBInterface *onFileCallback, PacketPriority _priority, char _orderingChannel, FileListProgress *cb)
@@ -169,6 +183,31 @@ unsigned short DirectoryDeltaTransfer::DownloadFromSubdirectory(FileList &localF
     // Setup the transfer plugin to get the response to this download request
     unsigned short setId = fileListTransfer->SetupReceive(transferCallback, true, host);
 
+    // In case the host uses SendChunked(). Local files are named as the host names them, which is subdir rather than outputSubdir
+    FileList basis;
+    unsigned int outputSubdirLen = outputSubdir ? (unsigned int) strlen(outputSubdir) : 0;
+    if (outputSubdirLen > 0 && outputSubdir[outputSubdirLen-1]!='/' && outputSubdir[outputSubdirLen-1]!='\\')
+        outputSubdirLen++;
+    RakNet::RakString subdirPrefix(subdir ? subdir : "");
+    if (subdirPrefix.IsEmpty()==false && subdirPrefix.C_String()[subdirPrefix.GetLength()-1]!='/' && subdirPrefix.C_String()[subdirPrefix.GetLength()-1]!='\\')
+        subdirPrefix+="/";
+    for (unsigned int i=0; i < localFiles.fileList.Size(); i++)
+    {
+        const FileListNode &node = localFiles.fileList[i];
+        if (node.filename.GetLength() <= outputSubdirLen || (outputSubdirLen > 0 && _strnicmp(node.filename.C_String(), outputSubdir, strlen(outputSubdir))!=0))
+            continue;
+        // Not AddFile(), which checks every file already added for the same name
+        FileListNode basisNode;
+        basisNode.filename = subdirPrefix + (node.filename.C_String() + outputSubdirLen);
+        basisNode.fullPathToFile = node.fullPathToFile;
+        basisNode.data = 0;
+        basisNode.dataLengthBytes = 0;
+        basisNode.fileLengthBytes = node.fileLengthBytes;
+        basisNode.isAReference = true;
+        basis.fileList.Insert(basisNode);
+    }
+    fileListTransfer->SetReceiveBasis(setId, basis);
+
     // Send to the host, telling it to process this request
     RakNet::BitStream outBitstream;
     outBitstream.Write((MessageID)ID_DDT_DOWNLOAD_REQUEST);
@@ -184,11 +223,13 @@ unsigned short DirectoryDeltaTransfer::DownloadFromSubdirectory(const char *subd
 {
     FileList localFiles;
     // Get a hash of all the files that we already have (if any)
+    localFiles.SetHashOptions(manifestCache, hashThreadCount);
     localFiles.AddFilesFromDirectory(prependAppDirToOutputSubdir ? applicationDirectory : 0, outputSubdir, true, false, true, FileListNodeContext(0,0,0,0));
     return DownloadFromSubdirectory(localFiles, subdir, outputSubdir, prependAppDirToOutputSubdir, host, onFileCallback, _priority, _orderingChannel, cb);
 }
 void DirectoryDeltaTransfer::GenerateHashes(FileList &localFiles, const char *outputSubdir, bool prependAppDirToOutputSubdir)
 {
+    localFiles.SetHashOptions(manifestCache, hashThreadCount);
     localFiles.AddFilesFromDirectory(prependAppDirToOutputSubdir ? applicationDirectory : 0, outputSubdir, true, false, true, FileListNodeContext(0,0,0,0));
 }
 void DirectoryDeltaTransfer::ClearUploads(void)
@@ -222,7 +263,10 @@ void DirectoryDeltaTransfer::OnDownloadRequest(Packet *packet)
         delta.FlagFilesAsReferences();
 
     // This will call the ddtCallback interface that was passed to FileListTransfer::SetupReceive on the remote system
-    fileListTransfer->Send(&delta, rakPeerInterface, packet->systemAddress, setId, priority, orderingChannel, incrementalReadInterface, chunkSize);
+    if (chunkDownloadRequests)
+        fileListTransfer->SendChunked(&delta, rakPeerInterface, packet->systemAddress, setId, priority, orderingChannel, incrementalReadInterface, chunkSize);
+    else
+        fileListTransfer->Send(&delta, rakPeerInterface, packet->systemAddress, setId, priority, orderingChannel, incrementalReadInterface, chunkSize);
 }
 PluginReceiveResult DirectoryDeltaTransfer::OnReceive(Packet *packet)
 {
@@ -247,6 +291,11 @@ void DirectoryDeltaTransfer::SetDownloadRequestIncrementalReadInterface(Incremen
     chunkSize=_chunkSize;
 }
 
+void DirectoryDeltaTransfer::SetDownloadRequestChunking(bool enabled)
+{
+    chunkDownloadRequests=enabled;
+}
+
 #ifdef _MSC_VER
 #pragma warning( pop )
 #endif
@@ -38,6 +38,11 @@
 #include "BitStream.h"
 #include "FileOperations.h"
 #include "SuperFastHash.h"
+#include "FileManifestCache.h"
+#include "ThreadPool.h"
+#include "SignaledEvent.h"
+#include "SimpleMutex.h"
+#include "GetTime.h"
 #include "RakAssert.h"
 #include "../Utils/LinuxStrings.h"
 
@@ -74,6 +79,108 @@ STATIC_FACTORY_DEFINITIONS(FileListProgress, FileListProgress)
 STATIC_FACTORY_DEFINITIONS(FLP_Printf, FLP_Printf)
 STATIC_FACTORY_DEFINITIONS(FileList, FileList)
 
+namespace
+{
+// Files of HashFiles() not yet hashed. hashesDone is set when the last one is
+struct FileHashPass
+{
+    SimpleMutex mutex;
+    unsigned int hashesRemaining;
+    SignaledEvent hashesDone;
+};
+
+// A file found by AddFilesFromDirectory() when adding hashes only, added once every hash is known
+struct FileHashJob
+{
+    RakString fullPath;
+    // Length of the application directory at the start of fullPath, which is not part of the filename
+    unsigned int rootLen;
+    unsigned int fileLength;
+    // Set if the file was found by FileManifestCache::GetFileInfo(), so the hash can be recorded in the manifest cache
+    bool hasFileInfo;
+    uint64_t size;
+    int64_t modificationTime;
+    bool needsHash;
+    uint32_t hash;
+    FileHashPass *pass;
+};
+
+void HashFile(FileHashJob *job)
+{
+    job->hash = SuperFastHashFile(job->fullPath.C_String());
+
+    job->pass->mutex.Lock();
+    bool lastHash = --job->pass->hashesRemaining == 0;
+    job->pass->mutex.Unlock();
+    if (lastHash)
+        job->pass->hashesDone.SetEvent();
+}
+
+FileHashJob *HashFileCB(FileHashJob *job, bool *returnOutput, void *perThreadData)
+{
+    (void) perThreadData;
+    HashFile(job);
+    *returnOutput = false;
+    return job;
+}
+
+// Hashes every job that needs it, on hashThreadCount threads as well as this one. Returns the number of files hashed
+unsigned int HashFiles(DataStructures::List<FileHashJob> &jobs, int hashThreadCount)
+{
+    unsigned int hashCount = 0;
+    for (unsigned int i = 0; i < jobs.Size(); i++)
+    {
+        if (jobs[i].needsHash)
+            hashCount++;
+    }
+
+    ThreadPool<FileHashJob *, FileHashJob *> hashThreadPool;
+    if (hashThreadCount <= 0 || hashCount < 2 || !hashThreadPool.StartThreads(hashThreadCount, 0))
+    {
+        for (unsigned int i = 0; i < jobs.Size(); i++)
+        {
+            if (jobs[i].needsHash)
+                jobs[i].hash = SuperFastHashFile(jobs[i].fullPath.C_String());
+        }
+        return hashCount;
+    }
+
+    FileHashPass pass;
+    pass.hashesRemaining = hashCount;
+    pass.hashesDone.InitEvent();
+    for (unsigned int i = 0; i < jobs.Size(); i++)
+    {
+        if (jobs[i].needsHash)
+        {
+            jobs[i].pass = &pass;
+            hashThreadPool.AddInput(HashFileCB, &jobs[i]);
+        }
+    }
+
+    hashThreadPool.RunInput();
+    // Then block until the threads finish the files they took
+    for (;;)
+    {
+        pass.mutex.Lock();
+        unsigned int hashesRemaining = pass.hashesRemaining;
+        pass.mutex.Unlock();
+        if (hashesRemaining == 0)
+            break;
+        pass.hashesDone.WaitOnEvent(1000);
+    }
+    hashThreadPool.StopThreads();
+    pass.hashesDone.CloseEvent();
+    return hashCount;
+}
+}
+
+FileList::FileList()
+{
+    manifestCache = nullptr;
+    hashThreadCount = 0;
+    memset(&addFilesStatistics, 0, sizeof(addFilesStatistics));
+}
+
 #ifdef _MSC_VER
 #pragma warning(push)
 #endif
@@ -224,6 +331,11 @@ void FileList::AddFilesFromDirectory(const char *applicationDirectory, const cha
 {
 
 
+    RakNet::TimeUS startTime = RakNet::GetTimeUS();
+    memset(&addFilesStatistics, 0, sizeof(addFilesStatistics));
+    // Files to add with only their hash, once they are all hashed
+    DataStructures::List<FileHashJob> hashJobs;
+
     DataStructures::Queue<char *> dirList;
     char root[260];
     char fullPath[520];
@@ -272,7 +384,8 @@ void FileList::AddFilesFromDirectory(const char *applicationDirectory, const cha
             free(dirSoFar);
             for (unsigned i = 0; i < dirList.Size(); i++)
                 free(dirList[i]);
-            return;
+            // Still add the files found so far
+            break;
         }
 
 //        CRABNET_DEBUG_PRINTF("Adding %s. %i remaining.\n", fullPath, dirList.Size());
@@ -296,6 +409,7 @@ void FileList::AddFilesFromDirectory(const char *applicationDirectory, const cha
 
                 for (unsigned int flpcIndex = 0; flpcIndex < fileListProgressCallbacks.Size(); flpcIndex++)
                     fileListProgressCallbacks[flpcIndex]->OnFile(this, dirSoFar, fileInfo.name, fileInfo.size);
+                addFilesStatistics.filesFound++;
 
                 if (writeData && writeHash)
                 {
@@ -310,6 +424,8 @@ void FileList::AddFilesFromDirectory(const char *applicationDirectory, const cha
                         fclose(fp);
 
                         unsigned int hash = SuperFastHash(fileData + HASH_LENGTH, fileInfo.size);
+                        addFilesStatistics.filesHashed++;
+                        addFilesStatistics.bytesHashed += fileInfo.size;
                         if (RakNet::BitStream::DoEndianSwap())
                             RakNet::BitStream::ReverseBytesInPlace((unsigned char *) &hash, sizeof(hash));
                         memcpy(fileData, &hash, HASH_LENGTH);
@@ -325,18 +441,27 @@ void FileList::AddFilesFromDirectory(const char *applicationDirectory, const cha
                 }
                 else if (writeHash)
                 {
-//                    sha1.Reset();
-//                    DR_SHA1.hashFile((char*)fullPath);
-//                    sha1.Final();
-
-                    unsigned int hash = SuperFastHashFile(fullPath);
-                    if (RakNet::BitStream::DoEndianSwap())
-                        RakNet::BitStream::ReverseBytesInPlace((unsigned char *) &hash, sizeof(hash));
-
-                    // Hash only
-                    //    AddFile((const char*)fullPath+rootLen, (const char*)sha1.GetHash(), HASH_LENGTH, fileInfo.size, context);
-                    AddFile((const char *) fullPath + rootLen, fullPath, (const char *) &hash, HASH_LENGTH,
-                            fileInfo.size, context);
+                    // Hash only. Hashed after every directory is listed, so files can be hashed in parallel, and added in the order found
+                    FileHashJob job;
+                    job.fullPath = fullPath;
+                    job.rootLen = (unsigned int) rootLen;
+                    job.fileLength = (unsigned int) fileInfo.size;
+                    job.hasFileInfo = false;
+                    job.needsHash = true;
+                    job.hash = 0;
+                    job.pass = nullptr;
+                    if (manifestCache != nullptr)
+                    {
+                        job.hasFileInfo = FileManifestCache::GetFileInfo(fullPath, &job.size, &job.modificationTime);
+                        if (job.hasFileInfo && manifestCache->GetHash(fullPath, job.size, job.modificationTime, &job.hash))
+                        {
+                            job.needsHash = false;
+                            addFilesStatistics.filesFromManifest++;
+                        }
+                    }
+                    if (job.needsHash)
+                        addFilesStatistics.bytesHashed += fileInfo.size;
+                    hashJobs.Insert(job);
                 }
                 else if (writeData)
                 {
@@ -374,6 +499,35 @@ void FileList::AddFilesFromDirectory(const char *applicationDirectory, const cha
         free(dirSoFar);
     }
 
+    RakNet::TimeUS hashStartTime = RakNet::GetTimeUS();
+    addFilesStatistics.scanTime = hashStartTime - startTime;
+    addFilesStatistics.filesHashed += HashFiles(hashJobs, hashThreadCount);
+    for (unsigned int i = 0; i < hashJobs.Size(); i++)
+    {
+        FileHashJob &job = hashJobs[i];
+        if (job.needsHash && job.hasFileInfo)
+            manifestCache->SetHash(job.fullPath.C_String(), job.size, job.modificationTime, job.hash);
+
+        unsigned int hash = job.hash;
+        if (RakNet::BitStream::DoEndianSwap())
+            RakNet::BitStream::ReverseBytesInPlace((unsigned char *) &hash, sizeof(hash));
+        AddFile(job.fullPath.C_String() + job.rootLen, job.fullPath.C_String(), (const char *) &hash, HASH_LENGTH,
+                job.fileLength, context);
+    }
+    RakNet::TimeUS endTime = RakNet::GetTimeUS();
+    addFilesStatistics.hashTime = endTime - hashStartTime;
+    addFilesStatistics.totalTime = endTime - startTime;
+}
+
+void FileList::SetHashOptions(FileManifestCache *_manifestCache, int _hashThreadCount)
+{
+    manifestCache = _manifestCache;
+    hashThreadCount = _hashThreadCount;
+}
+
+const FileList::AddFilesStatistics &FileList::GetAddFilesStatistics(void) const
+{
+    return addFilesStatistics;
 }
 
 void FileList::Clear()
@@ -465,6 +619,7 @@ bool FileList::Deserialize(RakNet::BitStream *inBitStream)
 
         n.filename = filename;
         n.fullPathToFile = filename;
+        n.isAReference = false;
         fileList.Insert(n);
     }
 
@@ -25,6 +25,11 @@
 #include "IncrementalReadInterface.h"
 #include "RakAssert.h"
 #include "RakAlloca.h"
+#include "SuperFastHash.h"
+#include "DS_OpenHash.h"
+#include "AutopatcherPatchContext.h"
+#include "../Utils/LinuxStrings.h"
+#include <stdio.h>
 
 #ifdef _MSC_VER
 #pragma warning( push )
@@ -38,6 +43,94 @@ struct FLR_MemoryBlock
     char *flrMemoryBlock;
 };
 
+// Where each chunk of a file sent with SendChunked() comes from
+enum FLR_ChunkSource
+{
+    FLR_CHUNK_RECEIVED,
+    FLR_CHUNK_FROM_BASIS,
+    FLR_CHUNK_FROM_EARLIER
+};
+
+struct FLR_Chunk
+{
+    unsigned int length;
+    unsigned char source;
+    // Into the basis file, or earlier in the same file
+    unsigned int sourceOffset;
+};
+
+// A file sent with SendChunked(), from ID_FILE_LIST_CHUNK_MANIFEST
+struct FLR_ChunkedFile
+{
+    unsigned int fileLength;
+    uint32_t fileHash;
+    RakString basisPath;
+    // False if every chunk was requested, in which case the file arrives whole
+    bool needsAssembly;
+    DataStructures::List<FLR_Chunk> chunks;
+};
+
+// Waiting for ID_FILE_LIST_CHUNK_REQUEST
+struct FileListChunkedSend
+{
+    SystemAddress recipient;
+    unsigned short setId;
+    RakPeerInterface *rakPeer;
+    PacketPriority priority;
+    char orderingChannel;
+    IncrementalReadInterface *incrementalReadInterface;
+    unsigned int chunkSize;
+    FileList fileList;
+    // The chunks of file i are from firstChunk[i] to firstChunk[i+1]. A file with no chunks is sent whole
+    DataStructures::List<ContentChunk> chunks;
+    DataStructures::List<unsigned int> firstChunk;
+};
+
+// File reads for SendChunked() and the chunk messages, which run on the thread pool so OnReceive() does not block on them
+enum FileListChunkJobType
+{
+    // From SendChunked(). Reads and chunks each file, and writes ID_FILE_LIST_CHUNK_MANIFEST
+    FLCJ_CHUNK_FILES,
+    // From ID_FILE_LIST_CHUNK_MANIFEST. Chunks the basis files, and writes ID_FILE_LIST_CHUNK_REQUEST
+    FLCJ_MATCH_BASIS,
+    // From ID_FILE_LIST_CHUNK_REQUEST. Reads the chunks requested
+    FLCJ_READ_CHUNKS
+};
+
+struct FileListChunkJob
+{
+    FileListChunkJob() {done=false; cancelled=false; chunkedSend=0;}
+    ~FileListChunkJob()
+    {
+        delete chunkedSend;
+        for (unsigned int i=0; i < chunkedFiles.Size(); i++)
+            delete chunkedFiles[i];
+    }
+
+    FileListChunkJobType type;
+    // The recipient, or the sender for FLCJ_MATCH_BASIS
+    SystemAddress systemAddress;
+    unsigned short setId;
+    // Set once the job has run. FileListTransfer::Update() then acts on it and deletes it
+    std::atomic<bool> done;
+    // Set when systemAddress is removed before the job is done, so nothing is sent
+    bool cancelled;
+    ContentChunker contentChunker;
+    // Written by FLCJ_CHUNK_FILES and FLCJ_MATCH_BASIS
+    RakNet::BitStream message;
+
+    // FLCJ_CHUNK_FILES and FLCJ_READ_CHUNKS
+    FileListChunkedSend *chunkedSend;
+    // FLCJ_READ_CHUNKS. One per chunk of chunkedSend, and the files to Send()
+    DataStructures::List<bool> requested;
+    FileList chunksToSend;
+
+    // FLCJ_MATCH_BASIS. The chunks of file i as sent are from firstChunk[i] to firstChunk[i+1]
+    DataStructures::List<FLR_ChunkedFile*> chunkedFiles;
+    DataStructures::List<ContentChunk> chunks;
+    DataStructures::List<unsigned int> firstChunk;
+};
+
 struct FileListReceiver
 {
     FileListReceiver();
@@ -55,6 +148,11 @@ struct FileListReceiver
     int  filesReceived;
     DataStructures::Map<unsigned int, FLR_MemoryBlock> pushedFiles;
 
+    // Set by SetReceiveBasis(). fullPathToFile by lower case filename
+    DataStructures::OpenHash<RakString, RakString, RakString::ToInteger> basisPaths;
+    // From ID_FILE_LIST_CHUNK_MANIFEST, by file index
+    DataStructures::List<FLR_ChunkedFile*> chunkedFiles;
+
     // Notifications
     unsigned int partLength;
 
@@ -69,6 +167,347 @@ FileListReceiver::~FileListReceiver() {
     unsigned int i=0;
     for (i=0; i < pushedFiles.Size(); i++)
         free(pushedFiles[i].flrMemoryBlock);
+    for (i=0; i < chunkedFiles.Size(); i++)
+        delete chunkedFiles[i];
+}
+
+namespace
+{
+
+// The contents of a file sent with SendChunked(), read whole
+struct ChunkedFileContents
+{
+    const char *data;
+    unsigned int length;
+    bool acquired, allocated;
+};
+
+bool ReadChunkedFile(FileListNode &node, IncrementalReadInterface *incrementalReadInterface, ChunkedFileContents *contents)
+{
+    contents->acquired=false;
+    contents->allocated=false;
+    if (node.isAReference==false)
+    {
+        contents->data=node.data;
+        contents->length=node.dataLengthBytes;
+        return true;
+    }
+    contents->data=0;
+    contents->length=node.fileLengthBytes;
+    if (contents->length==0)
+        return true;
+
+    IncrementalReadInterface defaultReader;
+    if (incrementalReadInterface==0)
+        incrementalReadInterface=&defaultReader;
+    unsigned int bytesRead;
+    if (incrementalReadInterface->AcquireFilePart(node.fullPathToFile, 0, contents->length, &contents->data, &bytesRead, node.context))
+    {
+        if (bytesRead==contents->length)
+        {
+            contents->acquired=true;
+            return true;
+        }
+        incrementalReadInterface->ReleaseFilePart(node.fullPathToFile, contents->data);
+        return false;
+    }
+    char *buffer=(char*) malloc(contents->length);
+    if (buffer==0)
+        return false;
+    if (incrementalReadInterface->GetFilePart(node.fullPathToFile, 0, contents->length, buffer, node.context)!=contents->length)
+    {
+        free(buffer);
+        return false;
+    }
+    contents->data=buffer;
+    contents->allocated=true;
+    return true;
+}
+
+void ReleaseChunkedFile(FileListNode &node, IncrementalReadInterface *incrementalReadInterface, ChunkedFileContents *contents)
+{
+    if (contents->acquired)
+        incrementalReadInterface->ReleaseFilePart(node.fullPathToFile, contents->data);
+    else if (contents->allocated)
+        free((void*) contents->data);
+}
+
+unsigned long ChunkHashToInteger(const uint64_t &hash)
+{
+    return (unsigned long) hash;
+}
+
+bool ReadBasisRun(FILE *basis, char *destination, unsigned int offset, unsigned int length)
+{
+    if (length==0)
+        return true;
+    return basis!=0 && fseek(basis, (long) offset, SEEK_SET)==0 && fread(destination, length, 1, basis)==1;
+}
+
+// Puts a file sent with SendChunked() back together from the chunks received, which are in onFileStruct->fileData, and the basis file.
+// Returns how many bytes did not have to be received.
+// Only files that were sent whole arrive through ID_FILE_LIST_REFERENCE_PUSH, so this is only needed for ID_FILE_LIST_TRANSFER_FILE
+uint64_t AssembleChunkedFile(FileListReceiver *fileListReceiver, FileListTransferCBInterface::OnFileStruct *onFileStruct)
+{
+    if (onFileStruct->fileIndex >= fileListReceiver->chunkedFiles.Size())
+        return 0;
+    FLR_ChunkedFile *chunkedFile=fileListReceiver->chunkedFiles[onFileStruct->fileIndex];
+    if (chunkedFile->needsAssembly==false)
+        return 0;
+
+    const char *received=onFileStruct->fileData;
+    unsigned int receivedLength=(unsigned int) onFileStruct->byteLengthOfThisFile;
+    char *file=0;
+    if (chunkedFile->fileLength > 0)
+        file=(char*) malloc(chunkedFile->fileLength);
+    FILE *basis=0;
+    if (chunkedFile->basisPath.IsEmpty()==false)
+        basis=fopen(chunkedFile->basisPath.C_String(), "rb");
+
+    bool valid=file!=0 || chunkedFile->fileLength==0;
+    unsigned int offset=0, receivedOffset=0;
+    uint64_t reused=0;
+    // Chunks next to each other in the basis file are read at once
+    unsigned int runOffset=0, runLength=0, runDestination=0;
+    for (unsigned int i=0; i < chunkedFile->chunks.Size() && valid; i++)
+    {
+        const FLR_Chunk &chunk=chunkedFile->chunks[i];
+        if (chunk.length > chunkedFile->fileLength-offset)
+        {
+            valid=false;
+            break;
+        }
+        if (chunk.source==FLR_CHUNK_FROM_BASIS)
+        {
+            if (runLength > 0 && runOffset+runLength==chunk.sourceOffset && runDestination+runLength==offset)
+                runLength+=chunk.length;
+            else
+            {
+                valid=ReadBasisRun(basis, file+runDestination, runOffset, runLength);
+                runOffset=chunk.sourceOffset;
+                runLength=chunk.length;
+                runDestination=offset;
+            }
+            reused+=chunk.length;
+        }
+        else if (chunk.source==FLR_CHUNK_FROM_EARLIER)
+        {
+            // The earlier chunk may be in the run not read yet
+            valid=ReadBasisRun(basis, file+runDestination, runOffset, runLength) && chunk.sourceOffset+chunk.length<=offset;
+            runLength=0;
+            if (valid)
+                memcpy(file+offset, file+chunk.sourceOffset, chunk.length);
+            reused+=chunk.length;
+        }
+        else
+        {
+            valid=chunk.length<=receivedLength-receivedOffset;
+            if (valid)
+                memcpy(file+offset, received+receivedOffset, chunk.length);
+            receivedOffset+=chunk.length;
+        }
+        offset+=chunk.length;
+    }
+    valid=valid && ReadBasisRun(basis, file+runDestination, runOffset, runLength) && offset==chunkedFile->fileLength &&
+        receivedOffset==receivedLength && SuperFastHash(file, (int) chunkedFile->fileLength)==chunkedFile->fileHash;
+    if (basis)
+        fclose(basis);
+
+    free(onFileStruct->fileData);
+    if (valid==false)
+    {
+        // For instance, the basis file changed after ID_FILE_LIST_CHUNK_MANIFEST
+        free(file);
+        onFileStruct->fileData=0;
+        onFileStruct->byteLengthOfThisFile=0;
+        onFileStruct->bytesDownloadedForThisFile=0;
+        onFileStruct->context.op=PC_ERROR_PATCH_RESULT_CHECKSUM_FAILURE;
+        return 0;
+    }
+    onFileStruct->fileData=file;
+    onFileStruct->byteLengthOfThisFile=chunkedFile->fileLength;
+    onFileStruct->bytesDownloadedForThisFile=chunkedFile->fileLength;
+    return reused;
+}
+
+// FLCJ_CHUNK_FILES
+void ChunkFiles(FileListChunkJob *job)
+{
+    FileListChunkedSend *chunkedSend=job->chunkedSend;
+    unsigned int minimum, average, maximum;
+    job->contentChunker.GetChunkSizes(&minimum, &average, &maximum);
+    job->message.Write((MessageID)ID_FILE_LIST_CHUNK_MANIFEST);
+    job->message.Write(job->setId);
+    job->message.WriteCompressed(minimum);
+    job->message.WriteCompressed(average);
+    job->message.WriteCompressed(maximum);
+    job->message.WriteCompressed(chunkedSend->fileList.fileList.Size());
+    for (unsigned int i=0; i < chunkedSend->fileList.fileList.Size(); i++)
+    {
+        FileListNode &node=chunkedSend->fileList.fileList[i];
+
+        // A file that cannot be read has no chunks, so it is sent whole
+        chunkedSend->firstChunk.Insert(chunkedSend->chunks.Size());
+        ChunkedFileContents contents;
+        uint32_t fileHash=0;
+        if (ReadChunkedFile(node, chunkedSend->incrementalReadInterface, &contents))
+        {
+            job->contentChunker.Chunk(contents.data, contents.length, chunkedSend->chunks);
+            fileHash=SuperFastHash(contents.data, (int) contents.length);
+            ReleaseChunkedFile(node, chunkedSend->incrementalReadInterface, &contents);
+        }
+        unsigned int firstChunk=chunkedSend->firstChunk[i];
+
+        StringCompressor::Instance().EncodeString(node.filename, 512, &job->message);
+        job->message.WriteCompressed(contents.length);
+        job->message.Write(fileHash);
+        job->message.WriteCompressed(chunkedSend->chunks.Size()-firstChunk);
+        for (unsigned int j=firstChunk; j < chunkedSend->chunks.Size(); j++)
+        {
+            job->message.WriteCompressed(chunkedSend->chunks[j].length);
+            job->message.Write(chunkedSend->chunks[j].hash);
+        }
+    }
+    chunkedSend->firstChunk.Insert(chunkedSend->chunks.Size());
+}
+
+// FLCJ_MATCH_BASIS
+void MatchBasis(FileListChunkJob *job)
+{
+    job->message.Write((MessageID)ID_FILE_LIST_CHUNK_REQUEST);
+    job->message.Write(job->setId);
+    job->message.WriteCompressed(job->chunkedFiles.Size());
+    for (unsigned int fileIndex=0; fileIndex < job->chunkedFiles.Size(); fileIndex++)
+    {
+        FLR_ChunkedFile *chunkedFile=job->chunkedFiles[fileIndex];
+        unsigned int firstChunk=job->firstChunk[fileIndex];
+        unsigned int endChunk=job->firstChunk[fileIndex+1];
+
+        // Chunks of the basis file with the same name, and chunks earlier in this file, by hash
+        DataStructures::OpenHash<uint64_t, ContentChunk, ChunkHashToInteger> basisChunks, earlierChunks;
+        FILE *fp = 0;
+        if (chunkedFile->basisPath.IsEmpty()==false && endChunk > firstChunk)
+            fp = fopen(chunkedFile->basisPath.C_String(), "rb");
+        if (fp)
+        {
+            fseek(fp, 0, SEEK_END);
+            long basisLength = ftell(fp);
+            fseek(fp, 0, SEEK_SET);
+            char *basisData = basisLength > 0 ? (char*) malloc(basisLength) : 0;
+            if (basisData && fread(basisData, basisLength, 1, fp)==1)
+            {
+                DataStructures::List<ContentChunk> chunks;
+                job->contentChunker.Chunk(basisData, (unsigned int) basisLength, chunks);
+                for (unsigned int j=0; j < chunks.Size(); j++)
+                    basisChunks.Push(chunks[j].hash, chunks[j]);
+            }
+            free(basisData);
+            fclose(fp);
+        }
+
+        unsigned int offset=0;
+        for (unsigned int i=firstChunk; i < endChunk; i++)
+        {
+            ContentChunk chunk=job->chunks[i];
+            FLR_Chunk flrChunk;
+            flrChunk.length=chunk.length;
+            flrChunk.source=FLR_CHUNK_RECEIVED;
+            flrChunk.sourceOffset=0;
+            ContentChunk *found=earlierChunks.Peek(chunk.hash);
+            if (found && found->length==chunk.length)
+            {
+                flrChunk.source=FLR_CHUNK_FROM_EARLIER;
+                flrChunk.sourceOffset=found->offset;
+            }
+            else
+            {
+                found=basisChunks.Peek(chunk.hash);
+                if (found && found->length==chunk.length)
+                {
+                    flrChunk.source=FLR_CHUNK_FROM_BASIS;
+                    flrChunk.sourceOffset=found->offset;
+                }
+                chunk.offset=offset;
+                earlierChunks.Push(chunk.hash, chunk);
+            }
+            if (flrChunk.source!=FLR_CHUNK_RECEIVED)
+                chunkedFile->needsAssembly=true;
+            job->message.Write(flrChunk.source==FLR_CHUNK_RECEIVED);
+            chunkedFile->chunks.Insert(flrChunk);
+            offset+=chunk.length;
+        }
+        // Sent whole, so there is nothing to put together
+        if (chunkedFile->needsAssembly==false)
+            chunkedFile->chunks.Clear(false);
+    }
+}
+
+// FLCJ_READ_CHUNKS
+void ReadChunks(FileListChunkJob *job)
+{
+    FileListChunkedSend *chunkedSend=job->chunkedSend;
+    // Each file is the chunks requested, one after the other, unless every chunk was requested
+    for (unsigned int i=0; i < chunkedSend->fileList.fileList.Size(); i++)
+    {
+        FileListNode &node=chunkedSend->fileList.fileList[i];
+        unsigned int firstChunk=chunkedSend->firstChunk[i];
+        unsigned int endChunk=chunkedSend->firstChunk[i+1];
+        unsigned int requestedLength=0;
+        bool everyChunk=true;
+        for (unsigned int j=firstChunk; j < endChunk; j++)
+        {
+            if (job->requested[j])
+                requestedLength+=chunkedSend->chunks[j].length;
+            else
+                everyChunk=false;
+        }
+
+        // Send() only reads references with an IncrementalReadInterface
+        if (everyChunk && (node.isAReference==false || chunkedSend->incrementalReadInterface!=0))
+        {
+            job->chunksToSend.AddFile(node.filename, node.fullPathToFile, node.data, node.dataLengthBytes, node.fileLengthBytes, node.context, node.isAReference);
+            continue;
+        }
+
+        ChunkedFileContents contents;
+        char *data=0;
+        unsigned int dataLength=0;
+        if (ReadChunkedFile(node, chunkedSend->incrementalReadInterface, &contents))
+        {
+            if (endChunk==firstChunk)
+                requestedLength=contents.length;
+            if (requestedLength > 0)
+                data=(char*) malloc(requestedLength);
+            if (data && endChunk==firstChunk)
+            {
+                memcpy(data, contents.data, contents.length);
+                dataLength=contents.length;
+            }
+            else if (data)
+            {
+                for (unsigned int j=firstChunk; j < endChunk; j++)
+                {
+                    const ContentChunk &chunk=chunkedSend->chunks[j];
+                    if (job->requested[j]==false)
+                        continue;
+                    // The file changed since SendChunked(). The receiver finds the hash does not match
+                    if (chunk.offset+chunk.length > contents.length)
+                        break;
+                    memcpy(data+dataLength, contents.data+chunk.offset, chunk.length);
+                    dataLength+=chunk.length;
+                }
+            }
+            ReleaseChunkedFile(node, chunkedSend->incrementalReadInterface, &contents);
+        }
+        if (dataLength==0)
+        {
+            free(data);
+            data=0;
+        }
+        job->chunksToSend.AddFile(node.filename, node.fullPathToFile, data, dataLength, dataLength, node.context, false, true);
+    }
+}
+
 }
 
 STATIC_FACTORY_DEFINITIONS(FileListTransfer,FileListTransfer)
@@ -102,6 +541,9 @@ void FileListTransfer::FileToPushRecipient::Deref(void)
 FileListTransfer::FileListTransfer()
 {
     setId=0;
+    fileBytesSent=0;
+    fileBytesReceived=0;
+    fileBytesReused=0;
     DataStructures::Map<unsigned short, FileListReceiver*>::IMPLEMENT_DEFAULT_COMPARISON();
 }
 FileListTransfer::~FileListTransfer()
@@ -221,6 +663,7 @@ void FileListTransfer::Send(FileList *fileList, RakNet::RakPeerInterface *rakPee
                 dataBlocks[1]=fileList->fileList[i].data;
                 lengths[1]=fileList->fileList[i].dataLengthBytes;
                 SendListUnified(dataBlocks,lengths,2,priority, RELIABLE_ORDERED, orderingChannel, recipient, false);
+                fileBytesSent+=lengths[1];
             }
         }
 
@@ -278,6 +721,69 @@ void FileListTransfer::Send(FileList *fileList, RakNet::RakPeerInterface *rakPee
     }
 }
 
+void FileListTransfer::SendChunked(FileList *fileList, RakNet::RakPeerInterface *rakPeer, SystemAddress recipient, unsigned short setID, PacketPriority priority, char orderingChannel, IncrementalReadInterface *_incrementalReadInterface, unsigned int _chunkSize)
+{
+    // Nothing to compare, so the recipient just gets an empty set
+    if (fileList->fileList.Size()==0)
+    {
+        Send(fileList, rakPeer, recipient, setID, priority, orderingChannel, _incrementalReadInterface, _chunkSize);
+        return;
+    }
+
+    FileListChunkedSend *chunkedSend = new FileListChunkedSend;
+    chunkedSend->recipient=recipient;
+    chunkedSend->setId=setID;
+    chunkedSend->rakPeer=rakPeer;
+    chunkedSend->priority=priority;
+    chunkedSend->orderingChannel=orderingChannel;
+    chunkedSend->incrementalReadInterface=_incrementalReadInterface;
+    chunkedSend->chunkSize=_chunkSize;
+    for (unsigned int i=0; i < fileList->fileList.Size(); i++)
+    {
+        FileListNode &node=fileList->fileList[i];
+        FileListNodeContext context(node.context.op, node.context.flnc_extraData1, node.context.flnc_extraData2, node.context.flnc_extraData3);
+        if (node.isAReference)
+            chunkedSend->fileList.AddFile(node.filename, node.fullPathToFile, 0, node.dataLengthBytes, node.fileLengthBytes, context, true);
+        else
+            chunkedSend->fileList.AddFile(node.filename, node.fullPathToFile, node.data, node.dataLengthBytes, node.fileLengthBytes, context);
+    }
+
+    FileListChunkJob *job = new FileListChunkJob;
+    job->type=FLCJ_CHUNK_FILES;
+    job->systemAddress=recipient;
+    job->setId=setID;
+    job->contentChunker=contentChunker;
+    job->chunkedSend=chunkedSend;
+    AddChunkJob(job);
+}
+
+void FileListTransfer::SetReceiveBasis(unsigned short setId, const FileList &basis)
+{
+    if (fileListReceivers.Has(setId)==false)
+    {
+#ifdef _DEBUG
+        RakAssert(0);
+#endif
+        return;
+    }
+    FileListReceiver *fileListReceiver=fileListReceivers.Get(setId);
+    fileListReceiver->basisPaths.Clear();
+    fileListReceiver->basisPaths.Reserve(basis.fileList.Size());
+    for (unsigned int i=0; i < basis.fileList.Size(); i++)
+    {
+        // Filenames are matched without case. The first file with a name is used
+        RakString filename(basis.fileList[i].filename);
+        filename.ToLower();
+        if (fileListReceiver->basisPaths.HasData(filename)==false)
+            fileListReceiver->basisPaths.Push(filename, basis.fileList[i].fullPathToFile);
+    }
+}
+
+void FileListTransfer::SetContentChunkSizes(unsigned int minimum, unsigned int average, unsigned int maximum)
+{
+    contentChunker.SetChunkSizes(minimum, average, maximum);
+}
+
 bool FileListTransfer::DecodeSetHeader(Packet *packet)
 {
     bool anythingToWrite=false;
@@ -405,6 +911,7 @@ bool FileListTransfer::DecodeFile(Packet *packet, bool isTheFullFile)
     {
         onFileStruct.bytesDownloadedForThisFile=onFileStruct.byteLengthOfThisFile;
         fileListReceiver->setTotalDownloadedLength+=onFileStruct.byteLengthOfThisFile;
+        fileBytesReceived+=onFileStruct.byteLengthOfThisFile;
         onFileStruct.bytesDownloadedForThisSet=fileListReceiver->setTotalDownloadedLength;
     }
     else
@@ -433,6 +940,9 @@ bool FileListTransfer::DecodeFile(Packet *packet, bool isTheFullFile)
         fps.senderGuid=packet->guid;
         fileListReceiver->downloadHandler->OnFileProgress(&fps);
 
+        // Files sent with SendChunked() only hold the chunks the receiver did not have
+        fileBytesReused+=AssembleChunkedFile(fileListReceiver, &onFileStruct);
+
         // Got a complete file
         // Either we are using IncrementalReadInterface and it was a small file or
         // We are not using IncrementalReadInterface
@@ -506,6 +1016,12 @@ PluginReceiveResult FileListTransfer::OnReceive(Packet *packet)
     case ID_FILE_LIST_REFERENCE_PUSH_ACK:
         OnReferencePushAck(packet);
         return RR_STOP_PROCESSING_AND_DEALLOCATE;
+    case ID_FILE_LIST_CHUNK_MANIFEST:
+        OnChunkManifest(packet);
+        return RR_STOP_PROCESSING_AND_DEALLOCATE;
+    case ID_FILE_LIST_CHUNK_REQUEST:
+        OnChunkRequest(packet);
+        return RR_STOP_PROCESSING_AND_DEALLOCATE;
     case ID_DOWNLOAD_PROGRESS:
         if (packet->length>sizeof(MessageID)+sizeof(unsigned int)*3)
         {
@@ -519,6 +1035,8 @@ PluginReceiveResult FileListTransfer::OnReceive(Packet *packet)
                 OnReferencePush(packet, false);
                 return RR_STOP_PROCESSING_AND_DEALLOCATE;
             }
+            if (packet->data[sizeof(MessageID)+sizeof(unsigned int)*3]==ID_FILE_LIST_CHUNK_MANIFEST)
+                return RR_STOP_PROCESSING_AND_DEALLOCATE;
         }
         break;
     }
@@ -553,6 +1071,23 @@ void FileListTransfer::Clear(void)
     fileToPushRecipientList.Clear(false);
     fileToPushRecipientListMutex.Unlock();
 
+    ClearChunkedSends(UNASSIGNED_SYSTEM_ADDRESS, false);
+
+    // Only called with the threads stopped, so no job is running. Jobs not run yet are taken out of the thread pool
+    threadPool.LockInput();
+    i=0;
+    while (i < threadPool.InputSize())
+    {
+        if (threadPool.GetInputAtIndex(i).chunkJob)
+            threadPool.RemoveInputAtIndex(i);
+        else
+            i++;
+    }
+    threadPool.UnlockInput();
+    for (i=0; i < chunkJobs.Size(); i++)
+        delete chunkJobs[i];
+    chunkJobs.Clear(false);
+
     //filesToPush.Clear(false);
 }
 void FileListTransfer::OnClosedConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, PI2_LostConnectionReason lostConnectionReason )
@@ -587,6 +1122,9 @@ void FileListTransfer::RemoveReceiver(SystemAddress systemAddress)
     {
         if (threadPool.GetInputAtIndex(i).systemAddress==systemAddress)
         {
+            // Will not run, so mark it done for UpdateChunkJobs() to delete. ClearChunkedSends() cancels it
+            if (threadPool.GetInputAtIndex(i).chunkJob)
+                threadPool.GetInputAtIndex(i).chunkJob->done=true;
             threadPool.RemoveInputAtIndex(i);
         }
         else
@@ -631,6 +1169,41 @@ void FileListTransfer::RemoveReceiver(SystemAddress systemAddress)
         }
     }
     fileToPushRecipientListMutex.Unlock();
+
+    ClearChunkedSends(systemAddress, true);
+}
+void FileListTransfer::ClearChunkedSends(SystemAddress systemAddress, bool abortedCallback)
+{
+    unsigned int i=0;
+    while (i < chunkedSends.Size())
+    {
+        if (systemAddress==UNASSIGNED_SYSTEM_ADDRESS || chunkedSends[i]->recipient==systemAddress)
+        {
+            if (abortedCallback)
+            {
+                for (unsigned int flpcIndex=0; flpcIndex < fileListProgressCallbacks.Size(); flpcIndex++)
+                    fileListProgressCallbacks[flpcIndex]->OnSendAborted(chunkedSends[i]->recipient);
+            }
+            delete chunkedSends[i];
+            chunkedSends.RemoveAtIndex(i);
+        }
+        else
+            i++;
+    }
+
+    // Jobs still on the thread pool are deleted by UpdateChunkJobs() when done
+    for (i=0; i < chunkJobs.Size(); i++)
+    {
+        FileListChunkJob *job=chunkJobs[i];
+        if (job->cancelled || (systemAddress!=UNASSIGNED_SYSTEM_ADDRESS && job->systemAddress!=systemAddress))
+            continue;
+        job->cancelled=true;
+        if (abortedCallback && job->type!=FLCJ_MATCH_BASIS)
+        {
+            for (unsigned int flpcIndex=0; flpcIndex < fileListProgressCallbacks.Size(); flpcIndex++)
+                fileListProgressCallbacks[flpcIndex]->OnSendAborted(job->systemAddress);
+        }
+    }
 }
 bool FileListTransfer::IsHandlerActive(unsigned short setId)
 {
@@ -661,6 +1234,8 @@ void FileListTransfer::GetCallbacks(DataStructures::List<FileListProgress*> &cal
 
 void FileListTransfer::Update(void)
 {
+    UpdateChunkJobs();
+
     unsigned i;
     i=0;
     while (i < fileListReceivers.Size())
@@ -797,6 +1372,7 @@ void FileListTransfer::OnReferencePush(Packet *packet, bool isTheFullFile)
 
         onFileStruct.bytesDownloadedForThisFile=offset+chunkLength;
         fileListReceiver->setTotalDownloadedLength+=chunkLength;
+        fileBytesReceived+=chunkLength;
         onFileStruct.bytesDownloadedForThisSet=fileListReceiver->setTotalDownloadedLength;
     }
     else
@@ -934,6 +1510,23 @@ File sender:
 Got ID_FILE_LIST_REFERENCE_PUSH_ACK. Calls OnReferencePushAck, calls SendIRIToAddress, calls SendIRIToAddressCB
 */
 
+int ChunkJobCB(FileListTransfer::ThreadData threadData, bool *returnOutput, void* perThreadData)
+{
+    (void) perThreadData;
+    *returnOutput=false;
+
+    FileListChunkJob *job=threadData.chunkJob;
+    if (job->type==FLCJ_CHUNK_FILES)
+        ChunkFiles(job);
+    else if (job->type==FLCJ_MATCH_BASIS)
+        MatchBasis(job);
+    else
+        ReadChunks(job);
+    // Update() acts on the job from here
+    job->done=true;
+    return 0;
+}
+
 int SendIRIToAddressCB(FileListTransfer::ThreadData threadData, bool *returnOutput, void* perThreadData)
 {
     (void) perThreadData;
@@ -948,6 +1541,9 @@ int SendIRIToAddressCB(FileListTransfer::ThreadData threadData, bool *returnOutp
     const char *dataBlocks[2];
     int lengths[2];
     unsigned int smallFileTotalSize=0;
+    // Set when the IncrementalReadInterface gave the file part directly, rather than copying it into buff
+    const char *filePart;
+    bool acquired;
     RakNet::BitStream outBitstream;
     unsigned int ftpIndex;
 
@@ -981,7 +1577,12 @@ int SendIRIToAddressCB(FileListTransfer::ThreadData threadData, bool *returnOutp
             }
 
             // Read the next file chunk
-            bytesRead=ftp->incrementalReadInterface->GetFilePart(ftp->fileListNode.fullPathToFile, ftp->currentOffset, ftp->chunkSize, buff, ftp->fileListNode.context);
+            acquired=ftp->incrementalReadInterface->AcquireFilePart(ftp->fileListNode.fullPathToFile, ftp->currentOffset, ftp->chunkSize, &filePart, &bytesRead, ftp->fileListNode.context);
+            if (!acquired)
+            {
+                bytesRead=ftp->incrementalReadInterface->GetFilePart(ftp->fileListNode.fullPathToFile, ftp->currentOffset, ftp->chunkSize, buff, ftp->fileListNode.context);
+                filePart=(const char*) buff;
+            }
 
             bool done = ftp->fileListNode.dataLengthBytes == ftp->currentOffset+bytesRead;
             while (done && ftp->currentOffset==0 && smallFileTotalSize<ftp->chunkSize)
@@ -1007,10 +1608,13 @@ int SendIRIToAddressCB(FileListTransfer::ThreadData threadData, bool *returnOutp
                 outBitstream.AlignWriteToByteBoundary();
                 dataBlocks[0]=(char*) outBitstream.GetData();
                 lengths[0]=outBitstream.GetNumberOfBytesUsed();
-                dataBlocks[1]=(const char*) buff;
+                dataBlocks[1]=filePart;
                 lengths[1]=bytesRead;
 
                 fileListTransfer->SendListUnified(dataBlocks,lengths,2,ftp->packetPriority, RELIABLE_ORDERED, ftp->orderingChannel, systemAddress, false);
+                fileListTransfer->fileBytesSent+=bytesRead;
+                if (acquired)
+                    ftp->incrementalReadInterface->ReleaseFilePart(ftp->fileListNode.fullPathToFile, filePart);
 
                 // LWS : fixed freed pointer reference
 //                unsigned int chunkSize = ftp->chunkSize;
@@ -1021,7 +1625,12 @@ int SendIRIToAddressCB(FileListTransfer::ThreadData threadData, bool *returnOutp
                 ftp = ftpr->filesToPush.Pop();
                 ////ftpr->filesToPushMutex.Unlock();
 
-                bytesRead=ftp->incrementalReadInterface->GetFilePart(ftp->fileListNode.fullPathToFile, ftp->currentOffset, ftp->chunkSize, buff, ftp->fileListNode.context);
+                acquired=ftp->incrementalReadInterface->AcquireFilePart(ftp->fileListNode.fullPathToFile, ftp->currentOffset, ftp->chunkSize, &filePart, &bytesRead, ftp->fileListNode.context);
+                if (!acquired)
+                {
+                    bytesRead=ftp->incrementalReadInterface->GetFilePart(ftp->fileListNode.fullPathToFile, ftp->currentOffset, ftp->chunkSize, buff, ftp->fileListNode.context);
+                    filePart=(const char*) buff;
+                }
                 done = ftp->fileListNode.dataLengthBytes == ftp->currentOffset+bytesRead;
             }
 
@@ -1044,11 +1653,14 @@ int SendIRIToAddressCB(FileListTransfer::ThreadData threadData, bool *returnOutp
 
             dataBlocks[0]=(char*) outBitstream.GetData();
             lengths[0]=outBitstream.GetNumberOfBytesUsed();
-            dataBlocks[1]=(char*) buff;
+            dataBlocks[1]=filePart;
             lengths[1]=bytesRead;
             //rakPeerInterface->SendList(dataBlocks,lengths,2,ftp->packetPriority, RELIABLE_ORDERED, ftp->orderingChannel, ftp->systemAddress, false);
             char orderingChannel = ftp->orderingChannel;
             PacketPriority packetPriority = ftp->packetPriority;
+            // ftp may be deleted below, but an acquired file part is only released after it is sent
+            IncrementalReadInterface *incrementalReadInterface = ftp->incrementalReadInterface;
+            RakString fullPathToFile = ftp->fileListNode.fullPathToFile;
 
             // Mutex state: FileToPushRecipient (ftpr) has AddRef. fileToPushRecipientListMutex not locked.
             if (done)
@@ -1085,6 +1697,9 @@ int SendIRIToAddressCB(FileListTransfer::ThreadData threadData, bool *returnOutp
             // 2/12/2012 Moved this line at after the if (done) block above.
             // See http://www.jenkinssoftware.com/forum/index.php?topic=4768.msg19738#msg19738
             fileListTransfer->SendListUnified(dataBlocks,lengths,2, packetPriority, RELIABLE_ORDERED, orderingChannel, systemAddress, false);
+            fileListTransfer->fileBytesSent+=bytesRead;
+            if (acquired)
+                incrementalReadInterface->ReleaseFilePart(fullPathToFile, filePart);
 
             free(buff);
             return 0;
@@ -1107,6 +1722,7 @@ void FileListTransfer::SendIRIToAddress(SystemAddress systemAddress, unsigned sh
     threadData.fileListTransfer=this;
     threadData.systemAddress=systemAddress;
     threadData.setId=setId;
+    threadData.chunkJob=0;
 
     if (threadPool.WasStarted())
     {
@@ -1126,6 +1742,197 @@ void FileListTransfer::OnReferencePushAck(Packet *packet)
     inBitStream.Read(setId);
     SendIRIToAddress(packet->systemAddress, setId);
 }
+void FileListTransfer::OnChunkManifest(Packet *packet)
+{
+    RakNet::BitStream inBitStream(packet->data, packet->length, false);
+    inBitStream.IgnoreBits(8);
+    unsigned short setID;
+    inBitStream.Read(setID);
+    if (fileListReceivers.Has(setID)==false)
+        return;
+    FileListReceiver *fileListReceiver=fileListReceivers.Get(setID);
+    if (fileListReceiver->allowedSender!=packet->systemAddress)
+    {
+#ifdef _DEBUG
+        RakAssert(0);
+#endif
+        return;
+    }
+
+    unsigned int minimum=0, average=0, maximum=0, fileCount=0;
+    inBitStream.ReadCompressed(minimum);
+    inBitStream.ReadCompressed(average);
+    inBitStream.ReadCompressed(maximum);
+    if (inBitStream.ReadCompressed(fileCount)==false || minimum==0 || average==0 || maximum <= minimum)
+    {
+#ifdef _DEBUG
+        RakAssert(0);
+#endif
+        return;
+    }
+
+    FileListChunkJob *job = new FileListChunkJob;
+    job->type=FLCJ_MATCH_BASIS;
+    job->systemAddress=packet->systemAddress;
+    job->setId=setID;
+    // Basis files have to be cut the same way as the files sent
+    job->contentChunker.SetChunkSizes(minimum, average, maximum);
+    for (unsigned int fileIndex=0; fileIndex < fileCount; fileIndex++)
+    {
+        char filename[512];
+        unsigned int chunkCount=0;
+        FLR_ChunkedFile *chunkedFile = new FLR_ChunkedFile;
+        chunkedFile->needsAssembly=false;
+        job->chunkedFiles.Insert(chunkedFile);
+        job->firstChunk.Insert(job->chunks.Size());
+        if (StringCompressor::Instance().DecodeString(filename, 512, &inBitStream)==false ||
+            inBitStream.ReadCompressed(chunkedFile->fileLength)==false ||
+            inBitStream.Read(chunkedFile->fileHash)==false ||
+            inBitStream.ReadCompressed(chunkCount)==false)
+        {
+#ifdef _DEBUG
+            RakAssert(0);
+#endif
+            delete job;
+            return;
+        }
+
+        RakString basisFilename(filename);
+        basisFilename.ToLower();
+        RakString *basisPath=fileListReceiver->basisPaths.Peek(basisFilename);
+        if (basisPath)
+            chunkedFile->basisPath=*basisPath;
+
+        for (unsigned int i=0; i < chunkCount; i++)
+        {
+            ContentChunk chunk;
+            chunk.offset=0;
+            if (inBitStream.ReadCompressed(chunk.length)==false || inBitStream.Read(chunk.hash)==false)
+            {
+#ifdef _DEBUG
+                RakAssert(0);
+#endif
+                delete job;
+                return;
+            }
+            job->chunks.Insert(chunk);
+        }
+    }
+    job->firstChunk.Insert(job->chunks.Size());
+    AddChunkJob(job);
+}
+void FileListTransfer::OnChunkRequest(Packet *packet)
+{
+    RakNet::BitStream inBitStream(packet->data, packet->length, false);
+    inBitStream.IgnoreBits(8);
+    unsigned short setID;
+    inBitStream.Read(setID);
+    unsigned int index;
+    for (index=0; index < chunkedSends.Size(); index++)
+    {
+        if (chunkedSends[index]->recipient==packet->systemAddress && chunkedSends[index]->setId==setID)
+            break;
+    }
+    if (index==chunkedSends.Size())
+        return;
+    FileListChunkedSend *chunkedSend=chunkedSends[index];
+    chunkedSends.RemoveAtIndex(index);
+
+    FileListChunkJob *job = new FileListChunkJob;
+    job->type=FLCJ_READ_CHUNKS;
+    job->systemAddress=chunkedSend->recipient;
+    job->setId=chunkedSend->setId;
+    job->chunkedSend=chunkedSend;
+
+    unsigned int fileCount=0;
+    bool valid=inBitStream.ReadCompressed(fileCount) && fileCount==chunkedSend->fileList.fileList.Size();
+    for (unsigned int j=0; j < chunkedSend->chunks.Size() && valid; j++)
+    {
+        bool isRequested=false;
+        valid=inBitStream.Read(isRequested);
+        job->requested.Insert(isRequested);
+    }
+
+    if (valid)
+        AddChunkJob(job);
+    else
+    {
+#ifdef _DEBUG
+        RakAssert(0);
+#endif
+        delete job;
+    }
+}
+void FileListTransfer::AddChunkJob(FileListChunkJob *job)
+{
+    chunkJobs.Insert(job);
+
+    ThreadData threadData;
+    threadData.fileListTransfer=this;
+    threadData.systemAddress=job->systemAddress;
+    threadData.setId=job->setId;
+    threadData.chunkJob=job;
+
+    if (threadPool.WasStarted())
+    {
+        threadPool.AddInput(ChunkJobCB, threadData);
+    }
+    else
+    {
+        bool doesNothing;
+        ChunkJobCB(threadData, &doesNothing, 0);
+        UpdateChunkJobs();
+    }
+}
+void FileListTransfer::UpdateChunkJobs(void)
+{
+    unsigned int i=0;
+    while (i < chunkJobs.Size())
+    {
+        FileListChunkJob *job=chunkJobs[i];
+        if (job->done==false)
+        {
+            i++;
+            continue;
+        }
+        chunkJobs.RemoveAtIndex(i);
+        if (job->cancelled==false)
+            FinishChunkJob(job);
+        delete job;
+    }
+}
+void FileListTransfer::FinishChunkJob(FileListChunkJob *job)
+{
+    FileListChunkedSend *chunkedSend=job->chunkedSend;
+    if (job->type==FLCJ_CHUNK_FILES)
+    {
+        // Taken by chunkedSends until ID_FILE_LIST_CHUNK_REQUEST
+        chunkedSends.Insert(chunkedSend);
+        job->chunkedSend=0;
+        if (chunkedSend->rakPeer)
+            chunkedSend->rakPeer->Send(&job->message, chunkedSend->priority, RELIABLE_ORDERED, chunkedSend->orderingChannel, chunkedSend->recipient, false);
+        else
+            SendUnified(&job->message, chunkedSend->priority, RELIABLE_ORDERED, chunkedSend->orderingChannel, chunkedSend->recipient, false);
+    }
+    else if (job->type==FLCJ_MATCH_BASIS)
+    {
+        // The receiver may have been cancelled, or its setId reused
+        if (fileListReceivers.Has(job->setId)==false)
+            return;
+        FileListReceiver *fileListReceiver=fileListReceivers.Get(job->setId);
+        if (fileListReceiver->allowedSender!=job->systemAddress)
+            return;
+        for (unsigned int i=0; i < fileListReceiver->chunkedFiles.Size(); i++)
+            delete fileListReceiver->chunkedFiles[i];
+        fileListReceiver->chunkedFiles=job->chunkedFiles;
+        job->chunkedFiles.Clear(false);
+        SendUnified(&job->message, HIGH_PRIORITY, RELIABLE, 0, job->systemAddress, false);
+    }
+    else
+    {
+        Send(&job->chunksToSend, chunkedSend->rakPeer, chunkedSend->recipient, chunkedSend->setId, chunkedSend->priority, chunkedSend->orderingChannel, chunkedSend->incrementalReadInterface, chunkedSend->chunkSize);
+    }
+}
 void FileListTransfer::RemoveFromList(FileToPushRecipient *ftpr)
 {
     fileToPushRecipientListMutex.Lock();
@@ -1158,6 +1965,18 @@ unsigned int FileListTransfer::GetPendingFilesToAddress(SystemAddress recipient)
 
     return 0;
 }
+uint64_t FileListTransfer::GetFileBytesSent(void) const
+{
+    return fileBytesSent;
+}
+uint64_t FileListTransfer::GetFileBytesReceived(void) const
+{
+    return fileBytesReceived;
+}
+uint64_t FileListTransfer::GetFileBytesReused(void) const
+{
+    return fileBytesReused;
+}
 
 #ifdef _MSC_VER
 #pragma warning( pop )
@@ -296,6 +296,25 @@ PluginReceiveResult FullyConnectedMesh2::OnReceive(Packet *packet)
 
     return RR_CONTINUE_PROCESSING;
 }
+bool FullyConnectedMesh2::GetReceiveMessageIDs(bool messageIds[256]) const
+{
+    messageIds[ID_REMOTE_NEW_INCOMING_CONNECTION]=true;
+    messageIds[ID_FCM2_REQUEST_FCMGUID]=true;
+    messageIds[ID_FCM2_RESPOND_CONNECTION_COUNT]=true;
+    messageIds[ID_FCM2_INFORM_FCMGUID]=true;
+    messageIds[ID_FCM2_UPDATE_MIN_TOTAL_CONNECTION_COUNT]=true;
+    messageIds[ID_FCM2_NEW_HOST]=true;
+    messageIds[ID_FCM2_VERIFIED_JOIN_START]=true;
+    messageIds[ID_FCM2_VERIFIED_JOIN_CAPABLE]=true;
+    messageIds[ID_FCM2_VERIFIED_JOIN_FAILED]=true;
+    messageIds[ID_FCM2_VERIFIED_JOIN_ACCEPTED]=true;
+    messageIds[ID_FCM2_VERIFIED_JOIN_REJECTED]=true;
+    messageIds[ID_NAT_TARGET_UNRESPONSIVE]=true;
+    messageIds[ID_NAT_TARGET_NOT_CONNECTED]=true;
+    messageIds[ID_NAT_CONNECTION_TO_TARGET_LOST]=true;
+    messageIds[ID_NAT_PUNCHTHROUGH_FAILED]=true;
+    return true;
+}
 void FullyConnectedMesh2::OnRakPeerStartup(void)
 {
     Clear();
@@ -0,0 +1,441 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "NativeFeatureIncludes.h"
+#if _CRABNET_SUPPORT_MetricsExporter==1
+
+#include "MetricsExporter.h"
+#include "InternalPacket.h"
+#include "RakPeerInterface.h"
+#include "RakNetStatistics.h"
+#include "GetTime.h"
+#if _CRABNET_SUPPORT_ReplicaManager3==1
+#include "ReplicaManager3.h"
+#endif
+#if _CRABNET_SUPPORT_FileListTransfer==1
+#include "FileListTransfer.h"
+#endif
+#if _CRABNET_SUPPORT_NatPunchthroughClient==1
+#include "NatPunchthroughClient.h"
+#endif
+#if _CRABNET_SUPPORT_NatPunchthroughServer==1
+#include "NatPunchthroughServer.h"
+#endif
+#if _CRABNET_SUPPORT_TCPInterface==1
+#include "TCPInterface.h"
+#endif
+#include <stdio.h>
+#include <string.h>
+
+using namespace RakNet;
+
+STATIC_FACTORY_DEFINITIONS(MetricsExporter,MetricsExporter)
+
+static const char *priorityLabels[NUMBER_OF_PRIORITIES] = {"priority=\"immediate\"", "priority=\"high\"", "priority=\"medium\"", "priority=\"low\""};
+
+MetricsExporter::MetricsExporter()
+{
+    for (int i=0; i < NUMBER_OF_PRIORITIES; i++)
+    {
+        messagesSent[i]=0;
+        messageBytesSent[i]=0;
+        messagesResent[i]=0;
+    }
+    messagesReceived=0;
+    messageBytesReceived=0;
+    acksReceived=0;
+    reliabilityErrors=0;
+    reliabilityWarnings=0;
+    connectionsOpened=0;
+    connectionsClosed=0;
+    failedConnectionAttempts=0;
+    connectionCount=0;
+    metricPrefix="raknet";
+    snapshotInterval=5000;
+    nextSnapshotTime=0;
+    includeConnectionStatistics=false;
+    replicaManager3=0;
+    fileListTransfer=0;
+    natPunchthroughClient=0;
+    natPunchthroughServer=0;
+#if _CRABNET_SUPPORT_TCPInterface==1
+    httpServer=0;
+#endif
+    snapshot="# EOF\n";
+}
+MetricsExporter::~MetricsExporter()
+{
+}
+void MetricsExporter::SetSnapshotInterval(RakNet::TimeMS interval)
+{
+    snapshotInterval=interval;
+    nextSnapshotTime=0;
+}
+void MetricsExporter::SetIncludeConnectionStatistics(bool include)
+{
+    includeConnectionStatistics=include;
+}
+void MetricsExporter::SetMetricPrefix(const char *prefix)
+{
+    metricPrefix=prefix;
+}
+void MetricsExporter::SetReplicaManager3(ReplicaManager3 *rm3)
+{
+    replicaManager3=rm3;
+}
+void MetricsExporter::SetFileListTransfer(FileListTransfer *flt)
+{
+    fileListTransfer=flt;
+}
+void MetricsExporter::SetNatPunchthroughClient(NatPunchthroughClient *client)
+{
+    natPunchthroughClient=client;
+}
+void MetricsExporter::SetNatPunchthroughServer(NatPunchthroughServer *server)
+{
+    natPunchthroughServer=server;
+}
+void MetricsExporter::SetGauge(const char *name, const char *help, double value)
+{
+    for (unsigned int i=0; i < gauges.Size(); i++)
+    {
+        if (gauges[i].name==name)
+        {
+            gauges[i].value=value;
+            return;
+        }
+    }
+    Gauge gauge;
+    gauge.name=name;
+    gauge.help=help;
+    gauge.value=value;
+    gauges.Push(gauge);
+}
+void MetricsExporter::RemoveGauge(const char *name)
+{
+    for (unsigned int i=0; i < gauges.Size(); i++)
+    {
+        if (gauges[i].name==name)
+        {
+            gauges.RemoveAtIndexFast(i);
+            return;
+        }
+    }
+}
+const RakString &MetricsExporter::GetSnapshot(void) const
+{
+    return snapshot;
+}
+bool MetricsExporter::WriteSnapshot(const char *filename) const
+{
+    RakString tempFilename("%s.tmp", filename);
+    FILE *fp = fopen(tempFilename.C_String(), "wb");
+    if (fp==0)
+        return false;
+    size_t length = snapshot.GetLength();
+    bool written = fwrite(snapshot.C_String(), 1, length, fp)==length;
+    if (fclose(fp)!=0)
+        written=false;
+    if (written==false)
+    {
+        remove(tempFilename.C_String());
+        return false;
+    }
+#ifdef _WIN32
+    // rename does not replace an existing file on Windows
+    remove(filename);
+#endif
+    return rename(tempFilename.C_String(), filename)==0;
+}
+#if _CRABNET_SUPPORT_TCPInterface==1
+void MetricsExporter::SetHTTPServer(TCPInterface *tcp)
+{
+    httpServer=tcp;
+}
+void MetricsExporter::ServeHTTP(void)
+{
+    // Nothing else reads these queues on this TCPInterface
+    while (httpServer->HasNewIncomingConnection()!=UNASSIGNED_SYSTEM_ADDRESS)
+        ;
+    while (httpServer->HasLostConnection()!=UNASSIGNED_SYSTEM_ADDRESS)
+        ;
+
+    Packet *packet;
+    for (packet=httpServer->Receive(); packet; httpServer->DeallocatePacket(packet), packet=httpServer->Receive())
+    {
+        // Only the first segment of a request starts with the method. Anything else, such as the rest of a long header, is ignored
+        if (packet->length < 4 || memcmp(packet->data, "GET ", 4)!=0)
+            continue;
+
+        RakString header("HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+            "Content-Length: %u\r\n"
+            "\r\n", (unsigned int) snapshot.GetLength());
+        const char *data[2] = {header.C_String(), snapshot.C_String()};
+        const unsigned int lengths[2] = {(unsigned int) header.GetLength(), (unsigned int) snapshot.GetLength()};
+        httpServer->SendList(data, lengths, 2, packet->systemAddress, false);
+    }
+}
+#endif
+void MetricsExporter::Update(void)
+{
+    RakNet::TimeMS curTime = RakNet::GetTimeMS();
+    if (nextSnapshotTime==0 || curTime - nextSnapshotTime < (RakNet::TimeMS)-1/2)
+    {
+        UpdateSnapshot();
+        nextSnapshotTime = curTime + snapshotInterval;
+        if (nextSnapshotTime==0)
+            nextSnapshotTime=1;
+    }
+
+#if _CRABNET_SUPPORT_TCPInterface==1
+    if (httpServer)
+        ServeHTTP();
+#endif
+}
+void MetricsExporter::OnNewConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, bool isIncoming)
+{
+    (void) systemAddress;
+    (void) rakNetGUID;
+    (void) isIncoming;
+
+    connectionsOpened++;
+    connectionCount++;
+}
+void MetricsExporter::OnClosedConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, PI2_LostConnectionReason lostConnectionReason )
+{
+    (void) systemAddress;
+    (void) rakNetGUID;
+    (void) lostConnectionReason;
+
+    connectionsClosed++;
+    if (connectionCount > 0)
+        connectionCount--;
+}
+void MetricsExporter::OnFailedConnectionAttempt(Packet *packet, PI2_FailedConnectionAttemptReason failedConnectionAttemptReason)
+{
+    (void) packet;
+    (void) failedConnectionAttemptReason;
+
+    failedConnectionAttempts++;
+}
+bool MetricsExporter::GetReceiveMessageIDs(bool messageIds[256]) const
+{
+    // Connections are counted from the callbacks above, so no messages are needed
+    (void) messageIds;
+    return true;
+}
+void MetricsExporter::OnReliabilityLayerNotification(const char *errorMessage, const BitSize_t bitsUsed, SystemAddress remoteSystemAddress, bool isError)
+{
+    (void) errorMessage;
+    (void) bitsUsed;
+    (void) remoteSystemAddress;
+
+    if (isError)
+        reliabilityErrors.fetch_add(1, std::memory_order_relaxed);
+    else
+        reliabilityWarnings.fetch_add(1, std::memory_order_relaxed);
+}
+void MetricsExporter::OnInternalPacket(InternalPacket *internalPacket, unsigned frameNumber, SystemAddress remoteSystemAddress, RakNet::TimeMS time, int isSend)
+{
+    (void) frameNumber;
+    (void) remoteSystemAddress;
+    (void) time;
+
+    if (isSend==1)
+    {
+        int priority = internalPacket->priority < NUMBER_OF_PRIORITIES ? (int) internalPacket->priority : LOW_PRIORITY;
+        // timesSent was already incremented for this send
+        if (internalPacket->timesSent > 1)
+            messagesResent[priority].fetch_add(1, std::memory_order_relaxed);
+        else
+        {
+            messagesSent[priority].fetch_add(1, std::memory_order_relaxed);
+            messageBytesSent[priority].fetch_add(BITS_TO_BYTES(internalPacket->dataBitLength), std::memory_order_relaxed);
+        }
+    }
+    else
+    {
+        messagesReceived.fetch_add(1, std::memory_order_relaxed);
+        messageBytesReceived.fetch_add(BITS_TO_BYTES(internalPacket->dataBitLength), std::memory_order_relaxed);
+    }
+}
+void MetricsExporter::OnAck(unsigned int messageNumber, SystemAddress remoteSystemAddress, RakNet::TimeMS time)
+{
+    (void) messageNumber;
+    (void) remoteSystemAddress;
+    (void) time;
+
+    acksReceived.fetch_add(1, std::memory_order_relaxed);
+}
+void MetricsExporter::AppendFamily(const char *name, const char *type, const char *help, const char *unit)
+{
+    snapshot += RakString("# TYPE %s_%s %s\n", metricPrefix.C_String(), name, type);
+    if (unit)
+        snapshot += RakString("# UNIT %s_%s %s\n", metricPrefix.C_String(), name, unit);
+    snapshot += RakString("# HELP %s_%s %s\n", metricPrefix.C_String(), name, help);
+}
+void MetricsExporter::AppendValue(const char *name, const char *labels, double value)
+{
+    if (labels)
+        snapshot += RakString("%s_%s{%s} %.9g\n", metricPrefix.C_String(), name, labels, value);
+    else
+        snapshot += RakString("%s_%s %.9g\n", metricPrefix.C_String(), name, value);
+}
+void MetricsExporter::AppendValue(const char *name, const char *labels, uint64_t value)
+{
+    if (labels)
+        snapshot += RakString("%s_%s{%s} %" PRINTF_64_BIT_MODIFIER "u\n", metricPrefix.C_String(), name, labels, (long long unsigned int) value);
+    else
+        snapshot += RakString("%s_%s %" PRINTF_64_BIT_MODIFIER "u\n", metricPrefix.C_String(), name, (long long unsigned int) value);
+}
+void MetricsExporter::AppendLatencyHistogram(const char *name, const char *help, const LatencyHistogram *histograms, int histogramCount, double scale, const char *unit)
+{
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+    AppendFamily(name, "summary", help, unit);
+    RakString countName("%s_count", name);
+    for (int i=0; i < histogramCount; i++)
+    {
+        // With one histogram there is nothing to tell apart, so no priority label
+        const char *priorityLabel = histogramCount==NUMBER_OF_PRIORITIES ? priorityLabels[i] : 0;
+        for (unsigned int j=0; j < sizeof(quantiles)/sizeof(quantiles[0]); j++)
+        {
+            RakString labels;
+            if (priorityLabel)
+                labels.Set("%s,quantile=\"%g\"", priorityLabel, quantiles[j]);
+            else
+                labels.Set("quantile=\"%g\"", quantiles[j]);
+            AppendValue(name, labels.C_String(), (double) histograms[i].GetPercentile(quantiles[j]*100.0) * scale);
+        }
+        AppendValue(countName.C_String(), priorityLabel, histograms[i].GetCount());
+    }
+}
+void MetricsExporter::UpdateSnapshot(void)
+{
+    snapshot.Clear();
+
+    AppendFamily("connections", "gauge", "Connected systems.");
+    AppendValue("connections", 0, (uint64_t) connectionCount);
+    AppendFamily("connections_opened", "counter", "Connections completed, incoming and outgoing.");
+    AppendValue("connections_opened_total", 0, connectionsOpened);
+    AppendFamily("connections_closed", "counter", "Connections closed or lost.");
+    AppendValue("connections_closed_total", 0, connectionsClosed);
+    AppendFamily("connection_attempts_failed", "counter", "Outgoing connection attempts that failed.");
+    AppendValue("connection_attempts_failed_total", 0, failedConnectionAttempts);
+
+    AppendFamily("messages_sent", "counter", "Messages sent for the first time by the reliability layer. Parts of split messages count separately.");
+    for (int i=0; i < NUMBER_OF_PRIORITIES; i++)
+        AppendValue("messages_sent_total", priorityLabels[i], messagesSent[i].load(std::memory_order_relaxed));
+    AppendFamily("message_sent_bytes", "counter", "Payload bytes of messages sent for the first time.", "bytes");
+    for (int i=0; i < NUMBER_OF_PRIORITIES; i++)
+        AppendValue("message_sent_bytes_total", priorityLabels[i], messageBytesSent[i].load(std::memory_order_relaxed));
+    AppendFamily("messages_resent", "counter", "Reliable messages sent again because no ack arrived in time.");
+    for (int i=0; i < NUMBER_OF_PRIORITIES; i++)
+        AppendValue("messages_resent_total", priorityLabels[i], messagesResent[i].load(std::memory_order_relaxed));
+    AppendFamily("messages_received", "counter", "Messages received by the reliability layer, including duplicates.");
+    AppendValue("messages_received_total", 0, messagesReceived.load(std::memory_order_relaxed));
+    AppendFamily("message_received_bytes", "counter", "Payload bytes of received messages.", "bytes");
+    AppendValue("message_received_bytes_total", 0, messageBytesReceived.load(std::memory_order_relaxed));
+    AppendFamily("acks_received", "counter", "Acks received for reliable messages.");
+    AppendValue("acks_received_total", 0, acksReceived.load(std::memory_order_relaxed));
+    AppendFamily("reliability_errors", "counter", "Messages or datagrams rejected by the reliability layer.");
+    AppendValue("reliability_errors_total", 0, reliabilityErrors.load(std::memory_order_relaxed));
+    AppendFamily("reliability_warnings", "counter", "Warnings from the reliability layer.");
+    AppendValue("reliability_warnings_total", 0, reliabilityWarnings.load(std::memory_order_relaxed));
+
+    if (includeConnectionStatistics && rakPeerInterface)
+    {
+        RakNetStatistics rns;
+        memset(&rns, 0, sizeof(rns));
+        // Returns 0 if there are no connections, in which case everything stays 0
+        rakPeerInterface->GetStatistics(UNASSIGNED_SYSTEM_ADDRESS, &rns);
+
+        AppendFamily("send_buffer_messages", "gauge", "Messages waiting to be sent, over all connections.");
+        for (int i=0; i < NUMBER_OF_PRIORITIES; i++)
+            AppendValue("send_buffer_messages", priorityLabels[i], (uint64_t) rns.messageInSendBuffer[i]);
+        AppendFamily("send_buffer_bytes", "gauge", "Bytes waiting to be sent, over all connections.", "bytes");
+        for (int i=0; i < NUMBER_OF_PRIORITIES; i++)
+            AppendValue("send_buffer_bytes", priorityLabels[i], rns.bytesInSendBuffer[i]);
+        AppendFamily("resend_buffer_messages", "gauge", "Reliable messages waiting for an ack, over all connections.");
+        AppendValue("resend_buffer_messages", 0, (uint64_t) rns.messagesInResendBuffer);
+        AppendFamily("resend_buffer_bytes", "gauge", "Bytes of reliable messages waiting for an ack, over all connections.", "bytes");
+        AppendValue("resend_buffer_bytes", 0, rns.bytesInResendBuffer);
+
+        RakNetLatencyHistograms histograms;
+        if (rakPeerInterface->GetLatencyHistograms(UNASSIGNED_SYSTEM_ADDRESS, &histograms) == false)
+            histograms.Clear();
+        AppendLatencyHistogram("send_queue_time_seconds", "Time messages waited in the send buffer before they were first sent.", histograms.sendQueueTime, NUMBER_OF_PRIORITIES, 0.000001, "seconds");
+        AppendLatencyHistogram("delivery_time_seconds", "Time from Send() until a reliable message was acked.", histograms.deliveryTime, NUMBER_OF_PRIORITIES, 0.000001, "seconds");
+        AppendLatencyHistogram("ack_round_trip_time_seconds", "Round trip time of acked datagrams.", &histograms.ackRoundTripTime, 1, 0.000001, "seconds");
+        AppendLatencyHistogram("resends_per_message", "Times each reliable message was resent before it was acked.", &histograms.resendCount, 1, 1.0, 0);
+    }
+
+#if _CRABNET_SUPPORT_ReplicaManager3==1
+    if (replicaManager3)
+    {
+        AppendFamily("replica_manager3_replicas", "gauge", "Replicas referenced by ReplicaManager3.");
+        for (unsigned int i=0; i < replicaManager3->GetWorldCount(); i++)
+        {
+            WorldId worldId = replicaManager3->GetWorldIdAtIndex(i);
+            AppendValue("replica_manager3_replicas", RakString("world=\"%u\"", (unsigned int) worldId).C_String(), (uint64_t) replicaManager3->GetReplicaCount(worldId));
+        }
+        AppendFamily("replica_manager3_connections", "gauge", "Connections tracked by ReplicaManager3.");
+        for (unsigned int i=0; i < replicaManager3->GetWorldCount(); i++)
+        {
+            WorldId worldId = replicaManager3->GetWorldIdAtIndex(i);
+            AppendValue("replica_manager3_connections", RakString("world=\"%u\"", (unsigned int) worldId).C_String(), (uint64_t) replicaManager3->GetConnectionCount(worldId));
+        }
+    }
+#endif
+
+#if _CRABNET_SUPPORT_FileListTransfer==1
+    if (fileListTransfer)
+    {
+        AppendFamily("file_list_transfer_sent_bytes", "counter", "File data sent by FileListTransfer.", "bytes");
+        AppendValue("file_list_transfer_sent_bytes_total", 0, fileListTransfer->GetFileBytesSent());
+        AppendFamily("file_list_transfer_received_bytes", "counter", "File data received by FileListTransfer.", "bytes");
+        AppendValue("file_list_transfer_received_bytes_total", 0, fileListTransfer->GetFileBytesReceived());
+    }
+#endif
+
+#if _CRABNET_SUPPORT_NatPunchthroughClient==1
+    if (natPunchthroughClient)
+    {
+        AppendFamily("nat_punchthrough_attempts", "counter", "Punchthroughs started with NatPunchthroughClient::OpenNAT().");
+        AppendValue("nat_punchthrough_attempts_total", 0, (uint64_t) natPunchthroughClient->GetPunchthroughAttemptCount());
+        AppendFamily("nat_punchthrough_successes", "counter", "Punchthroughs that returned ID_NAT_PUNCHTHROUGH_SUCCEEDED.");
+        AppendValue("nat_punchthrough_successes_total", 0, (uint64_t) natPunchthroughClient->GetPunchthroughSuccessCount());
+        AppendFamily("nat_punchthrough_failures", "counter", "Punchthroughs that returned ID_NAT_PUNCHTHROUGH_FAILED.");
+        AppendValue("nat_punchthrough_failures_total", 0, (uint64_t) natPunchthroughClient->GetPunchthroughFailureCount());
+    }
+#endif
+
+#if _CRABNET_SUPPORT_NatPunchthroughServer==1
+    if (natPunchthroughServer)
+    {
+        AppendFamily("nat_punchthrough_requests", "counter", "Punchthrough requests received by NatPunchthroughServer.");
+        AppendValue("nat_punchthrough_requests_total", 0, (uint64_t) natPunchthroughServer->GetPunchthroughRequestCount());
+        AppendFamily("nat_punchthrough_requests_rejected", "counter", "Punchthrough requests rejected because the target was not connected or already busy.");
+        AppendValue("nat_punchthrough_requests_rejected_total", 0, (uint64_t) natPunchthroughServer->GetPunchthroughRejectedCount());
+    }
+#endif
+
+    for (unsigned int i=0; i < gauges.Size(); i++)
+    {
+        AppendFamily(gauges[i].name.C_String(), "gauge", gauges[i].help.C_String());
+        AppendValue(gauges[i].name.C_String(), 0, gauges[i].value);
+    }
+
+    snapshot += "# EOF\n";
+}
+
+#endif // _CRABNET_SUPPORT_*
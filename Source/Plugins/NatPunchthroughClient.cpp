@@ -46,6 +46,7 @@ NatPunchthroughClient::NatPunchthroughClient()
     portStride = 0;
     portStrideCalTimeout = 0;
     hasPortStride = UNKNOWN_PORT_STRIDE;
+    punchthroughAttemptCount = punchthroughSuccessCount = punchthroughFailureCount = 0;
 }
 NatPunchthroughClient::~NatPunchthroughClient()
 {
@@ -91,6 +92,7 @@ bool NatPunchthroughClient::OpenNAT(RakNetGUID destination, const SystemAddress
         SendPunchthrough(destination, facilitator);
     }
 
+    punchthroughAttemptCount++;
     return true;
 }
 /*
@@ -336,6 +338,7 @@ void NatPunchthroughClient::Update(void)
 }
 void NatPunchthroughClient::PushFailure(void)
 {
+    punchthroughFailureCount++;
     Packet *p = AllocatePacketUnified(sizeof(MessageID)+sizeof(unsigned char));
     p->data[0]=ID_NAT_PUNCHTHROUGH_FAILED;
     p->systemAddress=sp.targetAddress;
@@ -1091,6 +1094,7 @@ void NatPunchthroughClient::OnReadyForNextPunchthrough(void)
 
 void NatPunchthroughClient::PushSuccess(void)
 {
+    punchthroughSuccessCount++;
     Packet *p = AllocatePacketUnified(sizeof(MessageID)+sizeof(unsigned char));
     p->data[0]=ID_NAT_PUNCHTHROUGH_SUCCEEDED;
     p->systemAddress=sp.targetAddress;
@@ -123,6 +123,7 @@ NatPunchthroughServer::NatPunchthroughServer()
     for (int i=0; i < MAXIMUM_NUMBER_OF_INTERNAL_IDS; i++)
         boundAddresses[i]=UNASSIGNED_SYSTEM_ADDRESS;
     boundAddressCount=0;
+    punchthroughRequestCount=punchthroughRejectedCount=0;
 }
 NatPunchthroughServer::~NatPunchthroughServer()
 {
@@ -383,6 +384,7 @@ void NatPunchthroughServer::OnNATPunchthroughRequest(Packet *packet)
     RakNetGUID recipientGuid, senderGuid;
     incomingBs.Read(recipientGuid);
     senderGuid=packet->guid;
+    punchthroughRequestCount++;
     unsigned int i;
     bool objectExists;
     i = users.GetIndexFromKey(senderGuid, &objectExists);
@@ -402,6 +404,7 @@ void NatPunchthroughServer::OnNATPunchthroughRequest(Packet *packet)
         outgoingBs.Write(recipientGuid);
         rakPeerInterface->Send(&outgoingBs,HIGH_PRIORITY,RELIABLE_ORDERED,0,packet->systemAddress,false);
         delete ca;
+        punchthroughRejectedCount++;
         return;
     }
     ca->recipient=users[i];
@@ -411,6 +414,7 @@ void NatPunchthroughServer::OnNATPunchthroughRequest(Packet *packet)
         outgoingBs.Write(recipientGuid);
         rakPeerInterface->Send(&outgoingBs,HIGH_PRIORITY,RELIABLE_ORDERED,0,packet->systemAddress,false);
         delete ca;
+        punchthroughRejectedCount++;
         return;
     }
 
@@ -0,0 +1,401 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "NativeFeatureIncludes.h"
+#if _CRABNET_SUPPORT_PacketLogger==1
+
+#include "PacketCaptureLogger.h"
+#include "InternalPacket.h"
+#include "RakPeerInterface.h"
+#include "MessageIdentifiers.h"
+#include "GetTime.h"
+#include "RakSleep.h"
+#include "RakThread.h"
+#include "RakAssert.h"
+#include <string.h>
+#include <time.h>
+
+using namespace RakNet;
+
+STATIC_FACTORY_DEFINITIONS(PacketCaptureLogger,PacketCaptureLogger)
+
+namespace RakNet
+{
+RAK_THREAD_DECLARATION(PacketCaptureWriterLoop);
+}
+
+// How many records the writer thread collects before each fwrite
+static const unsigned int WRITE_BATCH_RECORDS=256;
+// Largest ring length. Doubling past it would overflow
+static const uint32_t MAX_RING_RECORDS=0x80000000u;
+
+PacketCaptureLogger::PacketCaptureLogger()
+{
+    ring=nullptr;
+    ringMask=0;
+    enqueuePosition=0;
+    dequeuePosition=0;
+    captureFile=nullptr;
+    isCapturing=0;
+    threadRunning=0;
+    stopWriter=0;
+    activeProducers=0;
+    droppedRecordCount=0;
+    writtenRecordCount=0;
+    snippetLength=0;
+    captureDirectMessages=true;
+}
+PacketCaptureLogger::~PacketCaptureLogger()
+{
+    StopCapture();
+    delete [] ring;
+    for (unsigned int i=0; i < oldRings.Size(); i++)
+        delete [] oldRings[i];
+}
+bool PacketCaptureLogger::StartCapture(const char *filename, unsigned int ringBufferRecords)
+{
+    if (isCapturing > 0)
+        return false;
+
+    captureFile = fopen(filename, "wb");
+    if (captureFile == nullptr)
+        return false;
+
+    PacketCaptureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PACKET_CAPTURE_MAGIC, sizeof(header.magic));
+    header.version=PACKET_CAPTURE_VERSION;
+    header.recordSize=(uint16_t) sizeof(PacketCaptureRecord);
+    header.startTimeUS=RakNet::GetTimeUS();
+    header.startTimeSeconds=(uint64_t) time(nullptr);
+    if (rakPeerInterface)
+        header.localGuid=rakPeerInterface->GetMyGUID().g;
+    else
+        header.localGuid=UNASSIGNED_CRABNET_GUID.g;
+    fwrite(&header, sizeof(header), 1, captureFile);
+
+    uint32_t ringLength=2;
+    while (ringLength < ringBufferRecords && ringLength < MAX_RING_RECORDS)
+        ringLength<<=1;
+    // Rings are only freed in the destructor, in case a network thread still has a pointer it read before StopCapture()
+    if (ring == nullptr || ringMask+1 != ringLength)
+    {
+        if (ring)
+            oldRings.Push(ring);
+        ring = new CaptureSlot[ringLength];
+        ringMask=ringLength-1;
+    }
+    // StopCapture() waited for every network thread to finish its record, so no slot is claimed
+    RakAssert(activeProducers == 0);
+    for (uint32_t i=0; i < ringLength; i++)
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    enqueuePosition=0;
+    dequeuePosition=0;
+    droppedRecordCount=0;
+    writtenRecordCount=0;
+    stopWriter=0;
+
+    isCapturing++;
+    int errorCode = RakNet::RakThread::Create(PacketCaptureWriterLoop, this);
+    if (errorCode != 0)
+    {
+        isCapturing--;
+        while (activeProducers > 0)
+            RakSleep(0);
+        fclose(captureFile);
+        captureFile=nullptr;
+        return false;
+    }
+    while (threadRunning == 0)
+        RakSleep(0);
+    return true;
+}
+void PacketCaptureLogger::StopCapture(void)
+{
+    if (isCapturing == 0)
+        return;
+
+    isCapturing--;
+    // Network threads that saw isCapturing before it was cleared commit their records, which the writer thread drains before it exits
+    while (activeProducers > 0)
+        RakSleep(0);
+    stopWriter++;
+    while (threadRunning > 0)
+        RakSleep(15);
+
+    fclose(captureFile);
+    captureFile=nullptr;
+}
+bool PacketCaptureLogger::IsCapturing(void) const
+{
+    return isCapturing > 0;
+}
+void PacketCaptureLogger::SetPayloadSnippetLength(unsigned int bytes)
+{
+    if (bytes > PACKET_CAPTURE_MAX_SNIPPET_LENGTH)
+        bytes = PACKET_CAPTURE_MAX_SNIPPET_LENGTH;
+    snippetLength=bytes;
+}
+void PacketCaptureLogger::SetCaptureDirectMessages(bool capture)
+{
+    captureDirectMessages=capture;
+}
+uint64_t PacketCaptureLogger::GetDroppedRecordCount(void) const
+{
+    return droppedRecordCount;
+}
+uint64_t PacketCaptureLogger::GetWrittenRecordCount(void) const
+{
+    return writtenRecordCount;
+}
+PacketCaptureLogger::CaptureSlot *PacketCaptureLogger::AllocateRecord(PacketCaptureEventType eventType, const SystemAddress &remoteSystemAddress)
+{
+    // Counted before checking isCapturing, so StopCapture() either sees this thread or this thread sees the capture stopped
+    activeProducers++;
+    if (isCapturing == 0)
+    {
+        activeProducers--;
+        return nullptr;
+    }
+
+    // Claim the next position. Its slot is free once the writer has moved past it a full lap ago
+    CaptureSlot *slot;
+    uint32_t position = enqueuePosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        slot = &ring[position & ringMask];
+        uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int32_t difference = (int32_t) (sequence - position);
+        if (difference == 0)
+        {
+            if (enqueuePosition.compare_exchange_weak(position, position+1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // Full. Never block a network thread on the writer
+            droppedRecordCount++;
+            activeProducers--;
+            return nullptr;
+        }
+        else
+            position = enqueuePosition.load(std::memory_order_relaxed);
+    }
+
+    PacketCaptureRecord &record = slot->record;
+    memset(&record, 0, sizeof(PacketCaptureRecord) - PACKET_CAPTURE_MAX_SNIPPET_LENGTH);
+    record.time=RakNet::GetTimeUS();
+    record.eventType=(unsigned char) eventType;
+    record.remoteGuid=rakPeerInterface ? rakPeerInterface->GetGuidFromSystemAddress(remoteSystemAddress).g : UNASSIGNED_CRABNET_GUID.g;
+    record.remotePort=remoteSystemAddress.GetPort();
+#if CRABNET_SUPPORT_IPV6==1
+    if (remoteSystemAddress.GetIPVersion()==6)
+    {
+        record.ipVersion=6;
+        memcpy(record.remoteAddress, &remoteSystemAddress.address.addr6.sin6_addr, 16);
+    }
+    else
+#endif
+    {
+        record.ipVersion=4;
+        memcpy(record.remoteAddress, &remoteSystemAddress.address.addr4.sin_addr, 4);
+    }
+    return slot;
+}
+void PacketCaptureLogger::CommitRecord(CaptureSlot *slot)
+{
+    uint32_t position = (uint32_t) (slot - ring);
+    // Recover the full position from the sequence the slot had when claimed
+    uint32_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    RakAssert((sequence & ringMask) == position);
+    (void) position;
+    slot->sequence.store(sequence+1, std::memory_order_release);
+    activeProducers--;
+}
+void PacketCaptureLogger::SetSnippet(PacketCaptureRecord *record, const unsigned char *data, unsigned int length, unsigned int maxLength)
+{
+    if (length > maxLength)
+        length = maxLength;
+    memcpy(record->snippet, data, length);
+    record->snippetLength=(unsigned char) length;
+}
+void PacketCaptureLogger::SetMessageId(PacketCaptureRecord *record, const unsigned char *data, BitSize_t bitLength)
+{
+    if (bitLength < 8)
+        return;
+    if (data[0]==ID_TIMESTAMP && BITS_TO_BYTES(bitLength) > 1+sizeof(RakNet::Time))
+    {
+        record->messageId=data[1+sizeof(RakNet::Time)];
+        record->flags|=PCF_TIMESTAMPED;
+    }
+    else
+        record->messageId=data[0];
+}
+void PacketCaptureLogger::OnDirectSocketSend(const char *data, const BitSize_t bitsUsed, SystemAddress remoteSystemAddress)
+{
+    if (!captureDirectMessages)
+        return;
+
+    CaptureSlot *slot = AllocateRecord(PCE_SEND_RAW, remoteSystemAddress);
+    if (slot == nullptr)
+        return;
+    slot->record.bitLength=bitsUsed;
+    SetMessageId(&slot->record, (const unsigned char*) data, bitsUsed);
+    SetSnippet(&slot->record, (const unsigned char*) data, BITS_TO_BYTES(bitsUsed), snippetLength);
+    CommitRecord(slot);
+}
+void PacketCaptureLogger::OnDirectSocketReceive(const char *data, const BitSize_t bitsUsed, SystemAddress remoteSystemAddress)
+{
+    if (!captureDirectMessages)
+        return;
+
+    CaptureSlot *slot = AllocateRecord(PCE_RECEIVE_RAW, remoteSystemAddress);
+    if (slot == nullptr)
+        return;
+    slot->record.bitLength=bitsUsed;
+    SetMessageId(&slot->record, (const unsigned char*) data, bitsUsed);
+    SetSnippet(&slot->record, (const unsigned char*) data, BITS_TO_BYTES(bitsUsed), snippetLength);
+    CommitRecord(slot);
+}
+void PacketCaptureLogger::OnReliabilityLayerNotification(const char *errorMessage, const BitSize_t bitsUsed, SystemAddress remoteSystemAddress, bool isError)
+{
+    CaptureSlot *slot = AllocateRecord(isError ? PCE_ERROR : PCE_WARNING, remoteSystemAddress);
+    if (slot == nullptr)
+        return;
+    slot->record.bitLength=bitsUsed;
+    // Messages are always kept, whatever the snippet length
+    SetSnippet(&slot->record, (const unsigned char*) errorMessage, (unsigned int) strlen(errorMessage), PACKET_CAPTURE_MAX_SNIPPET_LENGTH);
+    CommitRecord(slot);
+}
+void PacketCaptureLogger::OnInternalPacket(InternalPacket *internalPacket, unsigned frameNumber, SystemAddress remoteSystemAddress, RakNet::TimeMS time, int isSend)
+{
+    (void) time;
+
+    // isSend above 1 is an error code, as PacketLogger prints it
+    static const char *errorTypes[] = {"Err1", "Err2", "Err3", "Err4", "Err5", "Err6"};
+    PacketCaptureEventType eventType;
+    if (isSend == 0)
+        eventType = PCE_RECEIVE;
+    else if (isSend == 1)
+        eventType = PCE_SEND;
+    else
+        eventType = PCE_ERROR;
+
+    CaptureSlot *slot = AllocateRecord(eventType, remoteSystemAddress);
+    if (slot == nullptr)
+        return;
+    PacketCaptureRecord &record = slot->record;
+    record.bitLength=internalPacket->dataBitLength;
+    record.reliableMessageNumber=internalPacket->reliableMessageNumber;
+    record.orderingIndex=internalPacket->orderingIndex;
+    record.sequencingIndex=internalPacket->sequencingIndex;
+    record.orderingChannel=internalPacket->orderingChannel;
+    record.splitPacketId=internalPacket->splitPacketId;
+    record.splitPacketIndex=internalPacket->splitPacketIndex;
+    record.splitPacketCount=internalPacket->splitPacketCount;
+    record.frameNumber=frameNumber;
+    record.reliability=(unsigned char) internalPacket->reliability;
+    record.priority=(unsigned char) internalPacket->priority;
+    if (internalPacket->reliability==UNRELIABLE || internalPacket->reliability==UNRELIABLE_SEQUENCED || internalPacket->reliability==UNRELIABLE_WITH_ACK_RECEIPT)
+        record.flags|=PCF_UNRELIABLE;
+    if (internalPacket->splitPacketCount>0)
+        record.flags|=PCF_SPLIT;
+    SetMessageId(&record, internalPacket->data, internalPacket->dataBitLength);
+    if (eventType == PCE_ERROR)
+    {
+        const char *errorType = errorTypes[(isSend-2) % (int) (sizeof(errorTypes)/sizeof(errorTypes[0]))];
+        SetSnippet(&record, (const unsigned char*) errorType, (unsigned int) strlen(errorType), PACKET_CAPTURE_MAX_SNIPPET_LENGTH);
+    }
+    else
+        SetSnippet(&record, internalPacket->data, BITS_TO_BYTES(internalPacket->dataBitLength), snippetLength);
+    CommitRecord(slot);
+}
+void PacketCaptureLogger::OnAck(unsigned int messageNumber, SystemAddress remoteSystemAddress, RakNet::TimeMS time)
+{
+    (void) time;
+
+    CaptureSlot *slot = AllocateRecord(PCE_ACK, remoteSystemAddress);
+    if (slot == nullptr)
+        return;
+    slot->record.reliableMessageNumber=messageNumber;
+    slot->record.snippetLength=0;
+    CommitRecord(slot);
+}
+void PacketCaptureLogger::OnPushBackPacket(const char *data, const BitSize_t bitsUsed, SystemAddress remoteSystemAddress)
+{
+    CaptureSlot *slot = AllocateRecord(PCE_PUSH_BACK, remoteSystemAddress);
+    if (slot == nullptr)
+        return;
+    slot->record.bitLength=bitsUsed;
+    SetMessageId(&slot->record, (const unsigned char*) data, bitsUsed);
+    SetSnippet(&slot->record, (const unsigned char*) data, BITS_TO_BYTES(bitsUsed), snippetLength);
+    CommitRecord(slot);
+}
+bool PacketCaptureLogger::GetReceiveMessageIDs(bool messageIds[256]) const
+{
+    // Does not implement OnReceive()
+    (void) messageIds;
+    return true;
+}
+void PacketCaptureLogger::WriterThread(void)
+{
+    threadRunning++;
+    PacketCaptureRecord *batch = new PacketCaptureRecord[WRITE_BATCH_RECORDS];
+    for (;;)
+    {
+        // Read stopWriter before draining, so records committed before StopCapture() are always written
+        bool stopping = stopWriter > 0;
+        unsigned int batchSize=0;
+        for (;;)
+        {
+            CaptureSlot *slot = &ring[dequeuePosition & ringMask];
+            uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+            if ((int32_t) (sequence - (dequeuePosition+1)) < 0)
+                break;
+
+            batch[batchSize++]=slot->record;
+            // Free the slot for the producer one lap ahead
+            slot->sequence.store(dequeuePosition+ringMask+1, std::memory_order_release);
+            dequeuePosition++;
+
+            if (batchSize==WRITE_BATCH_RECORDS)
+            {
+                fwrite(batch, sizeof(PacketCaptureRecord), batchSize, captureFile);
+                writtenRecordCount+=batchSize;
+                batchSize=0;
+            }
+        }
+        if (batchSize > 0)
+        {
+            fwrite(batch, sizeof(PacketCaptureRecord), batchSize, captureFile);
+            writtenRecordCount+=batchSize;
+        }
+
+        if (stopping)
+            break;
+        RakSleep(10);
+    }
+    fflush(captureFile);
+    delete [] batch;
+    threadRunning--;
+}
+
+namespace RakNet
+{
+RAK_THREAD_DECLARATION(PacketCaptureWriterLoop)
+{
+    PacketCaptureLogger *logger = (PacketCaptureLogger *) arguments;
+    logger->WriterThread();
+    return 0;
+}
+}
+
+#endif // _CRABNET_SUPPORT_*
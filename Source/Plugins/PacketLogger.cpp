@@ -398,8 +398,8 @@ const char* PacketLogger::BaseIDTOString(unsigned char Id)
         "ID_NAT_REQUEST_BOUND_ADDRESSES",
         "ID_NAT_RESPOND_BOUND_ADDRESSES",
         "ID_FCM2_UPDATE_USER_CONTEXT",
-        "ID_RESERVED_3",
-        "ID_RESERVED_4",
+        "ID_FILE_LIST_CHUNK_MANIFEST",
+        "ID_FILE_LIST_CHUNK_REQUEST",
         "ID_RESERVED_5",
         "ID_RESERVED_6",
         "ID_RESERVED_7",
@@ -202,6 +202,10 @@ void RPC4::RegisterLocalCallback(const char* uniqueID, MessageID messageId)
         lc->messageId=messageId;
         lc->functions.Insert(str,str,false);
         localCallbacks.InsertAtIndex(lc,index);
+
+        // OnReceive() now handles messageId
+        if (rakPeerInterface)
+            rakPeerInterface->RefreshPluginMessageIDs();
     }
 }
 bool RPC4::UnregisterFunction(const char* uniqueID)
@@ -233,6 +237,8 @@ bool RPC4::UnregisterLocalCallback(const char* uniqueID, MessageID messageId)
             {
                 delete lc;
                 localCallbacks.RemoveAtIndex(index);
+                if (rakPeerInterface)
+                    rakPeerInterface->RefreshPluginMessageIDs();
                 return true;
             }
         }
@@ -622,6 +628,14 @@ PluginReceiveResult RPC4::OnReceive(Packet *packet)
 
     return RR_CONTINUE_PROCESSING;
 }
+bool RPC4::GetReceiveMessageIDs(bool messageIds[256]) const
+{
+    messageIds[ID_RPC_PLUGIN]=true;
+    // RegisterLocalCallback() and UnregisterLocalCallback() refresh these
+    for (unsigned int i=0; i < localCallbacks.Size(); i++)
+        messageIds[localCallbacks[i]->messageId]=true;
+    return true;
+}
 DataStructures::HashIndex RPC4::GetLocalSlotIndex(const char *sharedIdentifier)
 {
     return localSlots.GetIndexOf(sharedIdentifier);
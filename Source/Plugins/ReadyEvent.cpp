@@ -305,6 +305,15 @@ PluginReceiveResult ReadyEvent::OnReceive(Packet *packet)
 
     return RR_CONTINUE_PROCESSING;
 }
+bool ReadyEvent::GetReceiveMessageIDs(bool messageIds[256]) const
+{
+    messageIds[ID_READY_EVENT_UNSET]=true;
+    messageIds[ID_READY_EVENT_SET]=true;
+    messageIds[ID_READY_EVENT_ALL_SET]=true;
+    messageIds[ID_READY_EVENT_FORCE_ALL_SET]=true;
+    messageIds[ID_READY_EVENT_QUERY]=true;
+    return true;
+}
 bool ReadyEvent::AddToWaitListInternal(unsigned eventIndex, RakNetGUID guid)
 {
     ReadyEventNode *ren = readyEventNodeList[eventIndex];
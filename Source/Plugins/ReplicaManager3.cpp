@@ -60,12 +60,15 @@ LastSerializationResult::LastSerializationResult()
 {
     replica=0;
     lastSerializationResultBS=0;
+    deltaSerialization=0;
     whenLastSerialized = RakNet::GetTime();
 }
 LastSerializationResult::~LastSerializationResult()
 {
     if (lastSerializationResultBS)
         delete lastSerializationResultBS;
+    if (deltaSerialization)
+        delete deltaSerialization;
 }
 void LastSerializationResult::AllocBS(void)
 {
@@ -74,6 +77,82 @@ void LastSerializationResult::AllocBS(void)
         lastSerializationResultBS=new LastSerializationResultBS;
     }
 }
+void LastSerializationResult::AllocDelta(void)
+{
+    if (deltaSerialization==0)
+    {
+        deltaSerialization=new RM3DeltaSerialization;
+    }
+}
+void LastSerializationResult::ClearDelta(void)
+{
+    if (deltaSerialization==0)
+        return;
+
+    // Keep counting sequence numbers from where we were, so receipts for serializations sent before the clear are ignored
+    for (int z=0; z < RM3_NUM_OUTPUT_BITSTREAM_CHANNELS; z++)
+    {
+        RM3DeltaChannel *deltaChannel = deltaSerialization->channels[z];
+        if (deltaChannel==0)
+            continue;
+        deltaChannel->hasBaseline=false;
+        for (int i=0; i < RM3_DELTA_HISTORY_LENGTH; i++)
+        {
+            deltaChannel->historyValid[i]=false;
+            deltaChannel->history[i].Reset();
+        }
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+RM3DeltaChannel::RM3DeltaChannel()
+{
+    nextSequence=0;
+    hasBaseline=false;
+    baselineSequence=0;
+    for (int i=0; i < RM3_DELTA_HISTORY_LENGTH; i++)
+    {
+        historyValid[i]=false;
+        historySequence[i]=0;
+    }
+}
+RakNet::BitStream *RM3DeltaChannel::GetHistory(uint16_t sequence)
+{
+    int slot = sequence % RM3_DELTA_HISTORY_LENGTH;
+    if (historyValid[slot]==false || historySequence[slot]!=sequence)
+        return 0;
+    return &history[slot];
+}
+void RM3DeltaChannel::SetHistory(uint16_t sequence, RakNet::BitStream *bitStream)
+{
+    int slot = sequence % RM3_DELTA_HISTORY_LENGTH;
+
+    // An old unreliable message arriving late must not overwrite a newer serialization that may be the current baseline
+    if (historyValid[slot] && (int16_t)(uint16_t)(sequence-historySequence[slot]) < 0)
+        return;
+
+    historyValid[slot]=true;
+    historySequence[slot]=sequence;
+    history[slot].Reset();
+    history[slot].WriteBits(bitStream->GetData(), bitStream->GetNumberOfBitsUsed(), false);
+}
+RM3DeltaSerialization::RM3DeltaSerialization()
+{
+    for (auto &channel : channels)
+        channel = nullptr;
+}
+RM3DeltaSerialization::~RM3DeltaSerialization()
+{
+    for (auto &channel : channels)
+        delete channel;
+}
+RM3DeltaChannel *RM3DeltaSerialization::GetChannel(int channelIndex)
+{
+    if (channels[channelIndex]==0)
+        channels[channelIndex]=new RM3DeltaChannel;
+    return channels[channelIndex];
+}
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
 ReplicaManager3::ReplicaManager3()
@@ -87,7 +166,10 @@ ReplicaManager3::ReplicaManager3()
     lastAutoSerializeOccurance = 0;
     autoCreateConnections = true;
     autoDestroyConnections = true;
+    deltaSerialization = false;
     currentlyDeallocatingReplica = nullptr;
+    serializationJobsRemaining = 0;
+    serializationJobsDone.InitEvent();
 
     for (auto &world : worldsArray)
         world = nullptr;
@@ -106,6 +188,8 @@ ReplicaManager3::~ReplicaManager3()
             RakAssert(worldsList[i]->connectionList.Size()==0);
         }
     }
+    serializationThreadPool.StopThreads();
+    serializationJobsDone.CloseEvent();
     Clear(true);
 }
 
@@ -172,7 +256,7 @@ bool ReplicaManager3::PushConnection(RakNet::Connection_RM3 *newConnection, Worl
         world->connectionList.Push(newConnection);
 
         // Send message to validate the connection
-        newConnection->SendValidation(rakPeerInterface, worldId);
+        newConnection->SendValidation(rakPeerInterface, worldId, deltaSerialization);
 
         Connection_RM3::ConstructionMode constructionMode = newConnection->QueryConstructionMode();
         if (constructionMode==Connection_RM3::QUERY_REPLICA_FOR_CONSTRUCTION || constructionMode==Connection_RM3::QUERY_REPLICA_FOR_CONSTRUCTION_AND_DESTRUCTION)
@@ -214,6 +298,11 @@ RakNet::Connection_RM3 * ReplicaManager3::PopConnection(unsigned int index, Worl
     connection->ClearDownloadGroup(rakPeerInterface);
 
     RakNetGUID guid = connection->GetRakNetGUID();
+
+    // If this system reconnects it starts counting serializations over again
+    for (index2=0; index2 < world->userReplicaList.Size(); index2++)
+        world->userReplicaList[index2]->ClearReceivedDeltaSerialization(guid);
+
     // This might be wrong, I am relying on the variable creatingSystemGuid which is transmitted
     // automatically from the first system to reference the object. However, if an object changes
     // owners then it is not going to be returned here, and therefore QueryActionOnPopConnection()
@@ -247,6 +336,7 @@ RakNet::Connection_RM3 * ReplicaManager3::PopConnection(unsigned int index, Worl
                     for (int z=0; z < RM3_NUM_OUTPUT_BITSTREAM_CHANNELS; z++)
                         lsr->lastSerializationResultBS->bitStream[z].Reset();
                 }
+                lsr->ClearDelta();
             }
         }
     }
@@ -353,6 +443,8 @@ void ReplicaManager3::Dereference(RakNet::Replica3 *replica3, WorldId worldId)
         }
     }
 
+    ClearInterestPosition(replica3, worldId);
+
     // Remove from all connections
     for (index2=0; index2 < world->connectionList.Size(); index2++)
     {
@@ -510,6 +602,83 @@ void ReplicaManager3::SetAutoSerializeInterval(RakNet::Time intervalMS)
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
+void ReplicaManager3::SetDeltaSerialization(bool enabled)
+{
+    if (deltaSerialization==enabled)
+        return;
+    deltaSerialization=enabled;
+
+    // Connections tell each other whether they accept deltas when validated, so repeat that for connections that already are
+    if (rakPeerInterface==0)
+        return;
+    for (unsigned int i=0; i < worldsList.Size(); i++)
+    {
+        for (unsigned int j=0; j < worldsList[i]->connectionList.Size(); j++)
+            worldsList[i]->connectionList[j]->SendValidation(rakPeerInterface, worldsList[i]->worldId, deltaSerialization);
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+bool ReplicaManager3::GetDeltaSerialization(void) const
+{
+    return deltaSerialization;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ReplicaManager3::SetInterestGrid(float cellWidth, float cellHeight, float minX, float minY, float maxX, float maxY, WorldId worldId)
+{
+    RakAssert(worldsArray[worldId]!=0 && "World not in use");
+    RM3World *world = worldsArray[worldId];
+
+    if (world->interestGrid==0)
+        world->interestGrid = new GridSectorizer;
+    world->interestGrid->Init(cellWidth, cellHeight, minX, minY, maxX, maxY);
+
+    // Init() discards the old cells, so put back anything that was already placed
+    for (unsigned int i=0; i < world->userReplicaList.Size(); i++)
+    {
+        Replica3 *replica3 = world->userReplicaList[i];
+        if (replica3->hasInterestPosition)
+            world->interestGrid->AddEntry(replica3, replica3->interestX, replica3->interestY, replica3->interestX, replica3->interestY);
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ReplicaManager3::SetInterestPosition(RakNet::Replica3 *replica3, float x, float y, WorldId worldId)
+{
+    RakAssert(worldsArray[worldId]!=0 && "World not in use");
+    RM3World *world = worldsArray[worldId];
+    RakAssert(world->interestGrid && "Call SetInterestGrid() first");
+    RakAssert(replica3->replicaManager==this && "Call Reference() first");
+
+    if (replica3->hasInterestPosition)
+        world->interestGrid->MoveEntry(replica3, replica3->interestX, replica3->interestY, replica3->interestX, replica3->interestY, x, y, x, y);
+    else
+        world->interestGrid->AddEntry(replica3, x, y, x, y);
+    replica3->hasInterestPosition=true;
+    replica3->interestX=x;
+    replica3->interestY=y;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ReplicaManager3::ClearInterestPosition(RakNet::Replica3 *replica3, WorldId worldId)
+{
+    RakAssert(worldsArray[worldId]!=0 && "World not in use");
+    RM3World *world = worldsArray[worldId];
+
+    if (replica3->hasInterestPosition==false)
+        return;
+    if (world->interestGrid)
+        world->interestGrid->RemoveEntry(replica3, replica3->interestX, replica3->interestY, replica3->interestX, replica3->interestY);
+    replica3->hasInterestPosition=false;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
 void ReplicaManager3::GetConnectionsThatHaveReplicaConstructed(Replica3 *replica, DataStructures::List<Connection_RM3*> &connectionsThatHaveConstructedThisReplica, WorldId worldId)
 {
     RakAssert(worldsArray[worldId]!=0 && "World not in use");
@@ -563,6 +732,14 @@ ReplicaManager3::RM3World::RM3World()
 {
     worldId = 0;
     networkIDManager = nullptr;
+    interestGrid = nullptr;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+ReplicaManager3::RM3World::~RM3World()
+{
+    delete interestGrid;
 }
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -585,9 +762,12 @@ void ReplicaManager3::RM3World::Clear(ReplicaManager3 *replicaManager3)
     {
         userReplicaList[i]->replicaManager=0;
         userReplicaList[i]->SetNetworkIDManager(0);
+        userReplicaList[i]->hasInterestPosition=false;
     }
     connectionList.Clear(true);
     userReplicaList.Clear(true);
+    if (interestGrid)
+        interestGrid->Clear();
 }
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -629,6 +809,20 @@ void ReplicaManager3::RemoveWorld(WorldId worldId)
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
+WorldId ReplicaManager3::GetWorldIdAtIndex(unsigned int index)
+{
+    return worldsList[index]->worldId;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+unsigned int ReplicaManager3::GetWorldCount(void) const
+{
+    return worldsList.Size();
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
 NetworkIDManager *ReplicaManager3::GetNetworkIDManager(WorldId worldId) const
 {
     RakAssert(worldsArray[worldId]!=0 && "World not in use");
@@ -651,6 +845,23 @@ void ReplicaManager3::SetNetworkIDManager(NetworkIDManager *_networkIDManager, W
 
 PluginReceiveResult ReplicaManager3::OnReceive(Packet *packet)
 {
+    if (packet->data[0]==ID_SND_RECEIPT_ACKED || packet->data[0]==ID_SND_RECEIPT_LOSS)
+    {
+        // Receipts are also returned to the user, who may be tracking their own sends
+        if (deltaSerialization && packet->length >= sizeof(MessageID) + sizeof(uint32_t))
+        {
+            uint32_t sendReceipt;
+            memcpy(&sendReceipt, packet->data+sizeof(MessageID), sizeof(uint32_t));
+            for (unsigned int i=0; i < worldsList.Size(); i++)
+            {
+                Connection_RM3 *connection = GetConnectionByGUID(packet->guid, worldsList[i]->worldId);
+                if (connection)
+                    connection->OnDeltaSendReceipt(sendReceipt, packet->data[0]==ID_SND_RECEIPT_ACKED);
+            }
+        }
+        return RR_CONTINUE_PROCESSING;
+    }
+
     if (packet->length<2)
         return RR_CONTINUE_PROCESSING;
 
@@ -691,7 +902,9 @@ PluginReceiveResult ReplicaManager3::OnReceive(Packet *packet)
     case ID_REPLICA_MANAGER_CONSTRUCTION:
         return OnConstruction(packet, packet->data, packet->length, packet->guid, packetDataOffset, incomingWorldId);
     case ID_REPLICA_MANAGER_SERIALIZE:
-        return OnSerialize(packet, packet->data, packet->length, packet->guid, timestamp, packetDataOffset, incomingWorldId);
+        return OnSerialize(packet, packet->data, packet->length, packet->guid, timestamp, packetDataOffset, incomingWorldId, false);
+    case ID_REPLICA_MANAGER_SERIALIZE_DELTA:
+        return OnSerialize(packet, packet->data, packet->length, packet->guid, timestamp, packetDataOffset, incomingWorldId, true);
     case ID_REPLICA_MANAGER_DOWNLOAD_STARTED:
         if (packet->wasGeneratedLocally==false)
         {
@@ -709,12 +922,21 @@ PluginReceiveResult ReplicaManager3::OnReceive(Packet *packet)
     case ID_REPLICA_MANAGER_SCOPE_CHANGE:
         {
             Connection_RM3 *connection = GetConnectionByGUID(packet->guid, incomingWorldId);
+            if (connection)
+            {
+                // Versions without delta serialization send nothing after the worldId, which reads as false
+                RakNet::BitStream bsIn(packet->data,packet->length,false);
+                bsIn.IgnoreBytes(packetDataOffset);
+                bool remoteDeltaSerialization=false;
+                bsIn.Read(remoteDeltaSerialization);
+                connection->remoteDeltaSerialization=remoteDeltaSerialization;
+            }
             if (connection && connection->isValidated==false)
             {
                 // This connection is now confirmed bidirectional
                 connection->isValidated=true;
                 // Reply back on validation
-                connection->SendValidation(rakPeerInterface,incomingWorldId);
+                connection->SendValidation(rakPeerInterface,incomingWorldId,deltaSerialization);
             }
         }
     }
@@ -724,6 +946,23 @@ PluginReceiveResult ReplicaManager3::OnReceive(Packet *packet)
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
+bool ReplicaManager3::GetReceiveMessageIDs(bool messageIds[256]) const
+{
+    // Receipts are used by delta serialization
+    messageIds[ID_SND_RECEIPT_ACKED]=true;
+    messageIds[ID_SND_RECEIPT_LOSS]=true;
+    messageIds[ID_TIMESTAMP]=true;
+    messageIds[ID_REPLICA_MANAGER_CONSTRUCTION]=true;
+    messageIds[ID_REPLICA_MANAGER_SERIALIZE]=true;
+    messageIds[ID_REPLICA_MANAGER_SERIALIZE_DELTA]=true;
+    messageIds[ID_REPLICA_MANAGER_DOWNLOAD_STARTED]=true;
+    messageIds[ID_REPLICA_MANAGER_DOWNLOAD_COMPLETE]=true;
+    messageIds[ID_REPLICA_MANAGER_SCOPE_CHANGE]=true;
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
 void Connection_RM3::AutoConstructByQuery(ReplicaManager3 *replicaManager3, WorldId worldId)
 {
     ValidateLists(replicaManager3);
@@ -840,9 +1079,12 @@ void Connection_RM3::AutoConstructByQuery(ReplicaManager3 *replicaManager3, Worl
             }
         }
     }
-    else if (constructionMode==QUERY_CONNECTION_FOR_REPLICA_LIST)
+    else if (constructionMode==QUERY_CONNECTION_FOR_REPLICA_LIST || constructionMode==QUERY_INTEREST_GRID)
     {
-        QueryReplicaList(constructedReplicasCulled,destroyedReplicasCulled);
+        if (constructionMode==QUERY_CONNECTION_FOR_REPLICA_LIST)
+            QueryReplicaList(constructedReplicasCulled,destroyedReplicasCulled);
+        else
+            QueryInterestGrid(replicaManager3,worldId,constructedReplicasCulled,destroyedReplicasCulled);
 
         unsigned int idx1, idx2;
 
@@ -856,6 +1098,7 @@ void Connection_RM3::AutoConstructByQuery(ReplicaManager3 *replicaManager3, Worl
             idx1=constructedReplicaList.GetIndexFromKey(destroyedReplicasCulled[idx2], &objectExists);
             if (objectExists)
             {
+                LastSerializationResult *destroyedLsr = constructedReplicaList[idx1];
                 constructedReplicaList.RemoveAtIndex(idx1);
 
                 unsigned int j;
@@ -867,15 +1110,84 @@ void Connection_RM3::AutoConstructByQuery(ReplicaManager3 *replicaManager3, Worl
                         break;
                     }
                 }
+                delete destroyedLsr;
             }
         }
     }
 
     SendConstruction(constructedReplicasCulled,destroyedReplicasCulled,replicaManager3->defaultSendParameters,replicaManager3->rakPeerInterface,worldId,replicaManager3);
 }
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void Connection_RM3::QueryInterestGrid(ReplicaManager3 *replicaManager3, WorldId worldId, DataStructures::List<Replica3*> &newReplicasToCreate, DataStructures::List<Replica3*> &existingReplicasToDestroy)
+{
+    ReplicaManager3::RM3World *world = replicaManager3->worldsArray[worldId];
+    RakAssert(world->interestGrid && "QUERY_INTEREST_GRID requires ReplicaManager3::SetInterestGrid()");
+    if (world->interestGrid==0)
+        return;
+
+    // Only what this connection already has is checked for leaving, so this scales with the number of nearby replicas
+    unsigned int index;
+    float dx, dy;
+    float leaveRadiusSq = interestLeaveRadius*interestLeaveRadius;
+    for (index=0; index < constructedReplicaList.Size(); index++)
+    {
+        Replica3 *replica = constructedReplicaList[index]->replica;
+        // They created it, so it is theirs to destroy
+        if (replica->creatingSystemGUID==guid)
+            continue;
+        if (hasInterestArea && replica->hasInterestPosition)
+        {
+            dx = replica->interestX-interestAreaX;
+            dy = replica->interestY-interestAreaY;
+            if (dx*dx+dy*dy <= leaveRadiusSq)
+                continue;
+        }
+        existingReplicasToDestroy.Push(replica);
+    }
+
+    if (hasInterestArea==false)
+        return;
+
+    float enterRadiusSq = interestEnterRadius*interestEnterRadius;
+    world->interestGrid->GetEntries(interestQueryResult, interestAreaX-interestEnterRadius, interestAreaY-interestEnterRadius, interestAreaX+interestEnterRadius, interestAreaY+interestEnterRadius);
+    for (index=0; index < interestQueryResult.Size(); index++)
+    {
+        Replica3 *replica = (Replica3*) interestQueryResult[index];
+        dx = replica->interestX-interestAreaX;
+        dy = replica->interestY-interestAreaY;
+        if (dx*dx+dy*dy > enterRadiusSq)
+            continue;
+
+        bool objectExists;
+        constructedReplicaList.GetIndexFromKey(replica, &objectExists);
+        if (objectExists==false)
+            newReplicasToCreate.Push(replica);
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void Connection_RM3::SetInterestArea(float x, float y, float enterRadius, float leaveRadius)
+{
+    RakAssert(enterRadius >= 0.0f && leaveRadius >= enterRadius);
+    hasInterestArea=true;
+    interestAreaX=x;
+    interestAreaY=y;
+    interestEnterRadius=enterRadius;
+    interestLeaveRadius=leaveRadius;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void Connection_RM3::ClearInterestArea(void)
+{
+    hasInterestArea=false;
+}
 void ReplicaManager3::Update(void)
 {
-    unsigned int index,index2,index3;
+    unsigned int index,index3;
 
     WorldId worldId;
     RM3World *world;
@@ -907,74 +1219,47 @@ void ReplicaManager3::Update(void)
                 world->userReplicaList[index]->OnUserReplicaPreSerializeTick();
             }
 
-            unsigned int index;
-            SerializeParameters sp;
-            sp.curTime=time;
-            Connection_RM3 *connection;
-            SendSerializeIfChangedResult ssicr;
-            LastSerializationResult *lsr;
-
-            sp.messageTimestamp=0;
-            for (int i=0; i < RM3_NUM_OUTPUT_BITSTREAM_CHANNELS; i++)
-                sp.pro[i]=defaultSendParameters;
-            index2=0;
-            for (index=0; index < world->connectionList.Size(); index++)
+            if (serializationThreadPool.WasStarted() && world->connectionList.Size() > 1)
             {
-                connection = world->connectionList[index];
-                sp.bitsWrittenSoFar=0;
-                index2=0;
-                sp.destinationConnection=connection;
-
-                DataStructures::List<Replica3*> replicasToSerialize;
-                replicasToSerialize.Clear(true);
-                if (connection->QuerySerializationList(replicasToSerialize))
+                // Connections are independent, so serialize them in parallel. Sends are queued and made from this thread afterwards, in connection order
+                SerializationThreadInput input;
+                input.replicaManager=this;
+                input.worldId=worldId;
+                input.time=time;
+                serializationJobsMutex.Lock();
+                serializationJobsRemaining=world->connectionList.Size();
+                serializationJobsMutex.Unlock();
+                for (index=0; index < world->connectionList.Size(); index++)
                 {
-                    // Update replica->lsr so we can lookup in the next block
-                    // lsr is per connection / per replica
-                    while (index2 < connection->queryToSerializeReplicaList.Size())
-                    {
-                        connection->queryToSerializeReplicaList[index2]->replica->lsr=connection->queryToSerializeReplicaList[index2];
-                        index2++;
-                    }
+                    input.connection=world->connectionList[index];
+                    input.connection->isSerializingInParallel=true;
+                    serializationThreadPool.AddInput(SerializeToConnectionCB, input);
+                }
 
+                serializationThreadPool.RunInput();
 
-                    // User is manually specifying list of replicas to serialize
-                    index2=0;
-                    while (index2 < replicasToSerialize.Size())
-                    {
-                        lsr=replicasToSerialize[index2]->lsr;
-                        RakAssert(lsr->replica==replicasToSerialize[index2]);
-
-                        sp.whenLastSerialized=lsr->whenLastSerialized;
-                        ssicr=connection->SendSerializeIfChanged(lsr, &sp, GetRakPeerInterface(), worldId, this, time);
-                        if (ssicr==SSICR_SENT_DATA)
-                            lsr->whenLastSerialized=time;
-                        index2++;
-                    }
+                // Then block until the workers finish the connections they took. The event may still be set from an earlier world or tick, so check the count each time it wakes
+                for (;;)
+                {
+                    serializationJobsMutex.Lock();
+                    unsigned int remaining=serializationJobsRemaining;
+                    serializationJobsMutex.Unlock();
+                    if (remaining==0)
+                        break;
+                    serializationJobsDone.WaitOnEvent(1000);
                 }
-                else
+
+                for (index=0; index < world->connectionList.Size(); index++)
                 {
-                    while (index2 < connection->queryToSerializeReplicaList.Size())
-                    {
-                        lsr=connection->queryToSerializeReplicaList[index2];
-
-                        sp.destinationConnection=connection;
-                        sp.whenLastSerialized=lsr->whenLastSerialized;
-                        ssicr=connection->SendSerializeIfChanged(lsr, &sp, GetRakPeerInterface(), worldId, this, time);
-                        if (ssicr==SSICR_SENT_DATA)
-                        {
-                            lsr->whenLastSerialized=time;
-                            index2++;
-                        }
-                        else if (ssicr==SSICR_NEVER_SERIALIZE)
-                        {
-                            // Removed from the middle of the list
-                        }
-                        else
-                            index2++;
-                    }
+                    world->connectionList[index]->isSerializingInParallel=false;
+                    world->connectionList[index]->SendDeferredSerializations(GetRakPeerInterface());
                 }
             }
+            else
+            {
+                for (index=0; index < world->connectionList.Size(); index++)
+                    SerializeToConnection(world->connectionList[index], worldId, time);
+            }
         }
 
         lastAutoSerializeOccurance=time;
@@ -983,6 +1268,127 @@ void ReplicaManager3::Update(void)
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
+void ReplicaManager3::SerializeToConnection(Connection_RM3 *connection, WorldId worldId, RakNet::Time time)
+{
+    SerializeParameters sp;
+    sp.curTime=time;
+    sp.messageTimestamp=0;
+    for (int i=0; i < RM3_NUM_OUTPUT_BITSTREAM_CHANNELS; i++)
+        sp.pro[i]=defaultSendParameters;
+    sp.bitsWrittenSoFar=0;
+    sp.destinationConnection=connection;
+
+    SendSerializeIfChangedResult ssicr;
+    LastSerializationResult *lsr;
+    unsigned int index2=0;
+
+    DataStructures::List<Replica3*> replicasToSerialize;
+    if (connection->QuerySerializationList(replicasToSerialize))
+    {
+        if (connection->isSerializingInParallel==false)
+        {
+            // Update replica->lsr so we can lookup in the next block
+            // lsr is per connection / per replica
+            while (index2 < connection->queryToSerializeReplicaList.Size())
+            {
+                connection->queryToSerializeReplicaList[index2]->replica->lsr=connection->queryToSerializeReplicaList[index2];
+                index2++;
+            }
+        }
+
+        // User is manually specifying list of replicas to serialize
+        index2=0;
+        while (index2 < replicasToSerialize.Size())
+        {
+            if (connection->isSerializingInParallel)
+            {
+                // replica->lsr is shared between connections, so look it up instead
+                bool objectExists;
+                unsigned int lsrIndex = connection->constructedReplicaList.GetIndexFromKey(replicasToSerialize[index2], &objectExists);
+                if (objectExists==false)
+                {
+                    index2++;
+                    continue;
+                }
+                lsr=connection->constructedReplicaList[lsrIndex];
+            }
+            else
+                lsr=replicasToSerialize[index2]->lsr;
+            RakAssert(lsr->replica==replicasToSerialize[index2]);
+
+            sp.whenLastSerialized=lsr->whenLastSerialized;
+            ssicr=connection->SendSerializeIfChangedLocked(lsr, &sp, GetRakPeerInterface(), worldId, this, time);
+            if (ssicr==SSICR_SENT_DATA)
+                lsr->whenLastSerialized=time;
+            index2++;
+        }
+    }
+    else
+    {
+        while (index2 < connection->queryToSerializeReplicaList.Size())
+        {
+            lsr=connection->queryToSerializeReplicaList[index2];
+
+            sp.destinationConnection=connection;
+            sp.whenLastSerialized=lsr->whenLastSerialized;
+            ssicr=connection->SendSerializeIfChangedLocked(lsr, &sp, GetRakPeerInterface(), worldId, this, time);
+            if (ssicr==SSICR_SENT_DATA)
+            {
+                lsr->whenLastSerialized=time;
+                index2++;
+            }
+            else if (ssicr==SSICR_NEVER_SERIALIZE)
+            {
+                // Removed from the middle of the list
+            }
+            else
+                index2++;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int ReplicaManager3::SerializeToConnectionCB(SerializationThreadInput input, bool *returnOutput, void* perThreadData)
+{
+    (void) perThreadData;
+
+    input.replicaManager->SerializeToConnection(input.connection, input.worldId, input.time);
+    input.replicaManager->OnSerializationJobDone();
+    *returnOutput=false;
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ReplicaManager3::OnSerializationJobDone(void)
+{
+    serializationJobsMutex.Lock();
+    RakAssert(serializationJobsRemaining > 0);
+    bool wasLast = --serializationJobsRemaining==0;
+    serializationJobsMutex.Unlock();
+    if (wasLast)
+        serializationJobsDone.SetEvent();
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ReplicaManager3::StartSerializationThreads(int numThreads)
+{
+    serializationThreadPool.StopThreads();
+    if (numThreads > 0)
+        serializationThreadPool.StartThreads(numThreads, 0);
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ReplicaManager3::StopSerializationThreads(void)
+{
+    serializationThreadPool.StopThreads();
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
 void ReplicaManager3::OnClosedConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, PI2_LostConnectionReason lostConnectionReason )
 {
     (void) lostConnectionReason;
@@ -1095,6 +1501,7 @@ PluginReceiveResult ReplicaManager3::OnConstruction(Packet *packet, unsigned cha
 
                 // Network ID already in use
                 connection->OnDownloadExisting(existingReplica, this);
+                existingReplica->ClearReceivedDeltaSerialization(senderGuid);
 
                 constructionTickStack.Push(0);
                 bsIn.SetReadOffset(streamEnd);
@@ -1248,7 +1655,7 @@ PluginReceiveResult ReplicaManager3::OnConstruction(Packet *packet, unsigned cha
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
-PluginReceiveResult ReplicaManager3::OnSerialize(Packet *packet, unsigned char *packetData, int packetDataLength, RakNetGUID senderGuid, RakNet::Time timestamp, unsigned char packetDataOffset, WorldId worldId)
+PluginReceiveResult ReplicaManager3::OnSerialize(Packet *packet, unsigned char *packetData, int packetDataLength, RakNetGUID senderGuid, RakNet::Time timestamp, unsigned char packetDataOffset, WorldId worldId, bool isDeltaFormat)
 {
     Connection_RM3 *connection = GetConnectionByGUID(senderGuid, worldId);
     if (connection==0)
@@ -1281,9 +1688,42 @@ PluginReceiveResult ReplicaManager3::OnSerialize(Packet *packet, unsigned char *
             bsIn.Read(ds.bitstreamWrittenTo[z]);
             if (ds.bitstreamWrittenTo[z])
             {
+                // Only ID_REPLICA_MANAGER_SERIALIZE_DELTA marks each channel, so ID_REPLICA_MANAGER_SERIALIZE reads as it always has
+                bool usesDelta=false, isDelta=false;
+                uint16_t sequence=0, baselineSequence=0;
+                if (isDeltaFormat)
+                    bsIn.Read(usesDelta);
+                if (usesDelta)
+                {
+                    bsIn.ReadCompressed(sequence);
+                    bsIn.Read(isDelta);
+                    if (isDelta)
+                        bsIn.ReadCompressed(baselineSequence);
+                }
                 bsIn.ReadCompressed(bitsUsed);
                 bsIn.AlignReadToByteBoundary();
-                bsIn.Read(ds.serializationBitstream[z], bitsUsed);
+                if (isDelta==false)
+                {
+                    bsIn.Read(ds.serializationBitstream[z], bitsUsed);
+                }
+                else
+                {
+                    RakNet::BitStream deltaBs;
+                    bsIn.Read(deltaBs, bitsUsed);
+                    RM3DeltaChannel *deltaChannel = replica->GetReceivedDeltaSerialization(senderGuid)->GetChannel(z);
+                    RakNet::BitStream *baseline = deltaChannel->GetHistory(baselineSequence);
+                    // The sender only uses baselines we are known to have, so this only fails if the two systems disagree about the replica's history.
+                    // Drop this channel rather than deserialize garbage
+                    if (baseline==0 || Connection_RM3::DecodeSerializationDelta(baseline, &deltaBs, &ds.serializationBitstream[z])==false)
+                    {
+                        ds.serializationBitstream[z].Reset();
+                        ds.bitstreamWrittenTo[z]=false;
+                        continue;
+                    }
+                }
+
+                if (usesDelta)
+                    replica->GetReceivedDeltaSerialization(senderGuid)->GetChannel(z)->SetHistory(sequence, &ds.serializationBitstream[z]);
             }
         }
         replica->Deserialize(&ds);
@@ -1461,6 +1901,11 @@ Connection_RM3::Connection_RM3(const SystemAddress &_systemAddress, RakNetGUID _
     isFirstConstruction = true;
     groupConstructionAndSerialize = false;
     gotDownloadComplete = false;
+    hasInterestArea = false;
+    interestAreaX = interestAreaY = 0.0f;
+    interestEnterRadius = interestLeaveRadius = 0.0f;
+    isSerializingInParallel = false;
+    remoteDeltaSerialization = false;
 }
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -1472,6 +1917,8 @@ Connection_RM3::~Connection_RM3()
         delete constructedReplicaList[i];
     for (i=0; i < queryToConstructReplicaList.Size(); i++)
         delete queryToConstructReplicaList[i];
+    for (i=0; i < deferredSerializeSends.Size(); i++)
+        delete deferredSerializeSends[i];
 }
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -1495,7 +1942,7 @@ bool Connection_RM3::HasReplicaConstructed(RakNet::Replica3 *replica)
 }
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Connection_RM3::SendSerializeHeader(RakNet::Replica3 *replica, RakNet::Time timestamp, RakNet::BitStream *bs, WorldId worldId)
+void Connection_RM3::SendSerializeHeader(RakNet::Replica3 *replica, RakNet::Time timestamp, RakNet::BitStream *bs, WorldId worldId, bool isDeltaFormat)
 {
     bs->Reset();
 
@@ -1504,7 +1951,10 @@ void Connection_RM3::SendSerializeHeader(RakNet::Replica3 *replica, RakNet::Time
         bs->Write((MessageID)ID_TIMESTAMP);
         bs->Write(timestamp);
     }
-    bs->Write((MessageID)ID_REPLICA_MANAGER_SERIALIZE);
+    if (isDeltaFormat)
+        bs->Write((MessageID)ID_REPLICA_MANAGER_SERIALIZE_DELTA);
+    else
+        bs->Write((MessageID)ID_REPLICA_MANAGER_SERIALIZE);
     bs->Write(worldId);
     bs->Write(replica->GetNetworkID());
 }
@@ -1539,6 +1989,22 @@ SendSerializeIfChangedResult Connection_RM3::SendSerialize(RakNet::Replica3 *rep
 
     RakAssert(replica->GetNetworkID()!=UNASSIGNED_NETWORK_ID);
 
+    // Per connection history of this replica, if delta serialization is on at both ends
+    LastSerializationResult *deltaLsr=0;
+    if (remoteDeltaSerialization && replica->replicaManager && replica->replicaManager->GetDeltaSerialization())
+    {
+        bool objectExists;
+        unsigned int idx = constructedReplicaList.GetIndexFromKey(replica, &objectExists);
+        if (objectExists)
+        {
+            deltaLsr=constructedReplicaList[idx];
+            deltaLsr->AllocDelta();
+        }
+    }
+    bool sentChannels[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS];
+    uint16_t sentSequences[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS];
+    memset(sentChannels, 0, sizeof(sentChannels));
+
     BitSize_t bitsUsed;
 
     int channelIndex;
@@ -1548,7 +2014,7 @@ SendSerializeIfChangedResult Connection_RM3::SendSerialize(RakNet::Replica3 *rep
     {
         if (channelIndex==0)
         {
-            SendSerializeHeader(replica, timestamp, &out, worldId);
+            SendSerializeHeader(replica, timestamp, &out, worldId, deltaLsr!=0);
         }
         else if (lastPro!=sendParameters[channelIndex])
         {
@@ -1561,7 +2027,8 @@ SendSerializeIfChangedResult Connection_RM3::SendSerialize(RakNet::Replica3 *rep
 
             // Send remainder
             replica->OnSerializeTransmission(&out, this, bitsPerChannel, curTime);
-            rakPeer->Send(&out,lastPro.priority,lastPro.reliability,lastPro.orderingChannel,systemAddress,false,lastPro.sendReceipt);
+            SendSerializeMessage(&out, lastPro, rakPeer, deltaLsr, sentChannels, sentSequences);
+            memset(sentChannels, 0, sizeof(sentChannels));
 
             // If no data left to send, quit out
             bool anyData=false;
@@ -1577,7 +2044,7 @@ SendSerializeIfChangedResult Connection_RM3::SendSerialize(RakNet::Replica3 *rep
                 return SSICR_SENT_DATA;
 
             // Restart stream
-            SendSerializeHeader(replica, timestamp, &out, worldId);
+            SendSerializeHeader(replica, timestamp, &out, worldId, deltaLsr!=0);
 
             for (int channelIndex2=0; channelIndex2 < channelIndex; channelIndex2++)
             {
@@ -1593,9 +2060,7 @@ SendSerializeIfChangedResult Connection_RM3::SendSerialize(RakNet::Replica3 *rep
         if (channelHasData)
         {
             bitsPerChannel[channelIndex] = bitsUsed;
-            out.WriteCompressed(bitsUsed);
-            out.AlignWriteToByteBoundary();
-            out.Write(serializationData[channelIndex]);
+            sentChannels[channelIndex] = WriteSerializeChannel(deltaLsr, channelIndex, sendParameters[channelIndex], &serializationData[channelIndex], &out, &sentSequences[channelIndex]);
             // Crap, forgot this line, was a huge bug in that I'd only send to the first 3 systems
             serializationData[channelIndex].ResetReadPointer();
         }
@@ -1605,12 +2070,273 @@ SendSerializeIfChangedResult Connection_RM3::SendSerialize(RakNet::Replica3 *rep
         }
     }
     replica->OnSerializeTransmission(&out, this, bitsPerChannel, curTime);
-    rakPeer->Send(&out,lastPro.priority,lastPro.reliability,lastPro.orderingChannel,systemAddress,false,lastPro.sendReceipt);
+    SendSerializeMessage(&out, lastPro, rakPeer, deltaLsr, sentChannels, sentSequences);
     return SSICR_SENT_DATA;
 }
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
+void Connection_RM3::SendSerializeMessage(RakNet::BitStream *out, const PRO &pro, RakNet::RakPeerInterface *rakPeer, LastSerializationResult *deltaLsr, bool sentChannels[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS], uint16_t sentSequences[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS])
+{
+    if (isSerializingInParallel)
+    {
+        // Called from a worker thread. ReplicaManager3::Update() sends these once all connections are done
+        DeferredSerializeSend *deferredSend = new DeferredSerializeSend;
+        deferredSend->bitStream.Write(out);
+        deferredSend->pro=pro;
+        deferredSend->deltaLsr=deltaLsr;
+        memcpy(deferredSend->sentChannels, sentChannels, sizeof(deferredSend->sentChannels));
+        memcpy(deferredSend->sentSequences, sentSequences, sizeof(deferredSend->sentSequences));
+        deferredSerializeSends.Push(deferredSend);
+        return;
+    }
+
+    uint32_t sendReceipt=rakPeer->Send(out,pro.priority,pro.reliability,pro.orderingChannel,systemAddress,false,pro.sendReceipt);
+    OnSerializeChannelsSent(deltaLsr, pro, sendReceipt, sentChannels, sentSequences);
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void Connection_RM3::SendDeferredSerializations(RakNet::RakPeerInterface *rakPeer)
+{
+    for (unsigned int i=0; i < deferredSerializeSends.Size(); i++)
+    {
+        DeferredSerializeSend *deferredSend = deferredSerializeSends[i];
+        SendSerializeMessage(&deferredSend->bitStream, deferredSend->pro, rakPeer, deferredSend->deltaLsr, deferredSend->sentChannels, deferredSend->sentSequences);
+        delete deferredSend;
+    }
+    deferredSerializeSends.Clear(true);
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+bool Connection_RM3::WriteSerializeChannel(LastSerializationResult *deltaLsr, int channelIndex, const PRO &pro, RakNet::BitStream *channelData, RakNet::BitStream *out, uint16_t *sequenceOut)
+{
+    // Without deltaLsr this is ID_REPLICA_MANAGER_SERIALIZE, which does not mark channels
+    if (deltaLsr==0)
+    {
+        out->WriteCompressed(channelData->GetNumberOfBitsUsed());
+        out->AlignWriteToByteBoundary();
+        out->Write(channelData);
+        return false;
+    }
+
+    // A serialization can only become a baseline if we can find out that it arrived
+    bool usesDelta =
+        pro.reliability==RELIABLE_ORDERED ||
+        pro.reliability==RELIABLE_ORDERED_WITH_ACK_RECEIPT ||
+        pro.reliability==RELIABLE_WITH_ACK_RECEIPT ||
+        pro.reliability==UNRELIABLE_WITH_ACK_RECEIPT;
+    out->Write(usesDelta);
+    if (usesDelta==false)
+    {
+        out->WriteCompressed(channelData->GetNumberOfBitsUsed());
+        out->AlignWriteToByteBoundary();
+        out->Write(channelData);
+        return false;
+    }
+
+    RM3DeltaChannel *deltaChannel = deltaLsr->deltaSerialization->GetChannel(channelIndex);
+    uint16_t sequence = deltaChannel->nextSequence++;
+    out->WriteCompressed(sequence);
+
+    // The remote system only remembers the last RM3_DELTA_HISTORY_LENGTH serializations
+    RakNet::BitStream delta;
+    bool isDelta=false;
+    if (deltaChannel->hasBaseline && (uint16_t)(sequence-deltaChannel->baselineSequence) < RM3_DELTA_HISTORY_LENGTH)
+    {
+        RakNet::BitStream *baseline = deltaChannel->GetHistory(deltaChannel->baselineSequence);
+        if (baseline)
+        {
+            EncodeSerializationDelta(baseline, channelData, &delta);
+            isDelta = delta.GetNumberOfBitsUsed() < channelData->GetNumberOfBitsUsed();
+        }
+    }
+
+    out->Write(isDelta);
+    if (isDelta)
+    {
+        out->WriteCompressed(deltaChannel->baselineSequence);
+        out->WriteCompressed(delta.GetNumberOfBitsUsed());
+        out->AlignWriteToByteBoundary();
+        out->Write(delta);
+    }
+    else
+    {
+        out->WriteCompressed(channelData->GetNumberOfBitsUsed());
+        out->AlignWriteToByteBoundary();
+        out->Write(channelData);
+        channelData->ResetReadPointer();
+    }
+
+    deltaChannel->SetHistory(sequence, channelData);
+    *sequenceOut=sequence;
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void Connection_RM3::OnSerializeChannelsSent(LastSerializationResult *deltaLsr, const PRO &pro, uint32_t sendReceipt, bool sentChannels[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS], uint16_t sentSequences[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS])
+{
+    if (deltaLsr==0 || sendReceipt==0)
+        return;
+
+    for (int z=0; z < RM3_NUM_OUTPUT_BITSTREAM_CHANNELS; z++)
+    {
+        if (sentChannels[z]==false)
+            continue;
+
+        if (pro.reliability==RELIABLE_ORDERED || pro.reliability==RELIABLE_ORDERED_WITH_ACK_RECEIPT)
+        {
+            // Anything sent after this on the same ordering channel is processed after it, so it is a safe baseline immediately
+            RM3DeltaChannel *deltaChannel = deltaLsr->deltaSerialization->channels[z];
+            deltaChannel->hasBaseline=true;
+            deltaChannel->baselineSequence=sentSequences[z];
+        }
+        else
+        {
+            DeltaPendingAck pendingAck;
+            pendingAck.referenceIndex=deltaLsr->replica->referenceIndex;
+            pendingAck.channelIndex=(unsigned char) z;
+            pendingAck.sequence=sentSequences[z];
+            deltaPendingAcks.Push(sendReceipt, pendingAck);
+        }
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void Connection_RM3::OnDeltaSendReceipt(uint32_t sendReceipt, bool wasAcked)
+{
+    // Each channel sent in the message has its own entry under the same receipt
+    DeltaPendingAck pendingAck;
+    while (deltaPendingAcks.Pop(pendingAck, sendReceipt))
+    {
+        if (wasAcked)
+        {
+            // The replica may have been dereferenced since, in which case there is nothing to update
+            LastSerializationResult *lsr = GetConstructedLSRByReferenceIndex(pendingAck.referenceIndex);
+            if (lsr && lsr->deltaSerialization && lsr->deltaSerialization->channels[pendingAck.channelIndex])
+            {
+                RM3DeltaChannel *deltaChannel = lsr->deltaSerialization->channels[pendingAck.channelIndex];
+                uint16_t sequence = pendingAck.sequence;
+                // Acks can arrive out of order. Only move the baseline forward, and only to something we still remember
+                if (deltaChannel->GetHistory(sequence) &&
+                    (deltaChannel->hasBaseline==false || (int16_t)(uint16_t)(sequence-deltaChannel->baselineSequence) > 0))
+                {
+                    deltaChannel->hasBaseline=true;
+                    deltaChannel->baselineSequence=sequence;
+                }
+            }
+        }
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+unsigned long Connection_RM3::SendReceiptToInteger(const uint32_t &sendReceipt)
+{
+    return sendReceipt;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+LastSerializationResult *Connection_RM3::GetConstructedLSRByReferenceIndex(uint32_t referenceIndex)
+{
+    // constructedReplicaList is sorted by referenceIndex, see Replica3LSRComp()
+    unsigned int lower=0, upper=constructedReplicaList.Size();
+    while (lower < upper)
+    {
+        unsigned int middle = lower + (upper-lower)/2;
+        uint32_t middleIndex = constructedReplicaList[middle]->replica->referenceIndex;
+        if (middleIndex==referenceIndex)
+            return constructedReplicaList[middle];
+        if (middleIndex < referenceIndex)
+            lower=middle+1;
+        else
+            upper=middle;
+    }
+    return 0;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void Connection_RM3::EncodeSerializationDelta(const RakNet::BitStream *baseline, const RakNet::BitStream *state, RakNet::BitStream *out)
+{
+    const unsigned char *baselineData = baseline->GetData();
+    const unsigned int baselineBytes = baseline->GetNumberOfBytesUsed();
+    const unsigned char *stateData = state->GetData();
+    const BitSize_t stateBits = state->GetNumberOfBitsUsed();
+    const unsigned int stateBytes = BITS_TO_BYTES(stateBits);
+
+    out->WriteCompressed(stateBits);
+
+    unsigned int index=0;
+    while (index < stateBytes)
+    {
+        // Run of bytes identical to the baseline, which XOR to zero
+        unsigned int zeroStart=index;
+        while (index < stateBytes && stateData[index]==(index < baselineBytes ? baselineData[index] : 0))
+            index++;
+
+        // Run of changed bytes. A single unchanged byte is cheaper to include than to end the run for
+        unsigned int literalStart=index;
+        while (index < stateBytes)
+        {
+            if (stateData[index]==(index < baselineBytes ? baselineData[index] : 0) &&
+                (index+1==stateBytes || stateData[index+1]==(index+1 < baselineBytes ? baselineData[index+1] : 0)))
+                break;
+            index++;
+        }
+
+        out->WriteCompressed(literalStart-zeroStart);
+        out->WriteCompressed(index-literalStart);
+        for (unsigned int i=literalStart; i < index; i++)
+            out->Write((unsigned char) (stateData[i] ^ (i < baselineBytes ? baselineData[i] : 0)));
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+bool Connection_RM3::DecodeSerializationDelta(const RakNet::BitStream *baseline, RakNet::BitStream *in, RakNet::BitStream *state)
+{
+    BitSize_t stateBits;
+    if (in->ReadCompressed(stateBits)==false)
+        return false;
+    const unsigned int stateBytes = BITS_TO_BYTES(stateBits);
+    const unsigned int baselineBytes = baseline->GetNumberOfBytesUsed();
+
+    // Start from the baseline, zero padded or truncated to the new length, then XOR in the changed runs
+    state->Reset();
+    state->PadWithZeroToByteLength(stateBytes);
+    unsigned char *stateData = state->GetData();
+    if (baselineBytes > 0)
+        memcpy(stateData, baseline->GetData(), baselineBytes < stateBytes ? baselineBytes : stateBytes);
+
+    unsigned int index=0;
+    while (index < stateBytes)
+    {
+        unsigned int zeroCount, literalCount;
+        if (in->ReadCompressed(zeroCount)==false || in->ReadCompressed(literalCount)==false)
+            return false;
+        if (zeroCount > stateBytes-index || literalCount > stateBytes-index-zeroCount)
+            return false;
+        index+=zeroCount;
+        for (unsigned int i=0; i < literalCount; i++, index++)
+        {
+            unsigned char literal;
+            if (in->Read(literal)==false)
+                return false;
+            stateData[index]^=literal;
+        }
+    }
+
+    state->SetWriteOffset(stateBits);
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
 SendSerializeIfChangedResult Connection_RM3::SendSerializeIfChanged(LastSerializationResult *lsr, SerializeParameters *sp, RakNet::RakPeerInterface *rakPeer, unsigned char worldId, ReplicaManager3 *replicaManager, RakNet::Time curTime)
 {
     RakNet::Replica3 *replica = lsr->replica;
@@ -1766,6 +2492,21 @@ SendSerializeIfChangedResult Connection_RM3::SendSerializeIfChanged(LastSerializ
     return SendSerialize(replica, indicesToSend, sp->outputBitstream, sp->messageTimestamp, sp->pro, rakPeer, worldId, curTime);
 }
 
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+SendSerializeIfChangedResult Connection_RM3::SendSerializeIfChangedLocked(LastSerializationResult *lsr, SerializeParameters *sp, RakNet::RakPeerInterface *rakPeer, unsigned char worldId, ReplicaManager3 *replicaManager, RakNet::Time curTime)
+{
+    if (isSerializingInParallel==false)
+        return SendSerializeIfChanged(lsr, sp, rakPeer, worldId, replicaManager, curTime);
+
+    // Other connections may be serializing the same replica right now. Its lastSentSerialization and forceSendUntilNextUpdate are shared,
+    // and holding the lock also means whichever connection gets here first does the serialization that RM3SR_BROADCAST_IDENTICALLY lets the others reuse
+    lsr->replica->serializationMutex.Lock();
+    SendSerializeIfChangedResult ssicr = SendSerializeIfChanged(lsr, sp, rakPeer, worldId, replicaManager, curTime);
+    lsr->replica->serializationMutex.Unlock();
+    return ssicr;
+}
+
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Connection_RM3::OnLocalReference(Replica3* replica3, ReplicaManager3 *replicaManager)
 {
@@ -1934,6 +2675,8 @@ void Connection_RM3::OnConstructToThisConnection(unsigned int queryToConstructId
     ValidateLists(replicaManager);
     LastSerializationResult* lsr = queryToConstructReplicaList[queryToConstructIdx];
     queryToConstructReplicaList.RemoveAtIndex(queryToConstructIdx);
+    // The remote system has none of the serializations we may have sent before
+    lsr->ClearDelta();
     //assert(constructedReplicaList.GetIndexOf(lsr->replica)==(unsigned int)-1);
     constructedReplicaList.Insert(lsr->replica,lsr,true);
     //assert(queryToDestructReplicaList.GetIndexOf(lsr->replica)==(unsigned int)-1);
@@ -1948,7 +2691,7 @@ void Connection_RM3::OnConstructToThisConnection(unsigned int queryToConstructId
 void Connection_RM3::OnConstructToThisConnection(Replica3 *replica, ReplicaManager3 *replicaManager)
 {
     RakAssert(replica);
-    RakAssert(QueryConstructionMode()==QUERY_CONNECTION_FOR_REPLICA_LIST);
+    RakAssert(QueryConstructionMode()==QUERY_CONNECTION_FOR_REPLICA_LIST || QueryConstructionMode()==QUERY_INTEREST_GRID);
     (void) replicaManager;
 
     LastSerializationResult* lsr=new LastSerializationResult;
@@ -1987,6 +2730,8 @@ void Connection_RM3::OnReplicaAlreadyExists(unsigned int queryToConstructIdx, Re
     ValidateLists(replicaManager);
     LastSerializationResult* lsr = queryToConstructReplicaList[queryToConstructIdx];
     queryToConstructReplicaList.RemoveAtIndex(queryToConstructIdx);
+    // The remote system has none of the serializations we may have sent before
+    lsr->ClearDelta();
     //assert(constructedReplicaList.GetIndexOf(lsr->replica)==(unsigned int)-1);
     constructedReplicaList.Insert(lsr->replica,lsr,true);
     //assert(queryToDestructReplicaList.GetIndexOf(lsr->replica)==(unsigned int)-1);
@@ -2369,12 +3114,14 @@ void Connection_RM3::SendConstruction(DataStructures::List<Replica3*> &newObject
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
-void Connection_RM3::SendValidation(RakNet::RakPeerInterface *rakPeer, WorldId worldId)
+void Connection_RM3::SendValidation(RakNet::RakPeerInterface *rakPeer, WorldId worldId, bool deltaSerialization)
 {
     // Hijack to mean sendValidation
     RakNet::BitStream bsOut;
     bsOut.Write((MessageID)ID_REPLICA_MANAGER_SCOPE_CHANGE);
     bsOut.Write(worldId);
+    // Versions without delta serialization ignore anything after the worldId
+    bsOut.Write(deltaSerialization);
     rakPeer->Send(&bsOut,HIGH_PRIORITY,RELIABLE_ORDERED,0,systemAddress,false);
 }
 
@@ -2388,6 +3135,8 @@ Replica3::Replica3()
     forceSendUntilNextUpdate = false;
     lsr = 0;
     referenceIndex = (uint32_t) -1;
+    hasInterestPosition = false;
+    interestX = interestY = 0.0f;
 }
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -2398,6 +3147,41 @@ Replica3::~Replica3()
     {
         replicaManager->Dereference(this);
     }
+
+    for (unsigned int i=0; i < receivedDeltaSerializations.Size(); i++)
+        delete receivedDeltaSerializations[i].deltaSerialization;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+RM3DeltaSerialization *Replica3::GetReceivedDeltaSerialization(RakNetGUID sourceGuid)
+{
+    for (unsigned int i=0; i < receivedDeltaSerializations.Size(); i++)
+    {
+        if (receivedDeltaSerializations[i].sourceGuid==sourceGuid)
+            return receivedDeltaSerializations[i].deltaSerialization;
+    }
+
+    ReceivedDeltaSerialization rds;
+    rds.sourceGuid=sourceGuid;
+    rds.deltaSerialization=new RM3DeltaSerialization;
+    receivedDeltaSerializations.Push(rds);
+    return rds.deltaSerialization;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void Replica3::ClearReceivedDeltaSerialization(RakNetGUID sourceGuid)
+{
+    for (unsigned int i=0; i < receivedDeltaSerializations.Size(); i++)
+    {
+        if (receivedDeltaSerializations[i].sourceGuid==sourceGuid)
+        {
+            delete receivedDeltaSerializations[i].deltaSerialization;
+            receivedDeltaSerializations.RemoveAtIndexFast(i);
+            return;
+        }
+    }
 }
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
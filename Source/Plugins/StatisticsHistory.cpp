@@ -722,6 +722,7 @@ void StatisticsHistoryPlugin::Update(void)
     DataStructures::List<RakNetGUID> guids;
     DataStructures::List<RakNetStatistics> stats;
     rakPeerInterface->GetStatisticsList(addresses, guids, stats);
+    RakNetLatencyHistograms histograms;
 
     Time curTime = GetTime();
     for (unsigned int idx = 0; idx < guids.Size(); idx++)
@@ -768,6 +769,21 @@ void StatisticsHistoryPlugin::Update(void)
                 "RN_packetlossLastSecond",
                 (SHValueType) stats[idx].packetlossLastSecond,
                 curTime, false);
+
+            static const char *sendQueueTimeKeys[NUMBER_OF_PRIORITIES] = {"RN_sendQueueTime_IMMEDIATE_PRIORITY",
+                "RN_sendQueueTime_HIGH_PRIORITY", "RN_sendQueueTime_MEDIUM_PRIORITY", "RN_sendQueueTime_LOW_PRIORITY"};
+            static const char *deliveryTimeKeys[NUMBER_OF_PRIORITIES] = {"RN_deliveryTime_IMMEDIATE_PRIORITY",
+                "RN_deliveryTime_HIGH_PRIORITY", "RN_deliveryTime_MEDIUM_PRIORITY", "RN_deliveryTime_LOW_PRIORITY"};
+            if (rakPeerInterface->GetLatencyHistograms(addresses[idx], &histograms))
+            {
+                for (int priority = 0; priority < NUMBER_OF_PRIORITIES; priority++)
+                {
+                    AddLatencyHistogram(objectIndex, sendQueueTimeKeys[priority], histograms.sendQueueTime[priority], curTime);
+                    AddLatencyHistogram(objectIndex, deliveryTimeKeys[priority], histograms.deliveryTime[priority], curTime);
+                }
+                AddLatencyHistogram(objectIndex, "RN_ackRoundTripTime", histograms.ackRoundTripTime, curTime);
+                AddLatencyHistogram(objectIndex, "RN_resendCount", histograms.resendCount, curTime);
+            }
         }
 
     }
@@ -787,6 +803,16 @@ void StatisticsHistoryPlugin::Update(void)
     }
     */
 }
+void StatisticsHistoryPlugin::AddLatencyHistogram(unsigned int objectIndex, const char *key, const LatencyHistogram &histogram, Time curTime)
+{
+    // Nothing recorded yet, for example a priority that is never used
+    if (histogram.GetCount() == 0)
+        return;
+
+    statistics.AddValueByIndex(objectIndex, RakString("%s_p50", key), (SHValueType) histogram.GetPercentile(50.0), curTime, false);
+    statistics.AddValueByIndex(objectIndex, RakString("%s_p99", key), (SHValueType) histogram.GetPercentile(99.0), curTime, false);
+    statistics.AddValueByIndex(objectIndex, RakString("%s_p999", key), (SHValueType) histogram.GetPercentile(99.9), curTime, false);
+}
 /*
 void StatisticsHistoryPlugin::OnDirectSocketSend(const char *data, const BitSize_t bitsUsed, SystemAddress remoteSystemAddress)
 {
@@ -817,5 +843,12 @@ void StatisticsHistoryPlugin::OnNewConnection(const SystemAddress &systemAddress
     }
 }
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool StatisticsHistoryPlugin::GetReceiveMessageIDs(bool messageIds[256]) const
+{
+    // Does not implement OnReceive()
+    (void) messageIds;
+    return true;
+}
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
 #endif // _CRABNET_SUPPORT_StatisticsHistory==1
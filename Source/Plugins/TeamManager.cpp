@@ -2262,6 +2262,17 @@ PluginReceiveResult TeamManager::OnReceive(Packet *packet)
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
+bool TeamManager::GetReceiveMessageIDs(bool messageIds[256]) const
+{
+    messageIds[ID_FCM2_NEW_HOST]=true;
+    messageIds[ID_TEAM_BALANCER_TEAM_ASSIGNED]=true;
+    messageIds[ID_TEAM_BALANCER_TEAM_REQUESTED_CANCELLED]=true;
+    messageIds[ID_TEAM_BALANCER_INTERNAL]=true;
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
 void TeamManager::OnClosedConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, PI2_LostConnectionReason lostConnectionReason )
 {
     for (unsigned int i=0; i < worldsList.Size(); i++)
@@ -14,6 +14,7 @@
 #include "RakSleep.h"
 #include "Utils/SocketDefines.h"
 #include "GetTime.h"
+#include "RakTrace.h"
 #include <stdio.h>
 #include <string.h> // memcpy
 
@@ -301,6 +302,7 @@ RAK_THREAD_DECLARATION(RNS2_Berkley::RecvFromLoop)
 unsigned RNS2_Berkley::RecvFromLoopInt(void)
 {
     isRecvFromLoopThreadActive++;
+    CRABNET_TRACE_THREAD_NAME("RNS2_Berkley::RecvFromLoop");
 
     while ( endThreads == false )
     {
@@ -313,6 +315,7 @@ unsigned RNS2_Berkley::RecvFromLoopInt(void)
 
             if (recvFromStruct->bytesRead>0)
             {
+                CRABNET_TRACE_ZONE("RNS2EventHandler::OnRNS2Recv");
                 RakAssert(recvFromStruct->systemAddress.GetPort());
                 binding.eventHandler->OnRNS2Recv(recvFromStruct);
             }
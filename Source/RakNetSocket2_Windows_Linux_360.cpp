@@ -17,6 +17,7 @@
 #if (defined(_WIN32) || defined(__GNUC__)  || defined(__GCCXML__) || defined(__S3E__) ) && !defined(__native_client__)
 
 RNS2SendResult RNS2_Windows_Linux_360::Send_Windows_Linux_360NoVDP( RNS2Socket rns2Socket, RNS2_SendParameters *sendParameters ) {
+    CRABNET_TRACE_ZONE("RNS2_Windows_Linux_360::Send");
 
     int len=0;
     do
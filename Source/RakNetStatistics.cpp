@@ -14,11 +14,75 @@
 
 #include "RakNetStatistics.h"
 #include <stdio.h> // sprintf
+#include <string.h> // memset, strcat
 #include "GetTime.h"
 #include "RakString.h"
 
 using namespace RakNet;
 
+uint64_t LatencyHistogram::GetCount(void) const
+{
+    uint64_t count = 0;
+    for (unsigned int i = 0; i < LATENCY_HISTOGRAM_BUCKET_COUNT; i++)
+        count += counts[i];
+    return count;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double percentile) const
+{
+    uint64_t count = GetCount();
+    if (count == 0)
+        return 0;
+
+    // Index of the value we want, counting from 1
+    uint64_t rank = (uint64_t) (percentile / 100.0 * (double) count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    else if (rank > count)
+        rank = count;
+
+    uint64_t runningCount = 0;
+    for (unsigned int i = 0; i < LATENCY_HISTOGRAM_BUCKET_COUNT - 1; i++)
+    {
+        runningCount += counts[i];
+        if (runningCount >= rank)
+            return BucketToValue(i + 1) - 1;
+    }
+    return BucketToValue(LATENCY_HISTOGRAM_BUCKET_COUNT - 1);
+}
+
+double LatencyHistogram::GetMean(void) const
+{
+    uint64_t count = 0;
+    double sum = 0.0;
+    for (unsigned int i = 0; i < LATENCY_HISTOGRAM_BUCKET_COUNT; i++)
+    {
+        if (counts[i] == 0)
+            continue;
+        double low = (double) BucketToValue(i);
+        double high = i + 1 < LATENCY_HISTOGRAM_BUCKET_COUNT ? (double) BucketToValue(i + 1) : low + 1.0;
+        sum += (low + high - 1.0) * 0.5 * (double) counts[i];
+        count += counts[i];
+    }
+    if (count == 0)
+        return 0.0;
+    return sum / (double) count;
+}
+
+void LatencyHistogram::Clear(void)
+{
+    memset(counts, 0, sizeof(counts));
+}
+
+uint64_t LatencyHistogram::BucketToValue(unsigned int bucket)
+{
+    if (bucket < LATENCY_HISTOGRAM_SUB_BUCKET_COUNT)
+        return bucket;
+    unsigned int shift = bucket / LATENCY_HISTOGRAM_SUB_BUCKET_COUNT - 1;
+    uint64_t subBucket = bucket % LATENCY_HISTOGRAM_SUB_BUCKET_COUNT + LATENCY_HISTOGRAM_SUB_BUCKET_COUNT;
+    return subBucket << shift;
+}
+
 // Verbosity level currently supports 0 (low), 1 (medium), 2 (high)
 // Buffer must be hold enough to hold the output string.  See the source to get an idea of how many bytes will be output
 void RAK_DLL_EXPORT RakNet::StatisticsToString(RakNetStatistics *s, char *buffer, int verbosityLevel)
@@ -150,3 +214,42 @@ void RAK_DLL_EXPORT RakNet::StatisticsToString(RakNetStatistics *s, char *buffer
         }
     }
 }
+
+static void LatencyHistogramToString(const char *name, const LatencyHistogram &histogram, char *buffer)
+{
+    char buff2[128];
+    sprintf(buff2, "%-28s %10" PRINTF_64_BIT_MODIFIER "u %10" PRINTF_64_BIT_MODIFIER "u %10" PRINTF_64_BIT_MODIFIER "u %10" PRINTF_64_BIT_MODIFIER "u\n",
+            name,
+            (long long unsigned int) histogram.GetCount(),
+            (long long unsigned int) histogram.GetPercentile(50.0),
+            (long long unsigned int) histogram.GetPercentile(99.0),
+            (long long unsigned int) histogram.GetPercentile(99.9)
+    );
+    strcat(buffer, buff2);
+}
+
+void RAK_DLL_EXPORT RakNet::LatencyHistogramsToString(RakNetLatencyHistograms *s, char *buffer)
+{
+    if (s == 0)
+    {
+        sprintf(buffer, "stats is a NULL pointer in LatencyHistogramsToString\n");
+        return;
+    }
+
+    static const char *priorityNames[NUMBER_OF_PRIORITIES] = {"immediate", "high", "medium", "low"};
+    char name[64];
+
+    sprintf(buffer, "%-28s %10s %10s %10s %10s\n", "", "count", "p50", "p99", "p99.9");
+    for (int i = 0; i < NUMBER_OF_PRIORITIES; i++)
+    {
+        sprintf(name, "Send queue us, %s", priorityNames[i]);
+        LatencyHistogramToString(name, s->sendQueueTime[i], buffer);
+    }
+    for (int i = 0; i < NUMBER_OF_PRIORITIES; i++)
+    {
+        sprintf(name, "Delivery us, %s", priorityNames[i]);
+        LatencyHistogramToString(name, s->deliveryTime[i], buffer);
+    }
+    LatencyHistogramToString("Ack round trip us", s->ackRoundTripTime, buffer);
+    LatencyHistogramToString("Resends per message", s->resendCount, buffer);
+}
@@ -53,6 +53,9 @@
 #include "NetworkIDManager.h"
 #include "SignaledEvent.h"
 #include "SuperFastHash.h"
+#include "RakTrace.h"
+#include "RakAllocator.h"
+#include "PacketCache.h"
 #include "RakAlloca.h"
 
 #ifdef USE_THREADED_SEND
@@ -155,12 +158,12 @@ Packet *RakPeer::AllocPacket(unsigned dataSize)
 //     p->guid=UNASSIGNED_CRABNET_GUID;
 //     return p;
 
-    RakNet::Packet *p;
-    packetAllocationPoolMutex.Lock();
-    p = packetAllocationPool.Allocate();
-    packetAllocationPoolMutex.Unlock();
-    p = new((void *) p) Packet;
-    p->data = (unsigned char *) malloc(dataSize);
+    RakNet::Packet *p = AllocCachedPacket();
+    RakAssert(p);
+    if (dataSize <= CRABNET_PACKET_INLINE_DATA_SIZE)
+        p->data = p->inlineData;
+    else
+        p->data = (unsigned char *) rakMalloc_Ex(dataSize, _FILE_AND_LINE_);
     p->length = dataSize;
     p->bitSize = BYTES_TO_BITS(dataSize);
     p->deleteData = true;
@@ -172,13 +175,17 @@ Packet *RakPeer::AllocPacket(unsigned dataSize)
 Packet *RakPeer::AllocPacket(unsigned dataSize, unsigned char *data)
 {
     // Packet *p = (Packet *)malloc(sizeof(Packet));
-    RakNet::Packet *p;
-    packetAllocationPoolMutex.Lock();
-    p = packetAllocationPool.Allocate();
-    packetAllocationPoolMutex.Unlock();
-    p = new((void *) p) Packet;
+    RakNet::Packet *p = AllocCachedPacket();
     RakAssert(p);
-    p->data = data;
+    if (dataSize <= CRABNET_PACKET_INLINE_DATA_SIZE)
+    {
+        // Also frees an allocated buffer here, on the thread that allocated it, rather than on whichever thread deallocates the packet
+        memcpy(p->inlineData, data, dataSize);
+        FreeReceivedData(data);
+        p->data = p->inlineData;
+    }
+    else
+        p->data = data;
     p->length = dataSize;
     p->bitSize = BYTES_TO_BITS(dataSize);
     p->deleteData = true;
@@ -187,6 +194,12 @@ Packet *RakPeer::AllocPacket(unsigned dataSize, unsigned char *data)
     return p;
 }
 
+void RakPeer::FreeReceivedData(unsigned char *data)
+{
+    if (data != receivedInlineData)
+        rakFree_Ex(data, _FILE_AND_LINE_);
+}
+
 STATIC_FACTORY_DEFINITIONS(RakPeerInterface, RakPeer)
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -220,6 +233,8 @@ RakPeer::RakPeer()
     endThreads = true;
     isMainLoopThreadActive = false;
     incomingDatagramEventHandler = 0;
+    pluginReceiveTableInUse = 0;
+    pluginReceiveTableDirty = false;
 
     // isRecvfromThreadActive=false;
 #if defined(GET_TIME_SPIKE_LIMIT) && GET_TIME_SPIKE_LIMIT > 0
@@ -258,10 +273,6 @@ RakPeer::RakPeer()
     bufferedCommands.SetPageSize(sizeof(BufferedCommandStruct) * 16);
     socketQueryOutput.SetPageSize(sizeof(SocketQueryOutput) * 8);
 
-    packetAllocationPoolMutex.Lock();
-    packetAllocationPool.SetPageSize(sizeof(DataStructures::MemoryPool<Packet>::MemoryWithPage) * 32);
-    packetAllocationPoolMutex.Unlock();
-
     remoteSystemIndexPool.SetPageSize(sizeof(DataStructures::MemoryPool<RemoteSystemIndex>::MemoryWithPage) * 32);
 
     GenerateGUID();
@@ -1107,9 +1118,6 @@ void RakPeer::Shutdown(unsigned int blockDuration, unsigned char orderingChannel
         DeallocatePacket(packetReturnQueue[i]);
     packetReturnQueue.Clear();
     packetReturnMutex.Unlock();
-    packetAllocationPoolMutex.Lock();
-    packetAllocationPool.Clear();
-    packetAllocationPoolMutex.Unlock();
 
     /*
     if (isRecvFromLoopThreadActive.GetValue()>0)
@@ -1398,6 +1406,132 @@ uint32_t RakPeer::SendList(const char **data, const int *lengths, const int numP
     return usedSendReceipt;
 }
 
+// ---------------------------------------------------------------------------------------------------------------------
+// Description:
+// Sends many messages at once, as Send() would one at a time, but as a single buffered command
+//
+// Returns:
+// The number of messages accepted
+// ---------------------------------------------------------------------------------------------------------------------
+unsigned int RakPeer::SendBatch(const BatchedMessage *messages, unsigned int numMessages, uint32_t *receipts)
+{
+    if (receipts)
+        memset(receipts, 0, sizeof(uint32_t) * numMessages);
+
+    if (messages == 0 || numMessages == 0)
+        return 0;
+
+    if (remoteSystemList == 0 || endThreads == true)
+        return 0;
+
+    // Size the batch for every message that Send() would accept
+    size_t batchSize = 0;
+    unsigned int numberOfUnforcedReceipts = 0;
+    unsigned int i;
+    for (i = 0; i < numMessages; i++)
+    {
+        const BatchedMessage &message = messages[i];
+#ifdef _DEBUG
+        RakAssert(message.data && message.length > 0);
+#endif
+        RakAssert(!(message.reliability >= NUMBER_OF_RELIABILITIES || message.reliability < 0));
+        RakAssert(!(message.priority > NUMBER_OF_PRIORITIES || message.priority < 0));
+        RakAssert(!(message.orderingChannel >= NUMBER_OF_ORDERED_STREAMS));
+
+        if (message.data == 0 || message.length < 0 || (message.broadcast == false && message.systemIdentifier.IsUndefined()))
+            continue;
+
+        batchSize += GetBatchedMessageSize((size_t) message.length);
+        if (message.forceReceiptNumber == 0)
+            numberOfUnforcedReceipts++;
+    }
+    if (batchSize == 0)
+        return 0;
+
+    // Reserve receipt numbers for the whole batch under one lock, skipping 0 as IncrementNextSendReceipt() does
+    uint32_t nextReceipt = 0;
+    if (numberOfUnforcedReceipts > 0)
+    {
+        sendReceiptSerialMutex.Lock();
+        nextReceipt = sendReceiptSerial;
+        for (i = 0; i < numberOfUnforcedReceipts; i++)
+        {
+            if (++sendReceiptSerial == 0)
+                sendReceiptSerial = 1;
+        }
+        sendReceiptSerialMutex.Unlock();
+    }
+
+    // Making a copy doesn't lose efficiency, the reliability layer copies small messages into the internal packet rather than allocating
+    char *batch = (char *) rakMalloc_Ex(batchSize, _FILE_AND_LINE_);
+    if (batch == 0)
+    {
+        RakAssert(0)
+        return 0;
+    }
+
+    char *position = batch;
+    unsigned int numberOfBufferedMessages = 0, numberOfAcceptedMessages = 0;
+    bool wakeNetworkThread = false;
+    for (i = 0; i < numMessages; i++)
+    {
+        const BatchedMessage &message = messages[i];
+        if (message.data == 0 || message.length < 0 || (message.broadcast == false && message.systemIdentifier.IsUndefined()))
+            continue;
+
+        uint32_t usedSendReceipt;
+        if (message.forceReceiptNumber != 0)
+            usedSendReceipt = message.forceReceiptNumber;
+        else
+        {
+            usedSendReceipt = nextReceipt;
+            if (++nextReceipt == 0)
+                nextReceipt = 1;
+        }
+        if (receipts)
+            receipts[i] = usedSendReceipt;
+        numberOfAcceptedMessages++;
+
+        if (message.broadcast == false && IsLoopbackAddress(message.systemIdentifier, true))
+        {
+            SendLoopback(message.data, message.length);
+
+            if (message.reliability >= UNRELIABLE_WITH_ACK_RECEIPT)
+            {
+                // The receipt returned in receipts[i], not the next unreserved one
+                char buff[5];
+                buff[0] = ID_SND_RECEIPT_ACKED;
+                memcpy(buff + 1, &usedSendReceipt, 4);
+                SendLoopback(buff, 5);
+            }
+            continue;
+        }
+
+        BufferedBatchMessage *bufferedMessage = new((void *) position) BufferedBatchMessage;
+        bufferedMessage->numberOfBitsToSend = BYTES_TO_BITS(message.length);
+        bufferedMessage->priority = message.priority;
+        bufferedMessage->reliability = message.reliability;
+        bufferedMessage->orderingChannel = message.orderingChannel;
+        bufferedMessage->systemIdentifier = message.systemIdentifier;
+        bufferedMessage->broadcast = message.broadcast;
+        bufferedMessage->connectionMode = RemoteSystemStruct::NO_ACTION;
+        bufferedMessage->receipt = usedSendReceipt;
+        memcpy(position + sizeof(BufferedBatchMessage), message.data, (size_t) message.length);
+        position += GetBatchedMessageSize((size_t) message.length);
+        numberOfBufferedMessages++;
+
+        if (message.priority == IMMEDIATE_PRIORITY)
+            wakeNetworkThread = true;
+    }
+
+    if (numberOfBufferedMessages > 0)
+        PushSendBatch(batch, numberOfBufferedMessages, wakeNetworkThread);
+    else
+        rakFree_Ex(batch, _FILE_AND_LINE_);
+
+    return numberOfAcceptedMessages;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 // Description:
 // Gets a packet from the incoming packet queue. Use DeallocatePacket to deallocate the packet after you are done with it.
@@ -1419,10 +1553,8 @@ Packet *RakPeer::Receive(void)
 
     RakNet::Packet *packet;
 //    Packet **threadPacket;
-    PluginReceiveResult pluginResult;
 
-    int offset;
-    unsigned int i;
+    CRABNET_TRACE_ZONE("RakPeer::Receive");
 
     // User should call RunUpdateCycle and RunRecvFromOnce to do this commented code
     /*
@@ -1461,14 +1593,7 @@ Packet *RakPeer::Receive(void)
 #endif
     */
 
-    for (i = 0; i < pluginListTS.Size(); i++)
-    {
-        pluginListTS[i]->Update();
-    }
-    for (i = 0; i < pluginListNTS.Size(); i++)
-    {
-        pluginListNTS[i]->Update();
-    }
+    UpdatePlugins();
 
     do
     {
@@ -1481,65 +1606,62 @@ Packet *RakPeer::Receive(void)
         if (packet == 0)
             return 0;
 
-//        unsigned char msgId;
-        if ((packet->length >= sizeof(unsigned char) + sizeof(RakNet::Time)) &&
-            ((unsigned char) packet->data[0] == ID_TIMESTAMP))
-        {
-            offset = sizeof(unsigned char);
-            ShiftIncomingTimestamp(packet->data + offset, packet->systemAddress);
-//            msgId=packet->data[sizeof(unsigned char) + sizeof( RakNet::Time )];
-        }
-//        else
-        //        msgId=packet->data[0];
+        if (!ProcessReturnedPacket(packet))
+            packet = 0; // Will do the loop again and get another packet
+    } while (packet == 0);
 
-        // Some locally generated packets need to be processed by plugins, for example ID_FCM2_NEW_HOST
-        // The plugin itself should intercept these messages generated remotely
-//         if (packet->wasGeneratedLocally)
-//             return packet;
+#ifdef _DEBUG
+    RakAssert(packet->data);
+#endif
+
+    return packet;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Description:
+// Gets up to maxPackets packets from the incoming packet queue, taking packetReturnMutex once and calling plugin Update() once
+//
+// Returns:
+// The number of packets written to packets
+// ---------------------------------------------------------------------------------------------------------------------
+unsigned int RakPeer::ReceiveBatch(Packet **packets, unsigned int maxPackets)
+{
+    if (!(IsActive()) || maxPackets == 0)
+        return 0;
 
+    CRABNET_TRACE_ZONE("RakPeer::ReceiveBatch");
 
-        CallPluginCallbacks(pluginListTS, packet);
-        CallPluginCallbacks(pluginListNTS, packet);
+    UpdatePlugins();
 
-        for (i = 0; i < pluginListTS.Size(); i++)
-        {
-            pluginResult = pluginListTS[i]->OnReceive(packet);
-            if (pluginResult == RR_STOP_PROCESSING_AND_DEALLOCATE)
-            {
-                DeallocatePacket(packet);
-                packet = 0; // Will do the loop again and get another packet
-                break; // break out of the enclosing for
-            }
-            else if (pluginResult == RR_STOP_PROCESSING)
-            {
-                packet = 0;
-                break;
-            }
-        }
+    unsigned int packetCount = 0;
+    while (packetCount < maxPackets)
+    {
+        unsigned int requested = maxPackets - packetCount;
+        unsigned int popped = 0;
+        packetReturnMutex.Lock();
+        while (popped < requested && !packetReturnQueue.IsEmpty())
+            packets[packetCount + popped++] = packetReturnQueue.Pop();
+        packetReturnMutex.Unlock();
 
-        for (i = 0; i < pluginListNTS.Size(); i++)
+        // Keep the packets the plugins passed on, in order
+        unsigned int end = packetCount + popped;
+        for (unsigned int i = packetCount; i < end; i++)
         {
-            pluginResult = pluginListNTS[i]->OnReceive(packet);
-            if (pluginResult == RR_STOP_PROCESSING_AND_DEALLOCATE)
-            {
-                DeallocatePacket(packet);
-                packet = 0; // Will do the loop again and get another packet
-                break; // break out of the enclosing for
-            }
-            else if (pluginResult == RR_STOP_PROCESSING)
-            {
-                packet = 0;
-                break;
-            }
+            if (ProcessReturnedPacket(packets[i]))
+                packets[packetCount++] = packets[i];
         }
 
-    } while (packet == 0);
+        // Fewer than requested means the queue is empty. Otherwise plugins kept some packets, so there is room for more
+        if (popped < requested)
+            break;
+    }
 
 #ifdef _DEBUG
-    RakAssert(packet->data);
+    for (unsigned int i = 0; i < packetCount; i++)
+        RakAssert(packets[i]->data);
 #endif
 
-    return packet;
+    return packetCount;
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -1553,11 +1675,9 @@ void RakPeer::DeallocatePacket(Packet *packet)
 
     if (packet->deleteData)
     {
-        free(packet->data);
-        packet->~Packet();
-        packetAllocationPoolMutex.Lock();
-        packetAllocationPool.Release(packet);
-        packetAllocationPoolMutex.Unlock();
+        if (packet->data != packet->inlineData)
+            rakFree_Ex(packet->data, _FILE_AND_LINE_);
+        ReleaseCachedPacket(packet);
     }
     else
     {
@@ -1565,6 +1685,16 @@ void RakPeer::DeallocatePacket(Packet *packet)
     }
 }
 
+// ---------------------------------------------------------------------------------------------------------------------
+// Description:
+// Call this to deallocate packets returned by ReceiveBatch
+// ---------------------------------------------------------------------------------------------------------------------
+void RakPeer::DeallocatePackets(Packet **packets, unsigned int numPackets)
+{
+    for (unsigned int i = 0; i < numPackets; i++)
+        DeallocatePacket(packets[i]);
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 // Description:
 // Return the total number of connections we are allowed
@@ -2726,6 +2856,7 @@ void RakPeer::AttachPlugin(PluginInterface2 *plugin)
             pluginListTS.Insert(plugin);
         }
     }
+    RefreshPluginMessageIDs();
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -2761,10 +2892,43 @@ void RakPeer::DetachPlugin(PluginInterface2 *plugin)
             pluginListTS.RemoveFromEnd();
         }
     }
+    RefreshPluginMessageIDs();
     plugin->OnDetach();
     plugin->SetRakPeerInterface(0);
 }
 
+// ---------------------------------------------------------------------------------------------------------------------
+// Rebuilds pluginReceiveTable from the attached plugins
+// ---------------------------------------------------------------------------------------------------------------------
+void RakPeer::RefreshPluginMessageIDs(void)
+{
+    // A plugin's OnReceive() can get here, for example through RPC4::RegisterLocalCallback() or DetachPlugin(). Don't free the list being walked
+    if (pluginReceiveTableInUse > 0)
+    {
+        pluginReceiveTableDirty = true;
+        return;
+    }
+    pluginReceiveTableDirty = false;
+
+    unsigned int i, messageId;
+    for (messageId = 0; messageId < 256; messageId++)
+        pluginReceiveTable[messageId].Clear(true);
+
+    // Thread safe plugins get packets first, as they always have
+    bool messageIds[256];
+    for (i = 0; i < pluginListTS.Size() + pluginListNTS.Size(); i++)
+    {
+        PluginInterface2 *plugin = i < pluginListTS.Size() ? pluginListTS[i] : pluginListNTS[i - pluginListTS.Size()];
+        memset(messageIds, 0, sizeof(messageIds));
+        bool filtered = plugin->GetReceiveMessageIDs(messageIds);
+        for (messageId = 0; messageId < 256; messageId++)
+        {
+            if (filtered == false || messageIds[messageId])
+                pluginReceiveTable[messageId].Push(plugin);
+        }
+    }
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 // Put a packet back at the end of the receive queue in case you don't want to deal with it immediately
 //
@@ -3076,6 +3240,43 @@ void RakPeer::GetStatisticsList(DataStructures::List<SystemAddress> &addresses,
     }
 }
 
+// ---------------------------------------------------------------------------------------------------------------------
+bool RakPeer::GetLatencyHistograms(const SystemAddress systemAddress, RakNetLatencyHistograms *histograms)
+{
+    if (remoteSystemList == 0 || endThreads == true)
+        return false;
+
+    if (systemAddress == UNASSIGNED_SYSTEM_ADDRESS)
+    {
+        bool firstWrite = false;
+        // Sum over all connections
+        for (unsigned short i = 0; i < maximumNumberOfPeers; i++)
+        {
+            if (remoteSystemList[i].isActive)
+            {
+                if (firstWrite == false)
+                {
+                    remoteSystemList[i].reliabilityLayer.GetLatencyHistograms(histograms);
+                    firstWrite = true;
+                }
+                else
+                {
+                    RakNetLatencyHistograms histogramsTemp;
+                    remoteSystemList[i].reliabilityLayer.GetLatencyHistograms(&histogramsTemp);
+                    (*histograms) += histogramsTemp;
+                }
+            }
+        }
+        return firstWrite;
+    }
+
+    RemoteSystemStruct *rss = GetRemoteSystemFromSystemAddress(systemAddress, false, false);
+    if (rss == 0)
+        return false;
+    rss->reliabilityLayer.GetLatencyHistograms(histograms);
+    return true;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 bool RakPeer::GetStatistics(const unsigned int index, RakNetStatistics *rns)
 {
@@ -4029,7 +4230,7 @@ void RakPeer::SendBuffered(const char *data, BitSize_t numberOfBitsToSend, Packe
 {
     BufferedCommandStruct *bcs = bufferedCommands.Allocate();
     // Making a copy doesn't lose efficiency because I tell the reliability layer to use this allocation for its own copy
-    bcs->data = (char *) malloc((size_t) BITS_TO_BYTES(numberOfBitsToSend));
+    bcs->data = (char *) rakMalloc_Ex((size_t) BITS_TO_BYTES(numberOfBitsToSend), _FILE_AND_LINE_);
     if (bcs->data == 0)
     {
         RakAssert(0)
@@ -4075,13 +4276,14 @@ void RakPeer::SendBufferedList(const char **data, const int *lengths, const int
     if (totalLength == 0)
         return;
 
-    // Making a copy doesn't lose efficiency because I tell the reliability layer to use this allocation for its own copy
-    char *dataAggregate = (char *) malloc((size_t) totalLength);
-    if (dataAggregate == 0)
+    // Sent as a batch of one message, so the parameters are gathered straight into the command
+    char *batch = (char *) rakMalloc_Ex(GetBatchedMessageSize(totalLength), _FILE_AND_LINE_);
+    if (batch == 0)
     {
         RakAssert(0)
         return;
     }
+    char *dataAggregate = batch + sizeof(BufferedBatchMessage);
     for (unsigned i = 0, lengthOffset = 0; i < numParameters; i++)
     {
         if (lengths[i] > 0)
@@ -4094,7 +4296,7 @@ void RakPeer::SendBufferedList(const char **data, const int *lengths, const int
     if (!broadcast && IsLoopbackAddress(systemIdentifier, true))
     {
         SendLoopback(dataAggregate, totalLength);
-        free(dataAggregate);
+        rakFree_Ex(batch, _FILE_AND_LINE_);
         return;
     }
 
@@ -4102,21 +4304,38 @@ void RakPeer::SendBufferedList(const char **data, const int *lengths, const int
     RakAssert(!(priority > NUMBER_OF_PRIORITIES || priority < 0));
     RakAssert(!(orderingChannel >= NUMBER_OF_ORDERED_STREAMS));
 
+    BufferedBatchMessage *bufferedMessage = new((void *) batch) BufferedBatchMessage;
+    bufferedMessage->numberOfBitsToSend = BYTES_TO_BITS(totalLength);
+    bufferedMessage->priority = priority;
+    bufferedMessage->reliability = reliability;
+    bufferedMessage->orderingChannel = orderingChannel;
+    bufferedMessage->systemIdentifier = systemIdentifier;
+    bufferedMessage->broadcast = broadcast;
+    bufferedMessage->connectionMode = connectionMode;
+    bufferedMessage->receipt = receipt;
+
+    // Forces pending sends to go out now, rather than waiting to the next update interval
+    PushSendBatch(batch, 1, priority == IMMEDIATE_PRIORITY);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+size_t RakPeer::GetBatchedMessageSize(size_t numberOfBytes)
+{
+    const size_t alignment = alignof(BufferedBatchMessage);
+    return sizeof(BufferedBatchMessage) + (numberOfBytes + alignment - 1) / alignment * alignment;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+void RakPeer::PushSendBatch(char *batch, unsigned int numberOfMessages, bool wakeNetworkThread)
+{
     BufferedCommandStruct *bcs = bufferedCommands.Allocate();
-    bcs->data = dataAggregate;
-    bcs->numberOfBitsToSend = BYTES_TO_BITS(totalLength);
-    bcs->priority = priority;
-    bcs->reliability = reliability;
-    bcs->orderingChannel = orderingChannel;
-    bcs->systemIdentifier = systemIdentifier;
-    bcs->broadcast = broadcast;
-    bcs->connectionMode = connectionMode;
-    bcs->receipt = receipt;
-    bcs->command = BufferedCommandStruct::BCS_SEND;
+    bcs->data = batch;
+    bcs->numberOfBatchedMessages = numberOfMessages;
+    bcs->command = BufferedCommandStruct::BCS_SEND_BATCH;
     bufferedCommands.Push(bcs);
 
-    if (priority == IMMEDIATE_PRIORITY)
-        quitAndDataEvents.SetEvent(); // Forces pending sends to go out now, rather than waiting to the next update interval
+    if (wakeNetworkThread)
+        quitAndDataEvents.SetEvent();
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -4257,7 +4476,7 @@ void RakPeer::ClearBufferedCommands(void)
     while ((bcs = bufferedCommands.Pop()) != 0)
     {
         if (bcs->data)
-            free(bcs->data);
+            rakFree_Ex(bcs->data, _FILE_AND_LINE_);
 
         bufferedCommands.Deallocate(bcs);
     }
@@ -5179,6 +5398,7 @@ namespace RakNet
     void ProcessNetworkPacket(SystemAddress systemAddress, const char *data, unsigned int length, RakPeer *rakPeer,
                               RakNetSocket2 *rakNetSocket, RakNet::TimeUS timeRead, BitStream &updateBitStream)
     {
+        CRABNET_TRACE_ZONE("ProcessNetworkPacket");
 #ifdef LIBCAT_SECURITY
 #ifdef CAT_AUDIT
     printf("AUDIT: RECV ");
@@ -5316,6 +5536,8 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
     RakNet::TimeUS timeNS = 0;
     RakNet::Time timeMS = 0;
 
+    CRABNET_TRACE_ZONE("RakPeer::RunUpdateCycle");
+
     // This is here so RecvFromBlocking actually gets data from the same thread
 #if defined(_WIN32)
     if (socketList[0]->GetSocketType()==RNS2T_WINDOWS && ((RNS2_Windows*)socketList[0])->GetSocketLayerOverride())
@@ -5351,6 +5573,8 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
     BufferedCommandStruct *bcs;
     while ((bcs = bufferedCommands.PopInaccurate()) != 0)
     {
+        CRABNET_TRACE_ZONE("RakPeer::ProcessBufferedCommand");
+
         if (bcs->command == BufferedCommandStruct::BCS_SEND)
         {
             // GetTime is a very slow call so do it once and as late as possible
@@ -5364,7 +5588,7 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
                                                      bcs->reliability, bcs->orderingChannel, bcs->systemIdentifier,
                                                      bcs->broadcast, true, timeNS, bcs->receipt);
             if (!callerDataAllocationUsed)
-                free(bcs->data);
+                rakFree_Ex(bcs->data, _FILE_AND_LINE_);
 
             // Set the new connection state AFTER we call sendImmediate in case we are setting it to a disconnection state, which does not allow further sends
             if (bcs->connectionMode != RemoteSystemStruct::NO_ACTION)
@@ -5374,6 +5598,35 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
                     remoteSystem->connectMode = bcs->connectionMode;
             }
         }
+        else if (bcs->command == BufferedCommandStruct::BCS_SEND_BATCH)
+        {
+            if (timeNS == 0)
+            {
+                timeNS = RakNet::GetTimeUS();
+                timeMS = (RakNet::TimeMS) (timeNS / (RakNet::TimeUS) 1000);
+            }
+
+            // The reliability layer copies each message, since they share one allocation
+            char *position = bcs->data;
+            for (unsigned int batchIndex = 0; batchIndex < bcs->numberOfBatchedMessages; batchIndex++)
+            {
+                BufferedBatchMessage *bufferedMessage = (BufferedBatchMessage *) position;
+                char *messageData = position + sizeof(BufferedBatchMessage);
+                SendImmediate(messageData, bufferedMessage->numberOfBitsToSend, bufferedMessage->priority,
+                              bufferedMessage->reliability, bufferedMessage->orderingChannel,
+                              bufferedMessage->systemIdentifier, bufferedMessage->broadcast, false, timeNS,
+                              bufferedMessage->receipt);
+
+                if (bufferedMessage->connectionMode != RemoteSystemStruct::NO_ACTION)
+                {
+                    RakPeer::RemoteSystemStruct *remoteSystem = GetRemoteSystem(bufferedMessage->systemIdentifier, true, true);
+                    if (remoteSystem)
+                        remoteSystem->connectMode = bufferedMessage->connectionMode;
+                }
+                position += GetBatchedMessageSize((size_t) BITS_TO_BYTES(bufferedMessage->numberOfBitsToSend));
+            }
+            rakFree_Ex(bcs->data, _FILE_AND_LINE_);
+        }
         else if (bcs->command == BufferedCommandStruct::BCS_CLOSE_CONNECTION)
             CloseConnectionInternal(bcs->systemIdentifier, false, true, bcs->orderingChannel, bcs->priority);
         else if (bcs->command == BufferedCommandStruct::BCS_CHANGE_SYSTEM_ADDRESS)
@@ -5415,6 +5668,7 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
 
     if (!requestedConnectionQueue.IsEmpty())
     {
+        CRABNET_TRACE_ZONE("RakPeer::RequestedConnections");
         if (timeNS == 0)
         {
             timeNS = RakNet::GetTimeUS();
@@ -5561,6 +5815,8 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
         //    remoteSystemList[ remoteSystemIndex ].allowSystemAddressAssigment=true;
 
 
+        CRABNET_TRACE_ZONE("RakPeer::UpdateRemoteSystem");
+
         // Found an active remote system
         RakPeer::RemoteSystemStruct *remoteSystem = activeSystemList[activeSystemListIndex];
         systemAddress = remoteSystem->systemAddress;
@@ -5666,7 +5922,8 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
 
         // Does the reliability layer have any packets waiting for us?
         // To be thread safe, this has to be called in the same thread as HandleSocketReceiveFromConnectedPlayer
-        BitSize_t bitSize = remoteSystem->reliabilityLayer.Receive(&data);
+        CRABNET_TRACE_ZONE("RakPeer::HandleReceivedMessages");
+        BitSize_t bitSize = remoteSystem->reliabilityLayer.Receive(&data, receivedInlineData);
 
         while (bitSize > 0)
         {
@@ -5687,7 +5944,7 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
                 if ((data)[0] == ID_CONNECTION_REQUEST)
                 {
                     ParseConnectionRequestPacket(remoteSystem, systemAddress, (const char *) data, byteSize);
-                    free(data);
+                    FreeReceivedData(data);
                 }
                 else
                 {
@@ -5700,7 +5957,7 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
                     systemAddress.ToString(false, str1);
                     AddToBanList(str1, remoteSystem->reliabilityLayer.GetTimeoutTime());
 
-                    free(data);
+                    FreeReceivedData(data);
                 }
             }
             else
@@ -5727,7 +5984,7 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
                         // This can happen due to race conditions with the fully connected mesh
                         OnConnectionRequest(remoteSystem, incomingTimestamp);
                     }
-                    free(data);
+                    FreeReceivedData(data);
                 }
                 else if (data[0] == ID_NEW_INCOMING_CONNECTION && byteSize > sizeof(unsigned char) + sizeof(unsigned int) +
                                                                              sizeof(unsigned short) + sizeof(RakNet::Time) * 2)
@@ -5802,7 +6059,7 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
 
                     OnConnectedPong(sendPingTime, sendPongTime, remoteSystem);
 
-                    free(data);
+                    FreeReceivedData(data);
                 }
                 else if (data[0] == ID_CONNECTED_PING && byteSize == sizeof(unsigned char) + sizeof(RakNet::Time))
                 {
@@ -5821,20 +6078,20 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
                     // Update again immediately after this tick so the ping goes out right away
                     quitAndDataEvents.SetEvent();
 
-                    free(data);
+                    FreeReceivedData(data);
                 }
                 else if (data[0] == ID_DISCONNECTION_NOTIFICATION)
                 {
                     // We shouldn't close the connection immediately because we need to ack the ID_DISCONNECTION_NOTIFICATION
                     remoteSystem->connectMode = RemoteSystemStruct::DISCONNECT_ON_NO_ACK;
-                    free(data);
+                    FreeReceivedData(data);
 
                     //    AddPacketToProducer(packet);
                 }
                 else if ((data)[0] == ID_DETECT_LOST_CONNECTIONS && byteSize == sizeof(unsigned char))
                 {
                     // Do nothing
-                    free(data);
+                    FreeReceivedData(data);
                 }
                 else if ((data)[0] == ID_INVALID_PASSWORD)
                 {
@@ -5852,7 +6109,7 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
                     }
                     else
                     {
-                        free(data);
+                        FreeReceivedData(data);
                     }
                 }
                 else if ((unsigned char) (data)[0] == ID_CONNECTION_REQUEST_ACCEPTED)
@@ -5934,13 +6191,13 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
                                 PingInternal(systemAddress, true, UNRELIABLE);
                         }
                         else
-                            free(data); // Ignore, already connected
+                            FreeReceivedData(data); // Ignore, already connected
                     }
                     else
                     {
                         // Version mismatch error?
                         RakAssert(0);
-                        free(data);
+                        FreeReceivedData(data);
                     }
                 }
                 else
@@ -5960,13 +6217,13 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
                         AddPacketToProducer(packet);
                     }
                     else
-                        free(data);
+                        FreeReceivedData(data);
                 }
             }
 
             // Does the reliability layer have any more packets waiting for us?
             // To be thread safe, this has to be called in the same thread as HandleSocketReceiveFromConnectedPlayer
-            bitSize = remoteSystem->reliabilityLayer.Receive(&data);
+            bitSize = remoteSystem->reliabilityLayer.Receive(&data, receivedInlineData);
         }
 
     }
@@ -5979,7 +6236,11 @@ bool RakPeer::RunUpdateCycle(BitStream &updateBitStream)
 void RakPeer::OnRNS2Recv(RNS2RecvStruct *recvStruct)
 {
     if (incomingDatagramEventHandler && !incomingDatagramEventHandler(recvStruct))
+    {
+        // Rejected datagrams go back to the pool, as they would once processed
+        DeallocRNS2RecvStruct(recvStruct);
         return;
+    }
 
     PushBufferedPacket(recvStruct);
     quitAndDataEvents.SetEvent();
@@ -6017,6 +6278,75 @@ RAK_THREAD_DECLARATION(RakNet::RecvFromLoop)
 }
 */
 
+// ---------------------------------------------------------------------------------------------------------------------
+void RakPeer::UpdatePlugins(void)
+{
+    CRABNET_TRACE_ZONE("PluginInterface2::Update");
+    unsigned int i;
+    for (i = 0; i < pluginListTS.Size(); i++)
+    {
+        pluginListTS[i]->Update();
+    }
+    for (i = 0; i < pluginListNTS.Size(); i++)
+    {
+        pluginListNTS[i]->Update();
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+bool RakPeer::ProcessReturnedPacket(Packet *packet)
+{
+    PluginReceiveResult pluginResult;
+    int offset;
+    unsigned int i;
+
+//        unsigned char msgId;
+    if ((packet->length >= sizeof(unsigned char) + sizeof(RakNet::Time)) &&
+        ((unsigned char) packet->data[0] == ID_TIMESTAMP))
+    {
+        offset = sizeof(unsigned char);
+        ShiftIncomingTimestamp(packet->data + offset, packet->systemAddress);
+//            msgId=packet->data[sizeof(unsigned char) + sizeof( RakNet::Time )];
+    }
+//        else
+    //        msgId=packet->data[0];
+
+    // Some locally generated packets need to be processed by plugins, for example ID_FCM2_NEW_HOST
+    // The plugin itself should intercept these messages generated remotely
+//         if (packet->wasGeneratedLocally)
+//             return packet;
+
+
+    CRABNET_TRACE_ZONE("PluginInterface2::OnReceive");
+    CallPluginCallbacks(pluginListTS, packet);
+    CallPluginCallbacks(pluginListNTS, packet);
+
+    // Only the plugins that handle this MessageID, or did not say which ones they handle
+    // Changes made by the plugins to which plugins get which MessageIDs apply from the next packet
+    pluginResult = RR_CONTINUE_PROCESSING;
+    pluginReceiveTableInUse++;
+    DataStructures::List<PluginInterface2*> &receivePlugins = pluginReceiveTable[packet->data[0]];
+    for (i = 0; i < receivePlugins.Size(); i++)
+    {
+        pluginResult = receivePlugins[i]->OnReceive(packet);
+        if (pluginResult == RR_STOP_PROCESSING_AND_DEALLOCATE || pluginResult == RR_STOP_PROCESSING)
+            break;
+    }
+    pluginReceiveTableInUse--;
+    if (pluginReceiveTableInUse == 0 && pluginReceiveTableDirty)
+        RefreshPluginMessageIDs();
+
+    if (pluginResult == RR_STOP_PROCESSING_AND_DEALLOCATE)
+    {
+        DeallocatePacket(packet);
+        return false;
+    }
+    else if (pluginResult == RR_STOP_PROCESSING)
+        return false;
+
+    return true;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 RAK_THREAD_DECLARATION(RakNet::UpdateNetworkLoop)
 {
@@ -6055,6 +6385,7 @@ RAK_THREAD_DECLARATION(RakNet::UpdateNetworkLoop)
     );
 //
     rakPeer->isMainLoopThreadActive = true;
+    CRABNET_TRACE_THREAD_NAME("RakPeer::UpdateNetworkLoop");
 
     while (rakPeer->endThreads == false)
     {
@@ -16,33 +16,58 @@
 #include <string.h>
 #include "Utils/LinuxStrings.h"
 #include "StringCompressor.h"
-#include "SimpleMutex.h"
 #include <stdlib.h>
 #include "Itoa.h"
 
 using namespace RakNet;
 
 //DataStructures::MemoryPool<RakString::SharedString> RakString::pool;
-RakString::SharedString RakString::emptyString = {0, 0, 0, (char *) "", (char *) "", ""};
+RakString::SharedString RakString::emptyString = {0, {0}, 0, (char *) "", (char *) "", ""};
 //RakString::SharedString *RakString::sharedStringFreeList=0;
 //unsigned int RakString::sharedStringFreeListAllocationCount=0;
-DataStructures::List<RakString::SharedString *> RakString::freeList;
 
-class RakStringCleanup
+namespace
 {
-public:
-    ~RakStringCleanup()
+    const size_t smallStringSize = 128 - sizeof(unsigned int) - sizeof(size_t) - sizeof(char *) * 2;
+
+    // Released strings beyond this many per thread are returned to free()
+    const unsigned int maxCachedSharedStrings = 1024;
+
+    // Trivially destructible, so strings released by static destructors after the thread cleanup below has run can still check exited
+    struct SharedStringThreadCache
     {
-        RakNet::RakString::FreeMemoryNoMutex();
+        RakString::SharedString *freeStrings;
+        unsigned int count;
+        bool holderCreated;
+        // Strings released after this is set are freed rather than cached
+        bool exited;
+    };
+
+    thread_local SharedStringThreadCache threadCache = {0, 0, false, false};
+
+    void FreeCachedStrings(void)
+    {
+        while (threadCache.freeStrings)
+        {
+            RakString::SharedString *ss = threadCache.freeStrings;
+            threadCache.freeStrings = ss->next;
+            free(ss);
+        }
+        threadCache.count = 0;
     }
-};
 
-static RakStringCleanup cleanup;
+    struct SharedStringThreadCacheHolder
+    {
+        bool created;
 
-SimpleMutex &GetPoolMutex()
-{
-    static SimpleMutex poolMutex;
-    return poolMutex;
+        ~SharedStringThreadCacheHolder()
+        {
+            FreeCachedStrings();
+            threadCache.exited = true;
+        }
+    };
+
+    thread_local SharedStringThreadCacheHolder threadCacheHolder = {false};
 }
 
 int RakNet::RakString::RakStringComp(RakString const &key, RakString const &data)
@@ -94,21 +119,8 @@ RakString::RakString(const char *format, ...)
 
 RakString::RakString(const RakString &rhs)
 {
-    if (rhs.sharedString == &emptyString)
-    {
-        sharedString = &emptyString;
-        return;
-    }
-
-    rhs.sharedString->refCountMutex->Lock();
-    if (rhs.sharedString->refCount == 0)
-        sharedString = &emptyString;
-    else
-    {
-        rhs.sharedString->refCount++;
-        sharedString = rhs.sharedString;
-    }
-    rhs.sharedString->refCountMutex->Unlock();
+    sharedString = rhs.sharedString;
+    AddReference(sharedString);
 }
 
 RakString::~RakString()
@@ -118,19 +130,11 @@ RakString::~RakString()
 
 RakString &RakString::operator=(const RakString &rhs)
 {
-    Free();
-    if (rhs.sharedString == &emptyString)
-        return *this;
-
-    rhs.sharedString->refCountMutex->Lock();
-    if (rhs.sharedString->refCount == 0)
-        sharedString = &emptyString;
-    else
-    {
-        sharedString = rhs.sharedString;
-        sharedString->refCount++;
-    }
-    rhs.sharedString->refCountMutex->Unlock();
+    // Reference rhs before releasing the current string, in case they are the same
+    SharedString *oldSharedString = sharedString;
+    sharedString = rhs.sharedString;
+    AddReference(sharedString);
+    ReleaseReference(oldSharedString);
     return *this;
 }
 
@@ -171,7 +175,6 @@ void RakString::Realloc(SharedString *sharedString, size_t bytes)
 
     RakAssert(bytes > 0);
     size_t oldBytes = sharedString->bytesUsed;
-    const size_t smallStringSize = 128 - sizeof(unsigned int) - sizeof(size_t) - sizeof(char *) * 2;
     size_t newBytes = GetSizeToAllocate(bytes);
     if (oldBytes <= (size_t) smallStringSize && newBytes > (size_t) smallStringSize)
     {
@@ -308,66 +311,12 @@ const RakNet::RakString operator+(const RakNet::RakString &lhs, const RakNet::Ra
     if (lhs.IsEmpty() && rhs.IsEmpty())
         return RakString(&RakString::emptyString);
     if (lhs.IsEmpty())
-    {
-        rhs.sharedString->refCountMutex->Lock();
-        if (rhs.sharedString->refCount == 0)
-        {
-            rhs.sharedString->refCountMutex->Unlock();
-            lhs.sharedString->refCountMutex->Lock();
-            lhs.sharedString->refCount++;
-            lhs.sharedString->refCountMutex->Unlock();
-            return RakString(lhs.sharedString);
-        }
-        else
-        {
-            rhs.sharedString->refCount++;
-            rhs.sharedString->refCountMutex->Unlock();
-            return RakString(rhs.sharedString);
-        }
-        // rhs.sharedString->refCountMutex->Unlock();
-    }
+        return rhs;
     if (rhs.IsEmpty())
-    {
-        lhs.sharedString->refCountMutex->Lock();
-        lhs.sharedString->refCount++;
-        lhs.sharedString->refCountMutex->Unlock();
-        return RakString(lhs.sharedString);
-    }
+        return lhs;
 
     size_t allocatedBytes = RakString::GetSizeToAllocate(lhs.GetLength() + rhs.GetLength() + 1);
-
-    RakString::LockMutex();
-    // sharedString = RakString::pool.Allocate(  );
-    if (RakString::freeList.Size() == 0)
-    {
-        //RakString::sharedStringFreeList=(RakString::SharedString*) rakRealloc_Ex(RakString::sharedStringFreeList,(RakString::sharedStringFreeListAllocationCount+1024)*sizeof(RakString::SharedString));
-        for (unsigned i = 0; i < 128; i++)
-        {
-            // RakString::freeList.Insert(RakString::sharedStringFreeList+i+RakString::sharedStringFreeListAllocationCount);
-            RakString::SharedString *ss;
-            ss = (RakString::SharedString *) malloc(sizeof(RakString::SharedString));
-            RakAssert(ss);
-            ss->refCountMutex = new SimpleMutex;
-            RakString::freeList.Insert(ss);
-
-        }
-        //RakString::sharedStringFreeListAllocationCount+=1024;
-    }
-    RakString::SharedString *sharedString = RakString::freeList[RakString::freeList.Size() - 1];
-    RakString::freeList.RemoveAtIndex(RakString::freeList.Size() - 1);
-    RakString::UnlockMutex();
-
-    const int smallStringSize = 128 - sizeof(unsigned int) - sizeof(size_t) - sizeof(char *) * 2;
-    sharedString->bytesUsed = allocatedBytes;
-    sharedString->refCount = 1;
-    if (allocatedBytes <= (size_t) smallStringSize)
-        sharedString->c_str = sharedString->smallString;
-    else
-    {
-        sharedString->bigString = (char *) malloc(sharedString->bytesUsed);
-        sharedString->c_str = sharedString->bigString;
-    }
-
+    RakString::SharedString *sharedString = RakString::AllocSharedString(allocatedBytes);
     strcpy(sharedString->c_str, lhs);
     strcat(sharedString->c_str, rhs);
 
@@ -1169,19 +1118,12 @@ RakNet::RakString &RakString::MakeFilePath()
 
 void RakString::FreeMemory()
 {
-    LockMutex();
-    FreeMemoryNoMutex();
-    UnlockMutex();
+    FreeCachedStrings();
 }
 
 void RakString::FreeMemoryNoMutex()
 {
-    for (unsigned int i = 0; i < freeList.Size(); i++)
-    {
-        delete freeList[i]->refCountMutex;
-        free(freeList[i]);
-    }
-    freeList.Clear(false);
+    FreeCachedStrings();
 }
 
 void RakString::Serialize(BitStream *bs) const
@@ -1299,40 +1241,7 @@ void RakString::Clear()
 
 void RakString::Allocate(size_t len)
 {
-    RakString::LockMutex();
-    // sharedString = RakString::pool.Allocate(  );
-    if (RakString::freeList.Size() == 0)
-    {
-        //RakString::sharedStringFreeList=(RakString::SharedString*) realloc(RakString::sharedStringFreeList,(RakString::sharedStringFreeListAllocationCount+1024)*sizeof(RakString::SharedString));
-        for (unsigned i = 0; i < 128; i++)
-        {
-            //    RakString::freeList.Insert(RakString::sharedStringFreeList+i+RakString::sharedStringFreeListAllocationCount);
-            //        RakString::freeList.Insert((RakString::SharedString*)malloc(sizeof(RakString::SharedString));
-
-            auto ss = (RakString::SharedString *) malloc(sizeof(RakString::SharedString));
-            RakAssert(ss);
-            ss->refCountMutex = new SimpleMutex;
-            RakString::freeList.Insert(ss);
-        }
-        //RakString::sharedStringFreeListAllocationCount+=1024;
-    }
-    sharedString = RakString::freeList[RakString::freeList.Size() - 1];
-    RakString::freeList.RemoveAtIndex(RakString::freeList.Size() - 1);
-    RakString::UnlockMutex();
-
-    const size_t smallStringSize = 128 - sizeof(unsigned int) - sizeof(size_t) - sizeof(char *) * 2;
-    sharedString->refCount = 1;
-    if (len <= smallStringSize)
-    {
-        sharedString->bytesUsed = smallStringSize;
-        sharedString->c_str = sharedString->smallString;
-    }
-    else
-    {
-        sharedString->bytesUsed = len << 1;
-        sharedString->bigString = (char *) malloc(sharedString->bytesUsed);
-        sharedString->c_str = sharedString->bigString;
-    }
+    sharedString = AllocSharedString(GetSizeToAllocate(len));
 }
 
 void RakString::Assign(const char *str)
@@ -1474,45 +1383,78 @@ void RakString::Clone()
         return;
 
     // Empty or solo then no point to cloning
-    sharedString->refCountMutex->Lock();
-    if (sharedString->refCount == 1)
-    {
-        sharedString->refCountMutex->Unlock();
+    if (sharedString->refCount.load(std::memory_order_acquire) == 1)
         return;
-    }
 
-    sharedString->refCount--;
-    sharedString->refCountMutex->Unlock();
-    Assign(sharedString->c_str);
+    SharedString *oldSharedString = sharedString;
+    Assign(oldSharedString->c_str);
+    ReleaseReference(oldSharedString);
 }
 
 void RakString::Free()
 {
-    if (sharedString == &emptyString)
-        return;
-    sharedString->refCountMutex->Lock();
-    sharedString->refCount--;
-    if (sharedString->refCount == 0)
+    ReleaseReference(sharedString);
+    sharedString = &emptyString;
+}
+
+RakString::SharedString *RakString::AllocSharedString(size_t bytes)
+{
+    SharedString *ss = threadCache.freeStrings;
+    if (ss)
+    {
+        threadCache.freeStrings = ss->next;
+        threadCache.count--;
+    }
+    else
     {
-        sharedString->refCountMutex->Unlock();
-        const size_t smallStringSize = 128 - sizeof(unsigned int) - sizeof(size_t) - sizeof(char *) * 2;
-        if (sharedString->bytesUsed > smallStringSize)
-            free(sharedString->bigString);
-        /*
-        poolMutex->Lock();
-        pool.Release(sharedString);
-        poolMutex->Unlock();
-        */
-
-        RakString::LockMutex();
-        RakString::freeList.Insert(sharedString);
-        RakString::UnlockMutex();
+        ss = (SharedString *) malloc(sizeof(SharedString));
+        RakAssert(ss);
+    }
 
-        sharedString = &emptyString;
+    ss->refCount.store(1, std::memory_order_relaxed);
+    if (bytes <= smallStringSize)
+    {
+        ss->bytesUsed = smallStringSize;
+        ss->c_str = ss->smallString;
     }
     else
-        sharedString->refCountMutex->Unlock();
-    sharedString = &emptyString;
+    {
+        ss->bytesUsed = bytes;
+        ss->bigString = (char *) malloc(bytes);
+        RakAssert(ss->bigString);
+        ss->c_str = ss->bigString;
+    }
+    return ss;
+}
+
+void RakString::AddReference(SharedString *ss)
+{
+    if (ss != &emptyString)
+        ss->refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RakString::ReleaseReference(SharedString *ss)
+{
+    if (ss == &emptyString || ss->refCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    if (ss->bytesUsed > smallStringSize)
+        free(ss->bigString);
+
+    if (threadCache.exited || threadCache.count >= maxCachedSharedStrings)
+    {
+        free(ss);
+        return;
+    }
+    if (threadCache.holderCreated == false)
+    {
+        // First use creates the holder, so the cache is freed when the thread exits
+        threadCacheHolder.created = true;
+        threadCache.holderCreated = true;
+    }
+    ss->next = threadCache.freeStrings;
+    threadCache.freeStrings = ss;
+    threadCache.count++;
 }
 
 unsigned char RakString::ToLower(unsigned char c)
@@ -1529,16 +1471,6 @@ unsigned char RakString::ToUpper(unsigned char c)
     return c;
 }
 
-void RakString::LockMutex()
-{
-    GetPoolMutex().Lock();
-}
-
-void RakString::UnlockMutex()
-{
-    GetPoolMutex().Unlock();
-}
-
 /*
 #include "RakString.h"
 #include <string>
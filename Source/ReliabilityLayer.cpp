@@ -21,6 +21,8 @@
 #include "RakAssert.h"
 #include "Rand.h"
 #include "MessageIdentifiers.h"
+#include "RakTrace.h"
+#include "RakAllocator.h"
 
 #ifdef USE_THREADED_SEND
 #include "SendToThread.h"
@@ -122,6 +124,28 @@ void BPSTracker::ClearExpired1(RakNet::TimeUS time)
     }
 }
 
+LatencyHistogramTracker::LatencyHistogramTracker() {Reset();}
+void LatencyHistogramTracker::Reset()
+{
+    for (unsigned int i = 0; i < LATENCY_HISTOGRAM_BUCKET_COUNT; i++)
+        counts[i].store(0, std::memory_order_relaxed);
+}
+void LatencyHistogramTracker::Copy(LatencyHistogram *histogram) const
+{
+    for (unsigned int i = 0; i < LATENCY_HISTOGRAM_BUCKET_COUNT; i++)
+        histogram->counts[i] = counts[i].load(std::memory_order_relaxed);
+}
+
+// Histograms are always in microseconds, whatever CCTimeType is
+static inline uint64_t CCTimeToUS(CCTimeType time)
+{
+#if CC_TIME_TYPE_BYTES == 8
+    return (uint64_t) time;
+#else
+    return (uint64_t) time * 1000;
+#endif
+}
+
 struct DatagramHeaderFormat
 {
 #if INCLUDE_TIMESTAMP_WITH_DATAGRAMS == 1
@@ -464,6 +488,14 @@ void ReliabilityLayer::InitializeVariables(void)
 
     for (int i = 0; i < RNS_PER_SECOND_METRICS_COUNT; i++)
         bpsMetrics[i].Reset();
+
+    for (int i = 0; i < NUMBER_OF_PRIORITIES; i++)
+    {
+        sendQueueTimeTracker[i].Reset();
+        deliveryTimeTracker[i].Reset();
+    }
+    ackRoundTripTimeTracker.Reset();
+    resendCountTracker.Reset();
 }
 
 //-------------------------------------------------------------------------------------------------------
@@ -581,7 +613,7 @@ void ReliabilityLayer::FreeThreadSafeMemory(void)
         ReleaseToInternalPacketPool(outgoingPacketBuffer[j]);
     }
 
-    outgoingPacketBuffer.Clear(true);
+    outgoingPacketBuffer.Clear();
 
 #ifdef _DEBUG
     for (unsigned i = 0; i < delayList.Size(); i++)
@@ -646,6 +678,8 @@ bool ReliabilityLayer::HandleSocketReceiveFromConnectedPlayer(
         RakNetSocket2 *s, RakNetRandom *rnr, CCTimeType timeRead,
         BitStream &updateBitStream)
 {
+    CRABNET_TRACE_ZONE("ReliabilityLayer::HandleSocketReceiveFromConnectedPlayer");
+
     RakAssert(buffer != nullptr);
 
 #if CC_TIME_TYPE_BYTES == 4
@@ -784,6 +818,7 @@ bool ReliabilityLayer::HandleSocketReceiveFromConnectedPlayer(
                     //    printf("%p Got ack for %i\n", this, datagramNumber.val);
 #if INCLUDE_TIMESTAMP_WITH_DATAGRAMS == 1
                     congestionManager.OnAck(timeRead, rtt, dhf.hasBAndAS, 0, dhf.AS, totalUserDataBytesAcked, bandwidthExceededStatistic, datagramNumber );
+                    ackRoundTripTimeTracker.Record(CCTimeToUS(rtt));
 #else
                     CCTimeType ping;
                     if (timeRead > whenSent)
@@ -792,6 +827,7 @@ bool ReliabilityLayer::HandleSocketReceiveFromConnectedPlayer(
                         ping = 0;
                     congestionManager.OnAck(timeRead, ping, dhf.hasBAndAS, 0, dhf.AS, totalUserDataBytesAcked,
                                             bandwidthExceededStatistic, datagramNumber);
+                    ackRoundTripTimeTracker.Record(CCTimeToUS(ping));
 #endif
                     while (messageNumberNode)
                     {
@@ -1404,7 +1440,7 @@ bool ReliabilityLayer::HandleSocketReceiveFromConnectedPlayer(
                                orderingHeaps[internalPacket->orderingChannel].Peek()->orderingIndex ==
                                orderedReadIndex[internalPacket->orderingChannel])
                         {
-                            internalPacket = orderingHeaps[internalPacket->orderingChannel].Pop(0);
+                            internalPacket = orderingHeaps[internalPacket->orderingChannel].Pop();
 
 #ifdef PRINT_TO_FILE_RELIABLE_ORDERED_TEST
                             BitStream bitStream2(internalPacket->data, BITS_TO_BYTES(internalPacket->dataBitLength), false);
@@ -1531,7 +1567,7 @@ bool ReliabilityLayer::HandleSocketReceiveFromConnectedPlayer(
 //-------------------------------------------------------------------------------------------------------
 // This gets an end-user packet already parsed out. Returns number of BITS put into the buffer
 //-------------------------------------------------------------------------------------------------------
-BitSize_t ReliabilityLayer::Receive(unsigned char **data)
+BitSize_t ReliabilityLayer::Receive(unsigned char **data, unsigned char *inlineBuffer)
 {
     InternalPacket *internalPacket;
 
@@ -1543,8 +1579,16 @@ BitSize_t ReliabilityLayer::Receive(unsigned char **data)
         internalPacket = outputQueue.Pop();
 
         BitSize_t bitLength;
-        *data = internalPacket->data;
         bitLength = internalPacket->dataBitLength;
+        if (internalPacket->allocationScheme == InternalPacket::STACK)
+        {
+            // Received into the internal packet itself, which is about to be reused
+            RakAssert(BITS_TO_BYTES(bitLength) <= CRABNET_PACKET_INLINE_DATA_SIZE);
+            memcpy(inlineBuffer, internalPacket->data, (size_t) BITS_TO_BYTES(bitLength));
+            *data = inlineBuffer;
+        }
+        else
+            *data = internalPacket->data;
         ReleaseToInternalPacketPool(internalPacket);
         return bitLength;
     }
@@ -1566,6 +1610,8 @@ ReliabilityLayer::Send(char *data, BitSize_t numberOfBitsToSend, PacketPriority
                        unsigned char orderingChannel, bool makeDataCopy, int MTUSize, CCTimeType currentTime,
                        uint32_t receipt)
 {
+    CRABNET_TRACE_ZONE("ReliabilityLayer::Send");
+
 #ifdef _DEBUG
     RakAssert(!(reliability >= NUMBER_OF_RELIABILITIES || reliability < 0));
     RakAssert(!(priority > NUMBER_OF_PRIORITIES || priority < 0));
@@ -1701,7 +1747,7 @@ ReliabilityLayer::Send(char *data, BitSize_t numberOfBitsToSend, PacketPriority
 
     RakAssert(internalPacket->dataBitLength < BYTES_TO_BITS(MAXIMUM_MTU_SIZE));
     RakAssert(!internalPacket->messageNumberAssigned);
-    outgoingPacketBuffer.Push(GetNextWeight(internalPacket->priority), internalPacket);
+    outgoingPacketBuffer.Push(internalPacket->priority, GetNextWeight(internalPacket->priority), internalPacket);
     RakAssert(outgoingPacketBuffer.Size() == 0 ||
               outgoingPacketBuffer.Peek()->dataBitLength < BYTES_TO_BITS(MAXIMUM_MTU_SIZE));
     statistics.messageInSendBuffer[(int) internalPacket->priority]++;
@@ -1721,6 +1767,8 @@ void ReliabilityLayer::Update(RakNetSocket2 *s, SystemAddress &systemAddress, in
                               RakNetRandom *rnr,
                               BitStream &updateBitStream)
 {
+    CRABNET_TRACE_ZONE("ReliabilityLayer::Update");
+
     (void) MTUSize;
 
     RakNet::TimeMS timeMs;
@@ -2008,7 +2056,7 @@ void ReliabilityLayer::Update(RakNetSocket2 *s, SystemAddress &systemAddress, in
                     if (internalPacket->data == 0)
                     {
                         //sendPacketSet[i].Pop();
-                        outgoingPacketBuffer.Pop(0);
+                        outgoingPacketBuffer.Pop();
                         RakAssert(outgoingPacketBuffer.Size() == 0 ||
                                   outgoingPacketBuffer.Peek()->dataBitLength < BYTES_TO_BITS(MAXIMUM_MTU_SIZE));
                         statistics.messageInSendBuffer[(int) internalPacket->priority]--;
@@ -2036,11 +2084,13 @@ void ReliabilityLayer::Update(RakNetSocket2 *s, SystemAddress &systemAddress, in
                                       internalPacket->reliability == RELIABLE_ORDERED_WITH_ACK_RECEIPT;
 
                     //sendPacketSet[ i ].Pop();
-                    outgoingPacketBuffer.Pop(0);
+                    outgoingPacketBuffer.Pop();
                     RakAssert(outgoingPacketBuffer.Size() == 0 || outgoingPacketBuffer.Peek()->dataBitLength < BYTES_TO_BITS(MAXIMUM_MTU_SIZE));
                     RakAssert(!internalPacket->messageNumberAssigned);
                     statistics.messageInSendBuffer[(int) internalPacket->priority]--;
                     statistics.bytesInSendBuffer[(int) internalPacket->priority] -= (double) BITS_TO_BYTES(internalPacket->dataBitLength);
+                    sendQueueTimeTracker[(int) internalPacket->priority].Record(
+                            time > internalPacket->creationTime ? CCTimeToUS(time - internalPacket->creationTime) : 0);
 
                     if (isReliable
                         // ||
@@ -2472,6 +2522,10 @@ ReliabilityLayer::RemovePacketFromResendListAndDeleteOlderReliableSequenced(cons
 //        orderingIndex = internalPacket->orderingIndex;
         totalUserDataBytesAcked += (double) BITS_TO_BYTES(internalPacket->headerLength + internalPacket->dataBitLength);
 
+        deliveryTimeTracker[(int) internalPacket->priority].Record(
+                time > internalPacket->creationTime ? CCTimeToUS(time - internalPacket->creationTime) : 0);
+        resendCountTracker.Record(internalPacket->timesSent > 0 ? internalPacket->timesSent - 1 : 0);
+
         // Return receipt if asked for
         if (internalPacket->reliability >= RELIABLE_WITH_ACK_RECEIPT &&
             (internalPacket->splitPacketCount == 0 ||
@@ -2733,8 +2787,9 @@ InternalPacket *ReliabilityLayer::CreateInternalPacketFromBitStream(RakNet::BitS
         return nullptr;
     }
 
-    // Allocate memory to hold our data
-    AllocInternalPacketData(internalPacket, BITS_TO_BYTES(internalPacket->dataBitLength), false);
+    // Allocate memory to hold our data. Messages small enough for Receive() to copy into the caller's buffer are kept in the internal packet
+    AllocInternalPacketData(internalPacket, BITS_TO_BYTES(internalPacket->dataBitLength),
+                            BITS_TO_BYTES(internalPacket->dataBitLength) <= CRABNET_PACKET_INLINE_DATA_SIZE);
     RakAssert(BITS_TO_BYTES(internalPacket->dataBitLength) < MAXIMUM_MTU_SIZE);
 
     if (internalPacket->data == 0)
@@ -2959,10 +3014,8 @@ void ReliabilityLayer::SplitPacket(InternalPacket *internalPacket)
 
     //    InternalPacket *workingPacket;
 
-    // Tell the heap we are going to push a list of elements where each element in the list follows the heap order
     RakAssert(outgoingPacketBuffer.Size() == 0 ||
               outgoingPacketBuffer.Peek()->dataBitLength < BYTES_TO_BITS(MAXIMUM_MTU_SIZE));
-    outgoingPacketBuffer.StartSeries();
 
     // Copy all the new packets into the split packet list
     for (int i = 0; i < (int) internalPacket->splitPacketCount; i++)
@@ -2973,7 +3026,7 @@ void ReliabilityLayer::SplitPacket(InternalPacket *internalPacket)
         //        sendPacketSet[ internalPacket->priority ].Push( internalPacketArray[ i ],   );
         RakAssert(internalPacketArray[i]->dataBitLength < BYTES_TO_BITS(MAXIMUM_MTU_SIZE));
         RakAssert(!internalPacketArray[i]->messageNumberAssigned);
-        outgoingPacketBuffer.PushSeries(GetNextWeight(internalPacketArray[i]->priority), internalPacketArray[i]);
+        outgoingPacketBuffer.Push(internalPacketArray[i]->priority, GetNextWeight(internalPacketArray[i]->priority), internalPacketArray[i]);
         RakAssert(outgoingPacketBuffer.Size() == 0 || outgoingPacketBuffer.Peek()->dataBitLength < BYTES_TO_BITS(MAXIMUM_MTU_SIZE));
         statistics.messageInSendBuffer[(int) internalPacketArray[i]->priority]++;
         statistics.bytesInSendBuffer[(int) (int) internalPacketArray[i]->priority] += (double) BITS_TO_BYTES(internalPacketArray[i]->dataBitLength);
@@ -3157,7 +3210,7 @@ ReliabilityLayer::BuildPacketFromSplitPacketList(SplitPacketChannel *splitPacket
     for (unsigned j = 0; j < splitPacketChannel->splitPacketList.size(); j++)
         internalPacket->dataBitLength += splitPacketChannel->splitPacketList[j]->dataBitLength;
 
-    internalPacket->data = (unsigned char *) malloc((size_t) BITS_TO_BYTES(internalPacket->dataBitLength));
+    internalPacket->data = (unsigned char *) rakMalloc_Ex((size_t) BITS_TO_BYTES(internalPacket->dataBitLength), _FILE_AND_LINE_);
     RakAssert(internalPacket->data);
     internalPacket->allocationScheme = InternalPacket::NORMAL;
 
@@ -3371,6 +3424,20 @@ RakNetStatistics *ReliabilityLayer::GetStatistics(RakNetStatistics *rns)
     return rns;
 }
 
+//-------------------------------------------------------------------------------------------------------
+// Copies the latency histograms
+//-------------------------------------------------------------------------------------------------------
+void ReliabilityLayer::GetLatencyHistograms(RakNetLatencyHistograms *histograms)
+{
+    for (int i = 0; i < NUMBER_OF_PRIORITIES; i++)
+    {
+        sendQueueTimeTracker[i].Copy(&histograms->sendQueueTime[i]);
+        deliveryTimeTracker[i].Copy(&histograms->deliveryTime[i]);
+    }
+    ackRoundTripTimeTracker.Copy(&histograms->ackRoundTripTime);
+    resendCountTracker.Copy(&histograms->resendCount);
+}
+
 //-------------------------------------------------------------------------------------------------------
 // Returns the number of packets in the resend queue, not counting holes
 //-------------------------------------------------------------------------------------------------------
@@ -3581,6 +3648,8 @@ bool ReliabilityLayer::IsResendQueueEmpty(void) const
 void ReliabilityLayer::SendACKs(RakNetSocket2 *s, SystemAddress &systemAddress, CCTimeType time, RakNetRandom *rnr,
                                 BitStream &updateBitStream)
 {
+    CRABNET_TRACE_ZONE("ReliabilityLayer::SendACKs");
+
     BitSize_t maxDatagramPayload = GetMaxDatagramSizeExcludingMessageHeaderBits();
 
     while (acknowlegements.Size() > 0)
@@ -3853,7 +3922,7 @@ void ReliabilityLayer::AllocInternalPacketData(InternalPacket *internalPacket, u
     else
     {
         internalPacket->allocationScheme = InternalPacket::NORMAL;
-        internalPacket->data = (unsigned char *) malloc(numBytes);
+        internalPacket->data = (unsigned char *) rakMalloc_Ex(numBytes, _FILE_AND_LINE_);
     }
 }
 
@@ -3871,7 +3940,7 @@ void ReliabilityLayer::FreeInternalPacketData(InternalPacket *internalPacket)
         internalPacket->refCountedData->refCount--;
         if (internalPacket->refCountedData->refCount == 0)
         {
-            free(internalPacket->refCountedData->sharedDataBlock);
+            rakFree_Ex(internalPacket->refCountedData->sharedDataBlock, _FILE_AND_LINE_);
             internalPacket->refCountedData->sharedDataBlock = 0;
             // delete internalPacket->refCountedData;
             refCountedDataPool.Release(internalPacket->refCountedData);
@@ -3883,7 +3952,7 @@ void ReliabilityLayer::FreeInternalPacketData(InternalPacket *internalPacket)
         if (internalPacket->data == 0)
             return;
 
-        free(internalPacket->data);
+        rakFree_Ex(internalPacket->data, _FILE_AND_LINE_);
         internalPacket->data = 0;
     }
     else // Data was on stack
@@ -83,6 +83,95 @@ bool TableSerializer::DeserializeTable(RakNet::BitStream *in, DataStructures::Ta
     return true;
 }
 
+bool TableSerializer::SerializeColumnBlock(DataStructures::Table *in, unsigned columnIndex, RakNet::BitStream *out)
+{
+    const DataStructures::Table::ColumnBlock *block = in->GetColumnBlock(columnIndex);
+    if (block == nullptr)
+        return false;
+
+    const DataStructures::List<unsigned> &rowIds = in->GetColumnBlockRowIds();
+    out->Write(columnIndex);
+    out->Write((unsigned char) block->columnType);
+    out->Write(rowIds.Size());
+    for (unsigned slot = 0; slot < rowIds.Size(); slot++)
+    {
+        out->Write(rowIds[slot]);
+        bool nonEmpty = block->nonEmpty[slot] != 0;
+        out->Write(nonEmpty);
+        if (nonEmpty == false)
+            continue;
+        if (block->columnType == DataStructures::Table::NUMERIC)
+            out->Write(block->numbers[slot]);
+        else
+        {
+            bool hasString = block->stringOffsets[slot] != (unsigned) -1;
+            out->Write(hasString);
+            if (hasString)
+            {
+                out->WriteCompressed(block->stringLengths[slot]);
+                out->Write(block->arena + block->stringOffsets[slot], block->stringLengths[slot]);
+            }
+        }
+    }
+    return true;
+}
+
+bool TableSerializer::DeserializeColumnBlock(RakNet::BitStream *in, DataStructures::Table *out)
+{
+    unsigned columnIndex, slotCount;
+    unsigned char columnType;
+    if (!in->Read(columnIndex) || !in->Read(columnType) || !in->Read(slotCount))
+        return false;
+    if (columnIndex >= out->GetColumnCount() || out->GetColumnType(columnIndex) != (DataStructures::Table::ColumnType) columnType ||
+        (columnType != DataStructures::Table::NUMERIC && columnType != DataStructures::Table::STRING))
+        return false;
+    // Each slot takes at least a row ID and a bit
+    if (slotCount > in->GetNumberOfUnreadBits() / 33)
+        return false; // Hacker crash prevention
+
+    char tempString[65536];
+    for (unsigned slot = 0; slot < slotCount; slot++)
+    {
+        unsigned rowId;
+        bool nonEmpty;
+        if (!in->Read(rowId) || !in->Read(nonEmpty))
+            return false;
+
+        double value = 0.0;
+        bool hasString = false;
+        if (nonEmpty && columnType == DataStructures::Table::NUMERIC)
+        {
+            if (!in->Read(value))
+                return false;
+        }
+        else if (nonEmpty)
+        {
+            if (!in->Read(hasString))
+                return false;
+            unsigned length;
+            if (hasString)
+            {
+                if (!in->ReadCompressed(length) || length >= sizeof(tempString) || !in->Read(tempString, length))
+                    return false;
+                tempString[length] = 0;
+            }
+        }
+
+        DataStructures::Table::Row *row = out->GetRowByID(rowId);
+        if (row == nullptr)
+            continue;
+        DataStructures::Table::Cell *cell = row->cells[columnIndex];
+        if (nonEmpty == false)
+            cell->Clear();
+        else if (columnType == DataStructures::Table::NUMERIC)
+            cell->Set(value);
+        else
+            cell->Set(hasString ? tempString : (const char *) nullptr);
+        out->UpdateIndexes(rowId, columnIndex);
+    }
+    return true;
+}
+
 bool TableSerializer::DeserializeColumns(RakNet::BitStream *in, DataStructures::Table *out)
 {
     unsigned columnSize;
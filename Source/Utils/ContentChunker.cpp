@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "ContentChunker.h"
+#include "DR_SHA1.h"
+#include "RakAssert.h"
+
+using namespace RakNet;
+
+namespace
+{
+
+// A random number for each byte value. The same on every system, as both sides of a transfer have to cut in the same places
+struct GearTable
+{
+    uint64_t gear[256];
+    GearTable()
+    {
+        // splitmix64
+        uint64_t state = 0x6A09E667F3BCC909ULL;
+        for (int i = 0; i < 256; i++)
+        {
+            state += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            gear[i] = z ^ (z >> 31);
+        }
+    }
+};
+
+const GearTable gearTable;
+
+}
+
+ContentChunker::ContentChunker()
+{
+    SetChunkSizes(2048, 8192, 65536);
+}
+
+ContentChunker::~ContentChunker()
+{
+}
+
+void ContentChunker::SetChunkSizes(unsigned int minimum, unsigned int average, unsigned int maximum)
+{
+    RakAssert(minimum > 0 && average > 0 && maximum > minimum);
+    if (minimum == 0)
+        minimum = 1;
+    if (maximum <= minimum)
+        maximum = minimum + 1;
+    unsigned int bits = 0;
+    while (bits < 31 && (2u << bits) <= average)
+        bits++;
+    minimumSize = minimum;
+    averageSize = 1u << bits;
+    maximumSize = maximum;
+    // Each byte shifts the hash left, so the high bits depend on the most bytes
+    cutMask = bits == 0 ? 0 : ((((uint64_t) 1) << bits) - 1) << (64 - bits);
+}
+
+void ContentChunker::GetChunkSizes(unsigned int *minimum, unsigned int *average, unsigned int *maximum) const
+{
+    *minimum = minimumSize;
+    *average = averageSize;
+    *maximum = maximumSize;
+}
+
+void ContentChunker::Chunk(const char *data, unsigned int length, DataStructures::List<ContentChunk> &chunks) const
+{
+    auto bytes = (const unsigned char *) data;
+    unsigned int offset = 0;
+    while (offset < length)
+    {
+        unsigned int remaining = length - offset;
+        unsigned int chunkLength = remaining < maximumSize ? remaining : maximumSize;
+        if (remaining > minimumSize)
+        {
+            uint64_t hash = 0;
+            for (unsigned int i = minimumSize; i < chunkLength; i++)
+            {
+                hash = (hash << 1) + gearTable.gear[bytes[offset + i]];
+                if ((hash & cutMask) == 0)
+                {
+                    chunkLength = i + 1;
+                    break;
+                }
+            }
+        }
+
+        ContentChunk chunk;
+        chunk.offset = offset;
+        chunk.length = chunkLength;
+        chunk.hash = HashChunk(data + offset, chunkLength);
+        chunks.Insert(chunk);
+        offset += chunkLength;
+    }
+}
+
+uint64_t ContentChunker::HashChunk(const char *data, unsigned int length)
+{
+    CSHA1 sha1;
+    sha1.Update((const unsigned char *) data, length);
+    sha1.Final();
+    unsigned char digest[SHA1_LENGTH];
+    sha1.GetHash(digest);
+    // Byte by byte so every system gets the same value
+    uint64_t hash = 0;
+    for (int i = 0; i < 8; i++)
+        hash = (hash << 8) | digest[i];
+    return hash;
+}
@@ -0,0 +1,193 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "FileManifestCache.h"
+
+#if _CRABNET_SUPPORT_FileOperations == 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "BitStream.h"
+
+using namespace RakNet;
+
+// Changed whenever the format written by Save() changes
+static const uint32_t MANIFEST_VERSION = 0x4D460001;
+// Bits Save() writes for an entry with an empty filename: the filename length, size, modification time and hash
+static const unsigned int MIN_ENTRY_BITS = (sizeof(unsigned short) + sizeof(uint64_t) + sizeof(int64_t) + sizeof(uint32_t)) * 8;
+
+FileManifestCache::FileManifestCache()
+{
+}
+
+FileManifestCache::~FileManifestCache()
+{
+}
+
+bool FileManifestCache::GetFileInfo(const char *path, uint64_t *size, int64_t *modificationTime)
+{
+#ifdef _WIN32
+    struct _stat64 fileInfo;
+    if (_stat64(path, &fileInfo) != 0)
+        return false;
+    *modificationTime = (int64_t) fileInfo.st_mtime;
+#else
+    struct stat fileInfo;
+    if (stat(path, &fileInfo) != 0)
+        return false;
+#if defined(__APPLE__)
+    *modificationTime = (int64_t) fileInfo.st_mtimespec.tv_sec * 1000000000 + fileInfo.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+    *modificationTime = (int64_t) fileInfo.st_mtim.tv_sec * 1000000000 + fileInfo.st_mtim.tv_nsec;
+#else
+    *modificationTime = (int64_t) fileInfo.st_mtime;
+#endif
+#endif
+    *size = (uint64_t) fileInfo.st_size;
+    return true;
+}
+
+bool FileManifestCache::Load(const char *path)
+{
+    Clear();
+    FILE *fp = fopen(path, "rb");
+    if (fp == nullptr)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    long length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    // BitStream counts in bits, in a BitSize_t
+    if (length <= 0 || (unsigned long) length > ((BitSize_t) -1) / 8)
+    {
+        fclose(fp);
+        return false;
+    }
+    auto data = (unsigned char *) malloc(length);
+    if (data == nullptr)
+    {
+        fclose(fp);
+        return false;
+    }
+    bool read = fread(data, 1, length, fp) == (size_t) length;
+    fclose(fp);
+
+    RakNet::BitStream bitStream(data, (unsigned int) length, false);
+    uint32_t version = 0;
+    unsigned int count = 0;
+    bool valid = read && bitStream.Read(version) && version == MANIFEST_VERSION && bitStream.ReadCompressed(count);
+    // Do not reserve for more entries than the file could hold
+    if (valid && count > bitStream.GetNumberOfUnreadBits() / MIN_ENTRY_BITS)
+        valid = false;
+    if (valid)
+        entries.Reserve(count);
+    for (unsigned int i = 0; i < count && valid; i++)
+    {
+        RakString filename;
+        Entry entry;
+        valid = filename.Deserialize(&bitStream) && bitStream.Read(entry.size) &&
+                bitStream.Read(entry.modificationTime) && bitStream.Read(entry.hash);
+        if (valid)
+        {
+            entry.used = false;
+            entries.Push(filename, entry);
+        }
+    }
+    free(data);
+
+    // Better to hash everything again than to trust part of a damaged manifest
+    if (!valid)
+        Clear();
+    return valid;
+}
+
+bool FileManifestCache::Save(const char *path) const
+{
+    DataStructures::List<Entry> entryList;
+    DataStructures::List<RakString> filenames;
+    entries.GetAsList(entryList, filenames);
+
+    RakNet::BitStream bitStream;
+    bitStream.Write(MANIFEST_VERSION);
+    bitStream.WriteCompressed(entryList.Size());
+    for (unsigned int i = 0; i < entryList.Size(); i++)
+    {
+        filenames[i].Serialize(&bitStream);
+        bitStream.Write(entryList[i].size);
+        bitStream.Write(entryList[i].modificationTime);
+        bitStream.Write(entryList[i].hash);
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == nullptr)
+        return false;
+    bool written = fwrite(bitStream.GetData(), 1, bitStream.GetNumberOfBytesUsed(), fp) == bitStream.GetNumberOfBytesUsed();
+    fclose(fp);
+    return written;
+}
+
+bool FileManifestCache::GetHash(const char *path, uint64_t size, int64_t modificationTime, uint32_t *hash)
+{
+    Entry *entry = entries.Peek(RakString(path));
+    if (entry == nullptr)
+        return false;
+    entry->used = true;
+    if (entry->size != size || entry->modificationTime != modificationTime)
+        return false;
+    *hash = entry->hash;
+    return true;
+}
+
+void FileManifestCache::SetHash(const char *path, uint64_t size, int64_t modificationTime, uint32_t hash)
+{
+    Entry entry;
+    entry.size = size;
+    entry.modificationTime = modificationTime;
+    entry.hash = hash;
+    entry.used = true;
+    RakString filename(path);
+    Entry *existing = entries.Peek(filename);
+    if (existing != nullptr)
+        *existing = entry;
+    else
+        entries.Push(filename, entry);
+}
+
+unsigned int FileManifestCache::RemoveUnused(void)
+{
+    DataStructures::List<Entry> entryList;
+    DataStructures::List<RakString> filenames;
+    entries.GetAsList(entryList, filenames);
+    unsigned int removed = 0;
+    for (unsigned int i = 0; i < entryList.Size(); i++)
+    {
+        if (entryList[i].used)
+            entries.Peek(filenames[i])->used = false;
+        else
+        {
+            entries.Remove(filenames[i]);
+            removed++;
+        }
+    }
+    return removed;
+}
+
+unsigned int FileManifestCache::Size(void) const
+{
+    return entries.Size();
+}
+
+void FileManifestCache::Clear(void)
+{
+    entries.Clear();
+}
+
+#endif // _CRABNET_SUPPORT_*
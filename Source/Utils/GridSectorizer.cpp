@@ -11,16 +11,20 @@
 
 #include "RakAssert.h"
 #include "GridSectorizer.h"
-//#include <stdlib.h>
+#include <cstring>
 #include <cmath>
 
 GridSectorizer::GridSectorizer()
 {
     grid = nullptr;
+    gridCellWidthCount = 0;
+    gridCellHeightCount = 0;
+    cellWidth = 0.0f;
 }
 
 GridSectorizer::~GridSectorizer()
 {
+    Clear();
     delete[] grid;
 }
 
@@ -28,6 +32,7 @@ void GridSectorizer::Init(float _maxCellWidth, float _maxCellHeight, float minX,
 {
     RakAssert(_maxCellWidth > 0.0f && _maxCellHeight > 0.0f);
 
+    Clear();
     delete[] grid;
 
     cellOriginX = minX;
@@ -42,38 +47,27 @@ void GridSectorizer::Init(float _maxCellWidth, float _maxCellHeight, float minX,
     invCellWidth = 1.0f / cellWidth;
     invCellHeight = 1.0f / cellHeight;
 
-#ifdef _USE_ORDERED_LIST
-    grid = new DataStructures::OrderedList<void*, void*>;
-    DataStructures::OrderedList<void*,void*>::IMPLEMENT_DEFAULT_COMPARISON();
-#else
-    grid = new DataStructures::List<void *>[gridCellWidthCount * gridCellHeightCount];
-#endif
+    grid = new GridCell[gridCellWidthCount * gridCellHeightCount];
+    memset(grid, 0, sizeof(GridCell) * gridCellWidthCount * gridCellHeightCount);
 }
 
 void GridSectorizer::AddEntry(void *entry, float minX, float minY, float maxX, float maxY)
 {
     RakAssert(cellWidth > 0.0f);
-    RakAssert(minX < maxX && minY < maxY);
+    RakAssert(minX <= maxX && minY <= maxY);
 
     int xStart = WorldToCellXOffsetAndClamped(minX);
     int yStart = WorldToCellYOffsetAndClamped(minY);
     int xEnd = WorldToCellXOffsetAndClamped(maxX);
     int yEnd = WorldToCellYOffsetAndClamped(maxY);
 
-    for (int xCur = xStart; xCur <= xEnd; ++xCur)
+    for (int yCur = yStart; yCur <= yEnd; ++yCur)
     {
-        for (int yCur = yStart; yCur <= yEnd; ++yCur)
-        {
-#ifdef _USE_ORDERED_LIST
-            grid[yCur * gridCellWidthCount + xCur].Insert(entry, entry, true);
-#else
-            grid[yCur * gridCellWidthCount + xCur].Insert(entry);
-#endif
-        }
+        for (int xCur = xStart; xCur <= xEnd; ++xCur)
+            InsertIntoCell(grid + yCur * gridCellWidthCount + xCur, entry, minX, minY, maxX, maxY);
     }
 }
 
-#ifdef _USE_ORDERED_LIST
 void GridSectorizer::RemoveEntry(void *entry, float minX, float minY, float maxX, float maxY)
 {
     RakAssert(cellWidth > 0.0f);
@@ -84,25 +78,20 @@ void GridSectorizer::RemoveEntry(void *entry, float minX, float minY, float maxX
     int xEnd = WorldToCellXOffsetAndClamped(maxX);
     int yEnd = WorldToCellYOffsetAndClamped(maxY);
 
-    for (int xCur = xStart; xCur <= xEnd; ++xCur)
+    for (int yCur = yStart; yCur <= yEnd; ++yCur)
     {
-        for (int yCur = yStart; yCur <= yEnd; ++yCur)
-            grid[yCur * gridCellWidthCount + xCur].RemoveIfExists(entry);
+        for (int xCur = xStart; xCur <= xEnd; ++xCur)
+            RemoveFromCell(grid + yCur * gridCellWidthCount + xCur, entry);
     }
 }
+
 void GridSectorizer::MoveEntry(void *entry, float sourceMinX, float sourceMinY, float sourceMaxX, float sourceMaxY,
                float destMinX, float destMinY, float destMaxX, float destMaxY)
 {
     RakAssert(cellWidth > 0.0f);
-    RakAssert(sourceMinX < sourceMaxX && sourceMinY < sourceMaxY);
-    RakAssert(destMinX < destMaxX && destMinY < destMaxY);
+    RakAssert(sourceMinX <= sourceMaxX && sourceMinY <= sourceMaxY);
+    RakAssert(destMinX <= destMaxX && destMinY <= destMaxY);
 
-    if (PositionCrossesCells(sourceMinX, sourceMinY, destMinX, destMinY) == false &&
-        PositionCrossesCells(destMinX, destMinY, destMinX, destMinY) == false)
-        return;
-
-    int xStartSource, yStartSource, xEndSource, yEndSource;
-    int xStartDest, yStartDest, xEndDest, yEndDest;
     int xStartSource = WorldToCellXOffsetAndClamped(sourceMinX);
     int yStartSource = WorldToCellYOffsetAndClamped(sourceMinY);
     int xEndSource = WorldToCellXOffsetAndClamped(sourceMaxX);
@@ -113,55 +102,213 @@ void GridSectorizer::MoveEntry(void *entry, float sourceMinX, float sourceMinY,
     int xEndDest = WorldToCellXOffsetAndClamped(destMaxX);
     int yEndDest = WorldToCellYOffsetAndClamped(destMaxY);
 
-    // Remove source that is not in dest
-    for (int xCur = xStartSource; xCur <= xEndSource; ++xCur)
+    GridCell *cell;
+    GridEntry *gridEntry;
+    for (int yCur = yStartSource; yCur <= yEndSource; ++yCur)
     {
-        for (int yCur = yStartSource; yCur <= yEndSource; ++yCur)
+        for (int xCur = xStartSource; xCur <= xEndSource; ++xCur)
         {
+            cell = grid + yCur * gridCellWidthCount + xCur;
             if (xCur < xStartDest || xCur > xEndDest || yCur < yStartDest || yCur > yEndDest)
-                grid[yCur*gridCellWidthCount+xCur].RemoveIfExists(entry);
+            {
+                // Left this cell
+                RemoveFromCell(cell, entry);
+            }
+            else
+            {
+                // Still in this cell, update in place
+                gridEntry = FindInCell(cell, entry);
+                RakAssert(gridEntry);
+                if (gridEntry)
+                {
+                    gridEntry->minX = destMinX;
+                    gridEntry->minY = destMinY;
+                    gridEntry->maxX = destMaxX;
+                    gridEntry->maxY = destMaxY;
+                }
+            }
         }
     }
 
-    // Add dest that is not in source
-    for (int xCur = xStartDest; xCur <= xEndDest; ++xCur)
+    // Entered these cells
+    for (int yCur = yStartDest; yCur <= yEndDest; ++yCur)
     {
-        for (int yCur = yStartDest; yCur <= yEndDest; ++yCur)
+        for (int xCur = xStartDest; xCur <= xEndDest; ++xCur)
         {
             if (xCur < xStartSource || xCur > xEndSource || yCur < yStartSource || yCur > yEndSource)
-                grid[yCur * gridCellWidthCount + xCur].Insert(entry,entry, true);
+                InsertIntoCell(grid + yCur * gridCellWidthCount + xCur, entry, destMinX, destMinY, destMaxX, destMaxY);
         }
     }
 }
-#endif
 
-void GridSectorizer::GetEntries(DataStructures::List<void *> &intersectionList, float minX, float minY, float maxX, float maxY)
+void GridSectorizer::GetEntries(DataStructures::List<void *> &intersectionList, float minX, float minY, float maxX, float maxY) const
 {
-#ifdef _USE_ORDERED_LIST
-    DataStructures::OrderedList<void*, void*>* cell;
-#else
-    DataStructures::List<void *> *cell;
-#endif
+    const GridCell *cell;
+    const GridEntry *gridEntry;
     int xStart = WorldToCellXOffsetAndClamped(minX);
     int yStart = WorldToCellYOffsetAndClamped(minY);
     int xEnd = WorldToCellXOffsetAndClamped(maxX);
     int yEnd = WorldToCellYOffsetAndClamped(maxY);
 
     intersectionList.Clear(true);
-    for (int xCur = xStart; xCur <= xEnd; ++xCur)
+    for (int yCur = yStart; yCur <= yEnd; ++yCur)
     {
-        for (int yCur = yStart; yCur <= yEnd; ++yCur)
+        for (int xCur = xStart; xCur <= xEnd; ++xCur)
         {
             cell = grid + yCur * gridCellWidthCount + xCur;
-            for (unsigned index = 0; index < cell->Size(); ++index)
-                intersectionList.Insert((*cell)[index]);
+            for (unsigned index = 0; index < cell->count; ++index)
+            {
+                gridEntry = cell->entries + index;
+                if (gridEntry->minX > maxX || gridEntry->maxX < minX || gridEntry->minY > maxY || gridEntry->maxY < minY)
+                    continue;
+
+                // An entry spanning several cells is only reported from the first of its cells that the query covers
+                int firstX = WorldToCellXOffsetAndClamped(gridEntry->minX);
+                int firstY = WorldToCellYOffsetAndClamped(gridEntry->minY);
+                if ((firstX > xStart ? firstX : xStart) != xCur || (firstY > yStart ? firstY : yStart) != yCur)
+                    continue;
+
+                intersectionList.Insert(gridEntry->entry);
+            }
         }
     }
 }
 
-bool GridSectorizer::PositionCrossesCells(float originX, float originY, float destinationX, float destinationY) const
+void GridSectorizer::GetNearestEntries(DataStructures::List<void *> &nearestList, float x, float y, unsigned k, float maxDistance) const
 {
-    return originX / cellWidth != destinationX / cellWidth || originY / cellHeight != destinationY / cellHeight;
+    nearestList.Clear(true);
+    if (k == 0 || grid == nullptr)
+        return;
+
+    // Best candidates so far, sorted by distance. k is expected to be small, so insertion into a sorted array is fine
+    DataStructures::List<float> nearestDistances;
+    float maxDistanceSquared = maxDistance < FLT_MAX ? maxDistance * maxDistance : FLT_MAX;
+
+    int centerX = WorldToCellXOffsetAndClamped(x);
+    int centerY = WorldToCellYOffsetAndClamped(y);
+    int maxRing = centerX;
+    if (gridCellWidthCount - 1 - centerX > maxRing) maxRing = gridCellWidthCount - 1 - centerX;
+    if (centerY > maxRing) maxRing = centerY;
+    if (gridCellHeightCount - 1 - centerY > maxRing) maxRing = gridCellHeightCount - 1 - centerY;
+
+    for (int ring = 0; ring <= maxRing; ++ring)
+    {
+        if (ring > 0)
+        {
+            // Everything not yet visited is outside the square of rings already searched
+            float bound = x - (cellOriginX + (centerX - ring + 1) * cellWidth);
+            float side = cellOriginX + (centerX + ring) * cellWidth - x;
+            if (side < bound) bound = side;
+            side = y - (cellOriginY + (centerY - ring + 1) * cellHeight);
+            if (side < bound) bound = side;
+            side = cellOriginY + (centerY + ring) * cellHeight - y;
+            if (side < bound) bound = side;
+            if (bound > 0.0f)
+            {
+                float boundSquared = bound * bound;
+                if (boundSquared > maxDistanceSquared)
+                    break;
+                if (nearestList.Size() == k && boundSquared > nearestDistances[k - 1])
+                    break;
+            }
+        }
+
+        int yStart = centerY - ring, yEnd = centerY + ring;
+        int xStart = centerX - ring, xEnd = centerX + ring;
+        for (int yCur = yStart; yCur <= yEnd; ++yCur)
+        {
+            if (yCur < 0 || yCur >= gridCellHeightCount)
+                continue;
+            // Only the border of the ring, the inside was searched already
+            int xStep = (yCur == yStart || yCur == yEnd) ? 1 : xEnd - xStart;
+            for (int xCur = xStart; xCur <= xEnd; xCur += xStep)
+            {
+                if (xCur < 0 || xCur >= gridCellWidthCount)
+                    continue;
+
+                const GridCell *cell = grid + yCur * gridCellWidthCount + xCur;
+                for (unsigned index = 0; index < cell->count; ++index)
+                {
+                    const GridEntry &gridEntry = cell->entries[index];
+                    float distanceSquared = DistanceSquaredToEntry(gridEntry, x, y);
+                    if (distanceSquared > maxDistanceSquared)
+                        continue;
+                    if (nearestList.Size() == k && distanceSquared >= nearestDistances[k - 1])
+                        continue;
+
+                    // Entries spanning several cells are seen more than once
+                    if (nearestList.GetIndexOf(gridEntry.entry) != (unsigned) -1)
+                        continue;
+
+                    if (nearestList.Size() == k)
+                    {
+                        nearestList.RemoveFromEnd();
+                        nearestDistances.RemoveFromEnd();
+                    }
+                    unsigned insertIndex = nearestList.Size();
+                    while (insertIndex > 0 && nearestDistances[insertIndex - 1] > distanceSquared)
+                        insertIndex--;
+                    nearestList.Insert(gridEntry.entry, insertIndex);
+                    nearestDistances.Insert(distanceSquared, insertIndex);
+                }
+            }
+        }
+    }
+}
+
+unsigned GridSectorizer::GetCellEntryCount() const
+{
+    unsigned total = 0;
+    int count = gridCellWidthCount * gridCellHeightCount;
+    for (int cur = 0; cur < count; cur++)
+        total += grid[cur].count;
+    return total;
+}
+
+void GridSectorizer::InsertIntoCell(GridCell *cell, void *entry, float minX, float minY, float maxX, float maxY)
+{
+    if (cell->count == cell->capacity)
+    {
+        unsigned newCapacity = cell->capacity == 0 ? 4 : cell->capacity * 2;
+        GridEntry *newEntries = new GridEntry[newCapacity];
+        if (cell->count > 0)
+            memcpy(newEntries, cell->entries, sizeof(GridEntry) * cell->count);
+        delete[] cell->entries;
+        cell->entries = newEntries;
+        cell->capacity = newCapacity;
+    }
+
+    GridEntry &gridEntry = cell->entries[cell->count++];
+    gridEntry.entry = entry;
+    gridEntry.minX = minX;
+    gridEntry.minY = minY;
+    gridEntry.maxX = maxX;
+    gridEntry.maxY = maxY;
+}
+
+void GridSectorizer::RemoveFromCell(GridCell *cell, void *entry)
+{
+    // Cells are unordered, so fill the hole with the last entry
+    GridEntry *gridEntry = FindInCell(cell, entry);
+    if (gridEntry)
+        *gridEntry = cell->entries[--cell->count];
+}
+
+GridSectorizer::GridEntry *GridSectorizer::FindInCell(GridCell *cell, void *entry) const
+{
+    for (unsigned index = 0; index < cell->count; ++index)
+    {
+        if (cell->entries[index].entry == entry)
+            return cell->entries + index;
+    }
+    return nullptr;
+}
+
+float GridSectorizer::DistanceSquaredToEntry(const GridEntry &gridEntry, float x, float y)
+{
+    float dx = x < gridEntry.minX ? gridEntry.minX - x : (x > gridEntry.maxX ? x - gridEntry.maxX : 0.0f);
+    float dy = y < gridEntry.minY ? gridEntry.minY - y : (y > gridEntry.maxY ? y - gridEntry.maxY : 0.0f);
+    return dx * dx + dy * dy;
 }
 
 int GridSectorizer::WorldToCellX(float input) const
@@ -194,5 +341,10 @@ void GridSectorizer::Clear()
 {
     int count = gridCellWidthCount * gridCellHeightCount;
     for (int cur = 0; cur < count; cur++)
-        grid[cur].Clear(true);
+    {
+        delete[] grid[cur].entries;
+        grid[cur].entries = nullptr;
+        grid[cur].count = 0;
+        grid[cur].capacity = 0;
+    }
 }
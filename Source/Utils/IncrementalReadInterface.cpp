@@ -26,3 +26,14 @@ unsigned int IncrementalReadInterface::GetFilePart(const char *filename, unsigne
     fclose(fp);
     return numRead;
 }
+
+bool IncrementalReadInterface::AcquireFilePart(const char */*filename*/, unsigned int /*startReadBytes*/,
+                                               unsigned int /*numBytesToRead*/, const char **/*data*/,
+                                               unsigned int */*bytesRead*/, FileListNodeContext &/*context*/)
+{
+    return false;
+}
+
+void IncrementalReadInterface::ReleaseFilePart(const char */*filename*/, const char */*data*/)
+{
+}
@@ -0,0 +1,315 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "MappedFileCache.h"
+#include <string.h>
+#include "RakAssert.h"
+
+#ifdef _WIN32
+#include "WindowsIncludes.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace RakNet;
+
+MappedFileCache::MappedFileCache()
+{
+    maxMappedBytes = (uint64_t) 1 << 30;
+    useCount = 0;
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+MappedFileCache::~MappedFileCache()
+{
+    // Every acquired part should have been released
+    RakAssert(unmappedFiles.Size() == 0);
+    for (unsigned int i = 0; i < mappedFiles.Size(); i++)
+    {
+        RakAssert(mappedFiles[i]->acquiredCount == 0);
+        UnmapFile(mappedFiles[i]);
+        delete mappedFiles[i];
+    }
+    for (unsigned int i = 0; i < unmappedFiles.Size(); i++)
+    {
+        UnmapFile(unmappedFiles[i]);
+        delete unmappedFiles[i];
+    }
+}
+
+bool MappedFileCache::MapFile(const char *filename, const char **data, unsigned int *length)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    // Empty files cannot be mapped
+    if (GetFileSizeEx(file, &fileSize) == 0 || fileSize.QuadPart == 0 || fileSize.QuadPart > 0xFFFFFFFF)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    CloseHandle(file);
+    if (mapping == 0)
+        return false;
+    // The view keeps the mapping open
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == 0)
+        return false;
+    *data = (const char *) view;
+    *length = (unsigned int) fileSize.QuadPart;
+    return true;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat fileInfo;
+    // Empty files cannot be mapped
+    if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size == 0 || (uint64_t) fileInfo.st_size > 0xFFFFFFFF)
+    {
+        close(fd);
+        return false;
+    }
+    void *view = mmap(0, (size_t) fileInfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file open
+    close(fd);
+    if (view == MAP_FAILED)
+        return false;
+    *data = (const char *) view;
+    *length = (unsigned int) fileInfo.st_size;
+    return true;
+#endif
+}
+
+void MappedFileCache::UnmapFile(MappedFile *mappedFile)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(mappedFile->data);
+#else
+    munmap((void *) mappedFile->data, mappedFile->length);
+#endif
+}
+
+MappedFileCache::MappedFile *MappedFileCache::GetMappedFile(const char *filename)
+{
+    MappedFile **found = filesByName.Peek(RakString(filename));
+    if (found != nullptr)
+    {
+        (*found)->lastUsed = ++useCount;
+        return *found;
+    }
+
+    const char *data;
+    unsigned int length;
+    if (!MapFile(filename, &data, &length))
+        return nullptr;
+
+    auto mappedFile = new MappedFile;
+    mappedFile->filename = filename;
+    mappedFile->data = data;
+    mappedFile->length = length;
+    mappedFile->acquiredCount = 0;
+    mappedFile->lastUsed = ++useCount;
+    filesByName.Push(mappedFile->filename, mappedFile);
+    mappedFiles.Insert(mappedFile);
+    statistics.filesMapped++;
+    statistics.bytesMapped += length;
+    statistics.mappingsCreated++;
+    RemoveUnused();
+    return mappedFile;
+}
+
+void MappedFileCache::RemoveUnused(void)
+{
+    while (statistics.bytesMapped > maxMappedBytes)
+    {
+        // Least recently used file not being read. The file just mapped is the most recent, so it is only removed if it is the only one
+        unsigned int oldest = mappedFiles.Size();
+        for (unsigned int i = 0; i < mappedFiles.Size(); i++)
+        {
+            if (mappedFiles[i]->acquiredCount == 0 && (oldest == mappedFiles.Size() || mappedFiles[i]->lastUsed < mappedFiles[oldest]->lastUsed))
+                oldest = i;
+        }
+        if (oldest == mappedFiles.Size() || mappedFiles[oldest]->lastUsed == useCount)
+            return;
+
+        MappedFile *mappedFile = mappedFiles[oldest];
+        filesByName.Remove(mappedFile->filename);
+        mappedFiles.RemoveAtIndexFast(oldest);
+        statistics.filesMapped--;
+        statistics.bytesMapped -= mappedFile->length;
+        UnmapFile(mappedFile);
+        delete mappedFile;
+    }
+}
+
+unsigned int MappedFileCache::GetFilePart(const char *filename, unsigned int startReadBytes, unsigned int numBytesToRead,
+                                          void *preallocatedDestination, FileListNodeContext &context)
+{
+    mutex.Lock();
+    MappedFile *mappedFile = GetMappedFile(filename);
+    if (mappedFile == nullptr)
+    {
+        statistics.partsRead++;
+        mutex.Unlock();
+        return IncrementalReadInterface::GetFilePart(filename, startReadBytes, numBytesToRead, preallocatedDestination, context);
+    }
+    // Held so the file is not unmapped during the copy, which is done without the lock
+    mappedFile->acquiredCount++;
+    statistics.partsMapped++;
+    mutex.Unlock();
+
+    unsigned int bytesRead = 0;
+    if (startReadBytes < mappedFile->length)
+    {
+        bytesRead = mappedFile->length - startReadBytes;
+        if (bytesRead > numBytesToRead)
+            bytesRead = numBytesToRead;
+        memcpy(preallocatedDestination, mappedFile->data + startReadBytes, bytesRead);
+    }
+    ReleaseFilePart(filename, mappedFile->data);
+    return bytesRead;
+}
+
+bool MappedFileCache::AcquireFilePart(const char *filename, unsigned int startReadBytes, unsigned int numBytesToRead,
+                                      const char **data, unsigned int *bytesRead, FileListNodeContext &/*context*/)
+{
+    mutex.Lock();
+    MappedFile *mappedFile = GetMappedFile(filename);
+    if (mappedFile == nullptr)
+    {
+        mutex.Unlock();
+        return false;
+    }
+    mappedFile->acquiredCount++;
+    statistics.partsMapped++;
+    mutex.Unlock();
+
+    if (startReadBytes < mappedFile->length)
+    {
+        *bytesRead = mappedFile->length - startReadBytes;
+        if (*bytesRead > numBytesToRead)
+            *bytesRead = numBytesToRead;
+        *data = mappedFile->data + startReadBytes;
+    }
+    else
+    {
+        *bytesRead = 0;
+        *data = mappedFile->data;
+    }
+    return true;
+}
+
+void MappedFileCache::ReleaseFilePart(const char *filename, const char *data)
+{
+    mutex.Lock();
+    MappedFile **found = filesByName.Peek(RakString(filename));
+    if (found != nullptr && data >= (*found)->data && data <= (*found)->data + (*found)->length)
+    {
+        RakAssert((*found)->acquiredCount > 0);
+        (*found)->acquiredCount--;
+        if ((*found)->acquiredCount == 0)
+            RemoveUnused();
+        mutex.Unlock();
+        return;
+    }
+
+    // Unmap() was called while this part was acquired
+    for (unsigned int i = 0; i < unmappedFiles.Size(); i++)
+    {
+        MappedFile *mappedFile = unmappedFiles[i];
+        if (data >= mappedFile->data && data <= mappedFile->data + mappedFile->length)
+        {
+            RakAssert(mappedFile->acquiredCount > 0);
+            if (--mappedFile->acquiredCount == 0)
+            {
+                unmappedFiles.RemoveAtIndexFast(i);
+                UnmapFile(mappedFile);
+                delete mappedFile;
+            }
+            break;
+        }
+    }
+    mutex.Unlock();
+}
+
+void MappedFileCache::SetMaxMappedBytes(uint64_t bytes)
+{
+    mutex.Lock();
+    maxMappedBytes = bytes;
+    // Nothing is the most recently used now, so every file not being read may be removed
+    useCount++;
+    RemoveUnused();
+    mutex.Unlock();
+}
+
+void MappedFileCache::Unmap(const char *filename)
+{
+    mutex.Lock();
+    MappedFile *mappedFile;
+    if (filesByName.Pop(mappedFile, RakString(filename)))
+    {
+        for (unsigned int i = 0; i < mappedFiles.Size(); i++)
+        {
+            if (mappedFiles[i] == mappedFile)
+            {
+                mappedFiles.RemoveAtIndexFast(i);
+                break;
+            }
+        }
+        statistics.filesMapped--;
+        statistics.bytesMapped -= mappedFile->length;
+        if (mappedFile->acquiredCount > 0)
+            unmappedFiles.Insert(mappedFile);
+        else
+        {
+            UnmapFile(mappedFile);
+            delete mappedFile;
+        }
+    }
+    mutex.Unlock();
+}
+
+void MappedFileCache::Clear(void)
+{
+    mutex.Lock();
+    unsigned int i = 0;
+    while (i < mappedFiles.Size())
+    {
+        MappedFile *mappedFile = mappedFiles[i];
+        if (mappedFile->acquiredCount > 0)
+        {
+            i++;
+            continue;
+        }
+        filesByName.Remove(mappedFile->filename);
+        mappedFiles.RemoveAtIndexFast(i);
+        statistics.filesMapped--;
+        statistics.bytesMapped -= mappedFile->length;
+        UnmapFile(mappedFile);
+        delete mappedFile;
+    }
+    mutex.Unlock();
+}
+
+MappedFileCache::Statistics MappedFileCache::GetStatistics(void)
+{
+    mutex.Lock();
+    Statistics copy = statistics;
+    mutex.Unlock();
+    return copy;
+}
@@ -0,0 +1,138 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file
+///
+
+#include "PacketCache.h"
+#include "RakAllocator.h"
+#include "SimpleMutex.h"
+#include "DS_List.h"
+#include <new>
+#include <atomic>
+
+using namespace RakNet;
+
+namespace
+{
+    struct PacketThreadCache;
+
+    struct CachedPacket
+    {
+        // First, so a Packet * from AllocCachedPacket() is also a CachedPacket *
+        Packet packet;
+        // Cache of the thread that allocated the packet, which it returns to when released
+        PacketThreadCache *owner;
+        CachedPacket *next;
+    };
+
+    struct PacketThreadCache
+    {
+        // Only used by the owning thread
+        CachedPacket *freePackets;
+        // Packets released by other threads. Pushed by any thread, emptied all at once by the owning thread
+        std::atomic<CachedPacket *> remoteFreePackets;
+    };
+
+    // Caches are never deleted, since other threads may still release packets into them. A cache left by a thread that exited is reused by the next new thread
+    struct PacketCacheRegistry
+    {
+        SimpleMutex mutex;
+        DataStructures::List<PacketThreadCache *> unusedCaches;
+    };
+
+    PacketCacheRegistry &GetPacketCacheRegistry(void)
+    {
+        // Never destroyed, so threads that exit after static destruction can still return their cache
+        static PacketCacheRegistry *registry = new PacketCacheRegistry;
+        return *registry;
+    }
+
+    struct PacketThreadCacheHolder
+    {
+        PacketThreadCache *cache;
+
+        ~PacketThreadCacheHolder()
+        {
+            if (cache == 0)
+                return;
+            PacketCacheRegistry &registry = GetPacketCacheRegistry();
+            registry.mutex.Lock();
+            registry.unusedCaches.Push(cache);
+            registry.mutex.Unlock();
+        }
+    };
+
+    thread_local PacketThreadCacheHolder threadCacheHolder = {0};
+
+    PacketThreadCache *GetPacketThreadCache(void)
+    {
+        if (threadCacheHolder.cache)
+            return threadCacheHolder.cache;
+
+        PacketCacheRegistry &registry = GetPacketCacheRegistry();
+        PacketThreadCache *cache;
+        registry.mutex.Lock();
+        if (registry.unusedCaches.Size() > 0)
+            cache = registry.unusedCaches.Pop();
+        else
+        {
+            cache = new PacketThreadCache;
+            cache->freePackets = 0;
+            cache->remoteFreePackets = 0;
+        }
+        registry.mutex.Unlock();
+        threadCacheHolder.cache = cache;
+        return cache;
+    }
+}
+
+Packet *RakNet::AllocCachedPacket(void)
+{
+    PacketThreadCache *cache = GetPacketThreadCache();
+    CachedPacket *cachedPacket = cache->freePackets;
+    if (cachedPacket == 0)
+    {
+        cachedPacket = cache->remoteFreePackets.exchange(0, std::memory_order_acquire);
+        if (cachedPacket == 0)
+        {
+            cachedPacket = (CachedPacket *) rakMalloc_Ex(sizeof(CachedPacket), _FILE_AND_LINE_);
+            if (cachedPacket == 0)
+                return 0;
+            cachedPacket->owner = cache;
+            cachedPacket->next = 0;
+        }
+    }
+    cache->freePackets = cachedPacket->next;
+    return new((void *) &cachedPacket->packet) Packet;
+}
+
+void RakNet::ReleaseCachedPacket(Packet *packet)
+{
+    if (packet == 0)
+        return;
+
+    packet->~Packet();
+    CachedPacket *cachedPacket = (CachedPacket *) packet;
+    PacketThreadCache *owner = cachedPacket->owner;
+    if (owner == threadCacheHolder.cache)
+    {
+        cachedPacket->next = owner->freePackets;
+        owner->freePackets = cachedPacket;
+        return;
+    }
+
+    CachedPacket *head = owner->remoteFreePackets.load(std::memory_order_relaxed);
+    do
+    {
+        cachedPacket->next = head;
+    } while (!owner->remoteFreePackets.compare_exchange_weak(head, cachedPacket, std::memory_order_release, std::memory_order_relaxed));
+}
@@ -0,0 +1,401 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file
+///
+
+#include "RakAllocator.h"
+#include "SimpleMutex.h"
+#include "RakAssert.h"
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+using namespace RakNet;
+
+static void *DefaultMalloc_Ex(size_t size, const char *file, unsigned int line)
+{
+    (void) file;
+    (void) line;
+    return malloc(size);
+}
+
+static void *DefaultRealloc_Ex(void *p, size_t size, const char *file, unsigned int line)
+{
+    (void) file;
+    (void) line;
+    return realloc(p, size);
+}
+
+static void DefaultFree_Ex(void *p, const char *file, unsigned int line)
+{
+    (void) file;
+    (void) line;
+    free(p);
+}
+
+void *(*RakNet::rakMalloc_Ex)(size_t size, const char *file, unsigned int line) = DefaultMalloc_Ex;
+void *(*RakNet::rakRealloc_Ex)(void *p, size_t size, const char *file, unsigned int line) = DefaultRealloc_Ex;
+void (*RakNet::rakFree_Ex)(void *p, const char *file, unsigned int line) = DefaultFree_Ex;
+
+void RakNet::SetMalloc_Ex(void *(*userFunction)(size_t size, const char *file, unsigned int line))
+{
+    rakMalloc_Ex = userFunction;
+}
+
+void RakNet::SetRealloc_Ex(void *(*userFunction)(void *p, size_t size, const char *file, unsigned int line))
+{
+    rakRealloc_Ex = userFunction;
+}
+
+void RakNet::SetFree_Ex(void (*userFunction)(void *p, const char *file, unsigned int line))
+{
+    rakFree_Ex = userFunction;
+}
+
+void RakNet::UseArenaAllocator(void)
+{
+    SetMalloc_Ex(ArenaMalloc_Ex);
+    SetRealloc_Ex(ArenaRealloc_Ex);
+    SetFree_Ex(ArenaFree_Ex);
+}
+
+namespace
+{
+    // 16 to 128 bytes in steps of 16, then four classes between each power of two up to 32768
+    const unsigned int ARENA_SIZE_CLASS_COUNT = 40;
+    const size_t ARENA_MAX_SMALL_SIZE = 32768;
+    const size_t ARENA_SPAN_SIZE = 65536;
+    const uint32_t ARENA_LARGE_BLOCK = 0xFFFFFFFF;
+    // Call sites counted per thread. Must be a power of two
+    const unsigned int ARENA_SITE_TABLE_SIZE = 256;
+
+    struct ArenaThreadCache;
+
+    // Precedes every block, 16 bytes so the memory returned keeps the alignment of malloc()
+    struct alignas(16) ArenaBlockHeader
+    {
+        // Cache of the thread that carved the block, which it returns to when freed. 0 for large blocks
+        ArenaThreadCache *owner;
+        uint32_t sizeClass;
+    };
+
+    struct ArenaSite
+    {
+        // Set last by the owning thread, so a reader that sees it also sees line
+        std::atomic<const char *> file;
+        unsigned int line;
+        std::atomic<uint64_t> allocations;
+        std::atomic<uint64_t> bytes;
+    };
+
+    struct ArenaThreadCache
+    {
+        // Only used by the owning thread
+        ArenaBlockHeader *freeBlocks[ARENA_SIZE_CLASS_COUNT];
+        // Blocks freed by other threads. Pushed by any thread, emptied all at once by the owning thread
+        std::atomic<ArenaBlockHeader *> remoteFreeBlocks[ARENA_SIZE_CLASS_COUNT];
+        ArenaSite sites[ARENA_SITE_TABLE_SIZE];
+        // Allocations from call sites that did not fit in sites
+        std::atomic<uint64_t> otherAllocations;
+        std::atomic<uint64_t> otherBytes;
+    };
+
+    // Caches are never deleted, since other threads may still free blocks into them. A cache left by a thread that exited is reused by the next new thread
+    struct ArenaRegistry
+    {
+        SimpleMutex mutex;
+        DataStructures::List<ArenaThreadCache *> caches;
+        DataStructures::List<ArenaThreadCache *> unusedCaches;
+    };
+
+    ArenaRegistry &GetArenaRegistry(void)
+    {
+        // Never destroyed, so threads that exit after static destruction can still return their cache
+        static ArenaRegistry *registry = new ArenaRegistry;
+        return *registry;
+    }
+
+    ArenaThreadCache *AcquireArenaThreadCache(void)
+    {
+        ArenaRegistry &registry = GetArenaRegistry();
+        registry.mutex.Lock();
+        ArenaThreadCache *cache;
+        if (registry.unusedCaches.Size() > 0)
+            cache = registry.unusedCaches.Pop();
+        else
+        {
+            cache = new ArenaThreadCache;
+            for (unsigned int i = 0; i < ARENA_SIZE_CLASS_COUNT; i++)
+            {
+                cache->freeBlocks[i] = 0;
+                cache->remoteFreeBlocks[i] = 0;
+            }
+            for (unsigned int i = 0; i < ARENA_SITE_TABLE_SIZE; i++)
+            {
+                cache->sites[i].file = 0;
+                cache->sites[i].line = 0;
+                cache->sites[i].allocations = 0;
+                cache->sites[i].bytes = 0;
+            }
+            cache->otherAllocations = 0;
+            cache->otherBytes = 0;
+            registry.caches.Push(cache);
+        }
+        registry.mutex.Unlock();
+        return cache;
+    }
+
+    struct ArenaThreadCacheHolder
+    {
+        ArenaThreadCache *cache;
+
+        ~ArenaThreadCacheHolder()
+        {
+            if (cache == 0)
+                return;
+            ArenaRegistry &registry = GetArenaRegistry();
+            registry.mutex.Lock();
+            registry.unusedCaches.Push(cache);
+            registry.mutex.Unlock();
+            // Another thread may take the cache now. Frees from later thread_local destructors on this thread push to it as remote frees
+            cache = 0;
+        }
+    };
+
+    thread_local ArenaThreadCacheHolder threadCacheHolder = {0};
+
+    inline ArenaThreadCache *GetArenaThreadCache(void)
+    {
+        if (threadCacheHolder.cache == 0)
+            threadCacheHolder.cache = AcquireArenaThreadCache();
+        return threadCacheHolder.cache;
+    }
+
+    inline ArenaBlockHeader *&NextFreeBlock(ArenaBlockHeader *block)
+    {
+        return *(ArenaBlockHeader **) (block + 1);
+    }
+
+    inline unsigned int SizeToClass(size_t size)
+    {
+        if (size <= 128)
+            return size == 0 ? 0 : (unsigned int) ((size + 15) >> 4) - 1;
+
+        size_t n = size - 1;
+        unsigned int highestBit = 7;
+        while ((n >> (highestBit + 1)) != 0)
+            highestBit++;
+        return 8 + (highestBit - 7) * 4 + (unsigned int) ((n >> (highestBit - 2)) & 3);
+    }
+
+    inline size_t ClassToSize(unsigned int sizeClass)
+    {
+        if (sizeClass < 8)
+            return 16 * (size_t) (sizeClass + 1);
+
+        unsigned int highestBit = 7 + (sizeClass - 8) / 4;
+        return ((size_t) 1 << highestBit) + ((size_t) 1 << (highestBit - 2)) * ((sizeClass - 8) % 4 + 1);
+    }
+
+    void CountAllocation(ArenaThreadCache *cache, size_t size, const char *file, unsigned int line)
+    {
+        unsigned int index = (unsigned int) ((((uintptr_t) file) >> 3) ^ (line * 2654435761u)) & (ARENA_SITE_TABLE_SIZE - 1);
+        for (unsigned int probe = 0; probe < ARENA_SITE_TABLE_SIZE; probe++)
+        {
+            ArenaSite &site = cache->sites[(index + probe) & (ARENA_SITE_TABLE_SIZE - 1)];
+            const char *siteFile = site.file.load(std::memory_order_relaxed);
+            if (siteFile == 0)
+            {
+                site.line = line;
+                site.allocations.store(1, std::memory_order_relaxed);
+                site.bytes.store(size, std::memory_order_relaxed);
+                site.file.store(file ? file : "", std::memory_order_release);
+                return;
+            }
+            if (site.line == line && (siteFile == file || (file == 0 && siteFile[0] == 0)))
+            {
+                site.allocations.store(site.allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                site.bytes.store(site.bytes.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+                return;
+            }
+        }
+        cache->otherAllocations.store(cache->otherAllocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        cache->otherBytes.store(cache->otherBytes.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+    }
+
+    // Carves a new span into blocks of one size class, and returns the first of them linked together
+    ArenaBlockHeader *AllocateSpan(ArenaThreadCache *cache, unsigned int sizeClass)
+    {
+        size_t blockSize = sizeof(ArenaBlockHeader) + ClassToSize(sizeClass);
+        size_t blockCount = ARENA_SPAN_SIZE / blockSize;
+        if (blockCount == 0)
+            blockCount = 1;
+
+        char *span = (char *) malloc(blockSize * blockCount);
+        if (span == 0)
+            return 0;
+
+        ArenaBlockHeader *first = 0;
+        for (size_t i = blockCount; i-- > 0;)
+        {
+            ArenaBlockHeader *block = (ArenaBlockHeader *) (span + i * blockSize);
+            block->owner = cache;
+            block->sizeClass = sizeClass;
+            NextFreeBlock(block) = first;
+            first = block;
+        }
+        return first;
+    }
+}
+
+void *RakNet::ArenaMalloc_Ex(size_t size, const char *file, unsigned int line)
+{
+    ArenaThreadCache *cache = GetArenaThreadCache();
+    CountAllocation(cache, size, file, line);
+
+    if (size > ARENA_MAX_SMALL_SIZE)
+    {
+        ArenaBlockHeader *block = (ArenaBlockHeader *) malloc(sizeof(ArenaBlockHeader) + size);
+        if (block == 0)
+            return 0;
+        block->owner = 0;
+        block->sizeClass = ARENA_LARGE_BLOCK;
+        return block + 1;
+    }
+
+    unsigned int sizeClass = SizeToClass(size);
+    ArenaBlockHeader *block = cache->freeBlocks[sizeClass];
+    if (block == 0)
+    {
+        block = cache->remoteFreeBlocks[sizeClass].exchange(0, std::memory_order_acquire);
+        if (block == 0)
+        {
+            block = AllocateSpan(cache, sizeClass);
+            if (block == 0)
+                return 0;
+        }
+    }
+    cache->freeBlocks[sizeClass] = NextFreeBlock(block);
+    return block + 1;
+}
+
+void RakNet::ArenaFree_Ex(void *p, const char *file, unsigned int line)
+{
+    (void) file;
+    (void) line;
+
+    if (p == 0)
+        return;
+
+    ArenaBlockHeader *block = ((ArenaBlockHeader *) p) - 1;
+    if (block->sizeClass == ARENA_LARGE_BLOCK)
+    {
+        free(block);
+        return;
+    }
+
+    RakAssert(block->sizeClass < ARENA_SIZE_CLASS_COUNT);
+    ArenaThreadCache *owner = block->owner;
+    if (owner == threadCacheHolder.cache)
+    {
+        NextFreeBlock(block) = owner->freeBlocks[block->sizeClass];
+        owner->freeBlocks[block->sizeClass] = block;
+        return;
+    }
+
+    std::atomic<ArenaBlockHeader *> &remoteFreeBlocks = owner->remoteFreeBlocks[block->sizeClass];
+    ArenaBlockHeader *head = remoteFreeBlocks.load(std::memory_order_relaxed);
+    do
+    {
+        NextFreeBlock(block) = head;
+    } while (!remoteFreeBlocks.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void *RakNet::ArenaRealloc_Ex(void *p, size_t size, const char *file, unsigned int line)
+{
+    if (p == 0)
+        return ArenaMalloc_Ex(size, file, line);
+    if (size == 0)
+    {
+        ArenaFree_Ex(p, file, line);
+        return 0;
+    }
+
+    ArenaBlockHeader *block = ((ArenaBlockHeader *) p) - 1;
+    if (block->sizeClass == ARENA_LARGE_BLOCK && size > ARENA_MAX_SMALL_SIZE)
+    {
+        CountAllocation(GetArenaThreadCache(), size, file, line);
+        block = (ArenaBlockHeader *) realloc(block, sizeof(ArenaBlockHeader) + size);
+        return block ? block + 1 : 0;
+    }
+
+    if (block->sizeClass != ARENA_LARGE_BLOCK && size <= ClassToSize(block->sizeClass))
+        return p;
+
+    void *newMemory = ArenaMalloc_Ex(size, file, line);
+    if (newMemory == 0)
+        return 0;
+    // Only reached when growing a small block or shrinking a large one, so the smaller of the two sizes is known
+    size_t copySize = block->sizeClass == ARENA_LARGE_BLOCK ? size : ClassToSize(block->sizeClass);
+    memcpy(newMemory, p, copySize);
+    ArenaFree_Ex(p, file, line);
+    return newMemory;
+}
+
+void RakNet::GetAllocationSiteStatistics(DataStructures::List<AllocationSiteStatistics> &sites)
+{
+    sites.Clear(true);
+
+    AllocationSiteStatistics other;
+    other.file = 0;
+    other.line = 0;
+    other.allocations = 0;
+    other.bytes = 0;
+
+    ArenaRegistry &registry = GetArenaRegistry();
+    registry.mutex.Lock();
+    for (unsigned int i = 0; i < registry.caches.Size(); i++)
+    {
+        ArenaThreadCache *cache = registry.caches[i];
+        for (unsigned int j = 0; j < ARENA_SITE_TABLE_SIZE; j++)
+        {
+            const char *file = cache->sites[j].file.load(std::memory_order_acquire);
+            if (file == 0)
+                continue;
+
+            unsigned int line = cache->sites[j].line;
+            unsigned int k;
+            for (k = 0; k < sites.Size(); k++)
+            {
+                if (sites[k].line == line && strcmp(sites[k].file, file) == 0)
+                    break;
+            }
+            if (k == sites.Size())
+            {
+                AllocationSiteStatistics site;
+                site.file = file;
+                site.line = line;
+                site.allocations = 0;
+                site.bytes = 0;
+                sites.Push(site);
+            }
+            sites[k].allocations += cache->sites[j].allocations.load(std::memory_order_relaxed);
+            sites[k].bytes += cache->sites[j].bytes.load(std::memory_order_relaxed);
+        }
+        other.allocations += cache->otherAllocations.load(std::memory_order_relaxed);
+        other.bytes += cache->otherBytes.load(std::memory_order_relaxed);
+    }
+    registry.mutex.Unlock();
+
+    if (other.allocations > 0)
+        sites.Push(other);
+}
@@ -0,0 +1,207 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file
+///
+
+#include "RakTrace.h"
+
+#if CRABNET_TRACE==1
+
+#include <stdio.h>
+#include <atomic>
+#include "GetTime.h"
+#include "SimpleMutex.h"
+#include "DS_List.h"
+
+static_assert((CRABNET_TRACE_BUFFER_EVENTS & (CRABNET_TRACE_BUFFER_EVENTS-1))==0, "CRABNET_TRACE_BUFFER_EVENTS must be a power of two");
+
+namespace
+{
+    struct TraceEvent
+    {
+        const char *name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    // Written only by the thread that owns it. Never freed, so zones recorded by threads that have exited can still be written out
+    struct TraceThreadBuffer
+    {
+        TraceEvent events[CRABNET_TRACE_BUFFER_EVENTS];
+        // Number of zones recorded since the thread started. The zone at index i is in events[i % CRABNET_TRACE_BUFFER_EVENTS]
+        std::atomic<uint64_t> writeIndex;
+        // Zones before this index were discarded by ClearTrace()
+        std::atomic<uint64_t> clearIndex;
+        std::atomic<const char *> name;
+        unsigned int threadId;
+    };
+
+    struct TraceRegistry
+    {
+        TraceRegistry() : clockStart(RakNet::ReadTraceClock()), timeStartUS(RakNet::GetTimeUS()) {}
+
+        RakNet::SimpleMutex mutex;
+        DataStructures::List<TraceThreadBuffer *> buffers;
+        // Matching readings of both clocks, to convert ReadTraceClock() ticks to microseconds
+        uint64_t clockStart;
+        RakNet::TimeUS timeStartUS;
+    };
+
+    TraceRegistry &GetTraceRegistry(void)
+    {
+        static TraceRegistry registry;
+        return registry;
+    }
+
+    thread_local TraceThreadBuffer *threadBuffer = 0;
+
+    TraceThreadBuffer *GetThreadBuffer(void)
+    {
+        if (threadBuffer)
+            return threadBuffer;
+
+        TraceRegistry &registry = GetTraceRegistry();
+        TraceThreadBuffer *buffer = new TraceThreadBuffer;
+        buffer->writeIndex = 0;
+        buffer->clearIndex = 0;
+        buffer->name = 0;
+        registry.mutex.Lock();
+        buffer->threadId = registry.buffers.Size() + 1;
+        registry.buffers.Push(buffer);
+        registry.mutex.Unlock();
+        threadBuffer = buffer;
+        return buffer;
+    }
+
+    void WriteJSONString(FILE *fp, const char *str)
+    {
+        fputc('"', fp);
+        for (; *str; str++)
+        {
+            if (*str == '"' || *str == '\\')
+                fputc('\\', fp);
+            if ((unsigned char) *str >= 32)
+                fputc(*str, fp);
+        }
+        fputc('"', fp);
+    }
+}
+
+void RakNet::RecordTraceZone(const char *name, uint64_t start, uint64_t end)
+{
+    TraceThreadBuffer *buffer = GetThreadBuffer();
+    uint64_t index = buffer->writeIndex.load(std::memory_order_relaxed);
+    TraceEvent &event = buffer->events[index & (CRABNET_TRACE_BUFFER_EVENTS - 1)];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    buffer->writeIndex.store(index + 1, std::memory_order_release);
+}
+
+void RakNet::SetTraceThreadName(const char *name)
+{
+    GetThreadBuffer()->name = name;
+}
+
+void RakNet::ClearTrace(void)
+{
+    TraceRegistry &registry = GetTraceRegistry();
+    registry.mutex.Lock();
+    for (unsigned int i = 0; i < registry.buffers.Size(); i++)
+        registry.buffers[i]->clearIndex = registry.buffers[i]->writeIndex.load(std::memory_order_acquire);
+    registry.mutex.Unlock();
+}
+
+bool RakNet::WriteChromeTrace(const char *filename)
+{
+    FILE *fp = fopen(filename, "wb");
+    if (fp == 0)
+        return false;
+
+    TraceRegistry &registry = GetTraceRegistry();
+    double ticksPerUS = (double) (ReadTraceClock() - registry.clockStart);
+    RakNet::TimeUS elapsedUS = RakNet::GetTimeUS() - registry.timeStartUS;
+    if (elapsedUS > 0)
+        ticksPerUS /= (double) elapsedUS;
+    if (ticksPerUS <= 0.0)
+        ticksPerUS = 1.0;
+
+    TraceEvent *events = new TraceEvent[CRABNET_TRACE_BUFFER_EVENTS];
+    bool firstRecord = true;
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    registry.mutex.Lock();
+    for (unsigned int i = 0; i < registry.buffers.Size(); i++)
+    {
+        TraceThreadBuffer *buffer = registry.buffers[i];
+
+        const char *threadName = buffer->name.load();
+        if (threadName)
+        {
+            fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", firstRecord ? "" : ",\n", buffer->threadId);
+            WriteJSONString(fp, threadName);
+            fprintf(fp, "}}");
+            firstRecord = false;
+        }
+
+        // Copy the zones out while the owning thread may still be recording, then drop any that it could have overwritten during the copy
+        uint64_t last = buffer->writeIndex.load(std::memory_order_acquire);
+        uint64_t first = buffer->clearIndex.load();
+        if (last > CRABNET_TRACE_BUFFER_EVENTS && first < last - CRABNET_TRACE_BUFFER_EVENTS)
+            first = last - CRABNET_TRACE_BUFFER_EVENTS;
+        for (uint64_t index = first; index < last; index++)
+            events[index - first] = buffer->events[index & (CRABNET_TRACE_BUFFER_EVENTS - 1)];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t writtenDuringCopy = buffer->writeIndex.load(std::memory_order_relaxed);
+        uint64_t skip = 0;
+        if (writtenDuringCopy + 1 > first + CRABNET_TRACE_BUFFER_EVENTS)
+            skip = writtenDuringCopy + 1 - CRABNET_TRACE_BUFFER_EVENTS - first;
+
+        for (uint64_t index = skip; index < last - first; index++)
+        {
+            const TraceEvent &event = events[index];
+            double ts = (double) (int64_t) (event.start - registry.clockStart) / ticksPerUS;
+            double dur = (double) (event.end - event.start) / ticksPerUS;
+            fprintf(fp, "%s{\"name\":", firstRecord ? "" : ",\n");
+            WriteJSONString(fp, event.name);
+            fprintf(fp, ",\"cat\":\"RakNet\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", buffer->threadId, ts, dur);
+            firstRecord = false;
+        }
+    }
+    registry.mutex.Unlock();
+
+    delete [] events;
+    fprintf(fp, "\n]}\n");
+    bool success = ferror(fp) == 0;
+    if (fclose(fp) != 0)
+        success = false;
+    return success;
+}
+
+#else
+
+void RakNet::SetTraceThreadName(const char *name)
+{
+    (void) name;
+}
+
+bool RakNet::WriteChromeTrace(const char *filename)
+{
+    (void) filename;
+    return false;
+}
+
+void RakNet::ClearTrace(void)
+{
+}
+
+#endif
@@ -76,12 +76,15 @@ void SignaledEvent::SetEvent()
 #else
     // Different from SetEvent which stays signaled.
     // We have to record manually that the event was signaled
+    // Hold hMutex so this cannot happen between a waiter checking isSignaled and starting pthread_cond_timedwait
+    pthread_mutex_lock(&hMutex);
     isSignaledMutex.Lock();
     isSignaled = true;
     isSignaledMutex.Unlock();
 
     // Unblock waiting threads
     pthread_cond_broadcast(&eventList);
+    pthread_mutex_unlock(&hMutex);
 #endif
 }
 
@@ -130,7 +133,11 @@ void SignaledEvent::WaitOnEvent(int timeoutMs)
         // the docs you are suppost to hold the lock before you wait
         // on the cond.
         pthread_mutex_lock(&hMutex);
-        pthread_cond_timedwait(&eventList, &hMutex, &ts);
+        isSignaledMutex.Lock();
+        bool signaled=isSignaled;
+        isSignaledMutex.Unlock();
+        if (signaled==false)
+            pthread_cond_timedwait(&eventList, &hMutex, &ts);
         pthread_mutex_unlock(&hMutex);
 
         timeoutMs-=30;
@@ -155,7 +162,11 @@ void SignaledEvent::WaitOnEvent(int timeoutMs)
     }
 
     pthread_mutex_lock(&hMutex);
-    pthread_cond_timedwait(&eventList, &hMutex, &ts);
+    isSignaledMutex.Lock();
+    bool signaled=isSignaled;
+    isSignaledMutex.Unlock();
+    if (signaled==false)
+        pthread_cond_timedwait(&eventList, &hMutex, &ts);
     pthread_mutex_unlock(&hMutex);
 
     isSignaledMutex.Lock();
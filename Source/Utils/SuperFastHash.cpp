@@ -117,7 +117,7 @@ uint32_t SuperFastHashFilePtr(FILE *fp)
     while (bytesRemaining >= (int) sizeof(readBlock))
     {
         size_t ret = fread(readBlock, sizeof(readBlock), 1, fp);
-        RakAssert(ret == sizeof(readBlock));
+        RakAssert(ret == 1);
         lastHash=SuperFastHashIncremental (readBlock, (int) sizeof(readBlock), lastHash);
         bytesRemaining -= (int) sizeof(readBlock);
     }
@@ -125,7 +125,7 @@ uint32_t SuperFastHashFilePtr(FILE *fp)
     if (bytesRemaining>0)
     {
         size_t ret = fread(readBlock, bytesRemaining, 1, fp);
-        RakAssert(ret == (size_t)bytesRemaining);
+        RakAssert(ret == 1);
         lastHash=SuperFastHashIncremental (readBlock, bytesRemaining, lastHash);
     }
     return lastHash;
@@ -65,6 +65,22 @@ public:
         double *priorRowPatchTime,
         double *mostRecentRowPatchTime)=0;
 
+    /// Optional. Used by PatchCache, so AutopatcherServer can make patches from versions of a file that GetPatches() has no patch from.
+    /// \param[in] applicationName A null terminated string identifying the application
+    /// \param[in] filename The file to look up
+    /// \param[out] hash Write the 4 byte hash of the newest version of \a filename here, as returned by GetChangelistSinceDate()
+    /// \return true on success, false if there is no such file or the repository does not implement this
+    virtual bool GetNewestFileHash(const char *applicationName, const char *filename, char *hash) {(void) applicationName; (void) filename; (void) hash; return false;}
+
+    /// Optional. Used by PatchCache to read the versions of a file it makes patches between.
+    /// \param[in] applicationName A null terminated string identifying the application
+    /// \param[in] filename The file to read
+    /// \param[in] hash The 4 byte hash of the version to read, as sent by AutopatcherClient
+    /// \param[out] content Allocate with new []. The caller frees it with delete []
+    /// \param[out] contentLength The length of \a content
+    /// \return true on success, false if the repository does not have that version or does not implement this
+    virtual bool GetFileVersion(const char *applicationName, const char *filename, const char *hash, char **content, unsigned int *contentLength) {(void) applicationName; (void) filename; (void) hash; (void) content; (void) contentLength; return false;}
+
     /// \return Whatever this function returns is sent from the AutopatcherServer to the AutopatcherClient when one of the above functions returns false.
     virtual const char *GetLastError(void) const=0;
 
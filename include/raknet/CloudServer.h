@@ -24,7 +24,7 @@
 #include "PluginInterface2.h"
 #include <stdint.h>
 #include "RakString.h"
-#include "DS_Hash.h"
+#include "DS_OpenHash.h"
 #include "CloudCommon.h"
 #include "DS_OrderedList.h"
 #include <cstdlib>
@@ -225,7 +225,7 @@ protected:
         DataStructures::OrderedList<CloudKey,KeySubscriberID*,CloudServer::KeySubscriberIDComp> subscribedKeys;
         uint64_t uploadedBytes;
     };
-    DataStructures::Hash<RakNetGUID, RemoteCloudClient*, 2048, RakNetGUID::ToUint32> remoteSystems;
+    DataStructures::OpenHash<RakNetGUID, RemoteCloudClient*, RakNetGUID::ToUint32> remoteSystems;
 
     // For a given user, release all subscribed and uploaded keys
     void ReleaseSystem(RakNetGUID clientAddress );
@@ -0,0 +1,68 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file ContentChunker.h
+/// \brief Cuts data into chunks at points chosen by its contents, so an edit only changes the chunks around it
+///
+
+
+#ifndef __CONTENT_CHUNKER_H
+#define __CONTENT_CHUNKER_H
+
+#include <stdint.h>
+#include "Export.h"
+#include "DS_List.h"
+
+namespace RakNet
+{
+
+/// A piece of data cut by ContentChunker
+struct ContentChunk
+{
+    unsigned int offset;
+    unsigned int length;
+    /// From ContentChunker::HashChunk()
+    uint64_t hash;
+};
+
+/// \brief Content defined chunking with a gear rolling hash
+/// \details A chunk ends where the rolling hash of the last 64 bytes has some bits clear, so cut points move with the data when bytes are inserted or removed.
+/// Data that is the same in two versions of a file is cut into the same chunks, except near the edits.<BR>
+/// Both sides of a transfer have to use the same chunk sizes. FileListTransfer::SendChunked() sends the sizes it used.
+/// \sa FileListTransfer::SendChunked()
+class RAK_DLL_EXPORT ContentChunker
+{
+public:
+    ContentChunker();
+    ~ContentChunker();
+
+    /// \brief Sets the size of the chunks cut
+    /// \param[in] minimum No cut is made less than this far into a chunk, unless the data ends. Defaults to 2048
+    /// \param[in] average Rounded down to a power of 2. Chunks are on average this much longer than \a minimum. Defaults to 8192
+    /// \param[in] maximum A cut is always made this far into a chunk. Defaults to 65536
+    void SetChunkSizes(unsigned int minimum, unsigned int average, unsigned int maximum);
+    void GetChunkSizes(unsigned int *minimum, unsigned int *average, unsigned int *maximum) const;
+
+    /// \brief Cuts \a data into chunks, which are appended to \a chunks
+    /// \details Thread safe
+    void Chunk(const char *data, unsigned int length, DataStructures::List<ContentChunk> &chunks) const;
+
+    /// The first 64 bits of the SHA1 of \a data
+    static uint64_t HashChunk(const char *data, unsigned int length);
+
+protected:
+    unsigned int minimumSize, averageSize, maximumSize;
+    uint64_t cutMask;
+};
+
+} // namespace RakNet
+
+#endif
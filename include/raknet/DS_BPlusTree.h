@@ -97,6 +97,8 @@ namespace DataStructures
         bool IsEmpty(void) const;
         Page<KeyType, DataType, order> *GetListHead(void) const;
         DataType GetDataHead(void) const;
+        // Returns the leaf holding the first key that is not less than key, with its position in index. Later keys follow through Page::next. Returns 0 if all keys are less than key
+        Page<KeyType, DataType, order> *GetLeafAtLowerBound(const KeyType key, int *index) const;
         void PrintLeaves(void);
         void ForEachLeaf(void (*func)(Page<KeyType, DataType, order> * leaf, int index));
         void ForEachData(void (*func)(DataType input, int index));
@@ -971,6 +973,22 @@ namespace DataStructures
     {
         return leftmostLeaf->data[0];
     }
+    template<class KeyType, class DataType, int order>
+        Page<KeyType, DataType, order> *BPlusTree<KeyType, DataType, order>::GetLeafAtLowerBound(const KeyType key, int *index) const
+    {
+        if (root==0)
+            return 0;
+
+        Page<KeyType, DataType, order>* leaf = GetLeafFromKey(key);
+        GetIndexOf(key, leaf, index);
+        if (*index==leaf->size)
+        {
+            // Every key in this leaf is less, so the first one of the next leaf is the lower bound
+            leaf=leaf->next;
+            *index=0;
+        }
+        return leaf;
+    }
     template<class KeyType, class DataType, int order>
         void BPlusTree<KeyType, DataType, order>::ForEachLeaf(void (*func)(Page<KeyType, DataType, order> * leaf, int index))
     {
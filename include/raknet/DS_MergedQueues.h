@@ -0,0 +1,146 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file DS_MergedQueues.h
+/// \internal
+/// \brief Priority queue made of several FIFO queues, each pushed in order of weight
+///
+
+
+#ifndef __CRABNET_MERGED_QUEUES_H
+#define __CRABNET_MERGED_QUEUES_H
+
+#include "DS_Queue.h"
+#include "Export.h"
+#include "RakAssert.h"
+
+/// The namespace DataStructures was only added to avoid compiler errors for commonly named data structures
+/// As these data structures are stand-alone, you can use them outside of RakNet for your own projects if you wish.
+namespace DataStructures
+{
+    /// \brief Same use as a min Heap, for when the data falls into \a queueCount classes, and each class is pushed in order of weight
+    /// \details Each class is a FIFO queue, so Push() is an append and Pop() takes the lowest weight at the head of any queue, in O(queueCount) rather than O(log(n)).
+    /// Among equal weights, the lower queue index comes out first.
+    template <class weight_type, class data_type, unsigned queueCount>
+    class RAK_DLL_EXPORT MergedQueues
+    {
+    public:
+        struct QueueNode
+        {
+            QueueNode() {}
+            QueueNode(const weight_type &w, const data_type &d) : weight(w), data(d) {}
+            weight_type weight;
+            data_type data;
+        };
+
+        MergedQueues();
+        ~MergedQueues();
+        /// \param[in] queueIndex Queue to add to. \a weight must not be less than the last weight pushed to this queue
+        void Push(unsigned queueIndex, const weight_type &weight, const data_type &data);
+        /// Removes and returns the data with the lowest weight
+        data_type Pop(void);
+        data_type Peek(void) const;
+        weight_type PeekWeight(void) const;
+        void Clear(void);
+        /// In no particular order, for visiting every entry
+        data_type& operator[] ( const unsigned int position ) const;
+        unsigned Size(void) const;
+
+    protected:
+        unsigned HeadQueue(void) const;
+
+        DataStructures::Queue<QueueNode> queues[queueCount];
+        unsigned size;
+    };
+
+    template <class weight_type, class data_type, unsigned queueCount>
+    MergedQueues<weight_type, data_type, queueCount>::MergedQueues()
+    {
+        size=0;
+    }
+
+    template <class weight_type, class data_type, unsigned queueCount>
+    MergedQueues<weight_type, data_type, queueCount>::~MergedQueues()
+    {
+    }
+
+    template <class weight_type, class data_type, unsigned queueCount>
+    void MergedQueues<weight_type, data_type, queueCount>::Push(unsigned queueIndex, const weight_type &weight, const data_type &data)
+    {
+        RakAssert(queueIndex < queueCount);
+        RakAssert(queues[queueIndex].IsEmpty() || queues[queueIndex][queues[queueIndex].Size()-1].weight <= weight);
+        queues[queueIndex].Push(QueueNode(weight, data));
+        size++;
+    }
+
+    template <class weight_type, class data_type, unsigned queueCount>
+    unsigned MergedQueues<weight_type, data_type, queueCount>::HeadQueue(void) const
+    {
+        RakAssert(size > 0);
+        unsigned headQueue=queueCount;
+        for (unsigned i=0; i < queueCount; i++)
+        {
+            if (queues[i].IsEmpty()==false && (headQueue==queueCount || queues[i][0].weight < queues[headQueue][0].weight))
+                headQueue=i;
+        }
+        return headQueue;
+    }
+
+    template <class weight_type, class data_type, unsigned queueCount>
+    data_type MergedQueues<weight_type, data_type, queueCount>::Pop(void)
+    {
+        unsigned headQueue=HeadQueue();
+        size--;
+        return queues[headQueue].Pop().data;
+    }
+
+    template <class weight_type, class data_type, unsigned queueCount>
+    data_type MergedQueues<weight_type, data_type, queueCount>::Peek(void) const
+    {
+        return queues[HeadQueue()][0].data;
+    }
+
+    template <class weight_type, class data_type, unsigned queueCount>
+    weight_type MergedQueues<weight_type, data_type, queueCount>::PeekWeight(void) const
+    {
+        return queues[HeadQueue()][0].weight;
+    }
+
+    template <class weight_type, class data_type, unsigned queueCount>
+    void MergedQueues<weight_type, data_type, queueCount>::Clear(void)
+    {
+        for (unsigned i=0; i < queueCount; i++)
+            queues[i].Clear();
+        size=0;
+    }
+
+    template <class weight_type, class data_type, unsigned queueCount>
+    data_type& MergedQueues<weight_type, data_type, queueCount>::operator[] ( const unsigned int position ) const
+    {
+        RakAssert(position < size);
+        unsigned remaining=position;
+        unsigned queueIndex=0;
+        while (remaining >= queues[queueIndex].Size())
+        {
+            remaining-=queues[queueIndex].Size();
+            queueIndex++;
+        }
+        return queues[queueIndex][remaining].data;
+    }
+
+    template <class weight_type, class data_type, unsigned queueCount>
+    unsigned MergedQueues<weight_type, data_type, queueCount>::Size(void) const
+    {
+        return size;
+    }
+}
+
+#endif
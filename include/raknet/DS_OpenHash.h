@@ -0,0 +1,345 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \internal
+/// \brief Hashing container that grows with its contents
+///
+
+
+#ifndef __OPEN_HASH_H
+#define __OPEN_HASH_H
+
+#include <stdint.h>
+#include "RakAssert.h"
+#include "Export.h"
+#include "DS_List.h"
+#include "DS_Hash.h"
+
+/// The namespace DataStructures was only added to avoid compiler errors for commonly named data structures
+/// As these data structures are stand-alone, you can use them outside of RakNet for your own projects if you wish.
+namespace DataStructures
+{
+    /// Largest number of slots an OpenHash grows to. A power of two
+    const unsigned int OPEN_HASH_MAX_CAPACITY=0x80000000u;
+
+    /// \brief Same interface as Hash, but stores entries in one table that doubles in size when it is three quarters full, rather than in a fixed number of chained buckets
+    /// \details Uses open addressing with robin hood probing: an entry being inserted takes the slot of any entry closer to its own home slot, so no entry is far from home
+    /// and a lookup can stop as soon as it passes the distance the key would have been at. Removal shifts the following entries back, so there are no tombstones.<BR>
+    /// The hash of each entry is stored next to it, so lookups only compare keys whose hashes are equal, and growing does not call \a hashFunction again.<BR>
+    /// As with Hash, Push() does not check for an existing key. A HashIndex, or a pointer returned by Peek(), is valid until the next Push(), Pop(), Remove() or RemoveAtIndex().
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    class RAK_DLL_EXPORT OpenHash
+    {
+    public:
+        /// Default constructor
+        OpenHash();
+
+        // Destructor
+        ~OpenHash();
+
+        void Push(key_type key, const data_type &input );
+        data_type* Peek(key_type key );
+        bool Pop(data_type& out, key_type key );
+        bool RemoveAtIndex(HashIndex index );
+        bool Remove(key_type key );
+        HashIndex GetIndexOf(key_type key) const;
+        bool HasData(key_type key) const;
+        data_type& ItemAtIndex(const HashIndex &index);
+        key_type  KeyAtIndex(const HashIndex &index) const;
+        void GetAsList(DataStructures::List<data_type> &itemList,DataStructures::List<key_type > &keyList) const;
+        unsigned int Size(void) const;
+
+        /// \brief Grows the table so it can hold \a count entries without growing again
+        /// \details The table does not grow past OPEN_HASH_MAX_CAPACITY slots, so at most three quarters of that many entries can be reserved
+        void Reserve(unsigned int count);
+
+        /// \brief Clear the list
+        void Clear();
+
+    protected:
+        unsigned int HashKey(const key_type &key) const;
+        unsigned int FindSlot(const key_type &key) const;
+        void Insert(unsigned int hash, key_type key, data_type item);
+        void RemoveSlot(unsigned int slot);
+        void Resize(unsigned int newCapacity);
+
+        // Stored hash of each slot, always with the high bit set, or 0 for an empty slot
+        unsigned int *hashes;
+        key_type *keys;
+        data_type *items;
+        // Number of slots, a power of two
+        unsigned int capacity;
+        unsigned int size;
+    };
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    OpenHash<key_type, data_type, hashFunction>::OpenHash()
+    {
+        hashes=0;
+        keys=0;
+        items=0;
+        capacity=0;
+        size=0;
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    OpenHash<key_type, data_type, hashFunction>::~OpenHash()
+    {
+        Clear();
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    unsigned int OpenHash<key_type, data_type, hashFunction>::HashKey(const key_type &key) const
+    {
+        // Hash functions such as RakNetGUID::ToUint32 return sequential or patterned values, so mix them before taking the low bits as the home slot
+        uint64_t h = (uint64_t) (*hashFunction)(key);
+        uint32_t x = (uint32_t) (h ^ (h >> 32));
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x | 0x80000000U;
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    unsigned int OpenHash<key_type, data_type, hashFunction>::FindSlot(const key_type &key) const
+    {
+        if (size==0)
+            return (unsigned int) -1;
+
+        const unsigned int mask=capacity-1;
+        const unsigned int hash=HashKey(key);
+        unsigned int slot=hash & mask;
+        for (unsigned int distance=0;; distance++)
+        {
+            const unsigned int slotHash=hashes[slot];
+            // An empty slot, or an entry nearer its home than the key would be, means the key is not present
+            if (slotHash==0 || ((slot-slotHash) & mask) < distance)
+                return (unsigned int) -1;
+            if (slotHash==hash && keys[slot]==key)
+                return slot;
+            slot=(slot+1) & mask;
+        }
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    void OpenHash<key_type, data_type, hashFunction>::Insert(unsigned int hash, key_type key, data_type item)
+    {
+        const unsigned int mask=capacity-1;
+        unsigned int slot=hash & mask;
+        unsigned int distance=0;
+        for (;;)
+        {
+            if (hashes[slot]==0)
+            {
+                hashes[slot]=hash;
+                keys[slot]=key;
+                items[slot]=item;
+                return;
+            }
+
+            const unsigned int slotDistance=(slot-hashes[slot]) & mask;
+            if (slotDistance < distance)
+            {
+                // Take the slot, and carry on inserting the entry that was there
+                unsigned int tempHash=hashes[slot];
+                hashes[slot]=hash;
+                hash=tempHash;
+                key_type tempKey=keys[slot];
+                keys[slot]=key;
+                key=tempKey;
+                data_type tempItem=items[slot];
+                items[slot]=item;
+                item=tempItem;
+                distance=slotDistance;
+            }
+            slot=(slot+1) & mask;
+            distance++;
+        }
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    void OpenHash<key_type, data_type, hashFunction>::RemoveSlot(unsigned int slot)
+    {
+        const unsigned int mask=capacity-1;
+        unsigned int next=(slot+1) & mask;
+        // Shift back the entries after this one, until one that is already in its home slot
+        while (hashes[next]!=0 && ((next-hashes[next]) & mask)!=0)
+        {
+            hashes[slot]=hashes[next];
+            keys[slot]=keys[next];
+            items[slot]=items[next];
+            slot=next;
+            next=(next+1) & mask;
+        }
+        hashes[slot]=0;
+        // Release whatever the key and item hold, such as the string of a RakString
+        keys[slot]=key_type();
+        items[slot]=data_type();
+        size--;
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    void OpenHash<key_type, data_type, hashFunction>::Resize(unsigned int newCapacity)
+    {
+        unsigned int *oldHashes=hashes;
+        key_type *oldKeys=keys;
+        data_type *oldItems=items;
+        unsigned int oldCapacity=capacity;
+
+        hashes=new unsigned int[newCapacity];
+        memset(hashes,0,sizeof(unsigned int)*newCapacity);
+        keys=new key_type[newCapacity];
+        items=new data_type[newCapacity];
+        capacity=newCapacity;
+        for (unsigned int i=0; i < oldCapacity; i++)
+        {
+            if (oldHashes[i]!=0)
+                Insert(oldHashes[i], oldKeys[i], oldItems[i]);
+        }
+
+        delete[] oldHashes;
+        delete[] oldKeys;
+        delete[] oldItems;
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    void OpenHash<key_type, data_type, hashFunction>::Reserve(unsigned int count)
+    {
+        unsigned int newCapacity=capacity==0 ? 16 : capacity;
+        // In 64 bits, as count*4 and newCapacity*3 do not fit in 32
+        while ((uint64_t) count*4 > (uint64_t) newCapacity*3 && newCapacity < OPEN_HASH_MAX_CAPACITY)
+            newCapacity*=2;
+        RakAssert((uint64_t) count*4 <= (uint64_t) newCapacity*3);
+        if (newCapacity!=capacity)
+            Resize(newCapacity);
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    void OpenHash<key_type, data_type, hashFunction>::Push(key_type key, const data_type &input )
+    {
+        Reserve(size+1);
+        Insert(HashKey(key), key, input);
+        size++;
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    data_type* OpenHash<key_type, data_type, hashFunction>::Peek(key_type key )
+    {
+        unsigned int slot=FindSlot(key);
+        if (slot==(unsigned int) -1)
+            return 0;
+        return &items[slot];
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    bool OpenHash<key_type, data_type, hashFunction>::Pop(data_type& out, key_type key )
+    {
+        unsigned int slot=FindSlot(key);
+        if (slot==(unsigned int) -1)
+            return false;
+        out=items[slot];
+        RemoveSlot(slot);
+        return true;
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    bool OpenHash<key_type, data_type, hashFunction>::RemoveAtIndex(HashIndex index )
+    {
+        if (index.IsInvalid() || index.primaryIndex >= capacity || hashes[index.primaryIndex]==0)
+            return false;
+        RemoveSlot(index.primaryIndex);
+        return true;
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    bool OpenHash<key_type, data_type, hashFunction>::Remove(key_type key )
+    {
+        return RemoveAtIndex(GetIndexOf(key));
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    HashIndex OpenHash<key_type, data_type, hashFunction>::GetIndexOf(key_type key) const
+    {
+        HashIndex idx;
+        unsigned int slot=FindSlot(key);
+        if (slot==(unsigned int) -1)
+        {
+            idx.SetInvalid();
+            return idx;
+        }
+        idx.primaryIndex=slot;
+        idx.secondaryIndex=0;
+        return idx;
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    bool OpenHash<key_type, data_type, hashFunction>::HasData(key_type key) const
+    {
+        return FindSlot(key)!=(unsigned int) -1;
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    data_type& OpenHash<key_type, data_type, hashFunction>::ItemAtIndex(const HashIndex &index)
+    {
+        RakAssert(index.primaryIndex < capacity && hashes[index.primaryIndex]!=0);
+        return items[index.primaryIndex];
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    key_type  OpenHash<key_type, data_type, hashFunction>::KeyAtIndex(const HashIndex &index) const
+    {
+        RakAssert(index.primaryIndex < capacity && hashes[index.primaryIndex]!=0);
+        return keys[index.primaryIndex];
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    void OpenHash<key_type, data_type, hashFunction>::Clear()
+    {
+        if (hashes)
+        {
+            delete[] hashes;
+            delete[] keys;
+            delete[] items;
+            hashes=0;
+            keys=0;
+            items=0;
+            capacity=0;
+            size=0;
+        }
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    void OpenHash<key_type, data_type, hashFunction>::GetAsList(DataStructures::List<data_type> &itemList,DataStructures::List<key_type > &keyList) const
+    {
+        if (hashes==0)
+            return;
+        itemList.Clear(false);
+        keyList.Clear(false);
+
+        for (unsigned int i=0; i < capacity; i++)
+        {
+            if (hashes[i]!=0)
+            {
+                itemList.Push(items[i]);
+                keyList.Push(keys[i]);
+            }
+        }
+    }
+
+    template <class key_type, class data_type, unsigned long (*hashFunction)(const key_type &) >
+    unsigned int OpenHash<key_type, data_type, hashFunction>::Size(void) const
+    {
+        return size;
+    }
+}
+#endif
@@ -0,0 +1,244 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file DS_RadixHeap.h
+/// \internal
+/// \brief Min heap for unsigned integer weights that never go below the last weight popped
+///
+
+
+#ifndef __CRABNET_RADIX_HEAP_H
+#define __CRABNET_RADIX_HEAP_H
+
+#include <stdint.h>
+#include "DS_List.h"
+#include "Export.h"
+#include "RakAssert.h"
+#if defined(_MSC_VER) && defined(_WIN64)
+#include <intrin.h>
+#endif
+
+/// The namespace DataStructures was only added to avoid compiler errors for commonly named data structures
+/// As these data structures are stand-alone, you can use them outside of RakNet for your own projects if you wish.
+namespace DataStructures
+{
+    /// \brief Same use as a min Heap, for when no weight pushed is less than the last weight popped
+    /// \details Entries are kept in one bucket per bit of \a weight_type, by the highest bit in which their weight differs from the last weight popped.
+    /// Push() is a single append. Pop() empties the lowest bucket into lower ones, so each entry moves at most once per bit over its lifetime, rather than log(n) swaps per Push() and Pop().<BR>
+    /// Pushing a weight below the last one popped is still correct, but redistributes every entry.<BR>
+    /// \a weight_type must be an unsigned integer of at most 64 bits.
+    template <class weight_type, class data_type>
+    class RAK_DLL_EXPORT RadixHeap
+    {
+    public:
+        struct HeapNode
+        {
+            HeapNode() {}
+            HeapNode(const weight_type &w, const data_type &d) : weight(w), data(d) {}
+            weight_type weight;
+            data_type data;
+        };
+
+        RadixHeap();
+        ~RadixHeap();
+        void Push(const weight_type &weight, const data_type &data);
+        /// Removes and returns the data with the lowest weight. Entries with equal weights come out in no particular order
+        data_type Pop(void);
+        data_type Peek(void) const;
+        weight_type PeekWeight(void) const;
+        void Clear(bool doNotDeallocateSmallBlocks);
+        /// In no particular order, for visiting every entry
+        data_type& operator[] ( const unsigned int position ) const;
+        unsigned Size(void) const;
+
+    protected:
+        static const unsigned BUCKET_COUNT=sizeof(weight_type)*8+1;
+        unsigned BucketIndex(const weight_type &weight) const;
+        void FindMinimum(void) const;
+        void Redistribute(const weight_type &newLast);
+
+        // buckets[0] holds weights equal to last, and buckets[i] weights whose highest bit that differs from last is bit i-1
+        DataStructures::List<HeapNode> buckets[BUCKET_COUNT];
+        weight_type last;
+        unsigned size;
+        // Position of the lowest weight outside buckets[0], found by Peek() and kept for Pop()
+        mutable bool minimumValid;
+        mutable unsigned minimumBucket, minimumIndex;
+    };
+
+    template <class weight_type, class data_type>
+    RadixHeap<weight_type, data_type>::RadixHeap()
+    {
+        last=0;
+        size=0;
+        minimumValid=false;
+        minimumBucket=0;
+        minimumIndex=0;
+    }
+
+    template <class weight_type, class data_type>
+    RadixHeap<weight_type, data_type>::~RadixHeap()
+    {
+    }
+
+    template <class weight_type, class data_type>
+    unsigned RadixHeap<weight_type, data_type>::BucketIndex(const weight_type &weight) const
+    {
+        uint64_t differentBits=(uint64_t) (weight ^ last);
+        if (differentBits==0)
+            return 0;
+#if defined(__GNUC__) || defined(__clang__)
+        return 64-(unsigned) __builtin_clzll(differentBits);
+#elif defined(_MSC_VER) && defined(_WIN64)
+        unsigned long highestBit;
+        _BitScanReverse64(&highestBit, differentBits);
+        return (unsigned) highestBit+1;
+#else
+        unsigned index=0;
+        while (differentBits)
+        {
+            differentBits>>=1;
+            index++;
+        }
+        return index;
+#endif
+    }
+
+    template <class weight_type, class data_type>
+    void RadixHeap<weight_type, data_type>::Push(const weight_type &weight, const data_type &data)
+    {
+        if (size==0)
+            last=weight;
+        else if (weight < last)
+            Redistribute(weight);
+
+        unsigned bucketIndex=BucketIndex(weight);
+        buckets[bucketIndex].Insert(HeapNode(weight, data));
+        size++;
+        if (minimumValid && bucketIndex!=0 && weight < buckets[minimumBucket][minimumIndex].weight)
+        {
+            minimumBucket=bucketIndex;
+            minimumIndex=buckets[bucketIndex].Size()-1;
+        }
+    }
+
+    template <class weight_type, class data_type>
+    void RadixHeap<weight_type, data_type>::Redistribute(const weight_type &newLast)
+    {
+        DataStructures::List<HeapNode> nodes;
+        nodes.Preallocate(size);
+        for (unsigned i=0; i < BUCKET_COUNT; i++)
+        {
+            for (unsigned j=0; j < buckets[i].Size(); j++)
+                nodes.Insert(buckets[i][j]);
+            buckets[i].Clear(true);
+        }
+        last=newLast;
+        for (unsigned i=0; i < nodes.Size(); i++)
+            buckets[BucketIndex(nodes[i].weight)].Insert(nodes[i]);
+        minimumValid=false;
+    }
+
+    template <class weight_type, class data_type>
+    void RadixHeap<weight_type, data_type>::FindMinimum(void) const
+    {
+        if (minimumValid)
+            return;
+        RakAssert(size > 0 && buckets[0].Size()==0);
+        unsigned bucketIndex=1;
+        while (buckets[bucketIndex].Size()==0)
+            bucketIndex++;
+        const DataStructures::List<HeapNode> &bucket=buckets[bucketIndex];
+        unsigned lowestIndex=0;
+        for (unsigned i=1; i < bucket.Size(); i++)
+        {
+            if (bucket[i].weight < bucket[lowestIndex].weight)
+                lowestIndex=i;
+        }
+        minimumBucket=bucketIndex;
+        minimumIndex=lowestIndex;
+        minimumValid=true;
+    }
+
+    template <class weight_type, class data_type>
+    data_type RadixHeap<weight_type, data_type>::Pop(void)
+    {
+        RakAssert(size > 0);
+        if (buckets[0].Size()==0)
+        {
+            // Every weight in the bucket of the lowest weight differs from it only in lower bits, so each goes to a lower bucket
+            FindMinimum();
+            DataStructures::List<HeapNode> &bucket=buckets[minimumBucket];
+            last=bucket[minimumIndex].weight;
+            for (unsigned i=0; i < bucket.Size(); i++)
+                buckets[BucketIndex(bucket[i].weight)].Insert(bucket[i]);
+            // Keep the allocation, as this bucket will likely fill again
+            bucket.RemoveFromEnd(bucket.Size());
+            minimumValid=false;
+        }
+
+        data_type data=buckets[0].Pop().data;
+        size--;
+        return data;
+    }
+
+    template <class weight_type, class data_type>
+    data_type RadixHeap<weight_type, data_type>::Peek(void) const
+    {
+        RakAssert(size > 0);
+        if (buckets[0].Size() > 0)
+            return buckets[0][buckets[0].Size()-1].data;
+        FindMinimum();
+        return buckets[minimumBucket][minimumIndex].data;
+    }
+
+    template <class weight_type, class data_type>
+    weight_type RadixHeap<weight_type, data_type>::PeekWeight(void) const
+    {
+        RakAssert(size > 0);
+        if (buckets[0].Size() > 0)
+            return last;
+        FindMinimum();
+        return buckets[minimumBucket][minimumIndex].weight;
+    }
+
+    template <class weight_type, class data_type>
+    void RadixHeap<weight_type, data_type>::Clear(bool doNotDeallocateSmallBlocks)
+    {
+        for (unsigned i=0; i < BUCKET_COUNT; i++)
+            buckets[i].Clear(doNotDeallocateSmallBlocks);
+        last=0;
+        size=0;
+        minimumValid=false;
+    }
+
+    template <class weight_type, class data_type>
+    data_type& RadixHeap<weight_type, data_type>::operator[] ( const unsigned int position ) const
+    {
+        RakAssert(position < size);
+        unsigned remaining=position;
+        unsigned bucketIndex=0;
+        while (remaining >= buckets[bucketIndex].Size())
+        {
+            remaining-=buckets[bucketIndex].Size();
+            bucketIndex++;
+        }
+        return buckets[bucketIndex][remaining].data;
+    }
+
+    template <class weight_type, class data_type>
+    unsigned RadixHeap<weight_type, data_type>::Size(void) const
+    {
+        return size;
+    }
+}
+
+#endif
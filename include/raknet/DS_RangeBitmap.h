@@ -0,0 +1,356 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file DS_RangeBitmap.h
+/// \internal
+/// \brief A sliding bitmap of received sequence numbers, written out as ranges in the same format as RangeList
+///
+
+
+#ifndef __RANGE_BITMAP_H
+#define __RANGE_BITMAP_H
+
+#include <stdint.h>
+#include <string.h>
+#include "DS_RangeList.h"
+#include "BitStream.h"
+#include "RakAssert.h"
+#if defined(_MSC_VER) && defined(_WIN64)
+#include <intrin.h>
+#endif
+
+namespace DataStructures
+{
+    /// \brief Holds a set of sequence numbers to acknowledge, as one bit per number in a window of 64 bit words
+    /// \details Insert() sets one bit, with no search and no shifting of other entries however out of order the numbers arrive.
+    /// Serialize() scans the window a word at a time, and writes the runs of set bits in exactly the format of RangeList::Serialize(), so RangeList::Deserialize() reads them.<BR>
+    /// The window grows to cover the numbers inserted since the last Serialize(), up to \a MAX_WINDOW_WORDS words.
+    /// Numbers that would not fit, such as those on the other side of a sequence number wraparound, are kept in a RangeList and written after the window.
+    template <class range_type>
+    class RAK_DLL_EXPORT RangeBitmap
+    {
+    public:
+        RangeBitmap();
+        ~RangeBitmap();
+        void Insert(range_type index);
+        void Clear(void);
+        /// \brief Sequence numbers in the window plus ranges kept outside it, so zero when there is nothing to write
+        unsigned Size(void) const;
+        RakNet::BitSize_t Serialize(RakNet::BitStream *in, RakNet::BitSize_t maxBits, bool clearSerialized);
+
+        /// Largest window, in 64 bit words, before numbers go to \a overflow instead. 32 kilobytes, or 262144 sequence numbers
+        static const unsigned MAX_WINDOW_WORDS=4096;
+
+    protected:
+        static unsigned CountTrailingZeros(uint64_t word);
+        bool GrowWindow(uint32_t span);
+        bool WriteRange(RakNet::BitStream *tempBS, RakNet::BitSize_t &bitsWritten, RakNet::BitSize_t maxBits, uint32_t minIndex, uint32_t maxIndex);
+        void ClearThrough(uint32_t index);
+        void ClearWindow(void);
+
+        // Ring of words, where sequence number n is bit n%64 of words[(n/64)&(wordCount-1)]. Words outside firstWord to lastWord are always zero
+        uint64_t *words;
+        // Power of two
+        uint32_t wordCount;
+        uint32_t firstWord, lastWord;
+        // Bits set in words
+        unsigned bitCount;
+        RangeList<range_type> overflow;
+    };
+
+    template <class range_type>
+    RangeBitmap<range_type>::RangeBitmap()
+    {
+        words=0;
+        wordCount=0;
+        firstWord=0;
+        lastWord=0;
+        bitCount=0;
+    }
+
+    template <class range_type>
+    RangeBitmap<range_type>::~RangeBitmap()
+    {
+        delete [] words;
+    }
+
+    template <class range_type>
+    unsigned RangeBitmap<range_type>::CountTrailingZeros(uint64_t word)
+    {
+        RakAssert(word!=0);
+#if defined(__GNUC__) || defined(__clang__)
+        return (unsigned) __builtin_ctzll(word);
+#elif defined(_MSC_VER) && defined(_WIN64)
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return (unsigned) index;
+#else
+        unsigned count=0;
+        while ((word & 1)==0)
+        {
+            word>>=1;
+            count++;
+        }
+        return count;
+#endif
+    }
+
+    template <class range_type>
+    bool RangeBitmap<range_type>::GrowWindow(uint32_t span)
+    {
+        if (span > MAX_WINDOW_WORDS)
+            return false;
+        uint32_t newWordCount=wordCount==0 ? 16 : wordCount;
+        while (newWordCount < span)
+            newWordCount*=2;
+        if (newWordCount==wordCount)
+            return true;
+
+        uint64_t *newWords=new uint64_t[newWordCount];
+        memset(newWords, 0, sizeof(uint64_t)*newWordCount);
+        if (bitCount > 0)
+        {
+            for (uint32_t word=firstWord;; word++)
+            {
+                newWords[word & (newWordCount-1)]=words[word & (wordCount-1)];
+                if (word==lastWord)
+                    break;
+            }
+        }
+        delete [] words;
+        words=newWords;
+        wordCount=newWordCount;
+        return true;
+    }
+
+    template <class range_type>
+    void RangeBitmap<range_type>::Insert(range_type index)
+    {
+        const uint32_t value=(uint32_t) index;
+        const uint32_t word=value >> 6;
+        if (bitCount==0)
+        {
+            if (words==0)
+                GrowWindow(1);
+            firstWord=word;
+            lastWord=word;
+        }
+        else if ((int32_t) (word-firstWord) < 0)
+        {
+            // Arrived before every number held, so extend the window back
+            if (GrowWindow(lastWord-word+1)==false)
+            {
+                overflow.Insert(index);
+                return;
+            }
+            firstWord=word;
+        }
+        else if ((int32_t) (word-lastWord) > 0)
+        {
+            if (GrowWindow(word-firstWord+1)==false)
+            {
+                overflow.Insert(index);
+                return;
+            }
+            lastWord=word;
+        }
+
+        uint64_t &bits=words[word & (wordCount-1)];
+        const uint64_t bit=(uint64_t) 1 << (value & 63);
+        if ((bits & bit)==0)
+        {
+            bits|=bit;
+            bitCount++;
+        }
+    }
+
+    template <class range_type>
+    bool RangeBitmap<range_type>::WriteRange(RakNet::BitStream *tempBS, RakNet::BitSize_t &bitsWritten, RakNet::BitSize_t maxBits, uint32_t minIndex, uint32_t maxIndex)
+    {
+        // Same test and encoding as RangeList::Serialize()
+        if ((int)sizeof(unsigned short)*8+bitsWritten+(int)sizeof(range_type)*8*2+1>maxBits)
+            return false;
+        unsigned char minEqualsMax=minIndex==maxIndex ? 1 : 0;
+        tempBS->Write(minEqualsMax);
+        tempBS->Write((range_type) minIndex);
+        bitsWritten+=sizeof(range_type)*8+8;
+        if (minIndex!=maxIndex)
+        {
+            tempBS->Write((range_type) maxIndex);
+            bitsWritten+=sizeof(range_type)*8;
+        }
+        return true;
+    }
+
+    template <class range_type>
+    RakNet::BitSize_t RangeBitmap<range_type>::Serialize(RakNet::BitStream *in, RakNet::BitSize_t maxBits, bool clearSerialized)
+    {
+        RakNet::BitStream tempBS;
+        RakNet::BitSize_t bitsWritten=0;
+        unsigned short countWritten=0;
+        bool full=false;
+        // Last number written from the window, for when it was only partly written
+        bool windowWritten=false;
+        uint32_t lastWritten=0;
+
+        if (bitCount > 0)
+        {
+            bool inRange=false;
+            uint32_t rangeMin=0;
+            for (uint32_t word=firstWord; full==false; word++)
+            {
+                const uint64_t bits=words[word & (wordCount-1)];
+                const uint32_t base=word << 6;
+                unsigned bit=0;
+                // Alternate between finding the next set bit and the next clear bit, so each step skips a whole run
+                while (bit < 64)
+                {
+                    if (inRange)
+                    {
+                        const uint64_t clear=~bits >> bit;
+                        if (clear==0)
+                            break;
+                        bit+=CountTrailingZeros(clear);
+                        inRange=false;
+                        if (countWritten==(unsigned short)-1 || WriteRange(&tempBS, bitsWritten, maxBits, rangeMin, base+bit-1)==false)
+                        {
+                            full=true;
+                            break;
+                        }
+                        windowWritten=true;
+                        lastWritten=base+bit-1;
+                        countWritten++;
+                    }
+                    else
+                    {
+                        const uint64_t set=bits >> bit;
+                        if (set==0)
+                            break;
+                        bit+=CountTrailingZeros(set);
+                        rangeMin=base+bit;
+                        inRange=true;
+                    }
+                }
+                if (word==lastWord)
+                {
+                    // A run that reaches the last bit of the window ends there
+                    if (inRange && full==false)
+                    {
+                        if (countWritten==(unsigned short)-1 || WriteRange(&tempBS, bitsWritten, maxBits, rangeMin, base+63)==false)
+                            full=true;
+                        else
+                        {
+                            windowWritten=true;
+                            lastWritten=base+63;
+                            countWritten++;
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+
+        unsigned overflowWritten=0;
+        if (full==false)
+        {
+            for (; overflowWritten < overflow.ranges.Size(); overflowWritten++)
+            {
+                if (countWritten==(unsigned short)-1 || WriteRange(&tempBS, bitsWritten, maxBits, (uint32_t) overflow.ranges[overflowWritten].minIndex, (uint32_t) overflow.ranges[overflowWritten].maxIndex)==false)
+                    break;
+                countWritten++;
+            }
+        }
+
+        in->AlignWriteToByteBoundary();
+        RakNet::BitSize_t before=in->GetWriteOffset();
+        in->Write(countWritten);
+        bitsWritten+=in->GetWriteOffset()-before;
+        in->Write(&tempBS, tempBS.GetNumberOfBitsUsed());
+
+        if (clearSerialized && countWritten)
+        {
+            if (full)
+            {
+                if (windowWritten)
+                    ClearThrough(lastWritten);
+            }
+            else
+            {
+                ClearWindow();
+                if (overflowWritten > 0)
+                {
+                    unsigned rangeSize=overflow.ranges.Size();
+                    for (unsigned i=0; i < rangeSize-overflowWritten; i++)
+                        overflow.ranges[i]=overflow.ranges[i+overflowWritten];
+                    overflow.ranges.RemoveFromEnd(overflowWritten);
+                }
+            }
+        }
+
+        return bitsWritten;
+    }
+
+    template <class range_type>
+    void RangeBitmap<range_type>::ClearThrough(uint32_t index)
+    {
+        // Ranges are written in order, so the numbers written are exactly those up to index
+        const uint32_t lastClearedWord=index >> 6;
+        for (uint32_t word=firstWord; word!=lastClearedWord; word++)
+        {
+            uint64_t &bits=words[word & (wordCount-1)];
+            while (bits)
+            {
+                bits&=bits-1;
+                bitCount--;
+            }
+        }
+        uint64_t &bits=words[lastClearedWord & (wordCount-1)];
+        const uint64_t written=(index & 63)==63 ? ~(uint64_t) 0 : (((uint64_t) 1 << ((index & 63)+1))-1);
+        uint64_t clearedBits=bits & written;
+        bits&=~written;
+        while (clearedBits)
+        {
+            clearedBits&=clearedBits-1;
+            bitCount--;
+        }
+        firstWord=lastClearedWord;
+    }
+
+    template <class range_type>
+    void RangeBitmap<range_type>::ClearWindow(void)
+    {
+        if (bitCount > 0)
+        {
+            for (uint32_t word=firstWord;; word++)
+            {
+                words[word & (wordCount-1)]=0;
+                if (word==lastWord)
+                    break;
+            }
+        }
+        bitCount=0;
+    }
+
+    template <class range_type>
+    void RangeBitmap<range_type>::Clear(void)
+    {
+        ClearWindow();
+        overflow.Clear();
+    }
+
+    template <class range_type>
+    unsigned RangeBitmap<range_type>::Size(void) const
+    {
+        return bitCount+overflow.Size();
+    }
+}
+
+#endif
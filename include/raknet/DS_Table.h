@@ -182,6 +182,55 @@ namespace DataStructures
             SortQueryType operation;
         };
 
+        /// \brief Contiguous copy of one NUMERIC or STRING column, added with AddColumnBlock()
+        /// \details All column blocks of a table have one slot per row, holding the same row in every column block. See GetColumnBlockRowIds().<BR>
+        /// Slots are in no particular order, and removing a row moves the last slot into its place.
+        struct RAK_DLL_EXPORT ColumnBlock
+        {
+            ColumnBlock(unsigned _columnIndex, ColumnType _columnType);
+            ~ColumnBlock();
+
+            /// \return The string in \a slot, or nullptr if the cell is empty or holds a null pointer. STRING only
+            const char *GetString(unsigned slot) const;
+
+            unsigned columnIndex;
+            ColumnType columnType;
+
+            /// 1 for each slot whose cell is not empty, otherwise 0
+            DataStructures::List<unsigned char> nonEmpty;
+
+            /// NUMERIC only. Value of each slot, 0 for empty cells
+            DataStructures::List<double> numbers;
+
+            /// STRING only. Offset of the string of each slot in \a arena, or (unsigned) -1 for empty cells and null pointers
+            DataStructures::List<unsigned> stringOffsets;
+            /// STRING only. Length of the string of each slot, not counting the terminator
+            DataStructures::List<unsigned> stringLengths;
+            /// STRING only. Null terminated strings of all slots, followed by space for more
+            char *arena;
+            unsigned arenaUsed;
+            unsigned arenaAllocated;
+            /// Bytes of \a arena holding strings that were replaced or removed, reclaimed when the arena is compacted
+            unsigned arenaUnused;
+
+        protected:
+            friend class Table;
+            void AddSlot(const Cell *cell);
+            void SetSlot(unsigned slot, const Cell *cell);
+            void RemoveSlot(unsigned slot);
+            void CompactArena(void);
+        };
+
+        /// Kinds of secondary index. See AddIndex()
+        enum IndexType
+        {
+            /// Finds the rows with a cell equal to a value. Used for QF_EQUAL
+            IT_HASH,
+
+            /// Keeps the rows sorted on a cell. Used for QF_EQUAL, QF_GREATER_THAN, QF_GREATER_THAN_EQ, QF_LESS_THAN and QF_LESS_THAN_EQ
+            IT_ORDERED,
+        };
+
         // Constructor
         Table() = default;
 
@@ -296,6 +345,53 @@ namespace DataStructures
         /// \param[out] out The address of an array of Rows, which will receive the sorted output.  The array must be long enough to contain all returned rows, up to GetRowCount()
         void SortTable(Table::SortQuery *sortQueries, unsigned numSortQueries, Table::Row** out);
 
+        /// \brief Adds a secondary index on a column, so QueryTable() can find the rows passing a filter on that column without testing every row
+        /// \details Indexes are kept up to date by AddRow(), RemoveRow(), RemoveRows(), UpdateCell() and UpdateCellByIndex(). If you write to Row::cells directly, call UpdateIndexes() for the row afterwards.<BR>
+        /// QueryTable() looks up each filter that has a usable index, and tests the remaining filters only on the smallest set of rows returned.<BR>
+        /// A column has at most one index, so adding another replaces it. Clear() removes all indexes, and operator= does not copy them.
+        /// \param[in] columnIndex The column to index
+        /// \param[in] indexType See IndexType. BINARY columns only support IT_HASH
+        /// \return false if the column does not exist, or the column is BINARY and \a indexType is IT_ORDERED
+        bool AddIndex(unsigned columnIndex, IndexType indexType);
+
+        /// \brief Removes the index added with AddIndex() for a column, if any
+        /// \param[in] columnIndex The indexed column
+        void RemoveIndex(unsigned columnIndex);
+
+        /// \param[in] columnIndex The column to check
+        /// \return true if AddIndex() was called for this column
+        bool HasIndex(unsigned columnIndex) const;
+
+        /// \brief Keeps a contiguous copy of a NUMERIC or STRING column, so QueryTable() can filter on it without visiting the cells of each row
+        /// \details NUMERIC cells are copied to an array of doubles, which QueryTable() compares for every FilterQueryType, with SSE2 where the compiler targets it.
+        /// STRING cells are copied to one character arena, which QueryTable() searches for QF_EQUAL and QF_NOT_EQUAL.<BR>
+        /// QueryTable() uses column blocks when no index added with AddIndex() applies to the filters, and tests the remaining filters only on the rows passing all filters on blocked columns.<BR>
+        /// Column blocks are kept up to date in the same places as indexes. Clear() removes all column blocks, and operator= does not copy them.
+        /// See TableSerializer::SerializeColumnBlock() to write one in a single pass.
+        /// \param[in] columnIndex The column to copy
+        /// \return false if the column does not exist, or is not NUMERIC or STRING
+        bool AddColumnBlock(unsigned columnIndex);
+
+        /// \brief Removes the column block added with AddColumnBlock() for a column, if any
+        /// \param[in] columnIndex The column
+        void RemoveColumnBlock(unsigned columnIndex);
+
+        /// \param[in] columnIndex The column to check
+        /// \return The column block added with AddColumnBlock() for this column, or nullptr if there is none
+        const ColumnBlock *GetColumnBlock(unsigned columnIndex) const;
+
+        /// \return The ID of the row in each slot of the column blocks. Empty if there are no column blocks
+        const DataStructures::List<unsigned> &GetColumnBlockRowIds(void) const;
+
+        /// \brief Updates the indexes and column blocks for one row after its cells were written directly, rather than through UpdateCell()
+        /// \param[in] rowId The ID of the row
+        void UpdateIndexes(unsigned rowId);
+
+        /// \brief Updates the index and column block of one cell after it was written directly
+        /// \param[in] rowId The ID of the row
+        /// \param[in] columnIndex The column of the cell
+        void UpdateIndexes(unsigned rowId, unsigned columnIndex);
+
         /// \brief Frees all memory in the table.
         void Clear(void);
 
@@ -329,18 +425,46 @@ namespace DataStructures
         Table& operator = ( const Table& input );
 
     protected:
-        Table::Row* AddRowColumns(unsigned rowId, Row *row, DataStructures::List<unsigned> columnIndices);
+        struct SecondaryIndex;
+
+        Table::Row* AddRowColumns(unsigned rowId, Row *row, const DataStructures::List<unsigned> &columnIndices);
 
         void DeleteRow(Row *row);
 
         void QueryRow(DataStructures::List<unsigned> &inclusionFilterColumnIndices, DataStructures::List<unsigned> &columnIndicesToReturn, unsigned key, Table::Row* row, FilterQuery *inclusionFilters, Table *result);
 
+        // Returns false if no index can stand in for any of the filters. Otherwise fills rowIds and rowList with the rows that may pass all of them
+        bool QueryIndexes(DataStructures::List<unsigned> &inclusionFilterColumnIndices, FilterQuery *inclusionFilters, DataStructures::List<unsigned> &rowIds, DataStructures::List<Row*> &rowList) const;
+
+        // Returns false if no column block can stand in for any of the filters. Otherwise sets columnBlockMask to 1 for each slot whose row may pass all of them
+        bool QueryColumnBlocks(DataStructures::List<unsigned> &inclusionFilterColumnIndices, FilterQuery *inclusionFilters);
+
+        SecondaryIndex *GetIndex(unsigned columnIndex) const;
+        ColumnBlock *FindColumnBlock(unsigned columnIndex) const;
+
+        // Keep the indexes and column blocks in step with the rows
+        void AddToIndexes(unsigned rowId, Row *row);
+        void RemoveFromIndexes(unsigned rowId);
+        void UpdateIndex(unsigned rowId, unsigned columnIndex, Row *row);
+        void RemoveAllIndexes(void);
+        void RemoveAllColumnBlocks(void);
+
         // 16 is arbitrary and is the order of the BPlus tree.  Higher orders are better for searching while lower orders are better for
         // Insertions and deletions.
         DataStructures::BPlusTree<unsigned, Row*, _TABLE_BPLUS_TREE_ORDER> rows;
 
         // Columns in the table.
         DataStructures::List<ColumnDescriptor> columns;
+
+        // Secondary indexes added with AddIndex(), at most one per column.
+        DataStructures::List<SecondaryIndex*> indexes;
+
+        // Column blocks added with AddColumnBlock(), at most one per column, with the row ID and row in each of their slots, and the slot of each row ID
+        DataStructures::List<ColumnBlock*> columnBlocks;
+        DataStructures::List<unsigned> columnBlockRowIds;
+        DataStructures::List<Row*> columnBlockRows;
+        DataStructures::BPlusTree<unsigned, unsigned, _TABLE_BPLUS_TREE_ORDER> columnBlockSlots;
+        DataStructures::List<unsigned char> columnBlockMask;
     };
 }
 
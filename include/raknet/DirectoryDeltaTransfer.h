@@ -26,6 +26,7 @@
 #include "PluginInterface2.h"
 #include "DS_Map.h"
 #include "PacketPriority.h"
+#include "FileList.h"
 
 /// \defgroup DIRECTORY_DELTA_TRANSFER_GROUP DirectoryDeltaTransfer
 /// \brief Simple class to send changes between directories
@@ -60,6 +61,7 @@ class FileListTransfer;
 class FileListTransferCBInterface;
 class FileListProgress;
 class IncrementalReadInterface;
+class FileManifestCache;
 
 class RAK_DLL_EXPORT DirectoryDeltaTransfer : public PluginInterface2
 {
@@ -94,6 +96,17 @@ public:
     /// \param[in] subdir Concatenated with pathToApplication to form the final path from which to allow uploads.
     void AddUploadsFromSubdirectory(const char *subdir);
 
+    /// \brief Speeds up hashing files in AddUploadsFromSubdirectory(), GenerateHashes() and the blocking DownloadFromSubdirectory()
+    /// \details Hashes of unchanged files are taken from \a manifestCache, and the other files are hashed on \a hashThreadCount threads as well as the calling thread.
+    /// Load the FileManifestCache before adding uploads, and save it afterwards, to skip hashing unchanged files on the next run. See FileList::SetHashOptions()
+    /// \param[in] manifestCache Pass 0 to hash every file. Must remain valid while files are added
+    /// \param[in] hashThreadCount Pass 0 to hash on the calling thread only
+    void SetHashOptions(FileManifestCache *manifestCache, int hashThreadCount);
+
+    /// \brief Counts and times from the last call to AddUploadsFromSubdirectory()
+    /// \details For example, FileList::AddFilesStatistics::totalTime is how long building the list of files took, and filesFromManifest how many files did not need hashing
+    const FileList::AddFilesStatistics& GetUploadsStatistics(void) const;
+
     /// \brief Downloads files from the matching parameter \a subdir in AddUploadsFromSubdirectory.
     /// \details \a subdir must contain all starting characters in \a subdir in AddUploadsFromSubdirectory
     /// Therefore,
@@ -151,6 +164,11 @@ public:
     /// \param[in] _chunkSize How large of a block of a file to send at once
     void SetDownloadRequestIncrementalReadInterface(IncrementalReadInterface *_incrementalReadInterface, unsigned int _chunkSize);
 
+    /// \brief Answers download requests with FileListTransfer::SendChunked() rather than Send()
+    /// \details A file the downloader already has an older copy of is cut into content defined chunks, and only the chunks that changed are sent, which takes one more round trip.
+    /// The downloader needs no setting, as DownloadFromSubdirectory() passes its files to FileListTransfer::SetReceiveBasis(). Defaults to false
+    void SetDownloadRequestChunking(bool enabled);
+
     /// \internal For plugin handling
     virtual PluginReceiveResult OnReceive(Packet *packet);
 protected:
@@ -163,6 +181,9 @@ protected:
     char orderingChannel;
     IncrementalReadInterface *incrementalReadInterface;
     unsigned int chunkSize;
+    bool chunkDownloadRequests;
+    FileManifestCache *manifestCache;
+    int hashThreadCount;
 };
 
 } // namespace RakNet
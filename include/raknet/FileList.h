@@ -38,6 +38,7 @@ namespace RakNet
 {
 /// Forward declarations
 class RakPeerInterface;
+class FileManifestCache;
 class FileList;
 
 
@@ -158,7 +159,7 @@ public:
     // GetInstance() and DestroyInstance(instance*)
     STATIC_FACTORY_DECLARATIONS(FileList)
 
-    FileList() = default;
+    FileList();
     ~FileList();
     /// \brief Add all the files at a given directory.
     /// \param[in] applicationDirectory The first part of the path. This is not stored as part of the filename.  Use \ as the path delineator.
@@ -169,6 +170,29 @@ public:
     /// \param[in] context User defined byte to store with each file. Use for whatever you want.
     void AddFilesFromDirectory(const char *applicationDirectory, const char *subDirectory, bool writeHash, bool writeData, bool recursive, FileListNodeContext context);
 
+    /// Counts and times from the last call to AddFilesFromDirectory()
+    struct AddFilesStatistics
+    {
+        /// Files added
+        unsigned int filesFound;
+        /// Files whose hash came from the FileManifestCache, and files read to hash them
+        unsigned int filesFromManifest, filesHashed;
+        uint64_t bytesHashed;
+        /// Microseconds listing directories and looking up hashes in the FileManifestCache, hashing the other files, and in all.
+        /// When adding data as well as the hash, each file is hashed as it is read, and that is counted in \a scanTime
+        RakNet::TimeUS scanTime, hashTime, totalTime;
+    };
+
+    /// \brief Makes AddFilesFromDirectory() look up hashes in \a manifestCache, and hash the files not found there on \a hashThreadCount threads
+    /// \details Applies when adding the hash without the data, as DirectoryDeltaTransfer does. With the data, every file has to be read anyway.
+    /// \a manifestCache is updated with the files hashed, so Save() it afterwards to skip them next time
+    /// \param[in] manifestCache Pass 0 to hash every file. Must remain valid while used by AddFilesFromDirectory()
+    /// \param[in] hashThreadCount Threads to start for hashing, in addition to the calling thread, which hashes as well. Pass 0 to hash on the calling thread only
+    void SetHashOptions(FileManifestCache *manifestCache, int hashThreadCount);
+
+    /// \return Counts and times from the last call to AddFilesFromDirectory(), for example to measure how long building the file list took
+    const AddFilesStatistics& GetAddFilesStatistics(void) const;
+
     /// Deallocate all memory
     void Clear(void);
 
@@ -253,6 +277,9 @@ public:
     static bool FixEndingSlash(char *str);
 protected:
     DataStructures::List<FileListProgress*> fileListProgressCallbacks;
+    FileManifestCache *manifestCache;
+    int hashThreadCount;
+    AddFilesStatistics addFilesStatistics;
 };
 
 } // namespace RakNet
@@ -30,6 +30,8 @@
 #include "DS_Queue.h"
 #include "SimpleMutex.h"
 #include "ThreadPool.h"
+#include "ContentChunker.h"
+#include <atomic>
 
 namespace RakNet
 {
@@ -38,6 +40,8 @@ class IncrementalReadInterface;
 class FileListTransferCBInterface;
 class FileListProgress;
 struct FileListReceiver;
+struct FileListChunkedSend;
+struct FileListChunkJob;
 
 /// \defgroup FILE_LIST_TRANSFER_GROUP FileListTransfer
 /// \brief A plugin to provide a simple way to compress and incrementally send the files in the FileList structure.
@@ -65,6 +69,7 @@ public:
     virtual ~FileListTransfer();
 
     /// \brief Optionally start worker threads when using _incrementalReadInterface for the Send() operation
+    /// \details The threads also read and chunk the files sent with SendChunked(), and the files passed to SetReceiveBasis(). Without them, that is done on the thread calling SendChunked() or Receive()
     /// \param[in] numThreads how many worker threads to start
     /// \param[in] threadPriority Passed to the thread creation routine. Use THREAD_PRIORITY_NORMAL for Windows. For Linux based systems, you MUST pass something reasonable based on the thread priorities for your application.
     void StartIncrementalReadThreads(int numThreads, int threadPriority=-99999);
@@ -87,9 +92,38 @@ public:
     /// \param[in] _chunkSize How large of a block of a file to read/send at once. Large values use more memory but transfer slightly faster.
     void Send(FileList *fileList, RakNet::RakPeerInterface *rakPeer, SystemAddress recipient, unsigned short setID, PacketPriority priority, char orderingChannel, IncrementalReadInterface *_incrementalReadInterface=0, unsigned int _chunkSize=262144*4*16);
 
+    /// \brief Like Send(), but only sends the parts of each file that \a recipient does not already have
+    /// \details Each file is cut into content defined chunks, so an insertion or deletion only changes the chunks around it. The hashes of the chunks are sent first, \a recipient replies with which of them are not in the files it passed to SetReceiveBasis(), and only those chunks are then sent with Send().<BR>
+    /// A file none of whose chunks \a recipient has is sent as Send() would, with \a _incrementalReadInterface if it is a reference.<BR>
+    /// Each file is read and chunked on the threads started with StartIncrementalReadThreads(), or when this is called if there are none. This takes as much memory as the largest file. Data is copied, so \a fileList need not stay valid
+    /// \sa Send() for the parameters
+    void SendChunked(FileList *fileList, RakNet::RakPeerInterface *rakPeer, SystemAddress recipient, unsigned short setID, PacketPriority priority, char orderingChannel, IncrementalReadInterface *_incrementalReadInterface=0, unsigned int _chunkSize=262144*4*16);
+
+    /// \brief Sets files this system already has, so that files sent to \a setId with SendChunked() only need the chunks that changed
+    /// \details A file sent uses the chunks of the file in \a basis with the same filename, which is read from FileListNode::fullPathToFile. It must not change until the file has arrived.<BR>
+    /// FileListTransferCBInterface::OnFile() gets the whole file. If it does not match the hash of the file sent, OnFileStruct::fileData is 0 and OnFileStruct::context.op is PC_ERROR_PATCH_RESULT_CHECKSUM_FAILURE.<BR>
+    /// The lengths in FileListTransferCBInterface::OnFileProgress() only count the chunks sent.
+    /// \param[in] setId The return value of SetupReceive()
+    /// \param[in] basis Only the filename and fullPathToFile of each file are used, so it can be built without data. They are copied
+    void SetReceiveBasis(unsigned short setId, const FileList &basis);
+
+    /// \brief Sets the size of the chunks cut by SendChunked()
+    /// \details See ContentChunker::SetChunkSizes(). The receiver uses the sizes the sender used
+    void SetContentChunkSizes(unsigned int minimum, unsigned int average, unsigned int maximum);
+
     /// Return number of files waiting to go out to a particular address
     unsigned int GetPendingFilesToAddress(SystemAddress recipient);
 
+    /// \brief Returns how many bytes of file data were sent since this plugin was created, not counting headers
+    /// \details Files sent with an IncrementalReadInterface are counted as each chunk is read and sent
+    uint64_t GetFileBytesSent(void) const;
+
+    /// Returns how many bytes of file data were received since this plugin was created, not counting headers or ID_DOWNLOAD_PROGRESS notifications
+    uint64_t GetFileBytesReceived(void) const;
+
+    /// Returns how many bytes of files sent with SendChunked() were copied from the files passed to SetReceiveBasis(), or from earlier in the same file, rather than received
+    uint64_t GetFileBytesReused(void) const;
+
     /// \brief Stop a download.
     void CancelReceive(unsigned short setId);
 
@@ -132,6 +166,12 @@ protected:
     void OnReferencePush(Packet *packet, bool fullFile);
     void OnReferencePushAck(Packet *packet);
     void SendIRIToAddress(SystemAddress systemAddress, unsigned short setId);
+    void OnChunkManifest(Packet *packet);
+    void OnChunkRequest(Packet *packet);
+    void ClearChunkedSends(SystemAddress systemAddress, bool abortedCallback);
+    void AddChunkJob(FileListChunkJob *job);
+    void UpdateChunkJobs(void);
+    void FinishChunkJob(FileListChunkJob *job);
 
     DataStructures::Map<unsigned short, FileListReceiver*> fileListReceivers;
     unsigned short setId;
@@ -171,11 +211,23 @@ protected:
         FileListTransfer *fileListTransfer;
         SystemAddress systemAddress;
         unsigned short setId;
+        // For ChunkJobCB, 0 otherwise
+        FileListChunkJob *chunkJob;
     };
 
     ThreadPool<ThreadData, int> threadPool;
 
+    ContentChunker contentChunker;
+    // Sent by SendChunked(), waiting for ID_FILE_LIST_CHUNK_REQUEST
+    DataStructures::List<FileListChunkedSend*> chunkedSends;
+    // Given to the thread pool, or run, by AddChunkJob(). Only used from the thread calling Update()
+    DataStructures::List<FileListChunkJob*> chunkJobs;
+
+    // Incremental reads run on the thread pool, so these are written from more than one thread
+    std::atomic<uint64_t> fileBytesSent, fileBytesReceived, fileBytesReused;
+
     friend int SendIRIToAddressCB(FileListTransfer::ThreadData threadData, bool *returnOutput, void* perThreadData);
+    friend int ChunkJobCB(FileListTransfer::ThreadData threadData, bool *returnOutput, void* perThreadData);
 };
 
 } // namespace RakNet
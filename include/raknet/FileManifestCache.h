@@ -0,0 +1,85 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file FileManifestCache.h
+/// \brief Remembers the hash of each file by path, size and modification time, so unchanged files need not be hashed again
+///
+
+
+#include "NativeFeatureIncludes.h"
+#if _CRABNET_SUPPORT_FileOperations==1
+
+#ifndef __FILE_MANIFEST_CACHE_H
+#define __FILE_MANIFEST_CACHE_H
+
+#include <stdint.h>
+#include "Export.h"
+#include "DS_OpenHash.h"
+#include "RakString.h"
+
+namespace RakNet
+{
+
+/// \brief Hashes of files from an earlier run, for FileList::AddFilesFromDirectory()
+/// \details Each entry holds the path, size, modification time and SuperFastHash of a file. A file whose size and modification time still match is not read again.
+/// Load() before building the file list and Save() afterwards to keep the hashes between runs.<BR>
+/// A file rewritten with the same size within the resolution of the file system's modification time is not detected. That is one second on some file systems.<BR>
+/// Not thread safe. FileList only uses it from the thread that calls AddFilesFromDirectory()
+/// \sa FileList::SetHashOptions()
+class RAK_DLL_EXPORT FileManifestCache
+{
+public:
+    FileManifestCache();
+    ~FileManifestCache();
+
+    /// \brief Replaces the entries with those saved by Save()
+    /// \return False if the file is missing or not a manifest written by this version, in which case there are no entries
+    bool Load(const char *path);
+
+    /// \brief Writes every entry to \a path
+    /// \return False if the file could not be written
+    bool Save(const char *path) const;
+
+    /// \brief Looks up the hash of \a path
+    /// \return True if \a path was recorded with this size and modification time, in which case \a hash is set
+    bool GetHash(const char *path, uint64_t size, int64_t modificationTime, uint32_t *hash);
+
+    /// Records the hash of \a path, replacing any earlier entry
+    void SetHash(const char *path, uint64_t size, int64_t modificationTime, uint32_t hash);
+
+    /// \brief Removes entries not passed to GetHash() or SetHash() since Load() or the last call, such as files that have been deleted
+    /// \return The number of entries removed
+    unsigned int RemoveUnused(void);
+
+    unsigned int Size(void) const;
+    void Clear(void);
+
+    /// \brief Gets what is compared to tell if a file changed
+    /// \param[out] modificationTime In the file system's own units, which are only compared on the same system
+    /// \return False if the file does not exist
+    static bool GetFileInfo(const char *path, uint64_t *size, int64_t *modificationTime);
+
+protected:
+    struct Entry
+    {
+        uint64_t size;
+        int64_t modificationTime;
+        uint32_t hash;
+        bool used;
+    };
+    DataStructures::OpenHash<RakString, Entry, RakString::ToInteger> entries;
+};
+
+} // namespace RakNet
+
+#endif
+
+#endif // _CRABNET_SUPPORT_*
@@ -12,15 +12,12 @@
 #ifndef _GRID_SECTORIZER_H
 #define _GRID_SECTORIZER_H
 
-//#define _USE_ORDERED_LIST
-
-
-#ifdef _USE_ORDERED_LIST
-#include "DS_OrderedList.h"
-#else
+#include <float.h>
 #include "DS_List.h"
-#endif
 
+// Uniform grid spatial index over 2D bounding rectangles
+// Each cell stores its entries contiguously together with their bounding rectangles, so queries never dereference the entries themselves
+// An entry that overlaps several cells is stored once per cell, but is returned only once per query
 class GridSectorizer
 {
 public:
@@ -28,36 +25,56 @@ public:
     ~GridSectorizer();
 
     // _cellWidth, _cellHeight is the width and height of each cell in world units
-    // minX, minY, maxX, maxY are the world dimensions (can be changed to dynamically allocate later if needed)
+    // minX, minY, maxX, maxY are the world dimensions. Entries outside the world are stored in the edge cells
     void Init(float _maxCellWidth, float _maxCellHeight, float minX, float minY, float maxX, float maxY);
 
     // Adds a pointer to the grid with bounding rectangle dimensions
     void AddEntry(void *entry, float minX, float minY, float maxX, float maxY);
 
-#ifdef _USE_ORDERED_LIST
-
-    // Removes a pointer, as above
+    // Removes a pointer, as above. Pass the same bounding rectangle that was last used to add or move the entry
     void RemoveEntry(void *entry, const float minX, const float minY, const float maxX, const float maxY);
 
-    // Adds and removes in one pass, more efficient than calling both functions consecutively
+    // Changes the bounding rectangle of an entry
+    // If the entry stays within the same cells it is updated in place, otherwise only the cells it left and entered are touched
     void MoveEntry(void *entry, const float sourceMinX, const float sourceMinY, const float sourceMaxX, const float sourceMaxY,
         const float destMinX, const float destMinY, const float destMaxX, const float destMaxY);
 
-#endif
+    // Writes to intersectionList all entries whose bounding rectangle intersects the given rectangle, each exactly once
+    void GetEntries(DataStructures::List<void*>& intersectionList, float minX, float minY, float maxX, float maxY) const;
 
-    // Adds to intersectionList all entries in a certain radius
-    void GetEntries(DataStructures::List<void*>& intersectionList, float minX, float minY, float maxX, float maxY);
+    // Writes to nearestList up to k entries closest to (x,y), nearest first
+    // Distance is measured to the closest point of each entry's bounding rectangle, so it is 0 for entries containing (x,y)
+    // Entries further than maxDistance are not returned
+    void GetNearestEntries(DataStructures::List<void*>& nearestList, float x, float y, unsigned k, float maxDistance = FLT_MAX) const;
+
+    // Returns how many cell slots are in use. An entry counts once for every cell it overlaps
+    unsigned GetCellEntryCount() const;
 
     void Clear();
 
 protected:
+    struct GridEntry
+    {
+        void *entry;
+        float minX, minY, maxX, maxY;
+    };
+
+    // Entries are kept contiguous within a cell, and removal fills the hole with the last entry
+    struct GridCell
+    {
+        GridEntry *entries;
+        unsigned count, capacity;
+    };
+
     int WorldToCellX(float input) const;
     int WorldToCellY(float input) const;
     int WorldToCellXOffsetAndClamped(float input) const;
     int WorldToCellYOffsetAndClamped(float input) const;
 
-    // Returns true or false if a position crosses cells in the grid.  If false, you don't need to move entries
-    bool PositionCrossesCells(float originX, float originY, float destinationX, float destinationY) const;
+    void InsertIntoCell(GridCell *cell, void *entry, float minX, float minY, float maxX, float maxY);
+    void RemoveFromCell(GridCell *cell, void *entry);
+    GridEntry *FindInCell(GridCell *cell, void *entry) const;
+    static float DistanceSquaredToEntry(const GridEntry &gridEntry, float x, float y);
 
     float cellOriginX, cellOriginY;
     float cellWidth, cellHeight;
@@ -65,14 +82,12 @@ protected:
     float gridWidth, gridHeight;
     int gridCellWidthCount, gridCellHeightCount;
 
+    GridCell *grid;
 
-    // int gridWidth, gridHeight;
-
-#ifdef _USE_ORDERED_LIST
-    DataStructures::OrderedList<void*, void*>* grid;
-#else
-    DataStructures::List<void*>* grid;
-#endif
+private:
+    // Not copyable, as grid and the entries of each cell are owned
+    GridSectorizer(const GridSectorizer &);
+    GridSectorizer &operator=(const GridSectorizer &);
 };
 
 #endif
@@ -32,6 +32,19 @@ public:
     /// \param[out] preallocatedDestination Write your data here
     /// \return The number of bytes read, or 0 if none
     virtual unsigned int GetFilePart( const char *filename, unsigned int startReadBytes, unsigned int numBytesToRead, void *preallocatedDestination, FileListNodeContext &context);
+
+    /// Optionally give direct access to part of a file, so FileListTransfer can send it without copying it into a buffer first
+    /// The default returns false, and GetFilePart() is used instead
+    /// \param[in] filename Filename to read
+    /// \param[in] startReadBytes What offset from the start of the file to read from
+    /// \param[in] numBytesToRead Most bytes to return
+    /// \param[out] data Set to the first byte read. Must stay valid until ReleaseFilePart() is called with it
+    /// \param[out] bytesRead The number of bytes at \a data, or 0 if none
+    /// \return True if \a data was set, in which case ReleaseFilePart() will be called once the data has been sent
+    virtual bool AcquireFilePart( const char *filename, unsigned int startReadBytes, unsigned int numBytesToRead, const char **data, unsigned int *bytesRead, FileListNodeContext &context);
+
+    /// Called once for every successful AcquireFilePart(), when \a data is no longer used
+    virtual void ReleaseFilePart( const char *filename, const char *data);
 };
 
 } // namespace RakNet
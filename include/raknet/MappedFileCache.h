@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file MappedFileCache.h
+/// \brief An IncrementalReadInterface that reads files through memory mappings shared by every transfer
+///
+
+
+#ifndef __MAPPED_FILE_CACHE_H
+#define __MAPPED_FILE_CACHE_H
+
+#include <stdint.h>
+#include "IncrementalReadInterface.h"
+#include "DS_List.h"
+#include "DS_OpenHash.h"
+#include "RakString.h"
+#include "SimpleMutex.h"
+#include "Export.h"
+
+namespace RakNet
+{
+
+/// \brief Serves file parts from read-only memory mappings, for FileListTransfer::Send() to many recipients at once
+/// \details Each file is mapped once, the first time any transfer reads it, and the mapping is shared by every transfer using this object.
+/// So sending the same files to hundreds of systems reads them from disk once, through the operating system's page cache, with no open, seek and read per part.
+/// FileListTransfer sends the mapped memory directly, using AcquireFilePart() and ReleaseFilePart(), so a part is not copied into a buffer first.<BR>
+/// Files that no transfer is reading are unmapped, least recently used first, while more than SetMaxMappedBytes() are mapped.
+/// A file that cannot be mapped is read with IncrementalReadInterface::GetFilePart() instead.<BR>
+/// A file must not be truncated while mapped. Call Unmap() after changing a file on disk.
+/// Safe to use from several threads, such as with FileListTransfer::StartIncrementalReadThreads()
+class RAK_DLL_EXPORT MappedFileCache : public IncrementalReadInterface
+{
+public:
+    MappedFileCache();
+    ~MappedFileCache() override;
+
+    unsigned int GetFilePart( const char *filename, unsigned int startReadBytes, unsigned int numBytesToRead, void *preallocatedDestination, FileListNodeContext &context) override;
+    bool AcquireFilePart( const char *filename, unsigned int startReadBytes, unsigned int numBytesToRead, const char **data, unsigned int *bytesRead, FileListNodeContext &context) override;
+    void ReleaseFilePart( const char *filename, const char *data) override;
+
+    /// Files not being read are unmapped while more than this many bytes are mapped. Defaults to 1 gigabyte
+    void SetMaxMappedBytes(uint64_t bytes);
+
+    /// Unmaps \a filename, or if a transfer is reading it, unmaps it once the part read is released. The next read maps the file again
+    void Unmap(const char *filename);
+
+    /// Unmaps every file that no transfer is reading
+    void Clear(void);
+
+    struct Statistics
+    {
+        /// Files currently mapped, and the sum of their sizes
+        unsigned int filesMapped;
+        uint64_t bytesMapped;
+        /// Times a file was mapped. Each time after the first for the same file means it was unmapped in between
+        uint64_t mappingsCreated;
+        /// Parts served from a mapping, and from IncrementalReadInterface::GetFilePart() because the file could not be mapped
+        uint64_t partsMapped;
+        uint64_t partsRead;
+    };
+    Statistics GetStatistics(void);
+
+protected:
+    struct MappedFile
+    {
+        RakString filename;
+        const char *data;
+        unsigned int length;
+        // Parts acquired and not yet released
+        unsigned int acquiredCount;
+        uint64_t lastUsed;
+    };
+
+    MappedFile *GetMappedFile(const char *filename);
+    static bool MapFile(const char *filename, const char **data, unsigned int *length);
+    static void UnmapFile(MappedFile *mappedFile);
+    void RemoveUnused(void);
+
+    DataStructures::OpenHash<RakString, MappedFile*, RakString::ToInteger> filesByName;
+    DataStructures::List<MappedFile*> mappedFiles;
+    // Removed by Unmap() while a part was acquired. Unmapped on the last ReleaseFilePart()
+    DataStructures::List<MappedFile*> unmappedFiles;
+    SimpleMutex mutex;
+    uint64_t maxMappedBytes;
+    uint64_t useCount;
+    Statistics statistics;
+};
+
+} // namespace RakNet
+
+#endif
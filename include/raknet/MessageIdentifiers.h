@@ -419,9 +419,12 @@ enum DefaultMessageIDTypes
     ID_NAT_REQUEST_BOUND_ADDRESSES,
     ID_NAT_RESPOND_BOUND_ADDRESSES,
     ID_FCM2_UPDATE_USER_CONTEXT,
-    ID_RESERVED_3,
-    ID_RESERVED_4,
-    ID_RESERVED_5,
+    /// FileListTransfer plugin - Hashes of the content defined chunks of the files in a set, sent by SendChunked()
+    ID_FILE_LIST_CHUNK_MANIFEST,
+    /// FileListTransfer plugin - Which chunks in ID_FILE_LIST_CHUNK_MANIFEST the receiver does not have
+    ID_FILE_LIST_CHUNK_REQUEST,
+    /// ReplicaManager3 plugin - ID_REPLICA_MANAGER_SERIALIZE, with each channel marked as full or a delta. See ReplicaManager3::SetDeltaSerialization()
+    ID_REPLICA_MANAGER_SERIALIZE_DELTA,
     ID_RESERVED_6,
     ID_RESERVED_7,
     ID_RESERVED_8,
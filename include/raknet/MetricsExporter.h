@@ -0,0 +1,169 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file
+/// \brief Publishes RakPeer and plugin counters as an OpenMetrics (Prometheus) text snapshot
+///
+
+
+#include "NativeFeatureIncludes.h"
+#if _CRABNET_SUPPORT_MetricsExporter==1
+
+#ifndef __METRICS_EXPORTER_H
+#define __METRICS_EXPORTER_H
+
+#include <atomic>
+#include "PluginInterface2.h"
+#include "PacketPriority.h"
+#include "RakString.h"
+#include "DS_List.h"
+#include "Export.h"
+
+namespace RakNet
+{
+/// Forward declarations
+class ReplicaManager3;
+class FileListTransfer;
+class NatPunchthroughClient;
+class NatPunchthroughServer;
+class TCPInterface;
+struct LatencyHistogram;
+
+/// \defgroup METRICS_EXPORTER_GROUP MetricsExporter
+/// \brief Publishes RakPeer and plugin counters as an OpenMetrics text snapshot
+/// \details
+/// \ingroup PLUGINS_GROUP
+
+/// \brief Publishes RakPeer and plugin counters as an OpenMetrics (Prometheus) text snapshot
+/// \details Message, byte, resend and ack counters are added up as the reliability layer calls the plugin, on the network thread, so no per connection polling is needed.<BR>
+/// Every SetSnapshotInterval() milliseconds, Update() reads the counters of the plugins passed to SetReplicaManager3() and the other setters, and formats the snapshot.<BR>
+/// The snapshot can be read with GetSnapshot(), written to a file with WriteSnapshot(), or served to HTTP GET requests with SetHTTPServer(), for example as a Prometheus scrape target.
+/// \ingroup METRICS_EXPORTER_GROUP
+class RAK_DLL_EXPORT MetricsExporter : public PluginInterface2
+{
+public:
+    // GetInstance() and DestroyInstance(instance*)
+    STATIC_FACTORY_DECLARATIONS(MetricsExporter)
+
+    MetricsExporter();
+    virtual ~MetricsExporter();
+
+    /// \brief How often Update() rebuilds the snapshot
+    /// \param[in] interval Milliseconds. Defaults to 5000. 0 rebuilds the snapshot on every Update()
+    void SetSnapshotInterval(RakNet::TimeMS interval);
+
+    /// \brief Also export the send buffer, resend buffer and latency histograms of RakNetStatistics, summed over all connections
+    /// \details This calls RakPeerInterface::GetStatistics() with UNASSIGNED_SYSTEM_ADDRESS, which visits every connection, once per snapshot. Defaults to false
+    void SetIncludeConnectionStatistics(bool include);
+
+    /// Prefix of every metric name. Defaults to "raknet"
+    void SetMetricPrefix(const char *prefix);
+
+    /// Export replica and connection counts for each world of \a rm3. Pass 0 to stop
+    void SetReplicaManager3(ReplicaManager3 *rm3);
+
+    /// Export file bytes sent and received by \a flt. Pass 0 to stop
+    void SetFileListTransfer(FileListTransfer *flt);
+
+    /// Export punchthrough attempts, successes and failures of \a client. Pass 0 to stop
+    void SetNatPunchthroughClient(NatPunchthroughClient *client);
+
+    /// Export punchthrough requests received by \a server. Pass 0 to stop
+    void SetNatPunchthroughServer(NatPunchthroughServer *server);
+
+    /// \brief Adds a gauge of your own to the snapshot, or changes its value
+    /// \param[in] name Metric name, without the prefix. Letters, digits and underscores only
+    /// \param[in] help Description written to the # HELP line
+    /// \param[in] value Current value
+    void SetGauge(const char *name, const char *help, double value);
+
+    /// Removes a gauge added with SetGauge()
+    void RemoveGauge(const char *name);
+
+    /// Rebuilds the snapshot now, without waiting for the interval
+    void UpdateSnapshot(void);
+
+    /// Returns the most recent snapshot in OpenMetrics text format, terminated by "# EOF"
+    const RakString &GetSnapshot(void) const;
+
+    /// \brief Writes the most recent snapshot to \a filename
+    /// \details The snapshot is written to a temporary file which then replaces \a filename, so a reader never sees a partial snapshot
+    /// \return false if the file could not be written
+    bool WriteSnapshot(const char *filename) const;
+
+#if _CRABNET_SUPPORT_TCPInterface==1
+    /// \brief Answers HTTP GET requests received by \a tcp with the most recent snapshot
+    /// \details \a tcp must be started with TCPInterface::Start(), and should be used for nothing else, since Update() reads and discards everything it receives.<BR>
+    /// Any path is answered with the snapshot, and connections are kept open for the next request. Pass 0 to stop
+    void SetHTTPServer(TCPInterface *tcp);
+#endif
+
+protected:
+    virtual void Update(void);
+    virtual void OnNewConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, bool isIncoming);
+    virtual void OnClosedConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, PI2_LostConnectionReason lostConnectionReason );
+    virtual void OnFailedConnectionAttempt(Packet *packet, PI2_FailedConnectionAttemptReason failedConnectionAttemptReason);
+    virtual bool GetReceiveMessageIDs(bool messageIds[256]) const;
+
+    // Called on the network thread
+    virtual bool UsesReliabilityLayer(void) const {return true;}
+    virtual void OnReliabilityLayerNotification(const char *errorMessage, const BitSize_t bitsUsed, SystemAddress remoteSystemAddress, bool isError);
+    virtual void OnInternalPacket(InternalPacket *internalPacket, unsigned frameNumber, SystemAddress remoteSystemAddress, RakNet::TimeMS time, int isSend);
+    virtual void OnAck(unsigned int messageNumber, SystemAddress remoteSystemAddress, RakNet::TimeMS time);
+
+    void AppendFamily(const char *name, const char *type, const char *help, const char *unit=0);
+    void AppendValue(const char *name, const char *labels, double value);
+    void AppendValue(const char *name, const char *labels, uint64_t value);
+    void AppendLatencyHistogram(const char *name, const char *help, const LatencyHistogram *histograms, int histogramCount, double scale, const char *unit);
+#if _CRABNET_SUPPORT_TCPInterface==1
+    void ServeHTTP(void);
+#endif
+
+    // Written by the network thread, read by Update()
+    std::atomic<uint64_t> messagesSent[NUMBER_OF_PRIORITIES];
+    std::atomic<uint64_t> messageBytesSent[NUMBER_OF_PRIORITIES];
+    std::atomic<uint64_t> messagesResent[NUMBER_OF_PRIORITIES];
+    std::atomic<uint64_t> messagesReceived, messageBytesReceived;
+    std::atomic<uint64_t> acksReceived;
+    std::atomic<uint64_t> reliabilityErrors, reliabilityWarnings;
+
+    // Only used on the game thread
+    uint64_t connectionsOpened, connectionsClosed, failedConnectionAttempts;
+    unsigned int connectionCount;
+
+    struct Gauge
+    {
+        RakString name;
+        RakString help;
+        double value;
+    };
+    DataStructures::List<Gauge> gauges;
+
+    RakString snapshot;
+    RakString metricPrefix;
+    RakNet::TimeMS snapshotInterval;
+    RakNet::TimeMS nextSnapshotTime;
+    bool includeConnectionStatistics;
+
+    ReplicaManager3 *replicaManager3;
+    FileListTransfer *fileListTransfer;
+    NatPunchthroughClient *natPunchthroughClient;
+    NatPunchthroughServer *natPunchthroughServer;
+#if _CRABNET_SUPPORT_TCPInterface==1
+    TCPInterface *httpServer;
+#endif
+};
+
+} // namespace RakNet
+
+#endif
+
+#endif // _CRABNET_SUPPORT_*
@@ -176,6 +176,15 @@ public:
     /// \param[in] i Pointer to an interface. The pointer is stored, so don't delete it while in progress. Pass 0 to clear.
     void SetDebugInterface(NatPunchthroughDebugInterface *i);
 
+    /// Returns how many times OpenNAT() started a punchthrough since this plugin was created
+    unsigned int GetPunchthroughAttemptCount(void) const {return punchthroughAttemptCount;}
+
+    /// Returns how many times ID_NAT_PUNCHTHROUGH_SUCCEEDED was returned since this plugin was created
+    unsigned int GetPunchthroughSuccessCount(void) const {return punchthroughSuccessCount;}
+
+    /// Returns how many times ID_NAT_PUNCHTHROUGH_FAILED was returned since this plugin was created
+    unsigned int GetPunchthroughFailureCount(void) const {return punchthroughFailureCount;}
+
     /// Get the port mappings you should pass to UPNP (for miniupnpc-1.6.20120410, for the function UPNP_AddPortMapping)
     void GetUPNPPortMappings(char *externalPort, char *internalPort, const SystemAddress &natPunchthroughServerAddress);
 
@@ -278,6 +287,8 @@ protected:
     } hasPortStride;
     RakNet::Time portStrideCalTimeout;
 
+    unsigned int punchthroughAttemptCount, punchthroughSuccessCount, punchthroughFailureCount;
+
     /*
     struct TimeAndGuid
     {
@@ -92,6 +92,12 @@ public:
     /// \param[in] i Pointer to an interface. The pointer is stored, so don't delete it while in progress. Pass 0 to clear.
     void SetDebugInterface(NatPunchthroughServerDebugInterface *i);
 
+    /// Returns how many ID_NAT_PUNCHTHROUGH_REQUEST messages were received since this plugin was created
+    unsigned int GetPunchthroughRequestCount(void) const {return punchthroughRequestCount;}
+
+    /// Returns how many requests were rejected because the target was not connected or was already busy
+    unsigned int GetPunchthroughRejectedCount(void) const {return punchthroughRejectedCount;}
+
     /// \internal For plugin handling
     virtual void Update(void);
 
@@ -137,6 +143,7 @@ public:
         void LogConnectionAttempts(RakNet::RakString &rs);
     };
     RakNet::Time lastUpdate;
+    unsigned int punchthroughRequestCount, punchthroughRejectedCount;
     static int NatPunchthroughUserComp( const RakNetGUID &key, User * const &data );
 protected:
     void OnNATPunchthroughRequest(Packet *packet);
@@ -24,6 +24,7 @@
 // #define _CRABNET_SUPPORT_FileListTransfer 0
 // #define _CRABNET_SUPPORT_FullyConnectedMesh2 0
 // #define _CRABNET_SUPPORT_MessageFilter 0
+// #define _CRABNET_SUPPORT_MetricsExporter 0
 // #define _CRABNET_SUPPORT_NatPunchthroughClient 0
 // #define _CRABNET_SUPPORT_NatPunchthroughServer 0
 // #define _CRABNET_SUPPORT_NatTypeDetectionClient 0
@@ -73,6 +74,9 @@
 #ifndef _CRABNET_SUPPORT_MessageFilter
 #define _CRABNET_SUPPORT_MessageFilter 1
 #endif
+#ifndef _CRABNET_SUPPORT_MetricsExporter
+#define _CRABNET_SUPPORT_MetricsExporter 1
+#endif
 #ifndef _CRABNET_SUPPORT_NatPunchthroughClient
 #define _CRABNET_SUPPORT_NatPunchthroughClient 1
 #endif
@@ -24,8 +24,8 @@
 namespace RakNet
 {
 
-/// Increase this value if you plan to have many persistent objects
-/// This value must match on all systems
+/// Initial number of slots in the NetworkID lookup table. Must be a power of two
+/// The table doubles whenever it becomes more than 3/4 full, so this only needs increasing to avoid the first few resizes
 #define NETWORK_ID_MANAGER_HASH_LENGTH 1024
 
 /// This class is simply used to generate a unique number for a group of instances of NetworkIDObject
@@ -57,6 +57,9 @@ public:
     // Stop tracking all NetworkID objects
     void Clear();
 
+    /// Returns how many NetworkIDObject instances are tracked
+    unsigned int GetNetworkIDObjectCount() const;
+
     /// \internal
     NetworkIDObject *GET_BASE_OBJECT_FROM_ID(NetworkID x);
 
@@ -67,12 +70,25 @@ protected:
 
     friend class NetworkIDObject;
 
-    NetworkIDObject *networkIdHash[NETWORK_ID_MANAGER_HASH_LENGTH];
-    unsigned int NetworkIDToHashIndex(NetworkID networkId);
+    // Open addressing with linear probing. The NetworkID is stored next to the pointer so probing does not touch the objects
+    struct NetworkIDSlot
+    {
+        NetworkID networkId;
+        NetworkIDObject *object;
+    };
+
+    NetworkIDSlot *networkIdHash;
+    unsigned int networkIdHashLength, networkIdHashMask, networkIdCount;
+    unsigned int NetworkIDToHashIndex(NetworkID networkId) const;
+    void ResizeNetworkIDHash(unsigned int newLength);
     uint64_t startingOffset;
     /// \internal
     NetworkID GetNewNetworkID();
 
+private:
+    // Not copyable, as networkIdHash is owned
+    NetworkIDManager(const NetworkIDManager &);
+    NetworkIDManager &operator=(const NetworkIDManager &);
 };
 
 } // namespace RakNet
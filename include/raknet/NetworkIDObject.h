@@ -81,7 +81,6 @@ protected:
 
     /// \internal, used by NetworkIDManager
     friend class NetworkIDManager;
-    NetworkIDObject *nextInstanceForNetworkIDManager;
 };
 
 } // namespace RakNet
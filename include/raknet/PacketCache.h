@@ -0,0 +1,39 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file PacketCache.h
+/// \internal
+/// \brief Per thread cache of Packet structures, used by RakPeer to allocate and deallocate packets without locking
+///
+
+
+#ifndef __PACKET_CACHE_H
+#define __PACKET_CACHE_H
+
+#include "Export.h"
+#include "RakNetTypes.h"
+
+namespace RakNet
+{
+    /// \internal
+    /// \brief Returns a default constructed Packet from the cache of the calling thread
+    /// \details Only allocates when the cache is empty, and no packets released by other threads are waiting to return to it
+    Packet RAK_DLL_EXPORT *AllocCachedPacket(void);
+
+    /// \internal
+    /// \brief Destroys a Packet returned by AllocCachedPacket(), from any thread. Does not free packet->data
+    /// \details The packet goes back to the cache of the thread that allocated it. From another thread it is pushed onto a lock free list,
+    /// which that thread takes back all at once when its own cache is empty.<BR>
+    /// Packet memory is kept for reuse until the process exits, so the caches grow to the largest number of packets held at one time
+    void RAK_DLL_EXPORT ReleaseCachedPacket(Packet *packet);
+}
+
+#endif
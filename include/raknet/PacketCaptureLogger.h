@@ -0,0 +1,219 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file
+/// \brief Captures all incoming and outgoing network messages to a compact binary file, for later conversion to text
+///
+
+
+#include "NativeFeatureIncludes.h"
+#if _CRABNET_SUPPORT_PacketLogger==1
+
+#ifndef __PACKET_CAPTURE_LOGGER_H
+#define __PACKET_CAPTURE_LOGGER_H
+
+#include <stdio.h>
+#include <atomic>
+#include "RakNetTypes.h"
+#include "PluginInterface2.h"
+#include "DS_List.h"
+#include "Export.h"
+
+namespace RakNet
+{
+
+/// Identifies a capture file, in the first four bytes of PacketCaptureFileHeader
+#define PACKET_CAPTURE_MAGIC "RNPC"
+/// Changes whenever PacketCaptureFileHeader or PacketCaptureRecord change
+#define PACKET_CAPTURE_VERSION 1
+/// How many bytes of each message PacketCaptureRecord can hold
+#define PACKET_CAPTURE_MAX_SNIPPET_LENGTH 56
+
+/// What a PacketCaptureRecord was captured from
+/// \ingroup PACKETLOGGER_GROUP
+enum PacketCaptureEventType
+{
+    /// A datagram sent outside the reliability layer, from PluginInterface2::OnDirectSocketSend()
+    PCE_SEND_RAW,
+    /// A datagram received outside the reliability layer, from PluginInterface2::OnDirectSocketReceive()
+    PCE_RECEIVE_RAW,
+    /// A message sent by the reliability layer, from PluginInterface2::OnInternalPacket()
+    PCE_SEND,
+    /// A message received by the reliability layer, from PluginInterface2::OnInternalPacket()
+    PCE_RECEIVE,
+    /// An ack for a reliable message, from PluginInterface2::OnAck(). The snippet is empty
+    PCE_ACK,
+    /// A packet passed to RakPeerInterface::PushBackPacket()
+    PCE_PUSH_BACK,
+    /// The reliability layer rejected a send or receive. The snippet holds the error message
+    PCE_ERROR,
+    /// The reliability layer warned about a send or receive. The snippet holds the warning
+    PCE_WARNING
+};
+
+/// Bits of PacketCaptureRecord::flags
+/// \ingroup PACKETLOGGER_GROUP
+enum PacketCaptureFlags
+{
+    /// The message starts with ID_TIMESTAMP. PacketCaptureRecord::messageId is the ID after the timestamp
+    PCF_TIMESTAMPED=1,
+    /// The message is part of a split packet
+    PCF_SPLIT=2,
+    /// The message was sent unreliably, so reliableMessageNumber is not used
+    PCF_UNRELIABLE=4
+};
+
+/// \brief Start of a capture file
+/// \details All capture fields are written in the byte order of the system that captured them. A reader on a system with the other byte order will see the wrong version.
+/// \ingroup PACKETLOGGER_GROUP
+struct PacketCaptureFileHeader
+{
+    /// PACKET_CAPTURE_MAGIC, not null terminated
+    char magic[4];
+    /// PACKET_CAPTURE_VERSION
+    uint16_t version;
+    /// sizeof(PacketCaptureRecord)
+    uint16_t recordSize;
+    /// RakNet::GetTimeUS() when the capture started. PacketCaptureRecord::time is on the same clock
+    uint64_t startTimeUS;
+    /// Seconds since 1970 when the capture started, to convert record times to the time of day
+    uint64_t startTimeSeconds;
+    /// RakNetGUID of the capturing system
+    uint64_t localGuid;
+};
+
+/// \brief One fixed size event in a capture file
+/// \ingroup PACKETLOGGER_GROUP
+struct PacketCaptureRecord
+{
+    /// RakNet::GetTimeUS() when the event was captured
+    uint64_t time;
+    /// RakNetGUID of the remote system, or UNASSIGNED_CRABNET_GUID if it is not connected
+    uint64_t remoteGuid;
+    /// Length of the message or datagram in bits
+    uint32_t bitLength;
+    uint32_t reliableMessageNumber;
+    uint32_t orderingIndex;
+    uint32_t sequencingIndex;
+    uint32_t splitPacketIndex;
+    uint32_t splitPacketCount;
+    /// Datagram count for the connection, as passed to PluginInterface2::OnInternalPacket()
+    uint32_t frameNumber;
+    uint16_t splitPacketId;
+    uint16_t remotePort;
+    /// The first 4 bytes are used for IPv4
+    unsigned char remoteAddress[16];
+    /// One of PacketCaptureEventType
+    unsigned char eventType;
+    /// 4 or 6
+    unsigned char ipVersion;
+    /// PacketReliability and PacketPriority, for PCE_SEND and PCE_RECEIVE
+    unsigned char reliability;
+    unsigned char priority;
+    unsigned char orderingChannel;
+    /// First byte of the message, or the byte after the timestamp if PCF_TIMESTAMPED is set
+    unsigned char messageId;
+    /// Combination of PacketCaptureFlags
+    unsigned char flags;
+    /// How many bytes of snippet are used
+    unsigned char snippetLength;
+    /// Start of the message. See PacketCaptureLogger::SetPayloadSnippetLength()
+    unsigned char snippet[PACKET_CAPTURE_MAX_SNIPPET_LENGTH];
+};
+
+/// \brief Writes incoming and outgoing messages to a binary capture file
+/// \details Unlike PacketFileLogger, nothing is formatted or written on the network threads. Each event is copied into a fixed size PacketCaptureRecord
+/// in a lock free ring buffer, and a writer thread appends the records to the file. If the writer falls behind and the ring buffer fills, further records are dropped and counted.<BR>
+/// Use the PacketCaptureConverter sample to turn a capture into text, CSV, or a pcap file.
+/// \ingroup PACKETLOGGER_GROUP
+class RAK_DLL_EXPORT PacketCaptureLogger : public PluginInterface2
+{
+public:
+    // GetInstance() and DestroyInstance(instance*)
+    STATIC_FACTORY_DECLARATIONS(PacketCaptureLogger)
+
+    PacketCaptureLogger();
+    virtual ~PacketCaptureLogger();
+
+    /// \brief Creates \a filename, writes the file header and starts the writer thread
+    /// \pre Attach the plugin first, so the file header has this system's RakNetGUID
+    /// \param[in] filename File to create. An existing file is overwritten
+    /// \param[in] ringBufferRecords How many records can wait for the writer thread. Rounded up to a power of two, at most 2^31
+    /// \return false if a capture is already running, or the file could not be created
+    bool StartCapture(const char *filename, unsigned int ringBufferRecords=65536);
+
+    /// \brief Writes out the records captured so far, stops the writer thread and closes the file
+    void StopCapture(void);
+
+    /// Returns true between StartCapture() and StopCapture()
+    bool IsCapturing(void) const;
+
+    /// \brief How many bytes at the start of each message to copy into PacketCaptureRecord::snippet
+    /// \param[in] bytes 0 to PACKET_CAPTURE_MAX_SNIPPET_LENGTH. Defaults to 0
+    void SetPayloadSnippetLength(unsigned int bytes);
+
+    /// Capture the direct sends and receives or not. Default true
+    void SetCaptureDirectMessages(bool capture);
+
+    /// Returns how many records were dropped since StartCapture() because the ring buffer was full
+    uint64_t GetDroppedRecordCount(void) const;
+
+    /// Returns how many records were written since StartCapture()
+    uint64_t GetWrittenRecordCount(void) const;
+
+    /// \internal
+    void WriterThread(void);
+
+protected:
+    virtual bool UsesReliabilityLayer(void) const {return true;}
+    virtual void OnDirectSocketSend(const char *data, const BitSize_t bitsUsed, SystemAddress remoteSystemAddress);
+    virtual void OnDirectSocketReceive(const char *data, const BitSize_t bitsUsed, SystemAddress remoteSystemAddress);
+    virtual void OnReliabilityLayerNotification(const char *errorMessage, const BitSize_t bitsUsed, SystemAddress remoteSystemAddress, bool isError);
+    virtual void OnInternalPacket(InternalPacket *internalPacket, unsigned frameNumber, SystemAddress remoteSystemAddress, RakNet::TimeMS time, int isSend);
+    virtual void OnAck(unsigned int messageNumber, SystemAddress remoteSystemAddress, RakNet::TimeMS time);
+    virtual void OnPushBackPacket(const char *data, const BitSize_t bitsUsed, SystemAddress remoteSystemAddress);
+    virtual bool GetReceiveMessageIDs(bool messageIds[256]) const;
+
+    // Bounded multi producer, single consumer queue. Each slot's sequence says whether it is free for the producer that claimed its position, or ready for the writer
+    struct CaptureSlot
+    {
+        std::atomic<uint32_t> sequence;
+        PacketCaptureRecord record;
+    };
+
+    // Claims a slot and fills in the fields every event has. Returns nullptr if the ring buffer is full
+    CaptureSlot *AllocateRecord(PacketCaptureEventType eventType, const SystemAddress &remoteSystemAddress);
+    // Makes the slot visible to the writer thread
+    void CommitRecord(CaptureSlot *slot);
+    void SetSnippet(PacketCaptureRecord *record, const unsigned char *data, unsigned int length, unsigned int maxLength);
+    void SetMessageId(PacketCaptureRecord *record, const unsigned char *data, BitSize_t bitLength);
+
+    CaptureSlot *ring;
+    uint32_t ringMask;
+    // Rings of earlier captures with another length. Only freed in the destructor
+    DataStructures::List<CaptureSlot*> oldRings;
+    std::atomic<uint32_t> enqueuePosition;
+    uint32_t dequeuePosition;
+
+    FILE *captureFile;
+    std::atomic<uint32_t> isCapturing, threadRunning, stopWriter;
+    // Network threads between checking isCapturing and committing or giving up on a record
+    std::atomic<uint32_t> activeProducers;
+    std::atomic<uint64_t> droppedRecordCount, writtenRecordCount;
+    unsigned int snippetLength;
+    bool captureDirectMessages;
+};
+
+} // namespace RakNet
+
+#endif
+
+#endif // _CRABNET_SUPPORT_*
@@ -107,6 +107,12 @@ public:
     /// \return True to allow the game and other plugins to get this message, false to absorb it
     virtual PluginReceiveResult OnReceive(Packet *packet) {(void) packet; return RR_CONTINUE_PROCESSING;}
 
+    /// Queried when attached to RakPeer, and by RakPeerInterface::RefreshPluginMessageIDs(), so OnReceive() is only called for messages the plugin handles
+    /// Return false to have OnReceive() called for every packet, which is the default
+    /// Otherwise set messageIds[id] to true for every value of packet->data[0] OnReceive() handles, including ID_TIMESTAMP if it reads past timestamps, and return true
+    /// \param[out] messageIds Indexed by MessageID, all false on entry
+    virtual bool GetReceiveMessageIDs(bool messageIds[256]) const {(void) messageIds; return false;}
+
     /// Called when RakPeer is initialized
     virtual void OnRakPeerStartup(void) {}
 
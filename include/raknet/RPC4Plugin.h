@@ -26,7 +26,7 @@
 #include "BitStream.h"
 #include "RakString.h"
 #include "NetworkIDObject.h"
-#include "DS_Hash.h"
+#include "DS_OpenHash.h"
 #include "DS_OrderedList.h"
 
 #ifdef _MSC_VER
@@ -207,7 +207,7 @@ class NetworkIDManager;
         {
             DataStructures::OrderedList<LocalSlotObject,LocalSlotObject,LocalSlotObjectComp> slotObjects;
         };
-        DataStructures::Hash<RakNet::RakString, LocalSlot*,256, RakNet::RakString::ToInteger> localSlots;
+        DataStructures::OpenHash<RakNet::RakString, LocalSlot*, RakNet::RakString::ToInteger> localSlots;
 
     protected:
 
@@ -216,9 +216,10 @@ class NetworkIDManager;
         // --------------------------------------------------------------------------------------------
         virtual void OnAttach(void);
         virtual PluginReceiveResult OnReceive(Packet *packet);
+        virtual bool GetReceiveMessageIDs(bool messageIds[256]) const;
 
-        DataStructures::Hash<RakNet::RakString, void ( * ) ( RakNet::BitStream *, Packet * ),64, RakNet::RakString::ToInteger> registeredNonblockingFunctions;
-        DataStructures::Hash<RakNet::RakString, void ( * ) ( RakNet::BitStream *, RakNet::BitStream *, Packet * ),64, RakNet::RakString::ToInteger> registeredBlockingFunctions;
+        DataStructures::OpenHash<RakNet::RakString, void ( * ) ( RakNet::BitStream *, Packet * ), RakNet::RakString::ToInteger> registeredNonblockingFunctions;
+        DataStructures::OpenHash<RakNet::RakString, void ( * ) ( RakNet::BitStream *, RakNet::BitStream *, Packet * ), RakNet::RakString::ToInteger> registeredBlockingFunctions;
         DataStructures::OrderedList<MessageID,LocalCallback*,RPC4::LocalCallbackComp> localCallbacks;
 
         RakNet::BitStream blockingReturnValue;
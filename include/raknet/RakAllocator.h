@@ -0,0 +1,76 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file RakAllocator.h
+/// \brief Replaceable allocation functions for message payloads and packets, and a size classed allocator with per thread caches to use for them
+/// \details RakPeer and ReliabilityLayer allocate and free every message payload and received Packet with rakMalloc_Ex() and rakFree_Ex().
+/// These default to malloc() and free(). Call UseArenaAllocator(), or SetMalloc_Ex(), SetRealloc_Ex() and SetFree_Ex() with your own functions,
+/// before the first RakPeerInterface is created, since memory allocated by one set of functions must not be freed by another.
+///
+
+
+#ifndef __RAK_ALLOCATOR_H
+#define __RAK_ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Export.h"
+#include "DS_List.h"
+
+namespace RakNet
+{
+    /// Allocates message payloads. \a file and \a line are the call site, from _FILE_AND_LINE_
+    extern RAK_DLL_EXPORT void *(*rakMalloc_Ex)(size_t size, const char *file, unsigned int line);
+    /// Resizes memory allocated by rakMalloc_Ex()
+    extern RAK_DLL_EXPORT void *(*rakRealloc_Ex)(void *p, size_t size, const char *file, unsigned int line);
+    /// Frees memory allocated by rakMalloc_Ex() or rakRealloc_Ex()
+    extern RAK_DLL_EXPORT void (*rakFree_Ex)(void *p, const char *file, unsigned int line);
+
+    /// Replaces rakMalloc_Ex(). Call before the first RakPeerInterface is created
+    void RAK_DLL_EXPORT SetMalloc_Ex(void *(*userFunction)(size_t size, const char *file, unsigned int line));
+    /// Replaces rakRealloc_Ex(). Call before the first RakPeerInterface is created
+    void RAK_DLL_EXPORT SetRealloc_Ex(void *(*userFunction)(void *p, size_t size, const char *file, unsigned int line));
+    /// Replaces rakFree_Ex(). Call before the first RakPeerInterface is created
+    void RAK_DLL_EXPORT SetFree_Ex(void (*userFunction)(void *p, const char *file, unsigned int line));
+
+    /// \brief Size classed allocator with a cache per thread
+    /// \details Allocations up to 32768 bytes are rounded up to one of 40 size classes, and taken from a free list of the calling thread without locking.
+    /// Memory freed by another thread, such as a Packet allocated by the network thread and deallocated by the game thread, is pushed onto a lock free list
+    /// of the thread that allocated it, which takes it back when its own free list for that size is empty.<BR>
+    /// Memory for small allocations is taken from malloc() in 64 kilobyte spans, and is kept for reuse until the process exits. Larger allocations use malloc() directly.<BR>
+    /// Every call counts one allocation and its size against \a file and \a line. See GetAllocationSiteStatistics()
+    void RAK_DLL_EXPORT *ArenaMalloc_Ex(size_t size, const char *file, unsigned int line);
+    /// Resizes memory allocated by ArenaMalloc_Ex()
+    void RAK_DLL_EXPORT *ArenaRealloc_Ex(void *p, size_t size, const char *file, unsigned int line);
+    /// Frees memory allocated by ArenaMalloc_Ex() or ArenaRealloc_Ex(), from any thread
+    void RAK_DLL_EXPORT ArenaFree_Ex(void *p, const char *file, unsigned int line);
+
+    /// Sets rakMalloc_Ex(), rakRealloc_Ex() and rakFree_Ex() to ArenaMalloc_Ex(), ArenaRealloc_Ex() and ArenaFree_Ex(). Call before the first RakPeerInterface is created
+    void RAK_DLL_EXPORT UseArenaAllocator(void);
+
+    /// Allocations counted against one call site by ArenaMalloc_Ex()
+    struct RAK_DLL_EXPORT AllocationSiteStatistics
+    {
+        /// Source file of the call site. 0 for allocations from call sites that did not fit in the table of a thread
+        const char *file;
+        unsigned int line;
+        /// Number of allocations since the process started
+        uint64_t allocations;
+        /// Total bytes requested by those allocations
+        uint64_t bytes;
+    };
+
+    /// \brief Returns the allocations counted by ArenaMalloc_Ex() for each call site, summed over all threads, in no particular order
+    /// \details Counters are read while other threads may be allocating, so the result is a close snapshot rather than an exact one
+    void RAK_DLL_EXPORT GetAllocationSiteStatistics(DataStructures::List<AllocationSiteStatistics> &sites);
+}
+
+#endif
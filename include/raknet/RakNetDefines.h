@@ -163,6 +163,24 @@
 #define USE_ALLOCA 1
 #endif
 
+// If defined to 1, CRABNET_TRACE_ZONE records how long each zone takes, for RakNet::WriteChromeTrace() in RakTrace.h
+// If 0, trace zones compile to nothing
+#ifndef CRABNET_TRACE
+#define CRABNET_TRACE 0
+#endif
+
+// How many trace zones each thread keeps when CRABNET_TRACE is 1. Older zones are overwritten. Must be a power of two
+// Uses 24 bytes per zone per thread that records zones
+#ifndef CRABNET_TRACE_BUFFER_EVENTS
+#define CRABNET_TRACE_BUFFER_EVENTS 65536
+#endif
+
+// Received messages up to this many bytes are stored inside the Packet, so delivering them needs no separate allocation for the data
+// Adds this many bytes to every Packet
+#ifndef CRABNET_PACKET_INLINE_DATA_SIZE
+#define CRABNET_PACKET_INLINE_DATA_SIZE 64
+#endif
+
 //#define USE_THREADED_SEND
 
 #endif // __CRABNET_DEFINES_H
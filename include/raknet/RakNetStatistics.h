@@ -53,6 +53,67 @@ enum RNSPerSecondMetrics
     RNS_PER_SECOND_METRICS_COUNT
 };
 
+/// Each power of two range of a LatencyHistogram is split into 2^LATENCY_HISTOGRAM_SUB_BUCKET_BITS linear buckets, so a recorded value is off by at most 1/8
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS 3
+#define LATENCY_HISTOGRAM_SUB_BUCKET_COUNT (1<<LATENCY_HISTOGRAM_SUB_BUCKET_BITS)
+/// Values of 2^LATENCY_HISTOGRAM_MAX_VALUE_BITS and above are counted in the last bucket. For microseconds, that is a little over a minute
+#define LATENCY_HISTOGRAM_MAX_VALUE_BITS 26
+#define LATENCY_HISTOGRAM_BUCKET_COUNT ((LATENCY_HISTOGRAM_MAX_VALUE_BITS-LATENCY_HISTOGRAM_SUB_BUCKET_BITS+1)*LATENCY_HISTOGRAM_SUB_BUCKET_COUNT)
+
+/// \brief Fixed size log-linear histogram, as used by HdrHistogram
+/// \details Values below LATENCY_HISTOGRAM_SUB_BUCKET_COUNT are counted exactly. Above that, bucket width doubles with each power of two.
+/// Two histograms can be added, so the histograms of several connections can be combined before taking percentiles.
+struct RAK_DLL_EXPORT LatencyHistogram
+{
+    /// How many values fell into each bucket
+    uint32_t counts[LATENCY_HISTOGRAM_BUCKET_COUNT];
+
+    /// Total number of recorded values
+    uint64_t GetCount(void) const;
+
+    /// \brief Returns the value below which \a percentile percent of the recorded values fall
+    /// \details The result is the largest value in the bucket holding that percentile, so it is never smaller than the true value
+    /// \param[in] percentile 0 to 100, for example 99.9
+    /// \return 0 if nothing was recorded
+    uint64_t GetPercentile(double percentile) const;
+
+    /// Returns the average of the recorded values, with each value taken as the middle of its bucket
+    double GetMean(void) const;
+
+    void Clear(void);
+
+    /// Returns which bucket \a value is counted in
+    static inline unsigned int ValueToBucket(uint64_t value)
+    {
+        if (value < LATENCY_HISTOGRAM_SUB_BUCKET_COUNT)
+            return (unsigned int) value;
+        if (value >= ((uint64_t) 1 << LATENCY_HISTOGRAM_MAX_VALUE_BITS))
+            return LATENCY_HISTOGRAM_BUCKET_COUNT-1;
+
+        // Position of the highest set bit
+        uint32_t v=(uint32_t) value;
+        unsigned int highestBit=0;
+        if (v >= 1<<16) {v>>=16; highestBit+=16;}
+        if (v >= 1<<8) {v>>=8; highestBit+=8;}
+        if (v >= 1<<4) {v>>=4; highestBit+=4;}
+        if (v >= 1<<2) {v>>=2; highestBit+=2;}
+        if (v >= 1<<1) highestBit+=1;
+
+        unsigned int shift=highestBit-LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+        return shift*LATENCY_HISTOGRAM_SUB_BUCKET_COUNT + (unsigned int) (value>>shift);
+    }
+
+    /// Returns the smallest value counted in \a bucket
+    static uint64_t BucketToValue(unsigned int bucket);
+
+    LatencyHistogram& operator +=(const LatencyHistogram& other)
+    {
+        for (unsigned int i=0; i < LATENCY_HISTOGRAM_BUCKET_COUNT; i++)
+            counts[i]+=other.counts[i];
+        return *this;
+    }
+};
+
 /// \brief Network Statisics Usage 
 ///
 /// Store Statistics information related to network usage 
@@ -119,6 +180,49 @@ struct RAK_DLL_EXPORT RakNetStatistics
     }
 };
 
+/// \brief Latency histograms of a connection
+///
+/// Kept out of RakNetStatistics, as they are several kilobytes and GetStatistics() is called often.
+/// \sa RakPeerInterface::GetLatencyHistograms()
+struct RAK_DLL_EXPORT RakNetLatencyHistograms
+{
+    /// For each priority level, how long messages waited in the send buffer before they were first sent, in microseconds
+    LatencyHistogram sendQueueTime[NUMBER_OF_PRIORITIES];
+
+    /// For each priority level, how long from RakPeerInterface::Send() until the message was acked, in microseconds
+    /// Only reliable messages are acked. Each part of a split message is counted on its own
+    LatencyHistogram deliveryTime[NUMBER_OF_PRIORITIES];
+
+    /// Round trip time of each acked datagram, in microseconds
+    LatencyHistogram ackRoundTripTime;
+
+    /// How many times each reliable message was resent before it was acked
+    LatencyHistogram resendCount;
+
+    void Clear(void)
+    {
+        for (unsigned int i=0; i < NUMBER_OF_PRIORITIES; i++)
+        {
+            sendQueueTime[i].Clear();
+            deliveryTime[i].Clear();
+        }
+        ackRoundTripTime.Clear();
+        resendCount.Clear();
+    }
+
+    RakNetLatencyHistograms& operator +=(const RakNetLatencyHistograms& other)
+    {
+        for (unsigned int i=0; i < NUMBER_OF_PRIORITIES; i++)
+        {
+            sendQueueTime[i]+=other.sendQueueTime[i];
+            deliveryTime[i]+=other.deliveryTime[i];
+        }
+        ackRoundTripTime+=other.ackRoundTripTime;
+        resendCount+=other.resendCount;
+        return *this;
+    }
+};
+
 /// Verbosity level currently supports 0 (low), 1 (medium), 2 (high)
 /// \param[in] s The Statistical information to format out
 /// \param[in] buffer The buffer containing a formated report
@@ -129,6 +233,11 @@ struct RAK_DLL_EXPORT RakNetStatistics
 /// 3 debugging congestion control
 void RAK_DLL_EXPORT StatisticsToString( RakNetStatistics *s, char *buffer, int verbosityLevel );
 
+/// Writes the median, 99th and 99.9th percentile of each histogram in \a s
+/// \param[in] s The histograms to format out
+/// \param[in] buffer Receives the report. 1024 bytes is enough
+void RAK_DLL_EXPORT LatencyHistogramsToString( RakNetLatencyHistograms *s, char *buffer );
+
 } // namespace RakNet
 
 #endif
@@ -425,6 +425,10 @@ struct Packet
     /// @internal
     /// If true, this message is meant for the user, not for the plugins, so do not process it through plugins
     bool wasGeneratedLocally;
+
+    /// @internal
+    /// Holds the data of packets allocated by RakPeer with length up to CRABNET_PACKET_INLINE_DATA_SIZE, in which case data points here
+    unsigned char inlineData[CRABNET_PACKET_INLINE_DATA_SIZE];
 };
 
 ///  Index of an unassigned player
@@ -265,6 +265,15 @@ public:
     /// \return 0 on bad input. Otherwise a number that identifies this message. If \a reliability is a type that returns a receipt, on a later call to Receive() you will get ID_SND_RECEIPT_ACKED or ID_SND_RECEIPT_LOSS with bytes 1-4 inclusive containing this number
     uint32_t SendList( const char **data, const int *lengths, const int numParameters, PacketPriority priority, PacketReliability reliability, char orderingChannel, const AddressOrGUID systemIdentifier, bool broadcast, uint32_t forceReceiptNumber=0 );
 
+    /// \brief Sends many messages at once.
+    /// \details Same as calling Send() for each message in order, but the messages are copied into one allocation and handed to the network thread as a single buffered command,
+    /// so the command queue is locked once for the batch rather than twice per message, and the network thread is woken at most once.
+    /// \param[in] messages The messages to send. Their data is copied, so it can be reused as soon as this returns.
+    /// \param[in] numMessages Number of elements in \a messages.
+    /// \param[out] receipts Optional array of \a numMessages elements, set to what Send() would have returned for each message. 0 for messages with bad input.
+    /// \return Number of messages accepted.
+    unsigned int SendBatch( const BatchedMessage *messages, unsigned int numMessages, uint32_t *receipts=0 );
+
     /// \brief Gets a message from the incoming message queue.
     /// \details Use DeallocatePacket() to deallocate the message after you are done with it.
     /// User-thread functions, such as RPC calls and the plugin function PluginInterface::Update occur here.
@@ -277,6 +286,19 @@ public:
     /// \param[in] packet Message to deallocate.
     void DeallocatePacket( Packet *packet );
 
+    /// \brief Gets up to \a maxPackets messages from the incoming message queue.
+    /// \details Takes the queue lock once and calls PluginInterface::Update once for all of them, rather than once per message as Receive() does.
+    /// Use DeallocatePackets() or DeallocatePacket() to deallocate the messages after you are done with them.
+    /// \param[out] packets Array of at least \a maxPackets pointers, filled in order of arrival.
+    /// \param[in] maxPackets Size of \a packets.
+    /// \return Number of packets written to \a packets. 0 if no packets are waiting to be handled.
+    unsigned int ReceiveBatch( Packet **packets, unsigned int maxPackets );
+
+    /// \brief Call this to deallocate messages returned by ReceiveBatch() when you are done handling them.
+    /// \param[in] packets Messages to deallocate.
+    /// \param[in] numPackets Number of messages in \a packets.
+    void DeallocatePackets( Packet **packets, unsigned int numPackets );
+
     /// \brief Return the total number of connections we are allowed.
     /// \return Total number of connections allowed.
     unsigned int GetMaximumNumberOfPeers( void ) const;
@@ -537,6 +559,10 @@ public:
     /// \param[in] messageHandler Pointer to a plugin to detach.
     void DetachPlugin( PluginInterface2 *messageHandler );
 
+    /// \brief Queries PluginInterface2::GetReceiveMessageIDs() again for all attached plugins
+    /// \details Call this if a plugin starts or stops handling a MessageID while attached.
+    void RefreshPluginMessageIDs( void );
+
     // --------------------------------------------------------------------------------------------Miscellaneous Functions--------------------------------------------------------------------------------------------
     /// \brief Puts a message back in the receive queue in case you don't want to deal with it immediately.
     /// \param[in] packet The pointer to the packet you want to push back.
@@ -622,6 +648,12 @@ public:
     /// \param[out] guids RakNetGUID for each connected system
     /// \param[out] statistics Calculated RakNetStatistics for each connected system
     virtual void GetStatisticsList(DataStructures::List<SystemAddress> &addresses, DataStructures::List<RakNetGUID> &guids, DataStructures::List<RakNetStatistics> &statistics);
+    /// \brief Returns the latency histograms of the specified system
+    /// \details These are not part of RakNetStatistics, as they are several kilobytes. You can map them to a string using LatencyHistogramsToString()
+    /// \param[in] systemAddress Which connected system to get histograms for. UNASSIGNED_SYSTEM_ADDRESS to sum over all connected systems
+    /// \param[out] histograms Written to
+    /// \return False if the system was not found, or with UNASSIGNED_SYSTEM_ADDRESS, if there are no connected systems
+    bool GetLatencyHistograms( const SystemAddress systemAddress, RakNetLatencyHistograms *histograms );
 
     /// \Returns how many messages are waiting when you call Receive()
     virtual unsigned int GetReceiveBufferSize(void);
@@ -861,6 +893,11 @@ protected:
     DataStructures::List<BanStruct*> banList;
     // Threadsafe, and not thread safe
     DataStructures::List<PluginInterface2*> pluginListTS, pluginListNTS;
+    // For each MessageID, the plugins whose OnReceive() is called, thread safe plugins first. Rebuilt by RefreshPluginMessageIDs()
+    DataStructures::List<PluginInterface2*> pluginReceiveTable[256];
+    // Nonzero while ProcessReturnedPacket() is walking pluginReceiveTable. RefreshPluginMessageIDs() then only sets pluginReceiveTableDirty, and the table is rebuilt once the walk is done
+    unsigned int pluginReceiveTableInUse;
+    bool pluginReceiveTableDirty;
 
     DataStructures::Queue<RequestedConnectionStruct*> requestedConnectionQueue;
     SimpleMutex requestedConnectionQueueMutex;
@@ -886,7 +923,22 @@ protected:
         RakNetSocket2* socket;
         unsigned short port;
         uint32_t receipt;
-        enum {BCS_SEND, BCS_CLOSE_CONNECTION, BCS_GET_SOCKET, BCS_CHANGE_SYSTEM_ADDRESS,/* BCS_USE_USER_SOCKET, BCS_REBIND_SOCKET_ADDRESS, BCS_RPC, BCS_RPC_SHIFT,*/ BCS_DO_NOTHING} command;
+        // Only used for BCS_SEND_BATCH
+        unsigned int numberOfBatchedMessages;
+        enum {BCS_SEND, BCS_SEND_BATCH, BCS_CLOSE_CONNECTION, BCS_GET_SOCKET, BCS_CHANGE_SYSTEM_ADDRESS,/* BCS_USE_USER_SOCKET, BCS_REBIND_SOCKET_ADDRESS, BCS_RPC, BCS_RPC_SHIFT,*/ BCS_DO_NOTHING} command;
+    };
+
+    // The data of a BCS_SEND_BATCH command is one of these for each message, each followed by the data of its message padded to the alignment of BufferedBatchMessage
+    struct BufferedBatchMessage
+    {
+        BitSize_t numberOfBitsToSend;
+        PacketPriority priority;
+        PacketReliability reliability;
+        char orderingChannel;
+        AddressOrGUID systemIdentifier;
+        bool broadcast;
+        RemoteSystemStruct::ConnectMode connectionMode;
+        uint32_t receipt;
     };
 
     // Single producer single consumer queue using a linked list
@@ -925,6 +977,10 @@ protected:
     void CloseConnectionInternal( const AddressOrGUID& systemIdentifier, bool sendDisconnectionNotification, bool performImmediate, unsigned char orderingChannel, PacketPriority disconnectionNotificationPriority );
     void SendBuffered( const char *data, BitSize_t numberOfBitsToSend, PacketPriority priority, PacketReliability reliability, char orderingChannel, const AddressOrGUID systemIdentifier, bool broadcast, RemoteSystemStruct::ConnectMode connectionMode, uint32_t receipt );
     void SendBufferedList( const char **data, const int *lengths, const int numParameters, PacketPriority priority, PacketReliability reliability, char orderingChannel, const AddressOrGUID systemIdentifier, bool broadcast, RemoteSystemStruct::ConnectMode connectionMode, uint32_t receipt );
+    /// Queues \a batch, allocated with rakMalloc_Ex() and laid out as described by BufferedBatchMessage, as one BCS_SEND_BATCH command. Takes ownership of \a batch
+    void PushSendBatch( char *batch, unsigned int numberOfMessages, bool wakeNetworkThread );
+    /// Bytes used in the data of a BCS_SEND_BATCH command by a message of \a numberOfBytes bytes, including its BufferedBatchMessage
+    static size_t GetBatchedMessageSize( size_t numberOfBytes );
     bool SendImmediate( char *data, BitSize_t numberOfBitsToSend, PacketPriority priority, PacketReliability reliability, char orderingChannel, const AddressOrGUID systemIdentifier, bool broadcast, bool useCallerDataAllocation, RakNet::TimeUS currentTime, uint32_t receipt );
     //bool HandleBufferedRPC(BufferedCommandStruct *bcs, RakNet::TimeMS time);
     void ClearBufferedCommands(void);
@@ -985,13 +1041,15 @@ protected:
     SignaledEvent quitAndDataEvents;
     bool limitConnectionFrequencyFromTheSameIP;
 
-    SimpleMutex packetAllocationPoolMutex;
-    DataStructures::MemoryPool<Packet> packetAllocationPool;
-
     SimpleMutex packetReturnMutex;
     DataStructures::Queue<Packet*> packetReturnQueue;
     Packet *AllocPacket(unsigned dataSize);
+    /// \a data is from ReliabilityLayer::Receive(), and is owned by the returned packet
     Packet *AllocPacket(unsigned dataSize, unsigned char *data);
+    /// Frees \a data from ReliabilityLayer::Receive(), unless it is receivedInlineData
+    void FreeReceivedData(unsigned char *data);
+    /// Small messages are copied here by ReliabilityLayer::Receive(), and from here into the Packet, so they need no allocation. Only used in RunUpdateCycle()
+    unsigned char receivedInlineData[CRABNET_PACKET_INLINE_DATA_SIZE];
 
     /// This is used to return a number to the user when they call Send identifying the message
     /// This number will be returned back with ID_SND_RECEIPT_ACKED or ID_SND_RECEIPT_LOSS and is only returned
@@ -1001,6 +1059,10 @@ protected:
     void ResetSendReceipt(void);
     void OnConnectedPong(RakNet::Time sendPingTime, RakNet::Time sendPongTime, RemoteSystemStruct *remoteSystem);
     void CallPluginCallbacks(DataStructures::List<PluginInterface2*> &pluginList, Packet *packet);
+    /// Calls PluginInterface2::Update() on every attached plugin
+    void UpdatePlugins(void);
+    /// Passes a packet from packetReturnQueue to the plugins. Returns false if a plugin kept or deallocated it
+    bool ProcessReturnedPacket(Packet *packet);
 
 #ifdef LIBCAT_SECURITY
     // Encryption and security
@@ -32,10 +32,25 @@ class BitStream;
 class PluginInterface2;
 struct RPCMap;
 struct RakNetStatistics;
+struct RakNetLatencyHistograms;
 struct RakNetBandwidth;
 class RouterInterface;
 class NetworkIDManager;
 
+/// One message for RakPeerInterface::SendBatch(). Members have the same meaning as the parameters of RakPeerInterface::Send()
+struct RAK_DLL_EXPORT BatchedMessage
+{
+    const char *data;
+    int length;
+    PacketPriority priority;
+    PacketReliability reliability;
+    char orderingChannel;
+    AddressOrGUID systemIdentifier;
+    bool broadcast;
+    /// If 0, a receipt number is assigned as with Send()
+    uint32_t forceReceiptNumber;
+};
+
 /// The primary interface for RakNet, RakPeer contains all major functions for the library.
 /// See the individual functions for what the class can do.
 /// \brief The main interface for network communications
@@ -238,6 +253,14 @@ public:
     /// \return 0 on bad input. Otherwise a number that identifies this message. If \a reliability is a type that returns a receipt, on a later call to Receive() you will get ID_SND_RECEIPT_ACKED or ID_SND_RECEIPT_LOSS with bytes 1-4 inclusive containing this number
     virtual uint32_t SendList( const char **data, const int *lengths, const int numParameters, PacketPriority priority, PacketReliability reliability, char orderingChannel, const AddressOrGUID systemIdentifier, bool broadcast, uint32_t forceReceiptNumber=0 )=0;
 
+    /// Sends many messages at once. Same as calling Send() for each of them in order, but they are copied into one allocation and handed to the network thread
+    /// as a single command, so the command queue is locked once for the batch rather than twice per message.
+    /// \param[in] messages The messages to send. Their data is copied, so it can be reused as soon as this returns
+    /// \param[in] numMessages Number of elements in \a messages
+    /// \param[out] receipts Optional array of \a numMessages elements, set to what Send() would have returned for each message. 0 for messages with bad input
+    /// \return Number of messages accepted
+    virtual unsigned int SendBatch( const BatchedMessage *messages, unsigned int numMessages, uint32_t *receipts=0 )=0;
+
     /// Gets a message from the incoming message queue.
     /// Use DeallocatePacket() to deallocate the message after you are done with it.
     /// User-thread functions, such as RPC calls and the plugin function PluginInterface::Update occur here.
@@ -250,6 +273,18 @@ public:
     /// \param[in] packet The message to deallocate.
     virtual void DeallocatePacket( Packet *packet )=0;
 
+    /// Gets up to \a maxPackets messages from the incoming message queue, taking the queue lock once and calling PluginInterface::Update once for all of them.
+    /// Use DeallocatePackets() or DeallocatePacket() to deallocate the messages after you are done with them.
+    /// \param[out] packets Array of at least \a maxPackets pointers, filled in order of arrival
+    /// \param[in] maxPackets Size of \a packets
+    /// \return Number of packets written to \a packets. 0 if no packets are waiting to be handled
+    virtual unsigned int ReceiveBatch( Packet **packets, unsigned int maxPackets )=0;
+
+    /// Call this to deallocate messages returned by ReceiveBatch() when you are done handling them.
+    /// \param[in] packets The messages to deallocate.
+    /// \param[in] numPackets How many messages are in \a packets
+    virtual void DeallocatePackets( Packet **packets, unsigned int numPackets )=0;
+
     /// Return the total number of connections we are allowed
     virtual unsigned int GetMaximumNumberOfPeers( void ) const=0;
 
@@ -500,6 +535,10 @@ public:
     /// \param[in] messageHandler Pointer to a plugin to detach.
     virtual void DetachPlugin( PluginInterface2 *messageHandler )=0;
 
+    /// \brief Queries PluginInterface2::GetReceiveMessageIDs() again for all attached plugins
+    /// \details Call this if a plugin starts or stops handling a MessageID while attached.
+    virtual void RefreshPluginMessageIDs( void )=0;
+
     // --------------------------------------------------------------------------------------------Miscellaneous Functions--------------------------------------------------------------------------------------------
     /// Put a message back at the end of the receive queue in case you don't want to deal with it immediately
     /// \param[in] packet The packet you want to push back.
@@ -586,6 +625,12 @@ public:
     /// \param[out] guids RakNetGUID for each connected system
     /// \param[out] statistics Calculated RakNetStatistics for each connected system
     virtual void GetStatisticsList(DataStructures::List<SystemAddress> &addresses, DataStructures::List<RakNetGUID> &guids, DataStructures::List<RakNetStatistics> &statistics)=0;
+    /// \brief Returns the latency histograms of the specified system
+    /// \details These are not part of RakNetStatistics, as they are several kilobytes. You can map them to a string using LatencyHistogramsToString()
+    /// \param[in] systemAddress Which connected system to get histograms for. UNASSIGNED_SYSTEM_ADDRESS to sum over all connected systems
+    /// \param[out] histograms Written to
+    /// \return False if the system was not found, or with UNASSIGNED_SYSTEM_ADDRESS, if there are no connected systems
+    virtual bool GetLatencyHistograms( const SystemAddress systemAddress, RakNetLatencyHistograms *histograms )=0;
 
     /// \Returns how many messages are waiting when you call Receive()
     virtual unsigned int GetReceiveBufferSize(void)=0;
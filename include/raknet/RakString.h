@@ -17,6 +17,7 @@
 #include "RakNetTypes.h" // int64_t
 #include <stdio.h>
 #include "stdarg.h"
+#include <atomic>
 
 #ifdef _WIN32
 #include "WindowsIncludes.h"
@@ -31,6 +32,7 @@ class BitStream;
 /// \brief String class
 /// \details Has the following improvements over std::string
 /// -Reference counting: Suitable to store in lists
+/// -Copying and releasing do not lock, so strings can be shared between threads cheaply
 /// -Variadic assignment operator
 /// -Doesn't cause linker errors
 class RAK_DLL_EXPORT RakString
@@ -243,8 +245,8 @@ public:
     /// Fix to be a file path, ending with /
     RakNet::RakString& MakeFilePath(void);
 
-    /// RakString uses a freeList of old no-longer used strings
-    /// Call this function to clear this memory on shutdown
+    /// RakString keeps the storage of released strings in a free list per thread, to reuse without locking
+    /// Call this function to clear this memory for the calling thread. It is also cleared when the thread exits
     static void FreeMemory(void);
     /// \internal
     static void FreeMemoryNoMutex(void);
@@ -298,10 +300,12 @@ public:
     }
 
     /// \internal
+    /// Strings up to smallString in length are stored inline, so they need no allocation besides the SharedString itself
     struct SharedString
     {
-        SimpleMutex *refCountMutex;
-        unsigned int refCount;
+        /// Next string in the free list of a thread, while this string is unused
+        SharedString *next;
+        std::atomic<unsigned int> refCount;
         size_t bytesUsed;
         char *bigString;
         char *c_str;
@@ -321,15 +325,19 @@ public:
 
     //static SharedString *sharedStringFreeList;
     //static unsigned int sharedStringFreeListAllocationCount;
+
+    /// \internal
+    /// Takes a SharedString with a refCount of 1 from the free list of the calling thread, with room for \a bytes
+    static SharedString *AllocSharedString(size_t bytes);
     /// \internal
-    /// List of free objects to reduce memory reallocations
-    static DataStructures::List<SharedString*> freeList;
+    /// Increments the refCount of \a ss
+    static void AddReference(SharedString *ss);
+    /// \internal
+    /// Decrements the refCount of \a ss, and returns it to the free list of the calling thread when it reaches 0
+    static void ReleaseReference(SharedString *ss);
 
     static int RakStringComp( RakString const &key, RakString const &data );
 
-    static void LockMutex(void);
-    static void UnlockMutex(void);
-
 protected:
     static RakNet::RakString FormatForPUTOrPost(const char* type, const char* uri, const char* contentType, const char* body, const char* extraHeaders);
     void Allocate(size_t len);
@@ -0,0 +1,97 @@
+/*
+ *  Copyright (c) 2014, Oculus VR, Inc.
+ *  Copyright (c) 2016-2018, TES3MP Team
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant 
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+/// \file RakTrace.h
+/// \brief Scoped trace zones, recorded per thread and written out as Chrome trace event JSON
+/// \details Define CRABNET_TRACE to 1 in RakNetDefinesOverrides.h to record zones. Put CRABNET_TRACE_ZONE("Name") at the start of a block,
+/// and the time until the end of the block is recorded into a ring buffer owned by the calling thread, without locks.<BR>
+/// Call RakNet::WriteChromeTrace() to write the recorded zones of all threads to a file that chrome://tracing or https://ui.perfetto.dev can open.<BR>
+/// With CRABNET_TRACE 0, CRABNET_TRACE_ZONE and CRABNET_TRACE_THREAD_NAME compile to nothing.
+///
+
+
+#ifndef __RAK_TRACE_H
+#define __RAK_TRACE_H
+
+#include <stdint.h>
+#include "RakNetDefines.h"
+#include "Export.h"
+
+#if CRABNET_TRACE==1
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CRABNET_TRACE_USE_TSC 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define CRABNET_TRACE_USE_TSC 1
+#else
+#include <chrono>
+#define CRABNET_TRACE_USE_TSC 0
+#endif
+#endif
+
+namespace RakNet
+{
+    /// \brief Names the calling thread in the trace written by WriteChromeTrace()
+    /// \param[in] name Must stay valid until the trace is written, for example a string literal
+    void RAK_DLL_EXPORT SetTraceThreadName(const char *name);
+
+    /// \brief Writes the zones recorded so far by every thread as Chrome trace event JSON
+    /// \details Threads may keep recording while this runs. Only the last CRABNET_TRACE_BUFFER_EVENTS zones of each thread are kept
+    /// \return false if CRABNET_TRACE is 0, or \a filename could not be written
+    bool RAK_DLL_EXPORT WriteChromeTrace(const char *filename);
+
+    /// Discards the zones recorded so far by every thread
+    void RAK_DLL_EXPORT ClearTrace(void);
+
+#if CRABNET_TRACE==1
+    /// \internal
+    /// Timestamp counter on x86, so recording a zone does not need a system call. Converted to microseconds when the trace is written
+    inline uint64_t ReadTraceClock(void)
+    {
+#if CRABNET_TRACE_USE_TSC==1
+        return __rdtsc();
+#else
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    /// \internal
+    void RAK_DLL_EXPORT RecordTraceZone(const char *name, uint64_t start, uint64_t end);
+
+    /// \internal
+    /// Use CRABNET_TRACE_ZONE instead
+    class TraceZone
+    {
+    public:
+        TraceZone(const char *_name) : name(_name), start(ReadTraceClock()) {}
+        ~TraceZone() {RecordTraceZone(name, start, ReadTraceClock());}
+    private:
+        TraceZone(const TraceZone &);
+        TraceZone &operator=(const TraceZone &);
+
+        const char *name;
+        uint64_t start;
+    };
+
+#define CRABNET_TRACE_CONCAT_INTERNAL(a, b) a##b
+#define CRABNET_TRACE_CONCAT(a, b) CRABNET_TRACE_CONCAT_INTERNAL(a, b)
+/// Records the time from here to the end of the enclosing block. \a name must be a string literal
+#define CRABNET_TRACE_ZONE(name) RakNet::TraceZone CRABNET_TRACE_CONCAT(traceZone, __LINE__)(name)
+/// Same as SetTraceThreadName(), but compiles to nothing if CRABNET_TRACE is 0
+#define CRABNET_TRACE_THREAD_NAME(name) RakNet::SetTraceThreadName(name)
+#else
+#define CRABNET_TRACE_ZONE(name)
+#define CRABNET_TRACE_THREAD_NAME(name)
+#endif
+}
+
+#endif
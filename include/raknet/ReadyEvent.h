@@ -201,6 +201,7 @@ protected:
     // Packet handling functions
     // --------------------------------------------------------------------------------------------
     virtual PluginReceiveResult OnReceive(Packet *packet);
+    virtual bool GetReceiveMessageIDs(bool messageIds[256]) const;
     virtual void OnClosedConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, PI2_LostConnectionReason lostConnectionReason );
     virtual void OnRakPeerShutdown(void);
 
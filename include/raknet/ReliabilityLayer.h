@@ -29,10 +29,12 @@
 #include "DR_SHA1.h"
 #include "DS_OrderedList.h"
 #include "DS_RangeList.h"
+#include "DS_RangeBitmap.h"
 #include "DS_BPlusTree.h"
 #include "DS_MemoryPool.h"
 #include "RakNetDefines.h"
-#include "DS_Heap.h"
+#include "DS_MergedQueues.h"
+#include "DS_RadixHeap.h"
 #include "BitStream.h"
 #include "NativeFeatureIncludes.h"
 #include "SecureHandshake.h"
@@ -40,6 +42,7 @@
 #include "Rand.h"
 #include "RakNetSocket2.h"
 #include "SplitPacketList.h"
+#include <atomic>
 
 #if USE_SLIDING_WINDOW_CONGESTION_CONTROL!=1
 #include "CCRakNetUDT.h"
@@ -114,6 +117,23 @@ struct BPSTracker
 //    void ClearExpired2(RakNet::TimeUS time);
 };
 
+// Helper class
+// Only the thread that updates the ReliabilityLayer records values, so an increment is a relaxed load and store rather than a locked add
+// Copy() may run on any thread at the same time, and sees each bucket either before or after an increment
+struct LatencyHistogramTracker
+{
+    LatencyHistogramTracker();
+    void Reset();
+    inline void Record(uint64_t value)
+    {
+        std::atomic<uint32_t> &count=counts[LatencyHistogram::ValueToBucket(value)];
+        count.store(count.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+    }
+    void Copy(LatencyHistogram *histogram) const;
+
+    std::atomic<uint32_t> counts[LATENCY_HISTOGRAM_BUCKET_COUNT];
+};
+
 /// Datagram reliable, ordered, unordered and sequenced sends.  Flow control.  Message splitting, reassembly, and coalescence.
 class ReliabilityLayer//<ReliabilityLayer>
 {
@@ -152,9 +172,10 @@ public:
         RakNetSocket2 *s, RakNetRandom *rnr, CCTimeType timeRead, BitStream &updateBitStream);
 
     /// This allocates bytes and writes a user-level message to those bytes.
-    /// \param[out] data The message
+    /// \param[out] data The message. Free with rakFree_Ex(), unless it points to \a inlineBuffer
+    /// \param[in] inlineBuffer CRABNET_PACKET_INLINE_DATA_SIZE bytes. Messages that fit are copied here instead of allocated
     /// \return Returns number of BITS put into the buffer
-    BitSize_t Receive( unsigned char**data );
+    BitSize_t Receive( unsigned char**data, unsigned char *inlineBuffer );
 
     /// Puts data on the send queue
     /// \param[in] data The data to send
@@ -192,6 +213,9 @@ public:
     /// \return A pointer to a static struct, filled out with current statistical information.
     RakNetStatistics * GetStatistics( RakNetStatistics *rns );
 
+    /// Copies the latency histograms to \a histograms
+    void GetLatencyHistograms( RakNetLatencyHistograms *histograms );
+
     ///Are we waiting for any data to be sent out or be processed by the player?
     bool IsOutgoingDataWaiting(void);
     bool AreAcksWaiting(void);
@@ -400,7 +424,8 @@ private:
 //    CCTimeType lastPacketlossTime;
 
     //DataStructures::Queue<InternalPacket*> sendPacketSet[ NUMBER_OF_PRIORITIES ];
-    DataStructures::Heap<reliabilityHeapWeightType, InternalPacket*, false> outgoingPacketBuffer;
+    // One queue per priority, as GetNextWeight() returns increasing weights for each priority until the buffer empties
+    DataStructures::MergedQueues<reliabilityHeapWeightType, InternalPacket*, NUMBER_OF_PRIORITIES> outgoingPacketBuffer;
     reliabilityHeapWeightType outgoingPacketBufferNextWeights[NUMBER_OF_PRIORITIES];
     void InitHeapWeights(void);
     reliabilityHeapWeightType GetNextWeight(int priorityLevel);
@@ -448,7 +473,8 @@ private:
     OrderingIndexType orderedReadIndex[NUMBER_OF_ORDERED_STREAMS];
     // Highest value received for sequencedWriteIndex for the current value of orderedReadIndex on the same channel.
     OrderingIndexType highestSequencedReadIndex[NUMBER_OF_ORDERED_STREAMS];
-    DataStructures::Heap<reliabilityHeapWeightType, InternalPacket*, false> orderingHeaps[NUMBER_OF_ORDERED_STREAMS];
+    // Messages are only pushed after orderedReadIndex, so weights never go below the last one popped
+    DataStructures::RadixHeap<reliabilityHeapWeightType, InternalPacket*> orderingHeaps[NUMBER_OF_ORDERED_STREAMS];
     OrderingIndexType heapIndexOffsets[NUMBER_OF_ORDERED_STREAMS];
 
 
@@ -564,8 +590,9 @@ private:
     InternalPacket* AllocateFromInternalPacketPool(void);
     void ReleaseToInternalPacketPool(InternalPacket *ip);
 
-    DataStructures::RangeList<DatagramSequenceNumberType> acknowlegements;
-    DataStructures::RangeList<DatagramSequenceNumberType> NAKs;
+    // Datagrams to ACK and NAK. Inserted into once per datagram received, in whatever order they arrive, so these are bitmaps rather than RangeLists
+    DataStructures::RangeBitmap<DatagramSequenceNumberType> acknowlegements;
+    DataStructures::RangeBitmap<DatagramSequenceNumberType> NAKs;
     bool remoteSystemNeedsBAndAS;
 
     unsigned int GetMaxDatagramSizeExcludingMessageHeaderBytes(void);
@@ -583,6 +610,11 @@ private:
     BPSTracker bpsMetrics[RNS_PER_SECOND_METRICS_COUNT];
     CCTimeType lastBpsClear;
 
+    LatencyHistogramTracker sendQueueTimeTracker[NUMBER_OF_PRIORITIES];
+    LatencyHistogramTracker deliveryTimeTracker[NUMBER_OF_PRIORITIES];
+    LatencyHistogramTracker ackRoundTripTimeTracker;
+    LatencyHistogramTracker resendCountTracker;
+
 #ifdef LIBCAT_SECURITY
 public:
     cat::AuthenticatedEncryption* GetAuthenticatedEncryption(void) { return &auth_enc; }
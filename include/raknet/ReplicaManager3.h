@@ -28,6 +28,11 @@
 #include "NetworkIDObject.h"
 #include "DS_OrderedList.h"
 #include "DS_Queue.h"
+#include "DS_OpenHash.h"
+#include "GridSectorizer.h"
+#include "SimpleMutex.h"
+#include "SignaledEvent.h"
+#include "ThreadPool.h"
 
 /// \defgroup REPLICA_MANAGER_GROUP3 ReplicaManager3
 /// \brief Third implementation of object replication
@@ -236,6 +241,60 @@ public:
     /// \param[in] intervalMS How frequently to autoserialize all objects. This controls the maximum number of game object updates per second.
     void SetAutoSerializeInterval(RakNet::Time intervalMS);
 
+    /// \brief Send serializations as a byte-level delta from the last serialization the remote system is known to have
+    /// \details When enabled, each channel of each replica is tracked per connection. A changed channel is XORed against the last acknowledged serialization for that connection, and the runs of unchanged bytes are compressed away.<BR>
+    /// A serialization becomes the baseline for future deltas as soon as it is sent if the channel uses RELIABLE_ORDERED or RELIABLE_ORDERED_WITH_ACK_RECEIPT, or when ID_SND_RECEIPT_ACKED arrives for it if the channel uses UNRELIABLE_WITH_ACK_RECEIPT or RELIABLE_WITH_ACK_RECEIPT.<BR>
+    /// Channels sent with any other reliability are always sent in full. If the delta would not be smaller than the full serialization, the full serialization is sent instead.<BR>
+    /// Both systems must enable it. Each tells the other whether it has when the connection is validated, and again whenever this is called. Until both have,
+    /// or if the remote system runs a version of ReplicaManager3 without delta serialization, serializations go out as ID_REPLICA_MANAGER_SERIALIZE unchanged.<BR>
+    /// Defaults to false.
+    /// \param[in] enabled True to send deltas where possible, false to always send the full serialization
+    void SetDeltaSerialization(bool enabled);
+
+    /// \return What was passed to SetDeltaSerialization()
+    bool GetDeltaSerialization(void) const;
+
+    /// \brief Serialize to each connection from worker threads during Update()
+    /// \details Normally Update() serializes every replica to every connection on the calling thread. With worker threads, each connection in a world is handled as a separate job, with the calling thread also taking jobs.
+    /// The messages are queued, then sent from the calling thread in connection order once all connections are done, so RakPeerInterface::Send() is never called from a worker.<BR>
+    /// Replica3::QuerySerialization(), Replica3::Serialize(), Replica3::OnSerializeTransmission() and Connection_RM3::QuerySerializationList() are then called from worker threads.
+    /// They are never called for the same replica from two threads at once, but may be for different replicas, so any state shared between replicas must be thread safe.<BR>
+    /// Replicas returning RM3SR_BROADCAST_IDENTICALLY or RM3SR_BROADCAST_IDENTICALLY_FORCE_SERIALIZATION are still only serialized once per tick, by whichever connection gets to them first.
+    /// \param[in] numThreads How many worker threads to start. 0 stops any running threads.
+    void StartSerializationThreads(int numThreads);
+
+    /// \brief Stops the threads started by StartSerializationThreads(), so Update() serializes on the calling thread again
+    void StopSerializationThreads(void);
+
+    /// \brief Enables spatial interest management for a world
+    /// \details Connections whose Connection_RM3::QueryConstructionMode() returns Connection_RM3::QUERY_INTEREST_GRID get every replica within their interest area constructed, and replicas that leave it destroyed.<BR>
+    /// Replicas are placed on the grid with SetInterestPosition(). Connections set their interest area with Connection_RM3::SetInterestArea().<BR>
+    /// The cost of Update() for such connections depends on the number of replicas near them, rather than the total number of replicas.<BR>
+    /// Choose a cell size close to the typical interest radius. Positions outside the world bounds are clamped to the edge cells.
+    /// \param[in] cellWidth Width of each grid cell, in world units
+    /// \param[in] cellHeight Height of each grid cell, in world units
+    /// \param[in] minX Lower X bound of the world
+    /// \param[in] minY Lower Y bound of the world
+    /// \param[in] maxX Upper X bound of the world
+    /// \param[in] maxY Upper Y bound of the world
+    /// \param[in] worldId Which world to enable interest management for
+    void SetInterestGrid(float cellWidth, float cellHeight, float minX, float minY, float maxX, float maxY, WorldId worldId=0);
+
+    /// \brief Places or moves a replica on the interest grid set with SetInterestGrid()
+    /// \details Call whenever the replica moves. Moves within the same grid cell are cheap.<BR>
+    /// Replicas that were never given a position are never constructed to connections using Connection_RM3::QUERY_INTEREST_GRID.
+    /// \param[in] replica3 A replica that was passed to Reference() for \a worldId
+    /// \param[in] x X position of the replica
+    /// \param[in] y Y position of the replica
+    /// \param[in] worldId Which world the replica is in
+    void SetInterestPosition(RakNet::Replica3 *replica3, float x, float y, WorldId worldId=0);
+
+    /// \brief Removes a replica from the interest grid
+    /// \details Connections using Connection_RM3::QUERY_INTEREST_GRID will destroy the replica on their next Update(). This is done automatically on Dereference()
+    /// \param[in] replica3 A replica that was passed to SetInterestPosition()
+    /// \param[in] worldId Which world the replica is in
+    void ClearInterestPosition(RakNet::Replica3 *replica3, WorldId worldId=0);
+
     /// \brief Return the connections that we think have an instance of the specified Replica3 instance
     /// \details This can be wrong, for example if that system locally deleted the outside the scope of ReplicaManager3, if QueryRemoteConstruction() returned false, or if DeserializeConstruction() returned false.
     /// \param[in] replica The replica to check against.
@@ -308,22 +367,26 @@ public:
     struct RM3World
     {
         RM3World();
+        ~RM3World();
         void Clear(ReplicaManager3 *replicaManager3);
 
         DataStructures::List<Connection_RM3*> connectionList;
         DataStructures::List<Replica3*> userReplicaList;
         WorldId worldId;
         NetworkIDManager *networkIDManager;
+        // Allocated by SetInterestGrid()
+        GridSectorizer *interestGrid;
     };
 protected:
     virtual PluginReceiveResult OnReceive(Packet *packet);
+    virtual bool GetReceiveMessageIDs(bool messageIds[256]) const;
     virtual void OnClosedConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, PI2_LostConnectionReason lostConnectionReason );
     virtual void OnNewConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, bool isIncoming);
     virtual void OnRakPeerShutdown(void);
     virtual void OnDetach(void);
 
     PluginReceiveResult OnConstruction(Packet *packet, unsigned char *packetData, int packetDataLength, RakNetGUID senderGuid, unsigned char packetDataOffset, WorldId worldId);
-    PluginReceiveResult OnSerialize(Packet *packet, unsigned char *packetData, int packetDataLength, RakNetGUID senderGuid, RakNet::Time timestamp, unsigned char packetDataOffset, WorldId worldId);
+    PluginReceiveResult OnSerialize(Packet *packet, unsigned char *packetData, int packetDataLength, RakNetGUID senderGuid, RakNet::Time timestamp, unsigned char packetDataOffset, WorldId worldId, bool isDeltaFormat);
     PluginReceiveResult OnDownloadStarted(Packet *packet, unsigned char *packetData, int packetDataLength, RakNetGUID senderGuid, unsigned char packetDataOffset, WorldId worldId);
     PluginReceiveResult OnDownloadComplete(Packet *packet, unsigned char *packetData, int packetDataLength, RakNetGUID senderGuid, unsigned char packetDataOffset, WorldId worldId);
 
@@ -336,7 +399,25 @@ protected:
     RakNet::Time autoSerializeInterval;
     RakNet::Time lastAutoSerializeOccurance;
     bool autoCreateConnections, autoDestroyConnections;
+    bool deltaSerialization;
     Replica3 *currentlyDeallocatingReplica;
+
+    // Serialization threads, see StartSerializationThreads()
+    struct SerializationThreadInput
+    {
+        ReplicaManager3 *replicaManager;
+        Connection_RM3 *connection;
+        WorldId worldId;
+        RakNet::Time time;
+    };
+    void SerializeToConnection(Connection_RM3 *connection, WorldId worldId, RakNet::Time time);
+    static int SerializeToConnectionCB(SerializationThreadInput input, bool *returnOutput, void* perThreadData);
+    void OnSerializationJobDone(void);
+    ThreadPool<SerializationThreadInput, int> serializationThreadPool;
+    // Connections of the world being serialized in parallel that are not done yet. Update() waits on serializationJobsDone, which is set when this reaches 0
+    unsigned int serializationJobsRemaining;
+    SimpleMutex serializationJobsMutex;
+    SignaledEvent serializationJobsDone;
     // Set on the first call to ReferenceInternal(), and should never be changed after that
     // Used to lookup in Replica3LSRComp. I don't want to rely on GetNetworkID() in case it changes at runtime
     uint32_t nextReferenceIndex;
@@ -351,6 +432,10 @@ protected:
 
 static const int RM3_NUM_OUTPUT_BITSTREAM_CHANNELS=16;
 
+/// How many past serializations are remembered per channel when delta serialization is enabled. See ReplicaManager3::SetDeltaSerialization()
+/// A delta is only sent if its baseline is less than this many serializations old, otherwise the full serialization is sent
+static const int RM3_DELTA_HISTORY_LENGTH=8;
+
 /// \ingroup REPLICA_MANAGER_GROUP3
 struct LastSerializationResultBS
 {
@@ -359,6 +444,46 @@ struct LastSerializationResultBS
     bool indicesToSend[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS];
 };
 
+/// \internal
+/// \brief Delta serialization state for one channel of one replica on one connection
+/// \details The sender remembers what it sent until the remote system is known to have it, the receiver remembers what it got so later deltas can be applied to it.
+/// \ingroup REPLICA_MANAGER_GROUP3
+struct RM3DeltaChannel
+{
+    RM3DeltaChannel();
+
+    /// Returns the remembered serialization with this sequence number, or 0 if it was never stored or was since overwritten
+    RakNet::BitStream *GetHistory(uint16_t sequence);
+
+    /// Remembers \a bitStream under \a sequence, unless a newer serialization already occupies that slot
+    void SetHistory(uint16_t sequence, RakNet::BitStream *bitStream);
+
+    /// Sender only. Sequence number of the next serialization sent on this channel
+    uint16_t nextSequence;
+
+    /// Sender only. True if \a baselineSequence is a serialization the remote system is known to have
+    bool hasBaseline;
+    uint16_t baselineSequence;
+
+    bool historyValid[RM3_DELTA_HISTORY_LENGTH];
+    uint16_t historySequence[RM3_DELTA_HISTORY_LENGTH];
+    RakNet::BitStream history[RM3_DELTA_HISTORY_LENGTH];
+};
+
+/// \internal
+/// \brief Delta serialization state for all channels of one replica on one connection. Channels are allocated on first use
+/// \ingroup REPLICA_MANAGER_GROUP3
+struct RM3DeltaSerialization
+{
+    RM3DeltaSerialization();
+    ~RM3DeltaSerialization();
+
+    /// Returns the state for \a channelIndex, allocating it if necessary
+    RM3DeltaChannel *GetChannel(int channelIndex);
+
+    RM3DeltaChannel *channels[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS];
+};
+
 /// Represents the serialized data for an object the last time it was sent. Used by Connection_RM3::OnAutoserializeInterval() and Connection_RM3::SendSerializeIfChanged()
 /// \ingroup REPLICA_MANAGER_GROUP3
 struct LastSerializationResult
@@ -375,6 +500,12 @@ struct LastSerializationResult
 
     void AllocBS(void);
     LastSerializationResultBS* lastSerializationResultBS;
+
+    /// Allocated on first use when ReplicaManager3::SetDeltaSerialization() is enabled
+    void AllocDelta(void);
+    /// Forget all delta baselines, so the next serialization is sent in full
+    void ClearDelta(void);
+    RM3DeltaSerialization* deltaSerialization;
 };
 
 /// Parameters passed to Replica3::Serialize()
@@ -507,9 +638,29 @@ public:
         /// Call Connection_RM3::QueryReplicaList() to determine which objects exist on remote systems
         /// This can be faster than QUERY_REPLICA_FOR_CONSTRUCTION and QUERY_REPLICA_FOR_CONSTRUCTION_AND_DESTRUCTION for large worlds
         /// See GridSectorizer.h under /Source for code that can help with this
-        QUERY_CONNECTION_FOR_REPLICA_LIST
+        QUERY_CONNECTION_FOR_REPLICA_LIST,
+
+        /// Do not call Replica3::QueryConstruction(), Replica3::QueryDestruction() or Connection_RM3::QueryReplicaList()
+        /// Replicas placed with ReplicaManager3::SetInterestPosition() within the area set by SetInterestArea() are constructed. Those that leave it are destroyed.
+        /// Replicas created by this remote system are never destroyed this way.
+        /// Requires ReplicaManager3::SetInterestGrid() for the world this connection is in
+        QUERY_INTEREST_GRID
     };
 
+    /// \brief Sets the area this connection is interested in, used when QueryConstructionMode() returns QUERY_INTEREST_GRID
+    /// \details Typically called every tick with the position of the player this connection controls.<BR>
+    /// Replicas are constructed once they are within \a enterRadius, and destroyed once they are further than \a leaveRadius.
+    /// A \a leaveRadius somewhat larger than \a enterRadius stops replicas near the edge from being constructed and destroyed repeatedly.
+    /// \param[in] x X position of the center of the area
+    /// \param[in] y Y position of the center of the area
+    /// \param[in] enterRadius Distance at which replicas are constructed to this connection
+    /// \param[in] leaveRadius Distance at which replicas are destroyed on this connection. Should be at least \a enterRadius
+    void SetInterestArea(float x, float y, float enterRadius, float leaveRadius);
+
+    /// \brief Clears the area set with SetInterestArea()
+    /// \details All replicas that were constructed because they were within the area will be destroyed on the next Update()
+    void ClearInterestArea(void);
+
     /// \brief Return whether or not downloads to our system should all be processed the same tick (call to RakPeer::Receive() )
     /// \details Normally the system will send ID_REPLICA_MANAGER_DOWNLOAD_STARTED, ID_REPLICA_MANAGER_CONSTRUCTION for all downloaded objects,
     /// ID_REPLICA_MANAGER_SERIALIZE for each downloaded object, and lastly ID_REPLICA_MANAGER_DOWNLOAD_COMPLETE.
@@ -575,6 +726,21 @@ public:
     /// \param[in] curTime The current time
     virtual SendSerializeIfChangedResult SendSerializeIfChanged(LastSerializationResult *lsr, SerializeParameters *sp, RakNet::RakPeerInterface *rakPeer, unsigned char worldId, ReplicaManager3 *replicaManager, RakNet::Time curTime);
 
+    /// \brief Writes \a state as a delta from \a baseline
+    /// \details The two are XORed byte by byte, with \a baseline treated as zero padded if it is shorter. The result is written as alternating runs of zero bytes and literal bytes.<BR>
+    /// Used by delta serialization, see ReplicaManager3::SetDeltaSerialization()
+    /// \param[in] baseline Serialization the remote system already has
+    /// \param[in] state Serialization to send
+    /// \param[out] out The delta is appended here
+    static void EncodeSerializationDelta(const RakNet::BitStream *baseline, const RakNet::BitStream *state, RakNet::BitStream *out);
+
+    /// \brief Reverses EncodeSerializationDelta()
+    /// \param[in] baseline The same baseline passed to EncodeSerializationDelta()
+    /// \param[in] in Bitstream positioned at the delta
+    /// \param[out] state The reconstructed serialization is written here
+    /// \return false if \a in was malformed
+    static bool DecodeSerializationDelta(const RakNet::BitStream *baseline, RakNet::BitStream *in, RakNet::BitStream *state);
+
     /// \internal
     /// \brief Given a list of objects that were created and destroyed, serialize and send them to another system.
     /// \param[in] newObjects Objects to serialize construction
@@ -586,7 +752,8 @@ public:
     virtual void SendConstruction(DataStructures::List<Replica3*> &newObjects, DataStructures::List<Replica3*> &deletedObjects, PRO sendParameters, RakNet::RakPeerInterface *rakPeer, unsigned char worldId, ReplicaManager3 *replicaManager3);
 
     /// \internal
-    void SendValidation(RakNet::RakPeerInterface *rakPeer, WorldId worldId);
+    /// \param[in] deltaSerialization Tells the remote system whether we accept ID_REPLICA_MANAGER_SERIALIZE_DELTA. See ReplicaManager3::SetDeltaSerialization()
+    void SendValidation(RakNet::RakPeerInterface *rakPeer, WorldId worldId, bool deltaSerialization);
 
     /// \internal
     void AutoConstructByQuery(ReplicaManager3 *replicaManager3, WorldId worldId);
@@ -664,7 +831,30 @@ protected:
     void OnSendDestructionFromQuery(unsigned int queryToDestructIdx, ReplicaManager3 *replicaManager);
     void OnDoNotQueryDestruction(unsigned int queryToDestructIdx, ReplicaManager3 *replicaManager);
     void ValidateLists(ReplicaManager3 *replicaManager) const;
-    void SendSerializeHeader(RakNet::Replica3 *replica, RakNet::Time timestamp, RakNet::BitStream *bs, WorldId worldId);
+    void SendSerializeHeader(RakNet::Replica3 *replica, RakNet::Time timestamp, RakNet::BitStream *bs, WorldId worldId, bool isDeltaFormat);
+    bool WriteSerializeChannel(LastSerializationResult *deltaLsr, int channelIndex, const PRO &pro, RakNet::BitStream *channelData, RakNet::BitStream *out, uint16_t *sequenceOut);
+    void OnSerializeChannelsSent(LastSerializationResult *deltaLsr, const PRO &pro, uint32_t sendReceipt, bool sentChannels[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS], uint16_t sentSequences[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS]);
+    void OnDeltaSendReceipt(uint32_t sendReceipt, bool wasAcked);
+    SendSerializeIfChangedResult SendSerializeIfChangedLocked(LastSerializationResult *lsr, SerializeParameters *sp, RakNet::RakPeerInterface *rakPeer, unsigned char worldId, ReplicaManager3 *replicaManager, RakNet::Time curTime);
+    void SendSerializeMessage(RakNet::BitStream *out, const PRO &pro, RakNet::RakPeerInterface *rakPeer, LastSerializationResult *deltaLsr, bool sentChannels[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS], uint16_t sentSequences[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS]);
+    void SendDeferredSerializations(RakNet::RakPeerInterface *rakPeer);
+    void QueryInterestGrid(ReplicaManager3 *replicaManager3, WorldId worldId, DataStructures::List<Replica3*> &newReplicasToCreate, DataStructures::List<Replica3*> &existingReplicasToDestroy);
+    LastSerializationResult *GetConstructedLSRByReferenceIndex(uint32_t referenceIndex);
+
+    // Serializations sent with UNRELIABLE_WITH_ACK_RECEIPT or RELIABLE_WITH_ACK_RECEIPT while delta serialization is enabled
+    // When the receipt is acked, that serialization becomes the baseline for its channel
+    struct DeltaPendingAck
+    {
+        uint32_t referenceIndex;
+        unsigned char channelIndex;
+        uint16_t sequence;
+    };
+    static unsigned long SendReceiptToInteger(const uint32_t &sendReceipt);
+    // Keyed by sendReceipt, with one entry per channel sent in that message
+    DataStructures::OpenHash<uint32_t, DeltaPendingAck, Connection_RM3::SendReceiptToInteger> deltaPendingAcks;
+
+    // The remote system accepts ID_REPLICA_MANAGER_SERIALIZE_DELTA, as sent with its validation
+    bool remoteDeltaSerialization;
 
     // The list of objects that our local system and this remote system both have
     // Either we sent this object to them, or they sent this object to us
@@ -694,6 +884,23 @@ protected:
     // Stores if we got download complete for this connection
     bool gotDownloadComplete;
 
+    // Set with SetInterestArea(), used if QueryConstructionMode() returns QUERY_INTEREST_GRID
+    bool hasInterestArea;
+    float interestAreaX, interestAreaY, interestEnterRadius, interestLeaveRadius;
+    DataStructures::List<void*> interestQueryResult;
+
+    // Set while a worker thread from ReplicaManager3::StartSerializationThreads() serializes to this connection. Sends are queued in deferredSerializeSends until it is done
+    bool isSerializingInParallel;
+    struct DeferredSerializeSend
+    {
+        RakNet::BitStream bitStream;
+        PRO pro;
+        LastSerializationResult *deltaLsr;
+        bool sentChannels[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS];
+        uint16_t sentSequences[RM3_NUM_OUTPUT_BITSTREAM_CHANNELS];
+    };
+    DataStructures::List<DeferredSerializeSend*> deferredSerializeSends;
+
     friend class ReplicaManager3;
 private:
     Connection_RM3() {};
@@ -1091,6 +1298,31 @@ public:
     bool forceSendUntilNextUpdate;
     LastSerializationResult *lsr;
     uint32_t referenceIndex;
+
+    /// \internal
+    /// Held while serializing this replica to a connection from a worker thread. See ReplicaManager3::StartSerializationThreads()
+    SimpleMutex serializationMutex;
+
+    /// \internal
+    /// Set with ReplicaManager3::SetInterestPosition()
+    bool hasInterestPosition;
+    float interestX, interestY;
+
+    /// \internal
+    /// Returns the serializations received from \a sourceGuid, used to apply deltas. See ReplicaManager3::SetDeltaSerialization()
+    RM3DeltaSerialization *GetReceivedDeltaSerialization(RakNetGUID sourceGuid);
+
+    /// \internal
+    /// Forgets the serializations received from \a sourceGuid, for when that system starts over with a new connection or construction
+    void ClearReceivedDeltaSerialization(RakNetGUID sourceGuid);
+
+    /// \internal
+    struct ReceivedDeltaSerialization
+    {
+        RakNetGUID sourceGuid;
+        RM3DeltaSerialization *deltaSerialization;
+    };
+    DataStructures::List<ReceivedDeltaSerialization> receivedDeltaSerializations;
 };
 
 /// \brief Use Replica3 through composition instead of inheritance by containing an instance of this templated class
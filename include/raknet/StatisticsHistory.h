@@ -33,6 +33,7 @@ namespace RakNet
 {
 /// Forward declarations
 class RakPeerInterface;
+struct LatencyHistogram;
 
 // Type used to track values. If needed, change to double and recompile
 typedef double SHValueType;
@@ -216,6 +217,10 @@ protected:
     virtual void Update(void);
     virtual void OnClosedConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, PI2_LostConnectionReason lostConnectionReason );
     virtual void OnNewConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, bool isIncoming);
+    virtual bool GetReceiveMessageIDs(bool messageIds[256]) const;
+
+    // Adds key_p50, key_p99 and key_p999. Histograms cover the whole connection, so these are percentiles since the connection started
+    void AddLatencyHistogram(unsigned int objectIndex, const char *key, const LatencyHistogram &histogram, Time curTime);
 
     // Too slow
 //     virtual bool UsesReliabilityLayer(void) const {return true;}
@@ -29,6 +29,10 @@ public:
     static void SerializeTable(DataStructures::Table *in, RakNet::BitStream *out);
     static bool DeserializeTable(unsigned char *serializedTable, unsigned int dataLength, DataStructures::Table *out);
     static bool DeserializeTable(RakNet::BitStream *in, DataStructures::Table *out);
+    // Writes the column block added with Table::AddColumnBlock() for columnIndex, in one pass over its arrays rather than over the rows. Returns false if there is no column block
+    static bool SerializeColumnBlock(DataStructures::Table *in, unsigned columnIndex, RakNet::BitStream *out);
+    // Writes a column read from SerializeColumnBlock() into the rows of out with the same IDs, which must have a column of the same type at the same index. Rows out does not have are skipped
+    static bool DeserializeColumnBlock(RakNet::BitStream *in, DataStructures::Table *out);
     static void SerializeColumns(DataStructures::Table *in, RakNet::BitStream *out);
     static void SerializeColumns(DataStructures::Table *in, RakNet::BitStream *out, DataStructures::List<int> &skipColumnIndices);
     static bool DeserializeColumns(RakNet::BitStream *in, DataStructures::Table *out);
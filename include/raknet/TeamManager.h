@@ -30,7 +30,7 @@
 #include <stdint.h>
 #include "DS_List.h"
 #include "RakNetTypes.h"
-#include "DS_Hash.h"
+#include "DS_OpenHash.h"
 #include "DS_OrderedList.h"
 
 namespace RakNet
@@ -580,9 +580,9 @@ protected:
     TeamMemberLimit GetBalancedTeamLimit(void) const;
 
     // For fast lookup. Shares pointers with list teams
-    DataStructures::Hash<NetworkID, TM_Team*, 256, TM_Team::ToUint32> teamsHash;
+    DataStructures::OpenHash<NetworkID, TM_Team*, TM_Team::ToUint32> teamsHash;
     // For fast lookup. Shares pointers with list teamMembers
-    DataStructures::Hash<NetworkID, TM_TeamMember*, 256, TM_TeamMember::ToUint32> teamMembersHash;
+    DataStructures::OpenHash<NetworkID, TM_TeamMember*, TM_TeamMember::ToUint32> teamMembersHash;
 
     TeamManager *teamManager;
     DataStructures::List<RakNetGUID> participants;
@@ -698,6 +698,7 @@ protected:
 
     virtual void Update(void);
     virtual PluginReceiveResult OnReceive(Packet *packet);
+    virtual bool GetReceiveMessageIDs(bool messageIds[256]) const;
     virtual void OnClosedConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, PI2_LostConnectionReason lostConnectionReason );
     virtual void OnNewConnection(const SystemAddress &systemAddress, RakNetGUID rakNetGUID, bool isIncoming);
     void Send( const RakNet::BitStream * bitStream, const AddressOrGUID systemIdentifier, bool broadcast );
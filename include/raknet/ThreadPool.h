@@ -70,6 +70,12 @@ struct RAK_DLL_EXPORT ThreadPool
     /// \param[in] outputData The output to inject
     void AddOutput(OutputType outputData);
 
+    /// Runs the functions waiting in the input queue on the calling thread until it is empty, as the threads would.
+    /// Use it to help out rather than wait idle for the threads to finish input you added
+    /// \param[in] perThreadData Passed to each function
+    /// \return How many functions were run
+    unsigned RunInput(void *perThreadData=0);
+
     /// Returns true if output from GetOutput is waiting.
     /// \return true if output is waiting, false otherwise
     bool HasOutput(void);
@@ -184,6 +190,8 @@ protected:
     int numThreadsWorking;
     /// \internal
     RakNet::SimpleMutex numThreadsRunningMutex;
+    /// \internal Set when a thread starts or stops, so StartThreads() and StopThreads() need not poll numThreadsRunning
+    RakNet::SignaledEvent numThreadsRunningEvent;
 
     RakNet::SignaledEvent quitAndIncomingDataEvents;
 
@@ -239,6 +247,7 @@ void* WorkerThread( void* arguments )
     // Increase numThreadsRunning
     threadPool->numThreadsRunningMutex.Lock();
     ++threadPool->numThreadsRunning;
+    threadPool->numThreadsRunningEvent.SetEvent();
     threadPool->numThreadsRunningMutex.Unlock();
 
     while (1)
@@ -291,16 +300,18 @@ void* WorkerThread( void* arguments )
         threadPool->workingThreadCountMutex.Unlock();
     }
 
-    // Decrease numThreadsRunning
-    threadPool->numThreadsRunningMutex.Lock();
-    --threadPool->numThreadsRunning;
-    threadPool->numThreadsRunningMutex.Unlock();
-
+    // Before decreasing numThreadsRunning, as StopThreads() returns as soon as it reaches 0 and the pool may then be restarted or destroyed
     if (threadPool->perThreadDataDestructor)
         threadPool->perThreadDataDestructor(perThreadData);
     else if (threadPool->threadDataInterface)
         threadPool->threadDataInterface->PerThreadDestructor(perThreadData, threadPool->tdiContext);
 
+    // Decrease numThreadsRunning. Set the event before unlocking, as StopThreads() closes it once it sees 0
+    threadPool->numThreadsRunningMutex.Lock();
+    --threadPool->numThreadsRunning;
+    threadPool->numThreadsRunningEvent.SetEvent();
+    threadPool->numThreadsRunningMutex.Unlock();
+
     return 0;
 }
 
@@ -339,6 +350,7 @@ bool ThreadPool<InputType, OutputType>::StartThreads(int numThreads, int stackSi
     runThreadsMutex.Unlock();
 
     quitAndIncomingDataEvents.InitEvent();
+    numThreadsRunningEvent.InitEvent();
 
     perThreadDataFactory=_perThreadDataFactory;
     perThreadDataDestructor=_perThreadDataDestructor;
@@ -370,11 +382,12 @@ bool ThreadPool<InputType, OutputType>::StartThreads(int numThreads, int stackSi
     bool done=false;
     while (done==false)
     {
-        RakSleep(50);
         numThreadsRunningMutex.Lock();
         if (numThreadsRunning==numThreads)
             done=true;
         numThreadsRunningMutex.Unlock();
+        if (done==false)
+            numThreadsRunningEvent.WaitOnEvent(1000);
     }
 
     return true;
@@ -398,20 +411,22 @@ void ThreadPool<InputType, OutputType>::StopThreads(void)
     runThreads=false;
     runThreadsMutex.Unlock();
 
-    // Wait for number of threads running to decrease to 0
+    // Wait for number of threads running to decrease to 0. Wake the threads again each time one stops, in case the event only woke one
     bool done=false;
     while (done==false)
     {
         quitAndIncomingDataEvents.SetEvent();
 
-        RakSleep(50);
         numThreadsRunningMutex.Lock();
         if (numThreadsRunning==0)
             done=true;
         numThreadsRunningMutex.Unlock();
+        if (done==false)
+            numThreadsRunningEvent.WaitOnEvent(1000);
     }
 
     quitAndIncomingDataEvents.CloseEvent();
+    numThreadsRunningEvent.CloseEvent();
 
 // #if defined(SN_TARGET_PSP2)
 //     RakNet::RakThread::DeallocRuntime(runtime);
@@ -430,6 +445,33 @@ void ThreadPool<InputType, OutputType>::AddInput(OutputType (*workerThreadCallba
     quitAndIncomingDataEvents.SetEvent();
 }
 template <class InputType, class OutputType>
+unsigned ThreadPool<InputType, OutputType>::RunInput(void *perThreadData)
+{
+    unsigned numRun=0;
+    for (;;)
+    {
+        inputQueueMutex.Lock();
+        if (inputFunctionQueue.Size()==0)
+        {
+            inputQueueMutex.Unlock();
+            return numRun;
+        }
+        OutputType (*userCallback)(InputType, bool *, void*)=inputFunctionQueue.Pop();
+        InputType inputData=inputQueue.Pop();
+        inputQueueMutex.Unlock();
+
+        bool returnOutput;
+        OutputType callbackOutput=userCallback(inputData, &returnOutput, perThreadData);
+        if (returnOutput)
+        {
+            outputQueueMutex.Lock();
+            outputQueue.Push(callbackOutput);
+            outputQueueMutex.Unlock();
+        }
+        numRun++;
+    }
+}
+template <class InputType, class OutputType>
 void ThreadPool<InputType, OutputType>::AddOutput(OutputType outputData)
 {
     outputQueueMutex.Lock();